@@ -0,0 +1,227 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "app.h"
+#include "anim.h"
+#include "blit.h"
+#include "instance.h"
+
+//______________________________________________________________________________
+
+typedef struct
+{
+	const u8 *data;
+	u16 size;
+	u16 pos;			// next byte to decode
+	u8 loop;
+	u8 drawing;			// part way through a frame
+	u8 index;			// next pad in the frame
+	u8 op;				// span being drawn, and pads left in it
+	u8 left;
+	u16 frames;			// drawn in full
+	u16 speed;
+	s32 wait;			// until the next frame is due, in 1/256 ms
+} Player;
+
+static INSTANCE Player g_Player = { 0, 0, 0, 0, 0, 0, 0, 0, 0, ANIM_SPEED_NORMAL, 0 };
+
+//______________________________________________________________________________
+
+void anim_play(const u8 *data, u16 size, u8 loop)
+{
+	anim_stop();
+	
+	if (size < ANIM_HEADER_SIZE + 1 || data[0] != ANIM_MAGIC)
+	{
+		return;
+	}
+	
+	u16 length = (data[1] << 7) | data[2];
+	
+	if (length > size || length < ANIM_HEADER_SIZE + 1)
+	{
+		return;
+	}
+	
+	Player *p = &g_Player;
+	
+	p->data = data;
+	p->size = length;
+	p->pos = ANIM_HEADER_SIZE;
+	p->loop = loop;
+	p->frames = 0;
+	p->wait = 0;
+}
+
+void anim_stop()
+{
+	g_Player.data = 0;
+	g_Player.drawing = 0;
+	g_Player.left = 0;
+}
+
+u8 anim_playing()
+{
+	return g_Player.data != 0;
+}
+
+u16 anim_frame()
+{
+	return g_Player.frames;
+}
+
+void anim_set_speed(u16 speed)
+{
+	g_Player.speed = speed;
+}
+
+//______________________________________________________________________________
+
+// read the next frame's duration, going round again at the end if looping
+static u8 start_frame(Player *p)
+{
+	if (p->pos < p->size && p->data[p->pos] == ANIM_END && p->loop && p->frames)
+	{
+		p->pos = ANIM_HEADER_SIZE;
+	}
+	
+	if (p->size - p->pos < 2 || p->data[p->pos] > 0x7F)
+	{
+		return 0;
+	}
+	
+	p->wait += (s32)(((p->data[p->pos] << 7) | p->data[p->pos + 1]) << 8);
+	p->pos += 2;
+	p->drawing = 1;
+	p->index = 0;
+	p->left = 0;
+	
+	return 1;
+}
+
+// draw up to budget pads of the frame, returning what's left of the budget,
+// or -1 if the frame is corrupt
+static s16 draw(Player *p, s16 budget)
+{
+	const u8 *data = p->data;
+	
+	while (budget > 0)
+	{
+		if (!p->left)
+		{
+			if (p->pos >= p->size)
+			{
+				return -1;
+			}
+			
+			u8 op = data[p->pos++];
+			
+			if (op == ANIM_END_FRAME)
+			{
+				p->drawing = 0;
+				break;
+			}
+			
+			if (op < BLIT_OP_LITERAL)
+			{
+				if (op + 1 > BLIT_LED_COUNT - p->index)
+				{
+					return -1;
+				}
+				
+				p->index += op + 1;
+				continue;
+			}
+			
+			p->op = op;
+			p->left = (op & 0x1F) + 1;
+			
+			u8 bytes = op < BLIT_OP_RUN ? 3 * p->left : 3;
+			
+			if (op > 0x7F || p->left > BLIT_LED_COUNT - p->index || p->size - p->pos < bytes)
+			{
+				return -1;
+			}
+		}
+		
+		const u8 *c = data + p->pos;
+		
+		hal_plot_led(TYPEPAD, p->index++, c[0], c[1], c[2]);
+		--budget;
+		
+		// a literal moves on every pad, a run once it's done
+		if (--p->left == 0 || p->op < BLIT_OP_RUN)
+		{
+			p->pos += 3;
+		}
+	}
+	
+	return budget;
+}
+
+void anim_tick(u16 ms)
+{
+	Player *p = &g_Player;
+	
+	if (!p->data)
+	{
+		return;
+	}
+	
+	p->wait -= (s32)ms * p->speed;
+	
+	if (!p->drawing)
+	{
+		// not due yet, or the end
+		if (p->wait > 0)
+		{
+			return;
+		}
+		
+		if (!start_frame(p))
+		{
+			anim_stop();
+			return;
+		}
+	}
+	
+	s16 budget = draw(p, ANIM_PADS_PER_TICK);
+	
+	if (budget < 0)
+	{
+		anim_stop();
+	}
+	else if (!p->drawing)
+	{
+		p->frames++;
+	}
+}
@@ -0,0 +1,108 @@
+#ifndef LAUNCHPAD_ANIM_H
+#define LAUNCHPAD_ANIM_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Compressed light show playback.  An animation is a header and a list of
+// frames, each coded against the one before with the same ops as a coded blit
+// (see blit.h), so pads that don't change cost nothing:
+//
+//   ANIM_MAGIC length(2)           header - length is of the whole animation
+//   duration(2) ops... ANIM_END_FRAME
+//   duration(2) ops... ANIM_END_FRAME
+//   ...
+//   ANIM_END
+//
+// Two byte values are sent most significant 7 bits first, as in transfer.h.
+// duration is how long the frame shows for, in ms.  The first frame must be a
+// keyframe - one that sets every pad, with no skips - so that looping back to
+// it starts from a known state; the encoder can put in more (tools/animcode.h).
+//
+// Frames are decoded a few pads per tick straight into hal_plot_led, with no
+// frame buffer, so a keyframe takes several ticks to draw.  Frame timing runs
+// on the ms given to anim_tick, not on ticks, and a frame that takes longer
+// to draw than it's shown for makes up the time on the ones after it.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define ANIM_MAGIC				0x41
+#define ANIM_END_FRAME			0x80
+#define ANIM_END				0x81
+
+#define ANIM_HEADER_SIZE		3
+#define ANIM_MAX_DURATION		16383
+
+// most pads drawn per tick
+#define ANIM_PADS_PER_TICK		20
+
+// playback speed is 8.8 fixed point
+#define ANIM_SPEED_NORMAL		256
+
+/**
+ * Start playing an animation from the first frame.  It must stay put while it
+ * plays.  Does nothing (and stops any animation playing) if the header
+ * doesn't check out; corrupt frames stop playback where they go wrong.
+ *
+ * @param loop - nonzero to go back to the first frame after the last
+ */
+void anim_play(const u8 *data, u16 size, u8 loop);
+
+void anim_stop();
+
+/**
+ * Nonzero while an animation is playing.
+ */
+u8 anim_playing();
+
+/**
+ * How many frames have been drawn in full since anim_play.
+ */
+u16 anim_frame();
+
+/**
+ * Playback speed, ANIM_SPEED_NORMAL being as recorded.
+ */
+void anim_set_speed(u16 speed);
+
+/**
+ * Draw the next few pads that are due.  Call from app_timer_event.  At most
+ * one frame is finished per call, so the LEDs show it in full until the next.
+ *
+ * @param ms - time since the last call
+ */
+void anim_tick(u16 ms);
+
+#endif
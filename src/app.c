@@ -36,6 +36,23 @@
 //______________________________________________________________________________
 
 #include "app.h"
+#include "anim.h"
+#include "arena.h"
+#include "arp.h"
+#include "blit.h"
+#include "boot.h"
+#include "grid.h"
+#include "instance.h"
+#include "layout.h"
+#include "looper.h"
+#include "mod.h"
+#include "route.h"
+#include "seq.h"
+#include "sync.h"
+#include "sysex.h"
+#include "trace.h"
+#include "transfer.h"
+#include "velocity.h"
 
 //______________________________________________________________________________
 //
@@ -46,18 +63,287 @@
 // and recall the pad state from flash.
 //______________________________________________________________________________
 
-// store ADC frame pointer
-static const u16 *g_ADC = 0;
-
-// buffer to store pad states for flash save
 #define BUTTON_COUNT 100
 
-u8 g_Buttons[BUTTON_COUNT] = {0};
+// settings a host can change over SysEx
+typedef struct
+{
+    u8 velocity_curve;
+    u8 velocity_window;
+    u8 layout;
+    u8 root;
+    u16 scale;
+    u8 chord;
+    u8 arp_mode;
+    u16 arp_rate;
+    u16 arp_gate;
+    u8 arp_octaves;
+    u8 sync_source;
+    u16 tempo;
+    u8 arp_pulses;
+} AppConfig;
+
+static const AppConfig DEFAULT_CONFIG =
+{
+    VELOCITY_CURVE_LINEAR, VELOCITY_DEFAULT_WINDOW,
+    LAYOUT_CHROMATIC, 36, LAYOUT_SCALE_MAJOR,
+    ARP_CHORD_NONE, ARP_OFF, 125, 60, 1,
+    SYNC_INTERNAL, 125, SYNC_PPQN / 4
+};
+
+// things a host can dump and load with SysEx, by index - see transfer.h
+#define AREA_BUTTONS 0
+#define AREA_FLASH 1
+#define AREA_CONFIG 2
+#define AREA_ANIMATION 3
+#define AREA_PATTERN 4
+#define AREA_MOD 5
+#define AREA_COUNT 6
+
+// a light show to play at power up, kept in the user area after the buttons
+#define ANIMATION_FLASH_OFFSET 128
+#define ANIMATION_SIZE (USER_AREA_SIZE - ANIMATION_FLASH_OFFSET)
+
+// read a tick at a time at start up
+#define ANIMATION_CHUNK 256
+
+// everything claimed from the arena in app_init has to fit - see arena.h
+#define APP_ARENA_SIZE (ARENA_ROUND(TRACE_ARENA_SIZE) + ARENA_ROUND(SYSEX_ARENA_SIZE) + ARENA_ROUND(ANIMATION_SIZE) + ARENA_ROUND(SEQ_ARENA_SIZE) + ARENA_ROUND(MOD_ARENA_SIZE) + ARENA_ROUND(LOOPER_ARENA_SIZE))
+
+ARENA_CHECK(APP_ARENA_SIZE <= ARENA_SIZE, app_over_arena);
+
+// what the timer draws the pads from
+typedef struct
+{
+    // pad toggle states
+    u8 buttons[BUTTON_COUNT];
+    
+    // pads lit by incoming notes, by brightness
+    u8 note_lit[BUTTON_COUNT];
+} AppView;
+
+// which view is the front one, and whether the back one is behind it
+#define VIEW_INDEX 1
+#define VIEW_STALE 2
+
+// everything the app keeps - one per Launchpad, see instance.h
+typedef struct
+{
+    // store ADC frame pointer
+    const u16 *adc;
+    
+    // buffer to store pad states for flash save
+    u8 buttons[BUTTON_COUNT];
+    
+    // the timer draws from the front view, while the other callbacks change
+    // the back one - see begin_change
+    AppView views[2];
+    volatile u8 view;
+    volatile u8 changing;       // changes part way through
+    volatile u8 changed;
+    
+    // the note each grid pad started, so it's the one let go even if the
+    // layout changes while the pad is held
+    u8 pad_notes[PAD_COUNT];
+    
+    AppConfig config;
+    TransferArea areas[AREA_COUNT];
+    
+    // the light show, see anim.h - ANIMATION_SIZE, from the arena
+    u8 *animation;
+    
+    // start up - how much of the light show has been read, and whether a pad
+    // press stopped it before it started
+    u16 animation_read;
+    u8 animation_stopped;
+} App;
+
+static INSTANCE App g_App;
+
+//______________________________________________________________________________
+//
+// The callbacks can interrupt each other, so if the timer drew straight from
+// the state the other callbacks change, it could draw half of a note lighting
+// several pads.  Instead those changes go into a back view, which the timer
+// swaps to the front between frames by writing a single byte - no interrupts
+// are turned off.
+//
+// The swap leaves the new back view behind by whatever changed since the last
+// one, so it's marked stale, in the same byte, and the next change catches it
+// up first.  The timer doesn't swap while a change is part way through, in
+// case it interrupted it - that change goes out with the next frame.  Changes
+// nest, as an event can interrupt another in the middle of one, so it's a
+// count - the inner change balances it before the outer one carries on, so
+// the increment needn't be atomic.
+//______________________________________________________________________________
+
+static AppView *begin_change()
+{
+    ++g_App.changing;
+    
+    u8 view = g_App.view;
+    AppView *back = &g_App.views[(view & VIEW_INDEX) ^ 1];
+    
+    if (view & VIEW_STALE)
+    {
+        // a loop rather than a struct copy, which would need memcpy
+        const u8 *from = (const u8*)&g_App.views[view & VIEW_INDEX];
+        u8 *to = (u8*)back;
+        
+        for (u32 i=0; i < sizeof(AppView); ++i)
+        {
+            to[i] = from[i];
+        }
+        
+        g_App.view = view & VIEW_INDEX;
+    }
+    
+    return back;
+}
+
+static void end_change()
+{
+    g_App.changed = 1;
+    --g_App.changing;
+}
+
+static const AppView *publish()
+{
+    if (g_App.changed && !g_App.changing)
+    {
+        // cleared first, so a change that gets in before the swap still goes
+        // out with it, and again next time
+        g_App.changed = 0;
+        g_App.view = ((g_App.view & VIEW_INDEX) ^ 1) | VIEW_STALE;
+    }
+    
+    return &g_App.views[g_App.view & VIEW_INDEX];
+}
+
+//______________________________________________________________________________
+
+static void draw_buttons()
+{
+    AppView *view = begin_change();
+    
+    for (int i=0; i < BUTTON_COUNT; ++i)
+    {
+        view->buttons[i] = g_App.buttons[i];
+        hal_plot_led(TYPEPAD, i, 0, 0, g_App.buttons[i]);
+    }
+    
+    end_change();
+}
+
+static void animation_loaded()
+{
+    anim_play(g_App.animation, ANIMATION_SIZE, 1);
+}
+
+static void pattern_loading()
+{
+    // the step masks only match the pattern again once it's all in, so
+    // nothing plays until then
+    seq_stop();
+}
+
+static void pattern_loaded()
+{
+    seq_pattern_changed();
+    seq_start();
+}
+
+static void config_loaded()
+{
+    velocity_set_curve(g_App.config.velocity_curve);
+    velocity_set_window(g_App.config.velocity_window);
+    layout_set(g_App.config.layout, g_App.config.root, g_App.config.scale);
+    arp_set_chord(g_App.config.chord);
+    
+    // following external clock, the arpeggiator steps on its pulses
+    u8 synced = g_App.config.sync_source != SYNC_INTERNAL;
+    u16 rate = synced ? g_App.config.arp_pulses : g_App.config.arp_rate;
+    
+    arp_set_sync(synced);
+    arp_set_mode(g_App.config.arp_mode, g_App.config.arp_octaves, rate, g_App.config.arp_gate);
+    sync_set_source(g_App.config.sync_source);
+    sync_set_tempo(g_App.config.tempo);
+}
+
+//______________________________________________________________________________
+
+static u8 is_grid_pad(u8 index)
+{
+    return grid_test(&GRID_PADS, index);
+}
+
+static void velocity_note(u8 index, u8 velocity)
+{
+    // example - play the 8x8 grid using our own velocity estimate
+    if (!is_grid_pad(index))
+    {
+        return;
+    }
+    
+    // ...through the chord and arpeggiator engine - letting go of the note the
+    // pad started, whatever it plays now
+    u8 *held = &g_App.pad_notes[(index / 10 - 1) * 8 + index % 10 - 1];
+    
+    if (*held != LAYOUT_NO_NOTE)
+    {
+        arp_note_off(0, *held);
+        mod_note_off();
+        *held = LAYOUT_NO_NOTE;
+    }
+    
+    if (velocity)
+    {
+        u8 note = layout_note(index);
+        
+        if (note != LAYOUT_NO_NOTE)
+        {
+            *held = note;
+            arp_note_on(0, note, velocity);
+            mod_note_on();
+        }
+    }
+}
+
+static void arp_note(u8 channel, u8 note, u8 velocity)
+{
+    hal_send_midi(DINMIDI, NOTEON | channel, note, velocity);
+}
+
+static void seq_note(u8 channel, u8 note, u8 velocity)
+{
+    hal_send_midi(DINMIDI, NOTEON | channel, note, velocity);
+}
+
+static void mod_cc(u8 port, u8 channel, u8 cc, u8 value)
+{
+    hal_send_midi(port, CC | channel, cc, value);
+}
+
+static void looper_aftertouch(u8 index, u8 value)
+{
+    hal_send_midi(USBMIDI, POLYAFTERTOUCH | 0, index, value);
+}
+
+static void sync_pulse()
+{
+    // send a clock pulse up the USB
+    hal_send_midi(USBSTANDALONE, MIDITIMINGCLOCK, 0, 0);
+    
+    arp_pulse();
+    seq_pulse();
+}
 
 //______________________________________________________________________________
 
 void app_surface_event(u8 type, u8 index, u8 value)
 {
+    u8 trace = trace_begin(TRACE_SURFACE, type, index, value);
+    
     switch (type)
     {
         case  TYPEPAD:
@@ -65,68 +351,124 @@ void app_surface_event(u8 type, u8 index, u8 value)
             // toggle it and store it off, so we can save to flash if we want to
             if (value)
             {
-                g_Buttons[index] = MAXLED * !g_Buttons[index];
+                // ...and stop any light show, so the pads are seen
+                anim_stop();
+                g_App.animation_stopped = 1;
+                
+                // the saved states aren't in until start up is done, and a
+                // toggle before then would be lost when they're read
+                if (boot_ready())
+                {
+                    g_App.buttons[index] = MAXLED * !g_App.buttons[index];
+                    
+                    begin_change()->buttons[index] = g_App.buttons[index];
+                    end_change();
+                }
             }
             
             // example - light / extinguish pad LEDs
-            hal_plot_led(TYPEPAD, index, 0, 0, g_Buttons[index]);
+            hal_plot_led(TYPEPAD, index, 0, 0, g_App.buttons[index]);
             
-            // example - send MIDI
-            hal_send_midi(DINMIDI, NOTEON | 0, index, value);
+            // example - send MIDI.  The 8x8 grid is played by the velocity engine
+            // from the raw ADC data, so only the buttons around the edge go here.
+            if (!is_grid_pad(index))
+            {
+                hal_send_midi(DINMIDI, NOTEON | 0, index, value);
+            }
             
         }
         break;
             
         case TYPESETUP:
         {
-            if (value)
+            // nothing to save until start up has read the states back, and
+            // saving the blank ones before then would wipe them
+            if (value && boot_ready())
             {
                 // save button states to flash (reload them by power cycling the hardware!)
-                hal_write_flash(0, g_Buttons, BUTTON_COUNT);
+                hal_write_flash(0, g_App.buttons, BUTTON_COUNT);
             }
         }
         break;
     }
+    
+    trace_end(trace);
 }
 
 //______________________________________________________________________________
 
 void app_midi_event(u8 port, u8 status, u8 d1, u8 d2)
 {
-    // example - MIDI interface functionality for USB "MIDI" port -> DIN port
-    if (port == USBMIDI)
-    {
-        hal_send_midi(DINMIDI, status, d1, d2);
-    }
+    u8 trace = trace_begin(TRACE_MIDI, port, status, d1);
+    
+    // example - MIDI interface functionality, by default USB "MIDI" port <-> DIN
+    // port, but the host can change the routes over SysEx
+    route_midi(port, status, d1, d2);
     
-    // // example -MIDI interface functionality for DIN -> USB "MIDI" port port
-    if (port == DINMIDI)
+    // follow incoming MIDI clock, if set up to
+    sync_midi(port, status);
+    
+    // example - light up the pads that play incoming notes
+    u8 type = status & 0xF0;
+    
+    if (type == NOTEON || type == NOTEOFF)
     {
-        hal_send_midi(USBMIDI, status, d1, d2);
+        u8 count;
+        const u8 *pads = layout_pads(d1, &count);
+        u8 level = type == NOTEON ? d2 >> 1 : 0;
+        AppView *view = begin_change();
+        
+        for (u8 i=0; i < count; ++i)
+        {
+            view->note_lit[pads[i]] = level;
+        }
+        
+        end_change();
     }
+    
+    trace_end(trace);
 }
 
 //______________________________________________________________________________
 
 void app_sysex_event(u8 port, u8 * data, u16 count)
 {
-    // example - respond to UDI messages?
+    u8 trace = trace_begin(TRACE_SYSEX, port, count >> 7, count & 0x7F);
+    
+    // example - bulk dump and load of pad state, flash and settings, whole
+    // LED frames painted by the host, MIDI routing, the pressure looper and
+    // the trace ring
+    if (!transfer_sysex(port, data, count) && !blit_sysex(port, data, count) && !route_sysex(port, data, count) &&
+        !looper_sysex(port, data, count))
+    {
+        trace_sysex(port, data, count);
+    }
+    
+    trace_end(trace);
 }
 
 //______________________________________________________________________________
 
 void app_aftertouch_event(u8 index, u8 value)
 {
+    u8 trace = trace_begin(TRACE_AFTERTOUCH, index, value, 0);
+    
     // example - send poly aftertouch to MIDI ports
     hal_send_midi(USBMIDI, POLYAFTERTOUCH | 0, index, value);
     
+    // ...and have any pressure followers follow it, and the looper record it
+    mod_pressure(value);
+    looper_pressure(index, value);
     
+    trace_end(trace);
 }
 
 //______________________________________________________________________________
 
 void app_cable_event(u8 type, u8 value)
 {
+    u8 trace = trace_begin(TRACE_CABLE, type, value, 0);
+    
     // example - light the Setup LED to indicate cable connections
     if (type == MIDI_IN_CABLE)
     {
@@ -136,26 +478,17 @@ void app_cable_event(u8 type, u8 value)
     {
         hal_plot_led(TYPESETUP, 0, value, 0, 0); // red
     }
+    
+    trace_end(trace);
 }
 
 //______________________________________________________________________________
 
-void app_timer_event()
+static void draw_pads()
 {
-    // example - send MIDI clock at 125bpm
-#define TICK_MS 20
-    
-    static u8 ms = TICK_MS;
-    
-    if (++ms >= TICK_MS)
-    {
-        ms = 0;
-        
-        // send a clock pulse up the USB
-        hal_send_midi(USBSTANDALONE, MIDITIMINGCLOCK, 0, 0);
-    }
-    
-	// alternative example - show raw ADC data as LEDs
+	// alternative example - show raw ADC data as LEDs, over the latest view
+	const AppView *view = publish();
+	
 	for (int i=0; i < PAD_COUNT; ++i)
 	{
 		// raw adc values are 12 bit, but LEDs are 6 bit.
@@ -164,9 +497,16 @@ void app_timer_event()
 		u16 g = 0;
 		u16 b = 0;
 		
-		u16 x = (3 * MAXLED * g_ADC[i]) >> 12;
+		u16 x = (3 * MAXLED * g_App.adc[i]) >> 12;
+		u8 index = ADC_MAP[i];
 		
-		if (x < MAXLED)
+		if (x == 0)
+		{
+			// not pressed - show the toggle state, and any incoming notes
+			g = view->note_lit[index];
+			b = view->buttons[index];
+		}
+		else if (x < MAXLED)
 		{
 			r = x;
 		}
@@ -181,28 +521,198 @@ void app_timer_event()
 			b = x - 2*MAXLED;
 		}
 		
-		hal_plot_led(TYPEPAD, ADC_MAP[i], r, g, b);
+		hal_plot_led(TYPEPAD, index, r, g, b);
 	}
 }
 
 //______________________________________________________________________________
 
+void app_timer_event()
+{
+    u32 trace = trace_tick_begin();
+    
+    // finish starting up, see app_init, and mark the tick it's done in the trace
+    if (!boot_ready() && boot_poll())
+    {
+        trace_end(trace_begin(TRACE_BOOT, boot_stage(), 0, 0));
+    }
+    
+    // example - send MIDI clock at 125bpm, or pass on a cleaned up copy of
+    // incoming clock
+    sync_tick();
+    
+    // example - velocity sensitive notes from the raw ADC data, played
+    // through the arpeggiator
+    velocity_scan(g_App.adc);
+    arp_tick();
+    
+    // example - a step sequencer, playing a pattern a host loads
+    seq_tick();
+    
+    // LFOs, envelopes and pressure followers a host sets up, sending CCs
+    mod_tick();
+    
+    // pressure played back from a loop
+    looper_tick();
+    
+    // stream out any SysEx dump in progress
+    transfer_poll();
+    trace_poll();
+    
+    // a light show plays until a pad is pressed, and a host's blitted frame
+    // stays up for a while - otherwise show the pads
+    blit_tick();
+    
+    if (anim_playing())
+    {
+        anim_tick(1);
+    }
+    else if (!blit_showing())
+    {
+        draw_pads();
+    }
+    
+    trace_tick_end(trace);
+}
+
+//______________________________________________________________________________
+//
+// Start up, after app_init - see boot.h
+//______________________________________________________________________________
+
+static u8 boot_buttons()
+{
+    // example - load button states from flash, and light the LEDs to say hello!
+    hal_read_flash(0, g_App.buttons, BUTTON_COUNT);
+    draw_buttons();
+    
+    return 1;
+}
+
+static u8 boot_animation()
+{
+    // example - play the light show saved in flash, if there is one
+    u16 offset = g_App.animation_read;
+    u16 length = ANIMATION_SIZE - offset;
+    
+    if (length > ANIMATION_CHUNK)
+    {
+        length = ANIMATION_CHUNK;
+    }
+    
+    hal_read_flash(ANIMATION_FLASH_OFFSET + offset, g_App.animation + offset, length);
+    g_App.animation_read += length;
+    
+    if (g_App.animation_read < ANIMATION_SIZE)
+    {
+        return 0;
+    }
+    
+    if (!g_App.animation_stopped)
+    {
+        animation_loaded();
+    }
+    
+    return 1;
+}
+
+static const BootStage BOOT_STAGES[] =
+{
+    { "buttons", boot_buttons },
+    { "animation", boot_animation },
+};
+
+//______________________________________________________________________________
+
 void app_init(const u16 *adc_raw)
 {
-    // example - load button states from flash
-    hal_read_flash(0, g_Buttons, BUTTON_COUNT);
+    // modules claim their RAM from here on, until it's sealed below
+    arena_init();
+    
+    // keep a record of what the app does, for reading back after a problem
+    trace_init();
+    sysex_init();
+    
+    g_App.animation = arena_claim("animation", ANIMATION_SIZE, 1);
+    g_App.animation_read = 0;
+    g_App.animation_stopped = 0;
     
-    // example - light the LEDs to say hello!
-    for (int i=0; i < 10; ++i)
+    // nothing drawn until the buttons are read
+    u8 *views = (u8*)g_App.views;
+    
+    for (u32 i=0; i < sizeof(g_App.views); ++i)
     {
-        for (int j=0; j < 10; ++j)
-        {
-            u8 b = g_Buttons[j*10 + i];
-            
-            hal_plot_led(TYPEPAD, j*10 + i, 0, 0, b);
-        }
+        views[i] = 0;
     }
+    g_App.view = 0;
+    g_App.changing = 0;
+    g_App.changed = 0;
 	
 	// store off the raw ADC frame pointer for later use
-	g_ADC = adc_raw;
+	g_App.adc = adc_raw;
+    
+    g_App.config = DEFAULT_CONFIG;
+    
+    for (int i=0; i < PAD_COUNT; ++i)
+    {
+        g_App.pad_notes[i] = LAYOUT_NO_NOTE;
+    }
+    
+    velocity_init(velocity_note);
+    arp_init(arp_note);
+    sync_init(sync_pulse);
+    blit_init();
+    route_init();
+    config_loaded();
+    
+    // sixteenths, on the same clock as everything else
+    seq_init(seq_note);
+    seq_set_sync(1);
+    seq_set_rate(SYNC_PPQN / 4, SEQ_SWING_NONE);
+    
+    // no generators on until a host loads some
+    mod_init(mod_cc);
+    
+    // pressure loops, recorded when a host asks
+    looper_init(looper_aftertouch);
+    
+    // the areas point into this instance's state, so they're filled in here
+    TransferArea *areas = g_App.areas;
+    
+    areas[AREA_BUTTONS].ram = g_App.buttons;
+    areas[AREA_BUTTONS].size = BUTTON_COUNT;
+    areas[AREA_BUTTONS].loaded = draw_buttons;
+    areas[AREA_BUTTONS].loading = 0;
+    
+    areas[AREA_FLASH].ram = 0;
+    areas[AREA_FLASH].size = USER_AREA_SIZE;
+    areas[AREA_FLASH].loaded = 0;
+    areas[AREA_FLASH].loading = 0;
+    
+    areas[AREA_CONFIG].ram = (u8*)&g_App.config;
+    areas[AREA_CONFIG].size = sizeof(g_App.config);
+    areas[AREA_CONFIG].loaded = config_loaded;
+    areas[AREA_CONFIG].loading = 0;
+    
+    areas[AREA_ANIMATION].ram = g_App.animation;
+    areas[AREA_ANIMATION].size = ANIMATION_SIZE;
+    areas[AREA_ANIMATION].loaded = animation_loaded;
+    areas[AREA_ANIMATION].loading = 0;
+    
+    areas[AREA_PATTERN].ram = (u8*)seq_pattern();
+    areas[AREA_PATTERN].size = sizeof(SeqPattern);
+    areas[AREA_PATTERN].loaded = pattern_loaded;
+    areas[AREA_PATTERN].loading = pattern_loading;
+    
+    areas[AREA_MOD].ram = (u8*)mod_patch();
+    areas[AREA_MOD].size = sizeof(ModPatch);
+    areas[AREA_MOD].loaded = mod_patch_changed;
+    areas[AREA_MOD].loading = 0;
+    
+    transfer_init(areas, AREA_COUNT);
+    
+    arena_seal();
+    
+    // reading flash and drawing what it held is left to the first ticks
+    boot_init(BOOT_STAGES, sizeof(BOOT_STAGES) / sizeof(BOOT_STAGES[0]));
 }
@@ -0,0 +1,177 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "arena.h"
+#include "instance.h"
+
+//______________________________________________________________________________
+
+// words, so every claim at the default alignment is aligned.  On the device it
+// gets a section of its own, so the link can check the statics without it
+// (see stm32_flash.ld)
+#ifdef INSTANCE_PER_THREAD
+#define ARENA_SECTION
+#else
+#define ARENA_SECTION __attribute__((section(".bss.arena")))
+#endif
+
+static INSTANCE u32 g_Arena[ARENA_SIZE / sizeof(u32)] ARENA_SECTION;
+static INSTANCE u16 g_Used = 0;
+static INSTANCE u16 g_HighWater = 0;
+static INSTANCE u8 g_Sealed = 0;
+static INSTANCE u8 g_Failures = 0;
+
+static INSTANCE ArenaClaim g_Claims[ARENA_MAX_CLAIMS];
+static INSTANCE u8 g_ClaimCount = 0;
+
+//______________________________________________________________________________
+
+void arena_init()
+{
+	g_Used = 0;
+	g_Sealed = 0;
+	g_Failures = 0;
+	g_ClaimCount = 0;
+}
+
+void *arena_claim(const char *name, u16 size, u8 align)
+{
+	u8 *free = (u8*)g_Arena + g_Used;
+	u16 pad = align ? -(unsigned long)free & (align - 1) : 0;
+	
+	if (g_Sealed || !align || (align & (align - 1)) || pad + size > ARENA_SIZE - g_Used)
+	{
+		++g_Failures;
+		return 0;
+	}
+	
+	u8 *p = free + pad;
+	
+	for (u16 i=0; i < size; ++i)
+	{
+		p[i] = 0;
+	}
+	
+	if (g_ClaimCount < ARENA_MAX_CLAIMS)
+	{
+		ArenaClaim *c = &g_Claims[g_ClaimCount++];
+		
+		c->name = name;
+		c->offset = g_Used + pad;
+		c->size = size;
+	}
+	
+	g_Used += pad + size;
+	g_HighWater = g_Used > g_HighWater ? g_Used : g_HighWater;
+	
+	return p;
+}
+
+void arena_seal()
+{
+	g_Sealed = 1;
+}
+
+u16 arena_used()
+{
+	return g_Used;
+}
+
+u16 arena_high_water()
+{
+	return g_HighWater;
+}
+
+u8 arena_failures()
+{
+	return g_Failures;
+}
+
+u8 arena_claims(const ArenaClaim **claims)
+{
+	*claims = g_Claims;
+	return g_ClaimCount;
+}
+
+//______________________________________________________________________________
+
+u8 arena_pool_init(ArenaPool *pool, const char *name, u16 size, u8 count)
+{
+	size = ARENA_ROUND(size ? size : 1);
+	count = count < ARENA_POOL_EMPTY ? count : ARENA_POOL_EMPTY - 1;
+	
+	pool->blocks = arena_claim(name, size * count, ARENA_ALIGN);
+	pool->size = size;
+	pool->count = pool->blocks ? count : 0;
+	pool->used = 0;
+	pool->high_water = 0;
+	
+	// each free block starts with the index of the next
+	for (u8 i=0; i < pool->count; ++i)
+	{
+		pool->blocks[i * size] = i + 1 < pool->count ? i + 1 : ARENA_POOL_EMPTY;
+	}
+	
+	pool->free = pool->count ? 0 : ARENA_POOL_EMPTY;
+	
+	return pool->blocks != 0;
+}
+
+void *arena_pool_take(ArenaPool *pool)
+{
+	if (pool->free == ARENA_POOL_EMPTY)
+	{
+		return 0;
+	}
+	
+	u8 *block = pool->blocks + pool->free * pool->size;
+	
+	pool->free = block[0];
+	pool->used++;
+	pool->high_water = pool->used > pool->high_water ? pool->used : pool->high_water;
+	
+	return block;
+}
+
+void arena_pool_give(ArenaPool *pool, void *block)
+{
+	u8 *b = block;
+	
+	if (!b)
+	{
+		return;
+	}
+	
+	b[0] = pool->free;
+	pool->free = (b - pool->blocks) / pool->size;
+	pool->used--;
+}
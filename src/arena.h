@@ -0,0 +1,160 @@
+#ifndef LAUNCHPAD_ARENA_H
+#define LAUNCHPAD_ARENA_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// RAM for the app's modules.  Rather than each keeping its own static arrays,
+// modules claim what they need from one arena while app_init runs, after
+// which it's sealed - so what the app uses is known, and checked against a
+// budget when it compiles.  Runtime objects that come and go, like messages
+// being built, come from fixed block pools that are claimed the same way.
+//
+// The STM32F103 has 20K of RAM (stm32_flash.ld).  The closed library takes
+// about 2.8K of it (size lib/launchpad_pro.a) and the stack 512 bytes, and
+// modules still keep some state in their own statics; the arena has to fit
+// in what's left.  Each module's header gives what it claims, and app.c
+// checks that the total fits in ARENA_SIZE.  The statics, the library's
+// included, are checked against ARENA_LIBRARY_RAM + ARENA_STATICS_RAM when
+// the firmware links (stm32_flash.ld).
+//
+// Like the rest of the app's state the arena is per instance (instance.h), so
+// the simulator runs the same allocator and can report on it.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define ARENA_RAM_SIZE			(20 * 1024)
+#define ARENA_LIBRARY_RAM		(3 * 1024)
+#define ARENA_STACK_SIZE		0x200
+#define ARENA_STATICS_RAM		(4 * 1024)
+#define ARENA_BUDGET			(ARENA_RAM_SIZE - ARENA_LIBRARY_RAM - ARENA_STACK_SIZE - ARENA_STATICS_RAM)
+
+#define ARENA_SIZE				9216
+
+// what a claim of n bytes at the default alignment takes, padding included
+#define ARENA_ALIGN				4
+#define ARENA_ROUND(n)			(((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+// claims the profile keeps track of
+#define ARENA_MAX_CLAIMS		16
+
+/**
+ * Fail to compile if a condition isn't met.  name says what went wrong.
+ */
+#define ARENA_CHECK(condition, name) typedef char name[(condition) ? 1 : -1]
+
+ARENA_CHECK(ARENA_SIZE <= ARENA_BUDGET, arena_over_ram_budget);
+
+/**
+ * Forget all claims and unseal the arena.  Call at the start of app_init,
+ * before any module's init - everything claimed before is gone.
+ */
+void arena_init();
+
+/**
+ * Claim size bytes, zeroed.  Returns 0 if there isn't room or the arena is
+ * sealed - either is a bug, counted by arena_failures.
+ *
+ * @param name - for the profile, must outlive the claim
+ * @param align - a power of two
+ */
+void *arena_claim(const char *name, u16 size, u8 align);
+
+/**
+ * No more claims - call at the end of app_init.
+ */
+void arena_seal();
+
+/**
+ * Bytes claimed, including alignment padding, and the most there have been
+ * since power up.
+ */
+u16 arena_used();
+u16 arena_high_water();
+
+/**
+ * Claims that couldn't be met.
+ */
+u8 arena_failures();
+
+typedef struct
+{
+	const char *name;
+	u16 offset;
+	u16 size;
+} ArenaClaim;
+
+/**
+ * The claims made since arena_init, in order.  Returns the count.
+ */
+u8 arena_claims(const ArenaClaim **claims);
+
+//______________________________________________________________________________
+//
+// Fixed block pools.  Taking and giving back are constant time, using a free
+// list threaded through the free blocks.  Not interrupt safe - take and give
+// from callbacks that can't interrupt each other.
+//______________________________________________________________________________
+
+#define ARENA_POOL_EMPTY		0xFF
+
+typedef struct
+{
+	u8 *blocks;
+	u16 size;			// of each block, rounded up to ARENA_ALIGN
+	u8 count;
+	u8 free;			// first free block, or ARENA_POOL_EMPTY
+	u8 used;
+	u8 high_water;
+} ArenaPool;
+
+// what a pool claims
+#define ARENA_POOL_SIZE(size, count)	(ARENA_ROUND(size) * (count))
+
+/**
+ * Claim a pool of count blocks of size bytes.  Returns nonzero on success.
+ *
+ * @param count - up to 254
+ */
+u8 arena_pool_init(ArenaPool *pool, const char *name, u16 size, u8 count);
+
+/**
+ * A free block, or 0 if they're all in use.
+ */
+void *arena_pool_take(ArenaPool *pool);
+
+void arena_pool_give(ArenaPool *pool, void *block);
+
+#endif
@@ -0,0 +1,611 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "arp.h"
+#include "instance.h"
+
+//______________________________________________________________________________
+//
+// 128 bit note sets, 32 bits to a word (u32 may be wider on the host).
+//______________________________________________________________________________
+
+#define CHANNELS		16
+#define WORDS			4
+
+typedef struct
+{
+	u32 w[WORDS];
+} NoteSet;
+
+static inline u8 set_test(const NoteSet *s, u8 n)
+{
+	return (s->w[n >> 5] >> (n & 31)) & 1;
+}
+
+static inline void set_add(NoteSet *s, u8 n)
+{
+	s->w[n >> 5] |= 1UL << (n & 31);
+}
+
+static inline void set_remove(NoteSet *s, u8 n)
+{
+	s->w[n >> 5] &= ~(1UL << (n & 31));
+}
+
+static inline u8 set_empty(const NoteSet *s)
+{
+	return !(s->w[0] | s->w[1] | s->w[2] | s->w[3]);
+}
+
+static inline void set_clear(NoteSet *s)
+{
+	s->w[0] = s->w[1] = s->w[2] = s->w[3] = 0;
+}
+
+// lowest note >= from, or -1
+static s16 set_next_up(const NoteSet *s, u8 from)
+{
+	for (u8 w = from >> 5; w < WORDS; ++w)
+	{
+		unsigned int bits = s->w[w];
+		
+		if (w == from >> 5)
+		{
+			bits &= 0xFFFFFFFFu << (from & 31);
+		}
+		
+		if (bits)
+		{
+			return (w << 5) + __builtin_ctz(bits);
+		}
+	}
+	
+	return -1;
+}
+
+// highest note <= from, or -1
+static s16 set_next_down(const NoteSet *s, u8 from)
+{
+	for (s8 w = from >> 5; w >= 0; --w)
+	{
+		unsigned int bits = s->w[w];
+		
+		if (w == from >> 5)
+		{
+			bits &= 0xFFFFFFFFu >> (31 - (from & 31));
+		}
+		
+		if (bits)
+		{
+			return (w << 5) + 31 - __builtin_clz(bits);
+		}
+	}
+	
+	return -1;
+}
+
+//______________________________________________________________________________
+
+typedef struct
+{
+	u8 count;
+	u8 interval[ARP_MAX_TONES];
+} Chord;
+
+static const Chord CHORDS[ARP_CHORD_COUNT] =
+{
+	{ 1, { 0 } },
+	{ 3, { 0, 4, 7 } },
+	{ 3, { 0, 3, 7 } },
+	{ 4, { 0, 4, 7, 10 } },
+	{ 2, { 0, 7 } },
+	{ 2, { 0, 12 } },
+};
+
+typedef struct
+{
+	NoteSet held;		// notes held down
+	NoteSet tones;		// held notes expanded into chords
+	NoteSet playing;	// notes sounding on arpeggiator voices
+	u8 velocity;		// of the last note on
+	u8 octave;			// arpeggiator position...
+	s16 position;		// ...-1 before the first step
+	s8 direction;
+} Channel;
+
+typedef struct
+{
+	u8 channel;
+	u8 note;
+	u16 ticks;			// left to sound, 0 once ended
+} Voice;
+
+static INSTANCE Channel g_Channels[CHANNELS];
+static INSTANCE u16 g_Active = 0;	// channels with any tones
+
+// voices, oldest first, as a ring
+static INSTANCE Voice g_Voices[ARP_VOICES];
+static INSTANCE u8 g_VoiceHead = 0;
+static INSTANCE u8 g_VoiceCount = 0;
+
+static INSTANCE const Chord *g_Chord = &CHORDS[ARP_CHORD_NONE];
+static INSTANCE u8 g_Mode = ARP_OFF;
+static INSTANCE u8 g_Octaves = 1;
+static INSTANCE u16 g_Rate = 125;
+static INSTANCE u16 g_Gate = 60;
+static INSTANCE u16 g_Counter = 0;
+static INSTANCE u8 g_Sync = 0;
+
+static INSTANCE arp_handler g_Handler = 0;
+
+//______________________________________________________________________________
+
+static void output(u8 channel, u8 note, u8 velocity)
+{
+	if (g_Handler)
+	{
+		g_Handler(channel, note, velocity);
+	}
+}
+
+static void reset_position(Channel *c)
+{
+	c->octave = 0;
+	c->position = -1;
+	c->direction = 1;
+}
+
+void arp_init(arp_handler handler)
+{
+	for (u8 i=0; i < CHANNELS; ++i)
+	{
+		Channel *c = &g_Channels[i];
+		
+		set_clear(&c->held);
+		set_clear(&c->tones);
+		set_clear(&c->playing);
+		c->velocity = 0;
+		reset_position(c);
+	}
+	
+	g_Active = 0;
+	g_VoiceHead = 0;
+	g_VoiceCount = 0;
+	g_Counter = 0;
+	g_Handler = handler;
+}
+
+//______________________________________________________________________________
+//
+// Voices
+//______________________________________________________________________________
+
+static void end_voice(Voice *v)
+{
+	if (v->ticks)
+	{
+		v->ticks = 0;
+		set_remove(&g_Channels[v->channel].playing, v->note);
+		output(v->channel, v->note, 0);
+	}
+}
+
+static void end_all_voices()
+{
+	for (u8 k=0; k < g_VoiceCount; ++k)
+	{
+		end_voice(&g_Voices[(g_VoiceHead + k) % ARP_VOICES]);
+	}
+	
+	g_VoiceCount = 0;
+}
+
+static void start_voice(u8 channel, u8 note, u8 velocity)
+{
+	Channel *c = &g_Channels[channel];
+	
+	// retrigger - end the note if it's still going, rare enough to search for
+	if (set_test(&c->playing, note))
+	{
+		for (u8 k=0; k < g_VoiceCount; ++k)
+		{
+			Voice *v = &g_Voices[(g_VoiceHead + k) % ARP_VOICES];
+			
+			if (v->ticks && v->channel == channel && v->note == note)
+			{
+				end_voice(v);
+				break;
+			}
+		}
+	}
+	
+	// out of voices - steal the oldest
+	if (g_VoiceCount == ARP_VOICES)
+	{
+		end_voice(&g_Voices[g_VoiceHead]);
+		g_VoiceHead = (g_VoiceHead + 1) % ARP_VOICES;
+		--g_VoiceCount;
+	}
+	
+	Voice *v = &g_Voices[(g_VoiceHead + g_VoiceCount++) % ARP_VOICES];
+	
+	v->channel = channel;
+	v->note = note;
+	v->ticks = g_Gate ? g_Gate : 1;
+	
+	set_add(&c->playing, note);
+	output(channel, note, velocity);
+}
+
+//______________________________________________________________________________
+//
+// Chords
+//______________________________________________________________________________
+
+// does any held note other than through this tone still want it?
+static u8 wanted(const Channel *c, u8 tone)
+{
+	for (u8 i=0; i < g_Chord->count; ++i)
+	{
+		u8 iv = g_Chord->interval[i];
+		
+		if (tone >= iv && set_test(&c->held, tone - iv))
+		{
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+void arp_note_on(u8 channel, u8 note, u8 velocity)
+{
+	channel &= 0x0F;
+	note &= 0x7F;
+	
+	Channel *c = &g_Channels[channel];
+	
+	set_add(&c->held, note);
+	c->velocity = velocity;
+	g_Active |= 1 << channel;
+	
+	for (u8 i=0; i < g_Chord->count; ++i)
+	{
+		u8 tone = note + g_Chord->interval[i];
+		
+		if (tone < 128 && !set_test(&c->tones, tone))
+		{
+			set_add(&c->tones, tone);
+			
+			if (g_Mode == ARP_OFF)
+			{
+				output(channel, tone, velocity);
+			}
+		}
+	}
+}
+
+void arp_note_off(u8 channel, u8 note)
+{
+	channel &= 0x0F;
+	note &= 0x7F;
+	
+	Channel *c = &g_Channels[channel];
+	
+	if (!set_test(&c->held, note))
+	{
+		return;
+	}
+	
+	set_remove(&c->held, note);
+	
+	for (u8 i=0; i < g_Chord->count; ++i)
+	{
+		u8 tone = note + g_Chord->interval[i];
+		
+		if (tone < 128 && set_test(&c->tones, tone) && !wanted(c, tone))
+		{
+			set_remove(&c->tones, tone);
+			
+			if (g_Mode == ARP_OFF)
+			{
+				output(channel, tone, 0);
+			}
+		}
+	}
+	
+	if (set_empty(&c->tones))
+	{
+		g_Active &= ~(1 << channel);
+		reset_position(c);
+	}
+}
+
+u8 arp_tone(u8 channel, u8 note)
+{
+	return set_test(&g_Channels[channel & 0x0F].tones, note & 0x7F);
+}
+
+// play or silence every tone (when the arpeggiator isn't doing it)
+static void sound_tones(u8 on)
+{
+	for (u8 ch=0; ch < CHANNELS; ++ch)
+	{
+		Channel *c = &g_Channels[ch];
+		
+		for (s16 n = set_next_up(&c->tones, 0); n >= 0; n = n < 127 ? set_next_up(&c->tones, n + 1) : -1)
+		{
+			output(ch, n, on ? c->velocity : 0);
+		}
+	}
+}
+
+void arp_set_chord(u8 chord)
+{
+	if (chord >= ARP_CHORD_COUNT)
+	{
+		return;
+	}
+	
+	if (g_Mode == ARP_OFF)
+	{
+		sound_tones(0);
+	}
+	
+	g_Chord = &CHORDS[chord];
+	
+	// re-voice whatever is held with the new chord
+	for (u8 ch=0; ch < CHANNELS; ++ch)
+	{
+		Channel *c = &g_Channels[ch];
+		
+		set_clear(&c->tones);
+		
+		for (s16 n = set_next_up(&c->held, 0); n >= 0; n = n < 127 ? set_next_up(&c->held, n + 1) : -1)
+		{
+			for (u8 i=0; i < g_Chord->count; ++i)
+			{
+				if (n + g_Chord->interval[i] < 128)
+				{
+					set_add(&c->tones, n + g_Chord->interval[i]);
+				}
+			}
+		}
+	}
+	
+	if (g_Mode == ARP_OFF)
+	{
+		sound_tones(1);
+	}
+}
+
+void arp_set_mode(u8 mode, u8 octaves, u16 rate, u16 gate)
+{
+	if (mode >= ARP_MODE_COUNT)
+	{
+		return;
+	}
+	
+	u8 was = g_Mode;
+	
+	g_Mode = mode;
+	g_Octaves = octaves < 1 ? 1 : octaves > ARP_MAX_OCTAVES ? ARP_MAX_OCTAVES : octaves;
+	g_Rate = rate ? rate : 1;
+	g_Gate = gate;
+	
+	if (mode == was)
+	{
+		return;
+	}
+	
+	// hand the tones over between holding and arpeggiating
+	if (was == ARP_OFF)
+	{
+		sound_tones(0);
+	}
+	else if (mode == ARP_OFF)
+	{
+		end_all_voices();
+		sound_tones(1);
+	}
+	
+	for (u8 ch=0; ch < CHANNELS; ++ch)
+	{
+		reset_position(&g_Channels[ch]);
+	}
+}
+
+//______________________________________________________________________________
+//
+// Arpeggiator
+//______________________________________________________________________________
+
+// move to the next tone up, through the octaves - 0 at the top
+static u8 advance_up(Channel *c)
+{
+	s16 n = c->position < 127 ? set_next_up(&c->tones, c->position + 1) : -1;
+	
+	if (n < 0)
+	{
+		if (c->octave + 1 >= g_Octaves)
+		{
+			return 0;
+		}
+		
+		++c->octave;
+		n = set_next_up(&c->tones, 0);
+	}
+	
+	c->position = n;
+	return 1;
+}
+
+// move to the next tone down, through the octaves - 0 at the bottom
+static u8 advance_down(Channel *c)
+{
+	s16 n = c->position > 0 ? set_next_down(&c->tones, c->position - 1) : -1;
+	
+	if (n < 0)
+	{
+		if (c->octave == 0)
+		{
+			return 0;
+		}
+		
+		--c->octave;
+		n = set_next_down(&c->tones, 127);
+	}
+	
+	c->position = n;
+	return 1;
+}
+
+static void step(u8 ch)
+{
+	Channel *c = &g_Channels[ch];
+	
+	switch (g_Mode)
+	{
+		case ARP_UP:
+		{
+			if (!advance_up(c))
+			{
+				c->octave = 0;
+				c->position = set_next_up(&c->tones, 0);
+			}
+		}
+		break;
+			
+		case ARP_DOWN:
+		{
+			if (c->position < 0)
+			{
+				// first step starts from the top
+				c->octave = g_Octaves - 1;
+				c->position = 128;
+			}
+			
+			if (!advance_down(c))
+			{
+				c->octave = g_Octaves - 1;
+				c->position = set_next_down(&c->tones, 127);
+			}
+		}
+		break;
+			
+		case ARP_UP_DOWN:
+		{
+			u8 moved = c->direction > 0 ? advance_up(c) : advance_down(c);
+			
+			if (!moved)
+			{
+				c->direction = -c->direction;
+				moved = c->direction > 0 ? advance_up(c) : advance_down(c);
+			}
+			
+			if (!moved)
+			{
+				// a single note in a single octave
+				c->octave = 0;
+				c->position = set_next_up(&c->tones, 0);
+			}
+		}
+		break;
+	}
+	
+	u16 note = c->position + 12 * c->octave;
+	
+	if (note < 128)
+	{
+		start_voice(ch, note, c->velocity);
+	}
+}
+
+// step each channel that has something to play, every g_Rate calls
+static void count_step()
+{
+	if (++g_Counter < g_Rate)
+	{
+		return;
+	}
+	g_Counter = 0;
+	
+	for (u16 active = g_Active; active; active &= active - 1)
+	{
+		step(__builtin_ctz(active));
+	}
+}
+
+void arp_tick()
+{
+	if (g_Mode == ARP_OFF)
+	{
+		return;
+	}
+	
+	// count down the gates, then drop ended voices from the front
+	for (u8 k=0; k < g_VoiceCount; ++k)
+	{
+		Voice *v = &g_Voices[(g_VoiceHead + k) % ARP_VOICES];
+		
+		if (v->ticks && --v->ticks == 0)
+		{
+			set_remove(&g_Channels[v->channel].playing, v->note);
+			output(v->channel, v->note, 0);
+		}
+	}
+	
+	while (g_VoiceCount && g_Voices[g_VoiceHead].ticks == 0)
+	{
+		g_VoiceHead = (g_VoiceHead + 1) % ARP_VOICES;
+		--g_VoiceCount;
+	}
+	
+	if (!g_Sync)
+	{
+		count_step();
+	}
+}
+
+void arp_set_sync(u8 sync)
+{
+	g_Sync = sync;
+	g_Counter = 0;
+}
+
+void arp_pulse()
+{
+	if (g_Mode != ARP_OFF && g_Sync)
+	{
+		count_step();
+	}
+}
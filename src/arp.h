@@ -0,0 +1,134 @@
+#ifndef LAUNCHPAD_ARP_H
+#define LAUNCHPAD_ARP_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Chord and arpeggiator engine.  Held notes are kept as a 128 bit set per MIDI
+// channel; each held note is expanded into the tones of the current chord,
+// and the union of those tones is a second 128 bit set per channel.
+//
+// With the arpeggiator off, tones sound for as long as they are held.  With it
+// on, the arpeggiator walks each channel's tones on the tick, finding the next
+// note with count trailing (or leading) zeros, and plays it on a voice from a
+// fixed pool that ends the note after the gate time.
+//
+// Nothing allocates, and note on and note off are constant time: a tone stops
+// when no other held note's chord still contains it, which is a handful of
+// bit tests.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+// chords
+#define ARP_CHORD_NONE			0
+#define ARP_CHORD_MAJOR			1
+#define ARP_CHORD_MINOR			2
+#define ARP_CHORD_SEVENTH		3
+#define ARP_CHORD_FIFTH			4
+#define ARP_CHORD_OCTAVE		5
+#define ARP_CHORD_COUNT			6
+
+// most tones in a chord, including the root
+#define ARP_MAX_TONES			4
+
+// arpeggiator modes
+#define ARP_OFF					0
+#define ARP_UP					1
+#define ARP_DOWN				2
+#define ARP_UP_DOWN				3
+#define ARP_MODE_COUNT			4
+
+#define ARP_MAX_OCTAVES			4
+
+// voices in the arpeggiator's pool - when they run out, the oldest is stolen
+#define ARP_VOICES				32
+
+/**
+ * Receives the notes to play.
+ *
+ * @param channel - MIDI channel, [0, 15]
+ * @param note - MIDI note
+ * @param velocity - [1, 127] for note on, 0 for note off
+ */
+typedef void (*arp_handler)(u8 channel, u8 note, u8 velocity);
+
+/**
+ * Release everything (without sending note offs) and set the output.
+ */
+void arp_init(arp_handler handler);
+
+/**
+ * Select a chord - ARP_CHORD_*.  Invalid chords are ignored.  Only affects
+ * notes played afterwards.
+ */
+void arp_set_chord(u8 chord);
+
+/**
+ * Set up the arpeggiator.  Changing mode ends any tones sounding without it.
+ *
+ * @param mode - ARP_OFF, ARP_UP, ARP_DOWN or ARP_UP_DOWN
+ * @param octaves - how many octaves to span, [1, ARP_MAX_OCTAVES]
+ * @param rate - ticks per step, or clock pulses per step when synced
+ * @param gate - ticks each step sounds for
+ */
+void arp_set_mode(u8 mode, u8 octaves, u16 rate, u16 gate);
+
+void arp_note_on(u8 channel, u8 note, u8 velocity);
+void arp_note_off(u8 channel, u8 note);
+
+/**
+ * Advance the arpeggiator by one tick.  Call from app_timer_event.  Gates are
+ * always timed in ticks.
+ */
+void arp_tick();
+
+/**
+ * Step on clock pulses passed to arp_pulse rather than on ticks, if sync is
+ * nonzero.
+ */
+void arp_set_sync(u8 sync);
+
+/**
+ * A clock pulse - see sync.h.
+ */
+void arp_pulse();
+
+/**
+ * Nonzero if a tone is part of the chord set of a channel (held, or part of
+ * a held note's chord).
+ */
+u8 arp_tone(u8 channel, u8 note);
+
+#endif
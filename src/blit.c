@@ -0,0 +1,154 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "app.h"
+#include "blit.h"
+#include "instance.h"
+#include "sysex.h"
+
+// ticks left before the timer draws over the last frame
+static INSTANCE u16 g_Hold = 0;
+
+//______________________________________________________________________________
+
+static void decode_raw(const u8 *p, const u8 *end)
+{
+	if (end - p < 3 * BLIT_LED_COUNT)
+	{
+		return;
+	}
+	
+	for (u8 i=0; i < BLIT_LED_COUNT; ++i)
+	{
+		hal_plot_led(TYPEPAD, i, p[0], p[1], p[2]);
+		p += 3;
+	}
+}
+
+static void decode_coded(const u8 *p, const u8 *end)
+{
+	u8 index = 0;
+	
+	while (p < end && index < BLIT_LED_COUNT)
+	{
+		u8 op = *p++;
+		
+		if (op < BLIT_OP_LITERAL)
+		{
+			index += op + 1;
+			continue;
+		}
+		
+		u8 n = (op & 0x1F) + 1;
+		
+		if (n > BLIT_LED_COUNT - index)
+		{
+			return;
+		}
+		
+		if (op < BLIT_OP_RUN)
+		{
+			if (end - p < 3 * n)
+			{
+				return;
+			}
+			
+			for (u8 i=0; i < n; ++i)
+			{
+				hal_plot_led(TYPEPAD, index++, p[0], p[1], p[2]);
+				p += 3;
+			}
+		}
+		else
+		{
+			if (end - p < 3)
+			{
+				return;
+			}
+			
+			for (u8 i=0; i < n; ++i)
+			{
+				hal_plot_led(TYPEPAD, index++, p[0], p[1], p[2]);
+			}
+			p += 3;
+		}
+	}
+}
+
+void blit_init()
+{
+	g_Hold = 0;
+}
+
+u8 blit_sysex(u8 port, const u8 *data, u16 count)
+{
+	(void)port;
+	
+	if (sysex_command(data, count) != SYSEX_BLIT)
+	{
+		return 0;
+	}
+	
+	// mode byte, then the frame up to (not including) the 0xF7
+	const u8 *p = data + SYSEX_DATA + 1;
+	const u8 *end = data + count - 1;
+	
+	switch (data[SYSEX_DATA])
+	{
+		case BLIT_RAW:
+			decode_raw(p, end);
+			break;
+			
+		case BLIT_CODED:
+			decode_coded(p, end);
+			break;
+			
+		default:
+			return 1;
+	}
+	
+	g_Hold = BLIT_HOLD_TICKS;
+	return 1;
+}
+
+void blit_tick()
+{
+	if (g_Hold)
+	{
+		--g_Hold;
+	}
+}
+
+u8 blit_showing()
+{
+	return g_Hold != 0;
+}
@@ -0,0 +1,93 @@
+#ifndef LAUNCHPAD_BLIT_H
+#define LAUNCHPAD_BLIT_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Full-frame LED blit.  A host can paint all 100 LEDs with one SysEx message
+// instead of 100 separate ones.  After the header and SYSEX_BLIT:
+//
+// BLIT_RAW    r g b for every LED, index 0 to 99 - 300 bytes
+// BLIT_CODED  a stream of ops, starting at index 0:
+//
+//   0x00-0x3F  skip n+1 LEDs, leaving them as they are
+//   0x40-0x5F  literal - (n & 0x1F)+1 LEDs, each followed by r g b
+//   0x60-0x7F  run - (n & 0x1F)+1 LEDs, all set to the single r g b that follows
+//
+// Coding against the previous frame is up to the host: unchanged LEDs are
+// skipped.  Colours are 6 bit, [0, MAXLED].  Ops are decoded straight into
+// hal_plot_led with no frame buffer on our side, so the timer has to leave the
+// pads alone while a host is blitting - see blit_showing.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define BLIT_LED_COUNT			100
+
+#define BLIT_RAW				0
+#define BLIT_CODED				1
+
+#define BLIT_OP_SKIP			0x00
+#define BLIT_OP_LITERAL			0x40
+#define BLIT_OP_RUN				0x60
+
+#define BLIT_MAX_SKIP			64
+#define BLIT_MAX_SPAN			32
+
+// how long the last frame stays up before the app draws the pads again
+#define BLIT_HOLD_TICKS			1000
+
+/**
+ * No frame showing.  Call from app_init.
+ */
+void blit_init();
+
+/**
+ * Handle a SysEx message.  Returns nonzero if it was a blit (even a malformed
+ * one - decoding stops at the first bad op, leaving the rest of the frame).
+ */
+u8 blit_sysex(u8 port, const u8 *data, u16 count);
+
+/**
+ * Count down the hold after the last frame.  Call from app_timer_event.
+ */
+void blit_tick();
+
+/**
+ * Nonzero while a host's frame is showing - until BLIT_HOLD_TICKS after the
+ * last one arrived.
+ */
+u8 blit_showing();
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef LAUNCHPAD_BOOT_H
+#define LAUNCHPAD_BOOT_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Deferred start up.  app_init only does what has to be done before the first
+// callback, and hands the rest - reading flash, drawing what it held - to a
+// list of stages that run on the timer, one step per tick, so the unit lights
+// up and answers sooner and no one tick takes long.  A stage can take more
+// than one step, to spread out a big read.
+//
+// Until the stages have all run, the app is up but not ready: what they load
+// isn't there yet.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+/**
+ * One step of a stage.  Returns nonzero once the stage is done, or 0 to be
+ * called again on the next tick.
+ */
+typedef u8 (*boot_handler)();
+
+typedef struct
+{
+	const char *name;
+	boot_handler step;
+} BootStage;
+
+/**
+ * Start over with a list of stages, which must outlive the boot.
+ */
+void boot_init(const BootStage *stages, u8 count);
+
+/**
+ * Run one step of the current stage.  Call from app_timer_event, first thing.
+ * Returns nonzero once all stages are done.
+ */
+u8 boot_poll();
+
+/**
+ * Nonzero once all stages are done.
+ */
+u8 boot_ready();
+
+/**
+ * The stage running, or the stage count once ready.
+ */
+u8 boot_stage();
+
+#endif
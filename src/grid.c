@@ -0,0 +1,383 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "grid.h"
+
+//______________________________________________________________________________
+//
+// Masks and tables
+//______________________________________________________________________________
+
+const Grid GRID_ALL = { { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x0000000F } };
+const Grid GRID_PADS = { { 0x9FE7F800, 0xE7F9FE7F, 0x01FE7F9F, 0x00000000 } };
+const Grid GRID_BUTTONS = { { 0x601805FE, 0x18060180, 0xFA018060, 0x00000007 } };
+
+const Grid GRID_ROWS[GRID_SIZE] =
+{
+	{ { 0x000003FF, 0x00000000, 0x00000000, 0x00000000 } },
+	{ { 0x000FFC00, 0x00000000, 0x00000000, 0x00000000 } },
+	{ { 0x3FF00000, 0x00000000, 0x00000000, 0x00000000 } },
+	{ { 0xC0000000, 0x000000FF, 0x00000000, 0x00000000 } },
+	{ { 0x00000000, 0x0003FF00, 0x00000000, 0x00000000 } },
+	{ { 0x00000000, 0x0FFC0000, 0x00000000, 0x00000000 } },
+	{ { 0x00000000, 0xF0000000, 0x0000003F, 0x00000000 } },
+	{ { 0x00000000, 0x00000000, 0x0000FFC0, 0x00000000 } },
+	{ { 0x00000000, 0x00000000, 0x03FF0000, 0x00000000 } },
+	{ { 0x00000000, 0x00000000, 0xFC000000, 0x0000000F } },
+};
+
+const Grid GRID_COLUMNS[GRID_SIZE] =
+{
+	{ { 0x40100401, 0x10040100, 0x04010040, 0x00000000 } },
+	{ { 0x80200802, 0x20080200, 0x08020080, 0x00000000 } },
+	{ { 0x00401004, 0x40100401, 0x10040100, 0x00000000 } },
+	{ { 0x00802008, 0x80200802, 0x20080200, 0x00000000 } },
+	{ { 0x01004010, 0x00401004, 0x40100401, 0x00000000 } },
+	{ { 0x02008020, 0x00802008, 0x80200802, 0x00000000 } },
+	{ { 0x04010040, 0x01004010, 0x00401004, 0x00000001 } },
+	{ { 0x08020080, 0x02008020, 0x00802008, 0x00000002 } },
+	{ { 0x10040100, 0x04010040, 0x01004010, 0x00000004 } },
+	{ { 0x20080200, 0x08020080, 0x02008020, 0x00000008 } },
+};
+
+#define XX GRID_NO_PAD
+
+const u8 GRID_ROW[GRID_CELLS] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+	8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+};
+
+const u8 GRID_COLUMN[GRID_CELLS] =
+{
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+};
+
+const u8 GRID_ADC[GRID_CELLS] =
+{
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX,  0,  2,  4,  6,  8, 10, 12, 14, XX,
+	XX, 16, 18, 20, 22, 24, 26, 28, 30, XX,
+	XX, 32, 34, 36, 38, 40, 42, 44, 46, XX,
+	XX, 48, 50, 52, 54, 56, 58, 60, 62, XX,
+	XX,  1,  3,  5,  7,  9, 11, 13, 15, XX,
+	XX, 17, 19, 21, 23, 25, 27, 29, 31, XX,
+	XX, 33, 35, 37, 39, 41, 43, 45, 47, XX,
+	XX, 49, 51, 53, 55, 57, 59, 61, 63, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+
+#undef XX
+
+//______________________________________________________________________________
+//
+// Shifts.  A step east moves a button on by one index, so the rightmost
+// column wraps round onto the leftmost of the row above - the masks keep
+// what lands there out, and anything past the grid.
+//______________________________________________________________________________
+
+static const Grid KEEP_EAST = { { 0xBFEFFBFE, 0xEFFBFEFF, 0xFBFEFFBF, 0x0000000F } };
+static const Grid KEEP_WEST = { { 0xDFF7FDFF, 0xF7FDFF7F, 0xFDFF7FDF, 0x00000007 } };
+
+static const s8 SHIFTS[GRID_DIRECTIONS] = { 10, 11, 1, -9, -10, -11, -1, 9 };
+
+static const Grid *const KEEP[GRID_DIRECTIONS] =
+{
+	&GRID_ALL, &KEEP_EAST, &KEEP_EAST, &KEEP_EAST, &GRID_ALL, &KEEP_WEST, &KEEP_WEST, &KEEP_WEST
+};
+
+static void shift(Grid *out, const Grid *in, s8 n, const Grid *keep)
+{
+	u32 a = in->w[0];
+	u32 b = in->w[1];
+	u32 c = in->w[2];
+	u32 d = in->w[3];
+	
+	// every word is masked, which also drops what a shift carries past
+	// 32 bits where u32 is wider
+	if (n > 0)
+	{
+		u8 m = 32 - n;
+		
+		out->w[0] = (a << n) & keep->w[0];
+		out->w[1] = ((b << n) | (a >> m)) & keep->w[1];
+		out->w[2] = ((c << n) | (b >> m)) & keep->w[2];
+		out->w[3] = ((d << n) | (c >> m)) & keep->w[3];
+	}
+	else
+	{
+		n = -n;
+		u8 m = 32 - n;
+		
+		out->w[0] = ((a >> n) | (b << m)) & keep->w[0];
+		out->w[1] = ((b >> n) | (c << m)) & keep->w[1];
+		out->w[2] = ((c >> n) | (d << m)) & keep->w[2];
+		out->w[3] = (d >> n) & keep->w[3];
+	}
+}
+
+// SWAR, as there's no popcount instruction on the Cortex-M3
+static u8 count_bits(u32 x)
+{
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	x = (x + (x >> 4)) & 0x0F0F0F0F;
+	
+	return ((x * 0x01010101) & 0xFFFFFFFF) >> 24;
+}
+
+//______________________________________________________________________________
+
+void grid_clear(Grid *g)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		g->w[w] = 0;
+	}
+}
+
+void grid_copy(Grid *out, const Grid *in)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = in->w[w];
+	}
+}
+
+void grid_set(Grid *g, u8 index)
+{
+	if (index < GRID_CELLS)
+	{
+		g->w[index >> 5] |= 1UL << (index & 31);
+	}
+}
+
+void grid_unset(Grid *g, u8 index)
+{
+	if (index < GRID_CELLS)
+	{
+		g->w[index >> 5] &= ~(1UL << (index & 31));
+	}
+}
+
+u8 grid_test(const Grid *g, u8 index)
+{
+	return index < GRID_CELLS && ((g->w[index >> 5] >> (index & 31)) & 1);
+}
+
+void grid_and(Grid *out, const Grid *a, const Grid *b)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = a->w[w] & b->w[w];
+	}
+}
+
+void grid_or(Grid *out, const Grid *a, const Grid *b)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = a->w[w] | b->w[w];
+	}
+}
+
+void grid_xor(Grid *out, const Grid *a, const Grid *b)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = a->w[w] ^ b->w[w];
+	}
+}
+
+void grid_and_not(Grid *out, const Grid *a, const Grid *b)
+{
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = a->w[w] & ~b->w[w];
+	}
+}
+
+u8 grid_count(const Grid *g)
+{
+	u8 count = 0;
+	
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		count += count_bits(g->w[w]);
+	}
+	return count;
+}
+
+u8 grid_any(const Grid *g)
+{
+	return (g->w[0] | g->w[1] | g->w[2] | g->w[3]) != 0;
+}
+
+u8 grid_next(const Grid *g, u8 index)
+{
+	for (u8 w = index >> 5; w < GRID_WORDS; ++w)
+	{
+		u32 bits = g->w[w];
+		
+		if (w == index >> 5)
+		{
+			bits &= 0xFFFFFFFF << (index & 31);
+		}
+		
+		if (bits)
+		{
+			return (w << 5) + __builtin_ctz(bits);
+		}
+	}
+	return GRID_NONE;
+}
+
+//______________________________________________________________________________
+
+void grid_shift(Grid *out, const Grid *in, u8 direction)
+{
+	if (direction < GRID_DIRECTIONS)
+	{
+		shift(out, in, SHIFTS[direction], KEEP[direction]);
+	}
+	else
+	{
+		grid_copy(out, in);
+	}
+}
+
+void grid_neighbours(Grid *out, const Grid *in, u8 diagonals)
+{
+	Grid around;
+	Grid step;
+	Grid row;
+	
+	// either side first
+	shift(&around, in, SHIFTS[GRID_EAST], KEEP[GRID_EAST]);
+	shift(&step, in, SHIFTS[GRID_WEST], KEEP[GRID_WEST]);
+	grid_or(&around, &around, &step);
+	
+	// then above and below - with diagonals, above and below the row of
+	// three, so four shifts cover all eight neighbours
+	if (diagonals)
+	{
+		grid_or(&row, &around, in);
+	}
+	else
+	{
+		grid_copy(&row, in);
+	}
+	
+	shift(&step, &row, SHIFTS[GRID_NORTH], KEEP[GRID_NORTH]);
+	grid_or(&around, &around, &step);
+	shift(&step, &row, SHIFTS[GRID_SOUTH], KEEP[GRID_SOUTH]);
+	grid_or(&around, &around, &step);
+	
+	grid_and_not(out, &around, in);
+}
+
+void grid_rect(Grid *out, u8 row0, u8 column0, u8 row1, u8 column1)
+{
+	Grid rows;
+	Grid columns;
+	
+	grid_clear(&rows);
+	grid_clear(&columns);
+	
+	u8 top = row0 > row1 ? row0 : row1;
+	u8 right = column0 > column1 ? column0 : column1;
+	
+	for (u8 r = row0 < row1 ? row0 : row1; r <= top && r < GRID_SIZE; ++r)
+	{
+		grid_or(&rows, &rows, &GRID_ROWS[r]);
+	}
+	
+	for (u8 c = column0 < column1 ? column0 : column1; c <= right && c < GRID_SIZE; ++c)
+	{
+		grid_or(&columns, &columns, &GRID_COLUMNS[c]);
+	}
+	
+	grid_and(out, &rows, &columns);
+}
+
+void grid_life(Grid *out, const Grid *in, const Grid *region)
+{
+	Grid alive;
+	Grid x;
+	
+	// each button's count of live neighbours, as three bits in three boards:
+	// add in each neighbour board a bit at a time.  Eight wraps round to
+	// nought, which is dead either way - s2 only says it's four or more.
+	u32 s0[GRID_WORDS] = { 0 };
+	u32 s1[GRID_WORDS] = { 0 };
+	u32 s2[GRID_WORDS] = { 0 };
+	
+	grid_and(&alive, in, region);
+	
+	for (u8 d=0; d < GRID_DIRECTIONS; ++d)
+	{
+		shift(&x, &alive, SHIFTS[d], KEEP[d]);
+		
+		for (u8 w=0; w < GRID_WORDS; ++w)
+		{
+			u32 c0 = s0[w] & x.w[w];
+			s0[w] ^= x.w[w];
+			
+			u32 c1 = s1[w] & c0;
+			s1[w] ^= c0;
+			s2[w] |= c1;
+		}
+	}
+	
+	// born with three, survives with two or three
+	for (u8 w=0; w < GRID_WORDS; ++w)
+	{
+		out->w[w] = s1[w] & ~s2[w] & (s0[w] | alive.w[w]) & region->w[w];
+	}
+}
@@ -0,0 +1,151 @@
+#ifndef LAUNCHPAD_GRID_H
+#define LAUNCHPAD_GRID_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Bitboards - sets of pads as one bit per button index, in four 32 bit words.
+// Bit n is button index n (see app.h), so a step to a neighbouring pad is a
+// shift of the whole board: by 1 along a row, 10 along a column, 9 or 11
+// diagonally, with a mask to stop pads wrapping onto the other edge.  That
+// turns whole grid effects - spreading ripples, the game of life, lighting
+// the neighbours of pressed pads - into a few dozen word operations rather
+// than a loop over 100 buttons with a branch for every edge, and a hit test
+// is one bit.
+//
+// There are also masks for every row and column, the 8x8 pads and the
+// buttons around them, and tables of each index's row and column and its
+// ADC index (the inverse of ADC_MAP in app_defs.h).
+//
+// Boards are passed by pointer, and out may be the same board as an input.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define GRID_SIZE				10
+#define GRID_CELLS				(GRID_SIZE * GRID_SIZE)
+#define GRID_WORDS				4
+
+// button indices with no pad, in GRID_ADC, and the end of grid_next
+#define GRID_NO_PAD				0xFF
+#define GRID_NONE				0xFF
+
+// directions to shift - north is up a row, towards the top buttons
+#define GRID_NORTH				0
+#define GRID_NORTH_EAST			1
+#define GRID_EAST				2
+#define GRID_SOUTH_EAST			3
+#define GRID_SOUTH				4
+#define GRID_SOUTH_WEST			5
+#define GRID_WEST				6
+#define GRID_NORTH_WEST			7
+#define GRID_DIRECTIONS			8
+
+typedef struct
+{
+	u32 w[GRID_WORDS];
+} Grid;
+
+// every button index, with the corners that have no button
+extern const Grid GRID_ALL;
+
+// the 8x8 pads, and the buttons around them
+extern const Grid GRID_PADS;
+extern const Grid GRID_BUTTONS;
+
+// row 0 is the bottom buttons, column 0 the left ones
+extern const Grid GRID_ROWS[GRID_SIZE];
+extern const Grid GRID_COLUMNS[GRID_SIZE];
+
+// by button index
+extern const u8 GRID_ROW[GRID_CELLS];
+extern const u8 GRID_COLUMN[GRID_CELLS];
+extern const u8 GRID_ADC[GRID_CELLS];
+
+void grid_clear(Grid *g);
+void grid_copy(Grid *out, const Grid *in);
+
+/**
+ * Single buttons.  Indices past the grid are ignored, and never set.
+ */
+void grid_set(Grid *g, u8 index);
+void grid_unset(Grid *g, u8 index);
+u8 grid_test(const Grid *g, u8 index);
+
+void grid_and(Grid *out, const Grid *a, const Grid *b);
+void grid_or(Grid *out, const Grid *a, const Grid *b);
+void grid_xor(Grid *out, const Grid *a, const Grid *b);
+
+/**
+ * What's in a and not in b.
+ */
+void grid_and_not(Grid *out, const Grid *a, const Grid *b);
+
+/**
+ * How many buttons are set, and whether any are.
+ */
+u8 grid_count(const Grid *g);
+u8 grid_any(const Grid *g);
+
+/**
+ * The lowest index set from index on, or GRID_NONE - for visiting each one:
+ *
+ *   for (u8 i = grid_next(g, 0); i != GRID_NONE; i = grid_next(g, i + 1))
+ */
+u8 grid_next(const Grid *g, u8 index);
+
+/**
+ * Move every set button one step in a direction, GRID_NORTH..., dropping
+ * those that go off the grid.
+ */
+void grid_shift(Grid *out, const Grid *in, u8 direction);
+
+/**
+ * Buttons next to a set one but not set themselves - the four beside them,
+ * or the eight around them with diagonals nonzero.
+ */
+void grid_neighbours(Grid *out, const Grid *in, u8 diagonals);
+
+/**
+ * A rectangle of buttons, corners included.
+ */
+void grid_rect(Grid *out, u8 row0, u8 column0, u8 row1, u8 column1);
+
+/**
+ * A generation of the game of life inside region, e.g. GRID_PADS - anything
+ * outside it is dead, and stays so.
+ */
+void grid_life(Grid *out, const Grid *in, const Grid *region);
+
+#endif
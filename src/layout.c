@@ -0,0 +1,164 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "layout.h"
+
+//______________________________________________________________________________
+
+#define GRID_SIZE		8
+#define GRID_PADS		(GRID_SIZE * GRID_SIZE)
+#define INDEX_COUNT		100
+
+// pad index -> note
+static INSTANCE u8 g_PadNote[INDEX_COUNT];
+
+// note -> pads, packed: the pads for note n are g_NotePads[g_NoteStart[n]] up
+// to (not including) g_NotePads[g_NoteStart[n + 1]]
+static INSTANCE u8 g_NoteStart[129];
+static INSTANCE u8 g_NotePads[GRID_PADS];
+
+//______________________________________________________________________________
+
+static u8 pad_index(u8 row, u8 col)
+{
+	return (row + 1) * 10 + col + 1;
+}
+
+static u16 grid_note(u8 layout, u8 root, const u8 *steps, u8 step_count, u8 row, u8 col)
+{
+	switch (layout)
+	{
+		case LAYOUT_CHROMATIC:
+			return root + row * GRID_SIZE + col;
+			
+		case LAYOUT_FOURTHS:
+			return root + row * 5 + col;
+			
+		case LAYOUT_SCALE:
+		{
+			u8 degree = row * 3 + col;
+			return root + (degree / step_count) * 12 + steps[degree % step_count];
+		}
+			
+		case LAYOUT_DRUM:
+		{
+			// which 4x4 block, then where in it
+			u8 block = (row / 4) * 2 + col / 4;
+			return root + block * 16 + (row % 4) * 4 + col % 4;
+		}
+	}
+	
+	return LAYOUT_NO_NOTE;
+}
+
+void layout_set(u8 layout, u8 root, u16 scale)
+{
+	if (layout >= LAYOUT_COUNT)
+	{
+		return;
+	}
+	
+	// the scale as a list of semitone steps above the root
+	u8 steps[12];
+	u8 step_count = 0;
+	
+	scale |= 1;
+	
+	for (u8 i=0; i < 12; ++i)
+	{
+		if (scale & (1 << i))
+		{
+			steps[step_count++] = i;
+		}
+	}
+	
+	// pad -> note, counting the pads on each note as we go
+	u8 counts[128] = {0};
+	
+	for (u8 i=0; i < INDEX_COUNT; ++i)
+	{
+		g_PadNote[i] = LAYOUT_NO_NOTE;
+	}
+	
+	for (u8 row=0; row < GRID_SIZE; ++row)
+	{
+		for (u8 col=0; col < GRID_SIZE; ++col)
+		{
+			u16 note = grid_note(layout, root, steps, step_count, row, col);
+			
+			if (note < 128)
+			{
+				g_PadNote[pad_index(row, col)] = note;
+				++counts[note];
+			}
+		}
+	}
+	
+	// note -> pads, as a prefix sum then a fill
+	u8 start = 0;
+	
+	for (u8 note=0; note < 128; ++note)
+	{
+		g_NoteStart[note] = start;
+		start += counts[note];
+		counts[note] = g_NoteStart[note];
+	}
+	g_NoteStart[128] = start;
+	
+	for (u8 row=0; row < GRID_SIZE; ++row)
+	{
+		for (u8 col=0; col < GRID_SIZE; ++col)
+		{
+			u8 index = pad_index(row, col);
+			u8 note = g_PadNote[index];
+			
+			if (note != LAYOUT_NO_NOTE)
+			{
+				g_NotePads[counts[note]++] = index;
+			}
+		}
+	}
+}
+
+u8 layout_note(u8 index)
+{
+	return index < INDEX_COUNT ? g_PadNote[index] : LAYOUT_NO_NOTE;
+}
+
+const u8 *layout_pads(u8 note, u8 *count)
+{
+	note &= 0x7F;
+	
+	*count = g_NoteStart[note + 1] - g_NoteStart[note];
+	return g_NotePads + g_NoteStart[note];
+}
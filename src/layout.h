@@ -0,0 +1,96 @@
+#ifndef LAUNCHPAD_LAYOUT_H
+#define LAUNCHPAD_LAYOUT_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Note layouts for the 8x8 grid.  Choosing a layout builds both directions at
+// once - a table from pad index to note, and a table from note to the list of
+// pads playing it - so that every pad press and every incoming note is a
+// single table lookup.
+//
+// CHROMATIC  root at bottom left, rows continue on from the row below
+// FOURTHS    chromatic, each row a fourth (5 semitones) above the one below
+// SCALE      in key - only notes in the scale, each row 3 scale degrees up
+// DRUM       four 4x4 blocks of 16 notes, bottom left, bottom right, top left,
+//            top right, like a drum rack
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define LAYOUT_CHROMATIC		0
+#define LAYOUT_FOURTHS			1
+#define LAYOUT_SCALE			2
+#define LAYOUT_DRUM				3
+#define LAYOUT_COUNT			4
+
+// scales, as 12 bit masks of semitones above the root (bit 0 = root)
+#define LAYOUT_SCALE_MAJOR			0x0AB5
+#define LAYOUT_SCALE_MINOR			0x05AD
+#define LAYOUT_SCALE_DORIAN			0x06AD
+#define LAYOUT_SCALE_MIXOLYDIAN		0x06B5
+#define LAYOUT_SCALE_HARMONIC_MINOR	0x09AD
+#define LAYOUT_SCALE_PENTATONIC		0x0295
+#define LAYOUT_SCALE_MINOR_PENTATONIC	0x04A9
+
+// what pads outside the grid, or off the top of the note range, map to
+#define LAYOUT_NO_NOTE			0xFF
+
+/**
+ * Build the tables for a layout.  Cheap enough to call from any callback.
+ *
+ * @param layout - one of the LAYOUT_* values above.  Invalid layouts are ignored.
+ * @param root - the note at the bottom left pad
+ * @param scale - LAYOUT_SCALE_* or any other 12 bit mask, only used by LAYOUT_SCALE.
+ *                The root is always included.
+ */
+void layout_set(u8 layout, u8 root, u16 scale);
+
+/**
+ * The note a pad plays, or LAYOUT_NO_NOTE.
+ *
+ * @param index - LED/button index, as in app.h
+ */
+u8 layout_note(u8 index);
+
+/**
+ * The pads playing a note.
+ *
+ * @param note - MIDI note number
+ * @param count - receives the number of pads
+ * @result pointer to count LED/button indices
+ */
+const u8 *layout_pads(u8 note, u8 *count);
+
+#endif
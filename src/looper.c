@@ -0,0 +1,348 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "arena.h"
+#include "grid.h"
+#include "looper.h"
+#include "sysex.h"
+
+static INSTANCE u8 *g_Ring = 0;
+static INSTANCE u8 *g_Values = 0;		// each pad's latest, recorded or played
+
+static INSTANCE u8 g_State = LOOPER_STOP;
+static INSTANCE u32 g_Length = 0;
+static INSTANCE u32 g_Now = 0;			// ms into the loop
+
+static INSTANCE u16 g_Used = 0;
+static INSTANCE u16 g_Dropped = 0;
+static INSTANCE u32 g_Last = 0;			// time of the last event recorded
+
+static INSTANCE u16 g_Cursor = 0;		// the next event to play...
+static INSTANCE u32 g_Due = 0;			// ...and its time
+
+static INSTANCE looper_handler g_Handler = 0;
+
+//______________________________________________________________________________
+
+static void clear_values()
+{
+	for (u8 pad=0; pad < PAD_COUNT; ++pad)
+	{
+		g_Values[pad] = 0;
+	}
+}
+
+// the time of the event at the cursor, moving past it
+static void read_time()
+{
+	u32 time = 0;
+	u8 shift = 0;
+	u8 byte;
+	
+	do
+	{
+		byte = g_Ring[g_Cursor++];
+		time |= (u32)(byte & 0x7F) << shift;
+		shift += 7;
+	}
+	while (byte & 0x80);
+	
+	g_Due += time;
+}
+
+// let go of any pads still pressed
+static void release()
+{
+	for (u8 pad=0; pad < PAD_COUNT; ++pad)
+	{
+		if (g_Values[pad])
+		{
+			g_Values[pad] = 0;
+			g_Handler(ADC_MAP[pad], 0);
+		}
+	}
+}
+
+// back to the start of the loop, which was recorded from nothing pressed - and
+// values are coded against the last one from there
+static void rewind()
+{
+	g_Now = 0;
+	g_Cursor = 0;
+	g_Due = 0;
+	
+	release();
+	
+	if (g_Used)
+	{
+		read_time();
+	}
+}
+
+static void play_event()
+{
+	u8 code = g_Ring[g_Cursor++];
+	u8 pad = code & 0x3F;
+	u8 value = g_Values[pad];
+	
+	switch (code & 0xC0)
+	{
+		case LOOPER_UP:
+			value = (value + 1) & 0x7F;
+			break;
+			
+		case LOOPER_DOWN:
+			value = (value - 1) & 0x7F;
+			break;
+			
+		case LOOPER_ZERO:
+			value = 0;
+			break;
+			
+		default:
+			value = (value + g_Ring[g_Cursor++]) & 0x7F;
+			break;
+	}
+	
+	g_Values[pad] = value;
+	g_Handler(ADC_MAP[pad], value);
+}
+
+//______________________________________________________________________________
+
+void looper_init(looper_handler handler)
+{
+	g_Ring = arena_claim("looper", LOOPER_ARENA_SIZE, 1);
+	g_Values = g_Ring + LOOPER_RING_SIZE;
+	g_Handler = handler;
+	
+	g_State = LOOPER_STOP;
+	g_Length = 0;
+	g_Now = 0;
+	g_Used = 0;
+	g_Dropped = 0;
+	g_Last = 0;
+	g_Cursor = 0;
+	g_Due = 0;
+}
+
+void looper_record(u32 length)
+{
+	if (!g_Ring)
+	{
+		return;
+	}
+	
+	looper_stop();
+	
+	if (length == 0)
+	{
+		return;
+	}
+	
+	g_Length = length < LOOPER_MAX_LENGTH ? length : LOOPER_MAX_LENGTH;
+	g_Now = 0;
+	g_Used = 0;
+	g_Dropped = 0;
+	g_Last = 0;
+	clear_values();
+	
+	g_State = LOOPER_RECORD;
+}
+
+void looper_play()
+{
+	if (!g_Ring || !g_Length)
+	{
+		return;
+	}
+	
+	looper_stop();
+	rewind();
+	g_State = LOOPER_PLAY;
+}
+
+void looper_stop()
+{
+	if (g_State == LOOPER_PLAY)
+	{
+		release();
+	}
+	else if (g_State == LOOPER_RECORD)
+	{
+		// stopped early, so the loop is what was recorded - the values
+		// were never played
+		g_Length = g_Now;
+		clear_values();
+	}
+	
+	g_State = LOOPER_STOP;
+}
+
+u8 looper_state()
+{
+	return g_State;
+}
+
+void looper_pressure(u8 index, u8 value)
+{
+	if (g_State != LOOPER_RECORD || index >= GRID_CELLS)
+	{
+		return;
+	}
+	
+	u8 pad = GRID_ADC[index];
+	value &= 0x7F;
+	
+	if (pad == GRID_NO_PAD || value == g_Values[pad])
+	{
+		return;
+	}
+	
+	u32 time = g_Now - g_Last;
+	u8 delta = (value - g_Values[pad]) & 0x7F;
+	u8 code = pad | (value == 0 ? LOOPER_ZERO : delta == 1 ? LOOPER_UP : delta == 0x7F ? LOOPER_DOWN : LOOPER_DELTA);
+	
+	// the whole event fits, or none of it goes in - and once one hasn't,
+	// none after it do either, so the loop plays what was played up to there
+	u8 size = (time < 0x80 ? 1 : time < 0x4000 ? 2 : 3) + ((code & 0xC0) == LOOPER_DELTA ? 2 : 1);
+	
+	if (g_Dropped || g_Used + size > LOOPER_RING_SIZE)
+	{
+		++g_Dropped;
+		return;
+	}
+	
+	while (time >= 0x80)
+	{
+		g_Ring[g_Used++] = (time & 0x7F) | 0x80;
+		time >>= 7;
+	}
+	g_Ring[g_Used++] = time;
+	g_Ring[g_Used++] = code;
+	
+	if ((code & 0xC0) == LOOPER_DELTA)
+	{
+		g_Ring[g_Used++] = delta;
+	}
+	
+	g_Values[pad] = value;
+	g_Last = g_Now;
+}
+
+void looper_tick()
+{
+	if (g_State == LOOPER_RECORD)
+	{
+		// and round again, playing what was just recorded
+		if (++g_Now >= g_Length)
+		{
+			clear_values();
+			rewind();
+			g_State = LOOPER_PLAY;
+		}
+		return;
+	}
+	
+	if (g_State != LOOPER_PLAY)
+	{
+		return;
+	}
+	
+	while (g_Cursor < g_Used && g_Due == g_Now)
+	{
+		play_event();
+		
+		if (g_Cursor < g_Used)
+		{
+			read_time();
+		}
+	}
+	
+	if (++g_Now >= g_Length)
+	{
+		rewind();
+	}
+}
+
+u8 looper_sysex(u8 port, const u8 *data, u16 count)
+{
+	(void)port;
+	
+	if (sysex_command(data, count) != SYSEX_LOOPER)
+	{
+		return 0;
+	}
+	
+	const u8 *p = data + SYSEX_DATA;
+	const u8 *end = data + count - 1;
+	
+	if (end - p < 1)
+	{
+		return 1;
+	}
+	
+	switch (p[0])
+	{
+		case LOOPER_RECORD:
+			if (end - p >= 4)
+			{
+				looper_record(p[1] | (p[2] << 7) | ((u32)p[3] << 14));
+			}
+			break;
+			
+		case LOOPER_PLAY:
+			looper_play();
+			break;
+			
+		default:
+			looper_stop();
+			break;
+	}
+	return 1;
+}
+
+u16 looper_used()
+{
+	return g_Used;
+}
+
+u32 looper_length()
+{
+	return g_Length;
+}
+
+u16 looper_dropped()
+{
+	return g_Dropped;
+}
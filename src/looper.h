@@ -0,0 +1,132 @@
+#ifndef LAUNCHPAD_LOOPER_H
+#define LAUNCHPAD_LOOPER_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Pressure looper - records the pressure on each pad over a loop, and plays
+// it back as poly aftertouch, round and round.  Sampling 64 pads every ms
+// would be 128K a second, so only changes are kept, as events in a fixed
+// ring of LOOPER_RING_SIZE bytes:
+//
+//   time   ms since the previous event, 7 bits a byte, low first, with the
+//          top bit set on all but the last - one byte under 128ms
+//   pad    the pad (0-63, the ADC index) in the low 6 bits, and how its
+//          value changed in the top two: LOOPER_UP or LOOPER_DOWN by one,
+//          LOOPER_ZERO let go, or LOOPER_DELTA with the difference from its
+//          last value, mod 128, in the next byte
+//
+// so a pressure sweep costs two bytes a step.  Playback keeps a cursor into
+// the ring and the time of the next event, so a tick only decodes what's
+// due.  Once the ring is full the rest of the take is dropped, and counted.
+//
+// Recording runs for a set number of ms, then playback starts by itself, or
+// until stopped, which makes the loop that long.  Every time round starts
+// from nothing pressed, as the recording did, so pads still held at the end
+// are let go.  A host starts and stops it over SysEx - after the header and SYSEX_LOOPER:
+//
+//   LOOPER_STOP, LOOPER_PLAY, or LOOPER_RECORD and the loop length in ms as
+//   three 7 bit bytes, low first
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define LOOPER_RING_SIZE		4096
+
+// what looper_init claims - the ring, and the pads' latest values
+#define LOOPER_ARENA_SIZE		(LOOPER_RING_SIZE + PAD_COUNT)
+
+// states
+#define LOOPER_STOP				0
+#define LOOPER_RECORD			1
+#define LOOPER_PLAY				2
+
+// how a pad's value changed, in the top bits of an event's pad byte
+#define LOOPER_UP				0x00
+#define LOOPER_DOWN				0x40
+#define LOOPER_ZERO				0x80
+#define LOOPER_DELTA			0xC0
+
+// the longest loop - a length fits three 7 bit bytes, and so does any time
+#define LOOPER_MAX_LENGTH		0x1FFFFF
+
+/**
+ * Receives pressure played back, as a button index and value - and 0s for
+ * pads still held when playback stops or goes round.
+ */
+typedef void (*looper_handler)(u8 index, u8 value);
+
+/**
+ * Claim the ring and stop.  Call from app_init.
+ */
+void looper_init(looper_handler handler);
+
+/**
+ * Forget any loop and record a new one, length ms long, starting now.  Longer
+ * than LOOPER_MAX_LENGTH is cut to it.
+ */
+void looper_record(u32 length);
+
+/**
+ * Play the loop from the start, or stop, letting go of any pads held.
+ */
+void looper_play();
+void looper_stop();
+
+u8 looper_state();
+
+/**
+ * Pressure on a pad, by button index - recorded if it's changed.
+ */
+void looper_pressure(u8 index, u8 value);
+
+/**
+ * Move on a ms, and play what's due.  Call from app_timer_event.
+ */
+void looper_tick();
+
+/**
+ * Handle a SYSEX_LOOPER message.  Returns 0 if it isn't one.
+ */
+u8 looper_sysex(u8 port, const u8 *data, u16 count);
+
+/**
+ * Bytes of the ring used, the loop's length in ms, and events that didn't
+ * fit.
+ */
+u16 looper_used();
+u32 looper_length();
+u16 looper_dropped();
+
+#endif
@@ -0,0 +1,650 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "mod.h"
+
+ARENA_CHECK(sizeof(ModPatch) == MOD_ARENA_SIZE, mod_patch_size);
+
+//______________________________________________________________________________
+//
+// Tables.  The waves start at the middle of their range and rise, like a sine.
+// CURVE is 1 - e^-4x scaled to [0, 255], which envelope stages follow.  RATES
+// are phase increments per tick for 0.02Hz * 2500^(n / 127), and TIMES for a
+// stage lasting 1ms * 10000^(n / 127).
+//______________________________________________________________________________
+
+#define WAVE_COUNT		MOD_RANDOM
+
+static const u8 WAVES[WAVE_COUNT][256] =
+{
+	// sine
+	{
+		128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+		176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+		218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+		245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+		255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+		245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+		218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+		176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+		128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+		 79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+		 37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+		 10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+		  0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+		 10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+		 37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+		 79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+	},
+	// triangle
+	{
+		128, 130, 132, 134, 136, 138, 140, 142, 144, 146, 148, 150, 152, 154, 156, 158,
+		160, 162, 164, 166, 168, 170, 172, 174, 176, 178, 180, 182, 184, 186, 188, 190,
+		192, 194, 196, 198, 200, 202, 204, 206, 208, 210, 212, 214, 216, 218, 220, 222,
+		224, 226, 228, 230, 232, 234, 236, 238, 240, 242, 244, 246, 248, 250, 252, 254,
+		255, 253, 251, 249, 247, 245, 243, 241, 239, 237, 235, 233, 231, 229, 227, 225,
+		223, 221, 219, 217, 215, 213, 211, 209, 207, 205, 203, 201, 199, 197, 195, 193,
+		191, 189, 187, 185, 183, 181, 179, 177, 175, 173, 171, 169, 167, 165, 163, 161,
+		159, 157, 155, 153, 151, 149, 147, 145, 143, 141, 139, 137, 135, 133, 131, 129,
+		127, 125, 123, 121, 119, 117, 115, 113, 111, 109, 107, 105, 103, 101,  99,  97,
+		 95,  93,  91,  89,  87,  85,  83,  81,  79,  77,  75,  73,  71,  69,  67,  65,
+		 63,  61,  59,  57,  55,  53,  51,  49,  47,  45,  43,  41,  39,  37,  35,  33,
+		 31,  29,  27,  25,  23,  21,  19,  17,  15,  13,  11,   9,   7,   5,   3,   1,
+		  0,   2,   4,   6,   8,  10,  12,  14,  16,  18,  20,  22,  24,  26,  28,  30,
+		 32,  34,  36,  38,  40,  42,  44,  46,  48,  50,  52,  54,  56,  58,  60,  62,
+		 64,  66,  68,  70,  72,  74,  76,  78,  80,  82,  84,  86,  88,  90,  92,  94,
+		 96,  98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 118, 120, 122, 124, 126,
+	},
+	// saw up
+	{
+		  0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,
+		 16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,
+		 32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,
+		 48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+		 64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,
+		 80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,
+		 96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+		112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+		128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139, 140, 141, 142, 143,
+		144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157, 158, 159,
+		160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170, 171, 172, 173, 174, 175,
+		176, 177, 178, 179, 180, 181, 182, 183, 184, 185, 186, 187, 188, 189, 190, 191,
+		192, 193, 194, 195, 196, 197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207,
+		208, 209, 210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222, 223,
+		224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235, 236, 237, 238, 239,
+		240, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250, 251, 252, 253, 254, 255,
+	},
+	// saw down
+	{
+		255, 254, 253, 252, 251, 250, 249, 248, 247, 246, 245, 244, 243, 242, 241, 240,
+		239, 238, 237, 236, 235, 234, 233, 232, 231, 230, 229, 228, 227, 226, 225, 224,
+		223, 222, 221, 220, 219, 218, 217, 216, 215, 214, 213, 212, 211, 210, 209, 208,
+		207, 206, 205, 204, 203, 202, 201, 200, 199, 198, 197, 196, 195, 194, 193, 192,
+		191, 190, 189, 188, 187, 186, 185, 184, 183, 182, 181, 180, 179, 178, 177, 176,
+		175, 174, 173, 172, 171, 170, 169, 168, 167, 166, 165, 164, 163, 162, 161, 160,
+		159, 158, 157, 156, 155, 154, 153, 152, 151, 150, 149, 148, 147, 146, 145, 144,
+		143, 142, 141, 140, 139, 138, 137, 136, 135, 134, 133, 132, 131, 130, 129, 128,
+		127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113, 112,
+		111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100,  99,  98,  97,  96,
+		 95,  94,  93,  92,  91,  90,  89,  88,  87,  86,  85,  84,  83,  82,  81,  80,
+		 79,  78,  77,  76,  75,  74,  73,  72,  71,  70,  69,  68,  67,  66,  65,  64,
+		 63,  62,  61,  60,  59,  58,  57,  56,  55,  54,  53,  52,  51,  50,  49,  48,
+		 47,  46,  45,  44,  43,  42,  41,  40,  39,  38,  37,  36,  35,  34,  33,  32,
+		 31,  30,  29,  28,  27,  26,  25,  24,  23,  22,  21,  20,  19,  18,  17,  16,
+		 15,  14,  13,  12,  11,  10,   9,   8,   7,   6,   5,   4,   3,   2,   1,   0,
+	},
+	// square
+	{
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+		  0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+	},
+};
+
+static const u8 CURVE[256] =
+{
+	  0,   4,   8,  12,  16,  20,  23,  27,  31,  34,  38,  41,  45,  48,  51,  54,
+	 58,  61,  64,  67,  70,  73,  76,  79,  81,  84,  87,  90,  92,  95,  98, 100,
+	103, 105, 107, 110, 112, 114, 117, 119, 121, 123, 125, 127, 129, 132, 134, 135,
+	137, 139, 141, 143, 145, 147, 148, 150, 152, 154, 155, 157, 158, 160, 162, 163,
+	165, 166, 168, 169, 170, 172, 173, 174, 176, 177, 178, 180, 181, 182, 183, 185,
+	186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196, 197, 198, 199, 200, 201,
+	202, 203, 204, 205, 206, 206, 207, 208, 209, 210, 211, 211, 212, 213, 213, 214,
+	215, 216, 216, 217, 218, 218, 219, 220, 220, 221, 221, 222, 223, 223, 224, 224,
+	225, 225, 226, 226, 227, 228, 228, 229, 229, 229, 230, 230, 231, 231, 232, 232,
+	233, 233, 233, 234, 234, 235, 235, 235, 236, 236, 237, 237, 237, 238, 238, 238,
+	239, 239, 239, 240, 240, 240, 241, 241, 241, 241, 242, 242, 242, 243, 243, 243,
+	243, 244, 244, 244, 244, 245, 245, 245, 245, 245, 246, 246, 246, 246, 247, 247,
+	247, 247, 247, 248, 248, 248, 248, 248, 248, 249, 249, 249, 249, 249, 249, 250,
+	250, 250, 250, 250, 250, 251, 251, 251, 251, 251, 251, 251, 252, 252, 252, 252,
+	252, 252, 252, 252, 252, 253, 253, 253, 253, 253, 253, 253, 253, 253, 254, 254,
+	254, 254, 254, 254, 254, 254, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255,
+};
+
+static const u32 RATES[128] =
+{
+	    85899,     91358,     97163,    103337,    109904,    116887,    124315,    132214,
+	   140616,    149551,    159054,    169161,    179910,    191342,    203501,    216432,
+	   230185,    244812,    260368,    276913,    294509,    313223,    333127,    354295,
+	   376808,    400752,    426217,    453301,    482105,    512740,    545322,    579974,
+	   616827,    656023,    697709,    742045,    789197,    839346,    892681,    949406,
+	  1009734,   1073897,   1142137,   1214712,   1291900,   1373992,   1461301,   1554158,
+	  1652915,   1757948,   1869655,   1988460,   2114815,   2249199,   2392122,   2544126,
+	  2705790,   2877727,   3060589,   3255071,   3461911,   3681894,   3915856,   4164685,
+	  4429325,   4710782,   5010124,   5328487,   5667080,   6027188,   6410179,   6817507,
+	  7250718,   7711458,   8201474,   8722628,   9276898,   9866388,  10493338,  11160125,
+	 11869284,  12623505,  13425652,  14278770,  15186099,  16151084,  17177387,  18268906,
+	 19429784,  20664429,  21977528,  23374066,  24859346,  26439007,  28119045,  29905840,
+	 31806175,  33827264,  35976781,  38262887,  40694261,  43280135,  46030325,  48955272,
+	 52066083,  55374566,  58893284,  62635594,  66615706,  70848730,  75350737,  80138819,
+	 85231154,  90647076,  96407148, 102533237, 109048602, 115977978, 123347675, 131185671,
+	139521724, 148387482, 157816606, 167844894, 178510418, 189853671, 201917719, 214748365,
+};
+
+static const u32 TIMES[128] =
+{
+	4294967295, 3994512626, 3715076279, 3455187916, 3213480059, 2988680887, 2779607554, 2585159957,
+	2404314952, 2236120969, 2079693006, 1934207969, 1798900346, 1673058174, 1556019299, 1447167885,
+	1345931177, 1251776489, 1164208397, 1082766135, 1007021171,  936574951,  871056799,  810121974,
+	 753449847,  700742222,  651721762,  606130531,  563728637,  524292969,  487616026,  453504821,
+	 421779866,  392274233,  364832668,  339310779,  315574275,  293498259,  272966573,  253871181,
+	 236111609,  219594409,  204232670,  189945562,  176657910,  164299796,  152806195,  142116630,
+	 132174853,  122928554,  114329080,  106331183,   98892780,   91974730,   85540632,   79556633,
+	  73991244,   68815183,   64001213,   59524005,   55360000,   51487288,   47885492,   44535659,
+	  41420165,   38522615,   35827763,   33321430,   30990428,   28822491,   26806212,   24930982,
+	  23186933,   21564890,   20056317,   18653276,   17348385,   16134778,   15006069,   13956318,
+	  12980003,   12071986,   11227490,   10442070,    9711595,    9032219,    8400370,    7812722,
+	   7266182,    6757876,    6285128,    5845452,    5436533,    5056220,    4702512,    4373547,
+	   4067596,    3783047,    3518403,    3272273,    3043361,    2830463,    2632457,    2448304,
+	   2277032,    2117742,    1969596,    1831812,    1703668,    1584488,    1473645,    1370556,
+	   1274678,    1185508,    1102576,    1025445,     953710,     886993,     824943,     767234,
+	    713562,     663645,     617220,     574042,     533885,     496537,     461802,     429496,
+};
+
+//______________________________________________________________________________
+
+#define PORTS			3
+#define NOT_SENT		0xFF
+
+// what a CC costs against a port's budget, in sixteenths of a byte, and how
+// much a port can save up beyond a tick's budget
+#define CC_COST			(3 * 16)
+#define MOST_SAVED		(4 * CC_COST)
+#define MOST_BUDGET		(64 * CC_COST)
+
+// envelope stages
+#define IDLE			0
+#define ATTACK			1
+#define DECAY			2
+#define SUSTAIN			3
+#define RELEASE			4
+
+typedef struct
+{
+	u32 phase;			// LFO phase, progress through an envelope stage, or follower level
+	u8 stage;			// envelope
+	u8 level;			// envelope, [0, 255]
+	u8 from;			// level the envelope stage started at, or the LFO's random value
+	u8 value;			// 7 bit CC value
+	u8 sent;			// last value sent, or NOT_SENT
+} Mod;
+
+static INSTANCE ModPatch *g_Patch = 0;
+static INSTANCE Mod g_Mods[MOD_GENERATORS];
+
+// generators that are on, and those with a value waiting to be sent
+static INSTANCE u16 g_Active = 0;
+static INSTANCE u16 g_Pending = 0;
+
+// where the next tick starts sending, after the last generator that did
+static INSTANCE u8 g_Next = 0;
+
+static INSTANCE u16 g_Budget[PORTS];
+static INSTANCE u16 g_Credit[PORTS];
+
+static INSTANCE u8 g_Held = 0;
+static INSTANCE u8 g_Pressure = 0;
+static INSTANCE u32 g_Random = 1;
+
+static INSTANCE mod_handler g_Handler = 0;
+
+//______________________________________________________________________________
+
+// x scaled by c / 255, near enough - exact at both ends
+static u8 scale(u8 x, u8 c)
+{
+	return (x * (c + 1)) >> 8;
+}
+
+// xorshift, for sample and hold
+static u8 random_byte()
+{
+	u32 x = g_Random;
+	
+	x ^= (x << 13) & 0xFFFFFFFF;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFF;
+	g_Random = x;
+	
+	return x >> 24;
+}
+
+// a source scaled by depth / 256 and added to the center - rounded away from
+// it, so a full depth reaches both ends of the CC range
+static u8 modulate(u8 center, s16 source, s8 depth)
+{
+	s16 offset = source * depth;
+	s16 value = center + (offset >= 0 ? (offset + 0x80) >> 8 : -((0x80 - offset) >> 8));
+	
+	return value < 0 ? 0 : value > 127 ? 127 : value;
+}
+
+// each source is [-128, 127] for an LFO, [0, 255] otherwise
+static s16 lfo(u8 g, Mod *m)
+{
+	u8 shape = g_Patch->shape[g];
+	u32 phase = (m->phase + RATES[g_Patch->rate[g] & 0x7F]) & 0xFFFFFFFF;
+	u8 wrapped = phase < m->phase;
+	
+	m->phase = phase;
+	
+	if (shape == MOD_RANDOM)
+	{
+		if (wrapped)
+		{
+			m->from = random_byte();
+		}
+		return m->from - 128;
+	}
+	
+	return WAVES[shape < WAVE_COUNT ? shape : MOD_SINE][phase >> 24] - 128;
+}
+
+static void start_stage(Mod *m, u8 stage)
+{
+	m->stage = stage;
+	m->from = m->level;
+	m->phase = 0;
+}
+
+static s16 envelope(u8 g, Mod *m)
+{
+	u8 sustain = g_Patch->sustain[g] & 0x7F;
+	u8 time;
+	
+	sustain = (sustain << 1) | (sustain >> 6);
+	
+	switch (m->stage)
+	{
+		case ATTACK:
+			time = g_Patch->rate[g];
+			break;
+			
+		case DECAY:
+			time = g_Patch->decay[g];
+			break;
+			
+		case RELEASE:
+			time = g_Patch->release[g];
+			break;
+			
+		case SUSTAIN:
+			m->level = sustain;
+			return m->level;
+			
+		default:
+			return m->level;
+	}
+	
+	u32 phase = (m->phase + TIMES[time & 0x7F]) & 0xFFFFFFFF;
+	u8 done = phase < m->phase;
+	u8 c = done ? 0xFF : CURVE[phase >> 24];
+	
+	m->phase = phase;
+	
+	switch (m->stage)
+	{
+		case ATTACK:
+			m->level = m->from + scale(0xFF - m->from, c);
+			if (done)
+			{
+				start_stage(m, DECAY);
+			}
+			break;
+			
+		case DECAY:
+			m->level = sustain + scale(m->from - sustain, 0xFF - c);
+			if (done)
+			{
+				start_stage(m, SUSTAIN);
+			}
+			break;
+			
+		case RELEASE:
+			m->level = scale(m->from, 0xFF - c);
+			if (done)
+			{
+				start_stage(m, IDLE);
+			}
+			break;
+	}
+	
+	return m->level;
+}
+
+// slews towards the pressure at one rate rising and another falling
+static s16 follower(u8 g, Mod *m)
+{
+	u32 target = (u32)((g_Pressure << 1) | (g_Pressure >> 6)) << 24;
+	u32 level = m->phase;
+	
+	if (level < target)
+	{
+		u32 step = TIMES[g_Patch->rate[g] & 0x7F];
+		level = target - level > step ? level + step : target;
+	}
+	else
+	{
+		u32 step = TIMES[g_Patch->decay[g] & 0x7F];
+		level = level - target > step ? level - step : target;
+	}
+	
+	m->phase = level;
+	
+	return level >> 24;
+}
+
+static void restart(u8 g)
+{
+	Mod *m = &g_Mods[g];
+	u16 bit = 1 << g;
+	u8 kind = g_Patch ? g_Patch->kind[g] : MOD_OFF;
+	
+	m->phase = 0;
+	m->stage = IDLE;
+	m->level = 0;
+	m->from = 0x80;
+	m->value = 0;
+	m->sent = NOT_SENT;
+	
+	g_Pending &= ~bit;
+	
+	// an unknown kind is off
+	if (kind != MOD_OFF && kind < MOD_KIND_COUNT)
+	{
+		g_Active |= bit;
+	}
+	else
+	{
+		g_Active &= ~bit;
+	}
+}
+
+//______________________________________________________________________________
+
+void mod_init(mod_handler handler)
+{
+	g_Patch = arena_claim("mod", MOD_ARENA_SIZE, ARENA_ALIGN);
+	g_Handler = handler;
+	g_Held = 0;
+	g_Pressure = 0;
+	g_Random = 1;
+	g_Next = 0;
+	
+	for (u8 port=0; port < PORTS; ++port)
+	{
+		g_Budget[port] = port == DINMIDI ? MOD_BUDGET_DIN : MOD_BUDGET_USB;
+		g_Credit[port] = 0;
+	}
+	
+	if (g_Patch)
+	{
+		for (u8 g=0; g < MOD_GENERATORS; ++g)
+		{
+			g_Patch->center[g] = 64;
+			g_Patch->port[g] = DINMIDI;
+			g_Patch->cc[g] = 1;
+		}
+	}
+	
+	mod_patch_changed();
+}
+
+ModPatch *mod_patch()
+{
+	return g_Patch;
+}
+
+void mod_patch_changed()
+{
+	for (u8 g=0; g < MOD_GENERATORS; ++g)
+	{
+		restart(g);
+	}
+}
+
+static void set_output(u8 g, u8 kind, s8 depth, u8 center, u8 port, u8 channel, u8 cc)
+{
+	g_Patch->kind[g] = kind;
+	g_Patch->depth[g] = depth;
+	g_Patch->center[g] = center;
+	g_Patch->port[g] = port;
+	g_Patch->channel[g] = channel;
+	g_Patch->cc[g] = cc;
+	
+	restart(g);
+}
+
+void mod_set_lfo(u8 generator, u8 shape, u8 rate, s8 depth, u8 center, u8 port, u8 channel, u8 cc)
+{
+	if (g_Patch && generator < MOD_GENERATORS)
+	{
+		g_Patch->shape[generator] = shape;
+		g_Patch->rate[generator] = rate;
+		set_output(generator, MOD_LFO, depth, center, port, channel, cc);
+	}
+}
+
+void mod_set_envelope(u8 generator, u8 attack, u8 decay, u8 sustain, u8 release, s8 depth, u8 center,
+					  u8 port, u8 channel, u8 cc)
+{
+	if (g_Patch && generator < MOD_GENERATORS)
+	{
+		g_Patch->rate[generator] = attack;
+		g_Patch->decay[generator] = decay;
+		g_Patch->sustain[generator] = sustain;
+		g_Patch->release[generator] = release;
+		set_output(generator, MOD_ENVELOPE, depth, center, port, channel, cc);
+	}
+}
+
+void mod_set_follower(u8 generator, u8 rise, u8 fall, s8 depth, u8 center, u8 port, u8 channel, u8 cc)
+{
+	if (g_Patch && generator < MOD_GENERATORS)
+	{
+		g_Patch->rate[generator] = rise;
+		g_Patch->decay[generator] = fall;
+		set_output(generator, MOD_FOLLOWER, depth, center, port, channel, cc);
+	}
+}
+
+void mod_set_budget(u8 port, u16 budget)
+{
+	if (port < PORTS)
+	{
+		g_Budget[port] = budget < MOST_BUDGET ? budget : MOST_BUDGET;
+	}
+}
+
+//______________________________________________________________________________
+
+static void gate_envelopes(u8 stage)
+{
+	for (u8 g=0; g < MOD_GENERATORS; ++g)
+	{
+		Mod *m = &g_Mods[g];
+		
+		if ((g_Active >> g) & 1 && g_Patch->kind[g] == MOD_ENVELOPE && (stage == ATTACK || m->stage != IDLE))
+		{
+			start_stage(m, stage);
+		}
+	}
+}
+
+void mod_note_on()
+{
+	if (g_Held < 0xFF)
+	{
+		++g_Held;
+	}
+	gate_envelopes(ATTACK);
+}
+
+void mod_note_off()
+{
+	if (g_Held && --g_Held == 0)
+	{
+		gate_envelopes(RELEASE);
+	}
+}
+
+void mod_pressure(u8 value)
+{
+	g_Pressure = value & 0x7F;
+}
+
+u8 mod_sent(u8 generator)
+{
+	return generator < MOD_GENERATORS ? g_Mods[generator].sent : NOT_SENT;
+}
+
+//______________________________________________________________________________
+
+void mod_tick()
+{
+	for (u8 port=0; port < PORTS; ++port)
+	{
+		u16 credit = g_Credit[port] + g_Budget[port];
+		u16 most = g_Budget[port] + MOST_SAVED;
+		
+		g_Credit[port] = credit < most ? credit : most;
+	}
+	
+	// run every generator that's on
+	u16 active = g_Active;
+	
+	for (u8 g=0; active; ++g, active >>= 1)
+	{
+		if (!(active & 1))
+		{
+			continue;
+		}
+		
+		Mod *m = &g_Mods[g];
+		s16 source;
+		
+		switch (g_Patch->kind[g])
+		{
+			case MOD_LFO:
+				source = lfo(g, m);
+				break;
+				
+			case MOD_ENVELOPE:
+				source = envelope(g, m);
+				break;
+				
+			default:
+				source = follower(g, m);
+				break;
+		}
+		
+		m->value = modulate(g_Patch->center[g], source, g_Patch->depth[g]);
+		
+		if (m->value != m->sent)
+		{
+			g_Pending |= 1 << g;
+		}
+		else
+		{
+			g_Pending &= ~(1 << g);
+		}
+	}
+	
+	// send what's changed, round robin, while the ports' budgets last
+	u16 pending = g_Pending;
+	
+	for (u8 i=0; pending && i < MOD_GENERATORS; ++i)
+	{
+		u8 g = (g_Next + i) % MOD_GENERATORS;
+		u16 bit = 1 << g;
+		
+		if (!(pending & bit))
+		{
+			continue;
+		}
+		
+		pending &= ~bit;
+		
+		u8 port = g_Patch->port[g] < PORTS ? g_Patch->port[g] : DINMIDI;
+		
+		if (g_Credit[port] < CC_COST)
+		{
+			continue;
+		}
+		
+		Mod *m = &g_Mods[g];
+		
+		g_Credit[port] -= CC_COST;
+		if (g_Handler)
+		{
+			g_Handler(port, g_Patch->channel[g] & 0x0F, g_Patch->cc[g] & 0x7F, m->value);
+		}
+		
+		m->sent = m->value;
+		g_Pending &= ~bit;
+		g_Next = (g + 1) % MOD_GENERATORS;
+	}
+}
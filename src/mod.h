@@ -0,0 +1,184 @@
+#ifndef LAUNCHPAD_MOD_H
+#define LAUNCHPAD_MOD_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Modulation generators - LFOs, envelopes and pressure followers, each sending
+// a CC.  There's no floating point on the Cortex-M3, and no time for it in
+// the 1ms tick anyway, so everything runs on 32 bit phase accumulators and
+// tables: a phase's top byte indexes a 256 entry wavetable, an envelope
+// stage's indexes an exponential curve, and rates and times are 7 bit
+// settings looked up in tables of phase increments.  A tick is a few adds,
+// loads and one multiply per generator.
+//
+// A CC is only sent when its 7 bit value changes, and each port has a budget
+// of bytes per tick that the generators share, so they can't flood the DIN
+// port.  When a port's budget runs out, generators wait their turn and send
+// their latest value, round robin.
+//
+// The settings are kept as a structure of arrays, like the sequencer's
+// pattern, so a host can load them as one block (see transfer.h), and are
+// claimed from the arena (see arena.h).
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+#include "arena.h"
+
+#define MOD_GENERATORS			16
+
+// kinds of generator
+#define MOD_OFF					0
+#define MOD_LFO					1
+#define MOD_ENVELOPE			2	// attack, decay, sustain, release - on held notes
+#define MOD_FOLLOWER			3	// follows pressure, slewed
+#define MOD_KIND_COUNT			4
+
+// LFO shapes - all but MOD_RANDOM are wavetables
+#define MOD_SINE				0
+#define MOD_TRIANGLE			1
+#define MOD_SAW_UP				2
+#define MOD_SAW_DOWN			3
+#define MOD_SQUARE				4
+#define MOD_RANDOM				5	// sample and hold, a new value each cycle
+#define MOD_SHAPE_COUNT			6
+
+// rate settings, [0, 127], run from 0.02Hz to 50Hz (LFOs) and times from 1ms
+// to 10s (envelope stages and follower slew), exponentially
+#define MOD_RATE_1HZ			64
+#define MOD_TIME_100MS			64
+
+// default share of each port's bandwidth, in sixteenths of a byte per tick -
+// DIN MIDI carries 3.125 bytes a ms, so half of that
+#define MOD_BUDGET_USB			(48 * 16)
+#define MOD_BUDGET_DIN			25
+
+typedef struct
+{
+	u8 kind[MOD_GENERATORS];		// MOD_OFF, MOD_LFO, MOD_ENVELOPE or MOD_FOLLOWER
+	u8 shape[MOD_GENERATORS];		// LFOs - MOD_SINE...
+	u8 rate[MOD_GENERATORS];		// LFO rate, envelope attack, follower rise
+	u8 decay[MOD_GENERATORS];		// envelope decay, follower fall
+	u8 sustain[MOD_GENERATORS];		// envelope sustain level, [0, 127]
+	u8 release[MOD_GENERATORS];		// envelope release
+	u8 depth[MOD_GENERATORS];		// signed - [-127, 127] as two's complement
+	u8 center[MOD_GENERATORS];		// CC value with no modulation
+	u8 port[MOD_GENERATORS];		// USBSTANDALONE, USBMIDI or DINMIDI
+	u8 channel[MOD_GENERATORS];
+	u8 cc[MOD_GENERATORS];
+} ModPatch;
+
+// what mod_init claims
+#define MOD_ARENA_SIZE			(11 * MOD_GENERATORS)
+
+/**
+ * Receives the CCs to send.
+ */
+typedef void (*mod_handler)(u8 port, u8 channel, u8 cc, u8 value);
+
+/**
+ * Claim the settings, turn every generator off, set the default
+ * budgets and the output, which may be 0 to drop the CCs.  Call from
+ * app_init.
+ */
+void mod_init(mod_handler handler);
+
+/**
+ * The settings, to edit directly or load into.  Call mod_patch_changed
+ * afterwards.  Anything out of range is taken in range as it runs.
+ */
+ModPatch *mod_patch();
+
+/**
+ * Restart every generator after changing the settings - LFOs from the start
+ * of their cycle, envelopes idle.  Each CC is sent again on the next tick.
+ */
+void mod_patch_changed();
+
+/**
+ * Set up an LFO.
+ *
+ * @param rate - [0, 127], MOD_RATE_1HZ is about 1Hz
+ * @param depth - [-127, 127], 127 sweeps the whole CC range about center 64
+ */
+void mod_set_lfo(u8 generator, u8 shape, u8 rate, s8 depth, u8 center, u8 port, u8 channel, u8 cc);
+
+/**
+ * Set up an envelope, which plays while notes are held.
+ *
+ * @param attack, decay, release - times, [0, 127], MOD_TIME_100MS is about 100ms
+ * @param sustain - level, [0, 127]
+ * @param depth - [-127, 127], 127 rises from center by the whole CC range
+ */
+void mod_set_envelope(u8 generator, u8 attack, u8 decay, u8 sustain, u8 release, s8 depth, u8 center,
+					  u8 port, u8 channel, u8 cc);
+
+/**
+ * Set up a pressure follower.
+ *
+ * @param rise, fall - how long it takes to slew the whole range, [0, 127]
+ * @param depth - [-127, 127], 127 rises from center by the whole CC range
+ */
+void mod_set_follower(u8 generator, u8 rise, u8 fall, s8 depth, u8 center, u8 port, u8 channel, u8 cc);
+
+/**
+ * Share of a port's bandwidth the generators may use, in sixteenths of a byte
+ * per tick.  A CC costs 3 bytes.
+ */
+void mod_set_budget(u8 port, u16 budget);
+
+/**
+ * Notes being played, which gate the envelopes - each note on restarts them,
+ * and they release when the last note is let go.
+ */
+void mod_note_on();
+void mod_note_off();
+
+/**
+ * Latest pressure, [0, 127], for the followers.
+ */
+void mod_pressure(u8 value);
+
+/**
+ * Advance every generator by one tick and send what's changed, budget
+ * allowing.  Call from app_timer_event.
+ */
+void mod_tick();
+
+/**
+ * The value a generator last sent, or 0xFF if it hasn't.
+ */
+u8 mod_sent(u8 generator);
+
+#endif
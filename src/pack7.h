@@ -0,0 +1,130 @@
+#ifndef LAUNCHPAD_PACK7_H
+#define LAUNCHPAD_PACK7_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// 8-to-7 bit packing for SysEx.  Every 7 bytes of 8 bit data become 8 bytes of
+// 7 bit data, most significant bits first, exactly as the bootloader expects
+// (see tools/hextosyx.cpp).  A partial group at the end is padded with zeros.
+//
+// This header stands alone so the host tools and the firmware share it - it
+// only uses plain C types and compiles as C99 or C++.
+// ____________________________________________________________________________
+
+// bytes of packed data for length bytes of unpacked data
+#define PACK7_SIZE(length)		((((length) + 6) / 7) * 8)
+
+static inline void pack7_group(unsigned char *out, const unsigned char *in)
+{
+	out[0] =                  in[0] >> 1;
+	out[1] = ((in[0] << 6) | (in[1] >> 2)) & 0x7F;
+	out[2] = ((in[1] << 5) | (in[2] >> 3)) & 0x7F;
+	out[3] = ((in[2] << 4) | (in[3] >> 4)) & 0x7F;
+	out[4] = ((in[3] << 3) | (in[4] >> 5)) & 0x7F;
+	out[5] = ((in[4] << 2) | (in[5] >> 6)) & 0x7F;
+	out[6] = ((in[5] << 1) | (in[6] >> 7)) & 0x7F;
+	out[7] =                  in[6] & 0x7F;
+}
+
+static inline void unpack7_group(unsigned char *out, const unsigned char *in)
+{
+	out[0] = (in[0] << 1) | (in[1] >> 6);
+	out[1] = (in[1] << 2) | (in[2] >> 5);
+	out[2] = (in[2] << 3) | (in[3] >> 4);
+	out[3] = (in[3] << 4) | (in[4] >> 3);
+	out[4] = (in[4] << 5) | (in[5] >> 2);
+	out[5] = (in[5] << 6) | (in[6] >> 1);
+	out[6] = (in[6] << 7) | in[7];
+}
+
+/**
+ * Pack length bytes from in to PACK7_SIZE(length) bytes at out.  Returns the
+ * number of bytes written.
+ */
+static inline unsigned long pack7(unsigned char *out, const unsigned char *in, unsigned long length)
+{
+	unsigned long i = 0;
+	unsigned char *start = out;
+	
+	for (; i + 7 <= length; i += 7)
+	{
+		pack7_group(out, in + i);
+		out += 8;
+	}
+	
+	if (i < length)
+	{
+		unsigned char tail[7] = {0};
+		
+		for (unsigned long j=0; i + j < length; ++j)
+		{
+			tail[j] = in[i + j];
+		}
+		
+		pack7_group(out, tail);
+		out += 8;
+	}
+	
+	return out - start;
+}
+
+/**
+ * Unpack PACK7_SIZE(length) bytes from in to length bytes at out.  Padding in
+ * a partial last group is dropped.
+ */
+static inline void unpack7(unsigned char *out, const unsigned char *in, unsigned long length)
+{
+	unsigned long i = 0;
+	
+	for (; i + 7 <= length; i += 7)
+	{
+		unpack7_group(out + i, in);
+		in += 8;
+	}
+	
+	if (i < length)
+	{
+		unsigned char tail[7];
+		
+		unpack7_group(tail, in);
+		
+		for (unsigned long j=0; i + j < length; ++j)
+		{
+			out[i + j] = tail[j];
+		}
+	}
+}
+
+#endif
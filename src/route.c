@@ -0,0 +1,164 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "app.h"
+#include "instance.h"
+#include "route.h"
+#include "sysex.h"
+
+//______________________________________________________________________________
+
+typedef struct
+{
+	u8 types;
+	u8 channel;
+} Route;
+
+static INSTANCE Route g_Routes[ROUTE_PORTS][ROUTE_PORTS];
+
+// compiled: destination port bits by [source port][status nibble]
+static INSTANCE u8 g_Table[ROUTE_PORTS][16];
+
+//______________________________________________________________________________
+
+static void compile()
+{
+	for (u8 src=0; src < ROUTE_PORTS; ++src)
+	{
+		for (u8 nibble=0; nibble < 16; ++nibble)
+		{
+			u8 dests = 0;
+			
+			// data bytes (nibbles below 8) never route
+			if (nibble >= 8)
+			{
+				for (u8 dst=0; dst < ROUTE_PORTS; ++dst)
+				{
+					if (g_Routes[src][dst].types & (1 << (nibble - 8)))
+					{
+						dests |= 1 << dst;
+					}
+				}
+			}
+			
+			g_Table[src][nibble] = dests;
+		}
+	}
+}
+
+void route_init()
+{
+	for (u8 src=0; src < ROUTE_PORTS; ++src)
+	{
+		for (u8 dst=0; dst < ROUTE_PORTS; ++dst)
+		{
+			g_Routes[src][dst].types = ROUTE_NONE;
+			g_Routes[src][dst].channel = ROUTE_KEEP_CHANNEL;
+		}
+	}
+	
+	g_Routes[USBMIDI][DINMIDI].types = ROUTE_ALL;
+	g_Routes[DINMIDI][USBMIDI].types = ROUTE_ALL;
+	
+	compile();
+}
+
+void route_set(u8 source, u8 destination, u8 types, u8 channel)
+{
+	if (source >= ROUTE_PORTS || destination >= ROUTE_PORTS)
+	{
+		return;
+	}
+	
+	g_Routes[source][destination].types = types;
+	g_Routes[source][destination].channel = channel < 16 ? channel : ROUTE_KEEP_CHANNEL;
+	
+	compile();
+}
+
+//______________________________________________________________________________
+
+void route_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	if (port >= ROUTE_PORTS)
+	{
+		return;
+	}
+	
+	u8 dests = g_Table[port][status >> 4];
+	
+	for (u8 dst=0; dests; ++dst, dests >>= 1)
+	{
+		if (dests & 1)
+		{
+			u8 channel = g_Routes[port][dst].channel;
+			
+			if (channel != ROUTE_KEEP_CHANNEL && status < 0xF0)
+			{
+				hal_send_midi(dst, (status & 0xF0) | channel, d1, d2);
+			}
+			else
+			{
+				hal_send_midi(dst, status, d1, d2);
+			}
+		}
+	}
+}
+
+u8 route_sysex(u8 port, const u8 *data, u16 count)
+{
+	(void)port;
+	
+	if (sysex_command(data, count) != SYSEX_ROUTE)
+	{
+		return 0;
+	}
+	
+	const u8 *p = data + SYSEX_DATA;
+	const u8 *end = data + count - 1;
+	
+	// set them all, then compile once
+	for (; end - p >= 5; p += 5)
+	{
+		u8 src = p[0];
+		u8 dst = p[1];
+		
+		if (src < ROUTE_PORTS && dst < ROUTE_PORTS)
+		{
+			g_Routes[src][dst].types = p[2] | (p[3] << 7);
+			g_Routes[src][dst].channel = p[4] < 16 ? p[4] : ROUTE_KEEP_CHANNEL;
+		}
+	}
+	
+	compile();
+	return 1;
+}
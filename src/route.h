@@ -0,0 +1,102 @@
+#ifndef LAUNCHPAD_ROUTE_H
+#define LAUNCHPAD_ROUTE_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// MIDI routing matrix between the three ports.  Each route from one port to
+// another (or to itself, for a thru) has a message type filter and can force
+// channel messages onto one channel.  Several routes into one port merge.
+//
+// The routes are compiled into a table of destination ports indexed by input
+// port and status nibble, so routing a message is one lookup plus a send per
+// destination.
+//
+// Routes can be changed over SysEx - after the header and SYSEX_ROUTE, any
+// number of five byte entries:
+//
+//   source  destination  types (low 7 bits)  types (bit 7)  channel
+//
+// with channel ROUTE_KEEP_CHANNEL or [0, 15].  Routes not mentioned are kept.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define ROUTE_PORTS				3
+
+// message type filter - bit n passes status nibble 0x8 + n
+#define ROUTE_NOTE_OFF			0x01
+#define ROUTE_NOTE_ON			0x02
+#define ROUTE_POLY_AFTERTOUCH	0x04
+#define ROUTE_CC				0x08
+#define ROUTE_PROGRAM			0x10
+#define ROUTE_CHANNEL_AFTERTOUCH 0x20
+#define ROUTE_PITCH_BEND		0x40
+#define ROUTE_SYSTEM			0x80
+
+#define ROUTE_NONE				0x00
+#define ROUTE_NOTES				(ROUTE_NOTE_OFF | ROUTE_NOTE_ON)
+#define ROUTE_CHANNEL			0x7F
+#define ROUTE_ALL				0xFF
+
+// leave channel messages on the channel they came in on
+#define ROUTE_KEEP_CHANNEL		0x7F
+
+/**
+ * Clear all routes, then set up USBMIDI <-> DINMIDI for everything, like a
+ * MIDI interface.
+ */
+void route_init();
+
+/**
+ * Set one route and rebuild the table.
+ *
+ * @param source - port messages arrive on - USBSTANDALONE, USBMIDI or DINMIDI
+ * @param destination - port to send them to
+ * @param types - ROUTE_* filter bits, ROUTE_NONE to remove the route
+ * @param channel - channel to send channel messages on, or ROUTE_KEEP_CHANNEL
+ */
+void route_set(u8 source, u8 destination, u8 types, u8 channel);
+
+/**
+ * Send a message everywhere its port routes it.  Call from app_midi_event.
+ */
+void route_midi(u8 port, u8 status, u8 d1, u8 d2);
+
+/**
+ * Handle a SysEx message.  Returns nonzero if it was a routing message.
+ */
+u8 route_sysex(u8 port, const u8 *data, u16 count);
+
+#endif
@@ -0,0 +1,385 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "seq.h"
+
+ARENA_CHECK(sizeof(SeqPattern) == SEQ_ARENA_SIZE, seq_pattern_size);
+
+//______________________________________________________________________________
+
+#define WORDS			(SEQ_STEPS / 32)
+#define NO_NOTE			0xFF
+
+// ticks per clock pulse at 120 bpm - a guess at how long a synced step takes
+// until one's been timed
+#define PULSE_TICKS		21
+
+typedef struct
+{
+	u8 note;			// sounding, or NO_NOTE
+	u8 channel;			// it's sounding on
+	u16 gate;			// ticks left to sound
+} Track;
+
+static INSTANCE SeqPattern *g_Pattern = 0;
+static INSTANCE Track g_Tracks[SEQ_TRACKS];
+
+// active steps of each track, tracks with any, and tracks with a note sounding
+static INSTANCE u32 g_Active[SEQ_TRACKS][WORDS];
+static INSTANCE u8 g_Used = 0;
+static INSTANCE u8 g_Sounding = 0;
+
+static INSTANCE u8 g_Running = 0;
+static INSTANCE u8 g_Sync = 0;
+static INSTANCE u16 g_Rate = 6;
+static INSTANCE u8 g_Swing = SEQ_SWING_NONE;
+
+// step clock - ticks or pulses to the next step, and steps played, which
+// gives every track's position.  Gates are timed against the average of the
+// last two steps, so swing doesn't make them uneven.
+static INSTANCE u16 g_Counter = 0;
+static INSTANCE u32 g_Step = 0;
+static INSTANCE u16 g_SinceStep = 0;
+static INSTANCE u16 g_LastTicks = 0;
+static INSTANCE u16 g_StepTicks = 0;
+
+static INSTANCE u32 g_Random = 1;
+
+static INSTANCE seq_handler g_Handler = 0;
+
+//______________________________________________________________________________
+
+static u8 track_length(u8 track)
+{
+	u8 length = g_Pattern->length[track];
+	return length && length <= SEQ_STEPS ? length : SEQ_STEPS;
+}
+
+static u8 is_active(u8 track, u8 step)
+{
+	return (g_Active[track][step >> 5] >> (step & 31)) & 1;
+}
+
+static void update_step(u8 track, u8 step)
+{
+	u32 bit = 1UL << (step & 31);
+	
+	if (g_Pattern->velocity[track][step] & 0x7F)
+	{
+		g_Active[track][step >> 5] |= bit;
+		g_Used |= 1 << track;
+	}
+	else
+	{
+		g_Active[track][step >> 5] &= ~bit;
+		
+		u8 any = 0;
+		
+		for (u8 w=0; w < WORDS; ++w)
+		{
+			any |= g_Active[track][w] != 0;
+		}
+		
+		if (!any)
+		{
+			g_Used &= ~(1 << track);
+		}
+	}
+}
+
+// xorshift - only decides whether steps play, so it needn't be good
+static u8 percent()
+{
+	u32 x = g_Random;
+	
+	x ^= (x << 13) & 0xFFFFFFFF;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFF;
+	g_Random = x;
+	
+	return (x >> 8) % 100;
+}
+
+//______________________________________________________________________________
+
+static void end_note(u8 track)
+{
+	Track *t = &g_Tracks[track];
+	
+	if (t->note != NO_NOTE)
+	{
+		if (g_Handler)
+		{
+			g_Handler(t->channel, t->note, 0);
+		}
+		
+		t->note = NO_NOTE;
+		g_Sounding &= ~(1 << track);
+	}
+}
+
+static void play(u8 track, u8 step)
+{
+	const SeqPattern *p = g_Pattern;
+	
+	if (p->probability[track][step] < SEQ_ALWAYS && percent() >= p->probability[track][step])
+	{
+		return;
+	}
+	
+	end_note(track);
+	
+	Track *t = &g_Tracks[track];
+	u32 gate = (u32)g_StepTicks * p->gate[track][step] / 100;
+	
+	t->note = p->note[track][step] & 0x7F;
+	t->channel = p->channel[track] & 0x0F;
+	t->gate = gate < 1 ? 1 : gate > 0xFFFF ? 0xFFFF : gate;
+	g_Sounding |= 1 << track;
+	
+	if (g_Handler)
+	{
+		g_Handler(t->channel, t->note, p->velocity[track][step] & 0x7F);
+	}
+}
+
+// one step on the tracks with anything to play
+static void step()
+{
+	// time the step just gone, if there was one
+	if (g_Step && g_SinceStep)
+	{
+		g_StepTicks = g_LastTicks ? (g_LastTicks + g_SinceStep) / 2 : g_SinceStep;
+		g_LastTicks = g_SinceStep;
+	}
+	
+	for (u8 bits = g_Used; bits; bits &= bits - 1)
+	{
+		u8 track = __builtin_ctz(bits);
+		u8 s = g_Step % track_length(track);
+		
+		if (is_active(track, s))
+		{
+			play(track, s);
+		}
+	}
+	
+	// swing stretches the first step of each pair, and shortens the second
+	u16 pair = 2 * g_Rate;
+	u16 first = (pair * g_Swing + 50) / 100;
+	
+	g_Counter = g_Step++ & 1 ? pair - first : first;
+	g_SinceStep = 0;
+	
+	if (!g_Counter)
+	{
+		g_Counter = 1;
+	}
+}
+
+static void count_step()
+{
+	if (g_Counter == 0 || --g_Counter == 0)
+	{
+		step();
+	}
+}
+
+//______________________________________________________________________________
+
+void seq_init(seq_handler handler)
+{
+	g_Pattern = arena_claim("seq", SEQ_ARENA_SIZE, ARENA_ALIGN);
+	g_Handler = handler;
+	g_Running = 0;
+	g_Sounding = 0;
+	g_Random = 1;
+	
+	for (u8 t=0; t < SEQ_TRACKS; ++t)
+	{
+		g_Tracks[t].note = NO_NOTE;
+		
+		if (g_Pattern)
+		{
+			g_Pattern->length[t] = 16;
+			g_Pattern->channel[t] = t;
+			
+			for (u8 s=0; s < SEQ_STEPS; ++s)
+			{
+				g_Pattern->note[t][s] = 36 + t;
+				g_Pattern->gate[t][s] = 50;
+				g_Pattern->probability[t][s] = SEQ_ALWAYS;
+			}
+		}
+	}
+	
+	seq_pattern_changed();
+}
+
+SeqPattern *seq_pattern()
+{
+	return g_Pattern;
+}
+
+void seq_pattern_changed()
+{
+	g_Used = 0;
+	
+	for (u8 t=0; t < SEQ_TRACKS; ++t)
+	{
+		for (u8 w=0; w < WORDS; ++w)
+		{
+			g_Active[t][w] = 0;
+		}
+		
+		if (!g_Pattern)
+		{
+			continue;
+		}
+		
+		for (u8 s=0; s < SEQ_STEPS; ++s)
+		{
+			if (g_Pattern->velocity[t][s] & 0x7F)
+			{
+				g_Active[t][s >> 5] |= 1UL << (s & 31);
+				g_Used |= 1 << t;
+			}
+		}
+	}
+}
+
+void seq_set_step(u8 track, u8 step, u8 note, u8 velocity, u8 gate, u8 probability)
+{
+	if (!g_Pattern || track >= SEQ_TRACKS || step >= SEQ_STEPS)
+	{
+		return;
+	}
+	
+	g_Pattern->note[track][step] = note;
+	g_Pattern->velocity[track][step] = velocity;
+	g_Pattern->gate[track][step] = gate;
+	g_Pattern->probability[track][step] = probability;
+	
+	update_step(track, step);
+}
+
+void seq_set_length(u8 track, u8 length)
+{
+	if (!g_Pattern || track >= SEQ_TRACKS || length < 1 || length > SEQ_STEPS)
+	{
+		return;
+	}
+	
+	g_Pattern->length[track] = length;
+}
+
+void seq_set_rate(u16 rate, u8 swing)
+{
+	g_Rate = rate ? rate : 1;
+	g_Swing = swing < SEQ_SWING_NONE ? SEQ_SWING_NONE : swing > SEQ_SWING_MAX ? SEQ_SWING_MAX : swing;
+}
+
+void seq_set_sync(u8 sync)
+{
+	g_Sync = sync;
+}
+
+void seq_start()
+{
+	seq_stop();
+	
+	// the first step plays on the next tick or pulse
+	g_Counter = 0;
+	g_Step = 0;
+	g_SinceStep = 0;
+	g_LastTicks = 0;
+	g_StepTicks = g_Sync ? g_Rate * PULSE_TICKS : g_Rate;
+	g_Running = g_Pattern != 0;
+}
+
+void seq_stop()
+{
+	for (u8 bits = g_Sounding; bits; bits &= bits - 1)
+	{
+		end_note(__builtin_ctz(bits));
+	}
+	
+	g_Running = 0;
+}
+
+u8 seq_running()
+{
+	return g_Running;
+}
+
+u8 seq_position(u8 track)
+{
+	return track < SEQ_TRACKS && g_Pattern ? g_Step % track_length(track) : 0;
+}
+
+void seq_tick()
+{
+	if (!g_Running)
+	{
+		return;
+	}
+	
+	if (g_SinceStep < 0xFFFF)
+	{
+		++g_SinceStep;
+	}
+	
+	// count down the gates of the notes sounding
+	for (u8 bits = g_Sounding; bits; bits &= bits - 1)
+	{
+		u8 track = __builtin_ctz(bits);
+		
+		if (--g_Tracks[track].gate == 0)
+		{
+			end_note(track);
+		}
+	}
+	
+	if (!g_Sync)
+	{
+		count_step();
+	}
+}
+
+void seq_pulse()
+{
+	if (g_Running && g_Sync)
+	{
+		count_step();
+	}
+}
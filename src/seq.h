@@ -0,0 +1,159 @@
+#ifndef LAUNCHPAD_SEQ_H
+#define LAUNCHPAD_SEQ_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Step sequencer.  SEQ_TRACKS tracks of up to SEQ_STEPS steps, each track with
+// its own length and MIDI channel, all stepping on one clock with swing.  A
+// track plays step (steps so far % its length), so tracks of different
+// lengths drift against each other.
+//
+// The pattern is kept as a structure of arrays - every step's note, then every
+// step's velocity, and so on - so each field of a track is one run of bytes,
+// and a host can load the whole pattern as a single block (see transfer.h).
+// Alongside it each track keeps a bitmask of its active steps (those with a
+// velocity), and the sequencer a mask of tracks with any active steps and
+// one of tracks with a note sounding, so a tick only visits the tracks that
+// have something to do: most ticks just count down the gates of the notes
+// sounding, and a step only fires on the tracks whose bit is set.
+//
+// The pattern is claimed from the arena (see arena.h).
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+#include "arena.h"
+
+#define SEQ_TRACKS				8
+#define SEQ_STEPS				64
+
+// always play the step
+#define SEQ_ALWAYS				100
+
+// straight, and the most swing
+#define SEQ_SWING_NONE			50
+#define SEQ_SWING_MAX			75
+
+typedef struct
+{
+	u8 note[SEQ_TRACKS][SEQ_STEPS];
+	u8 velocity[SEQ_TRACKS][SEQ_STEPS];		// 0 for a step that doesn't play
+	u8 gate[SEQ_TRACKS][SEQ_STEPS];			// percent of a step
+	u8 probability[SEQ_TRACKS][SEQ_STEPS];	// percent, SEQ_ALWAYS or over always plays
+	u8 length[SEQ_TRACKS];					// steps, [1, SEQ_STEPS] - 0 is SEQ_STEPS
+	u8 channel[SEQ_TRACKS];
+} SeqPattern;
+
+// what seq_init claims
+#define SEQ_ARENA_SIZE			((4 * SEQ_STEPS + 2) * SEQ_TRACKS)
+
+/**
+ * Receives the notes to play.
+ *
+ * @param channel - MIDI channel, [0, 15]
+ * @param note - MIDI note
+ * @param velocity - [1, 127] for note on, 0 for note off
+ */
+typedef void (*seq_handler)(u8 channel, u8 note, u8 velocity);
+
+/**
+ * Claim and clear the pattern, stop, and set the output.  Call from app_init.
+ * Tracks start out 16 steps long on channels 1 to 8, with no steps playing.
+ */
+void seq_init(seq_handler handler);
+
+/**
+ * The pattern, to edit directly or load into.  Call seq_pattern_changed
+ * afterwards.  Anything out of range is taken in range as it plays, rather
+ * than changed.
+ */
+SeqPattern *seq_pattern();
+
+/**
+ * Rebuild the step masks after changing the pattern directly.
+ */
+void seq_pattern_changed();
+
+/**
+ * Set one step, keeping the masks up to date.
+ *
+ * @param velocity - 0 for a step that doesn't play
+ * @param gate - percent of a step, over 100 to tie into the next
+ * @param probability - percent, SEQ_ALWAYS to always play
+ */
+void seq_set_step(u8 track, u8 step, u8 note, u8 velocity, u8 gate, u8 probability);
+
+/**
+ * @param length - steps, [1, SEQ_STEPS]
+ */
+void seq_set_length(u8 track, u8 length);
+
+/**
+ * @param rate - ticks per step, or clock pulses per step when synced
+ * @param swing - percent of a pair of steps the first one takes,
+ *                [SEQ_SWING_NONE, SEQ_SWING_MAX]
+ */
+void seq_set_rate(u16 rate, u8 swing);
+
+/**
+ * Step on clock pulses passed to seq_pulse rather than on ticks, if sync is
+ * nonzero.  Gates are always timed in ticks, against how long the last step
+ * took.
+ */
+void seq_set_sync(u8 sync);
+
+/**
+ * Start from the first step of every track, or stop, ending any notes
+ * sounding.
+ */
+void seq_start();
+void seq_stop();
+u8 seq_running();
+
+/**
+ * The step each track plays next.
+ */
+u8 seq_position(u8 track);
+
+/**
+ * Advance by one tick.  Call from app_timer_event.
+ */
+void seq_tick();
+
+/**
+ * A clock pulse - see sync.h.
+ */
+void seq_pulse();
+
+#endif
@@ -0,0 +1,299 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "sync.h"
+
+//______________________________________________________________________________
+//
+// The oscillator phase is 8.24 fixed point pulses, wrapping every 256 pulses,
+// and the rate is 8.24 fixed point pulses per ms.
+//______________________________________________________________________________
+
+#define ONE_PULSE		(1L << 24)
+
+// loop gains, as shifts - phase error correction, then rate
+#define FAST_PHASE		1
+#define FAST_RATE		3
+#define SLOW_PHASE		4
+#define SLOW_RATE		9
+
+// phase errors, in pulses << 24.  Locked when the average error has been
+// under LOCK_ERROR for LOCK_PULSES pulses, unlocked when it goes over
+// UNLOCK_ERROR, and restarted by any one error over RESTART_ERROR.
+#define LOCK_ERROR		(ONE_PULSE / 4)
+#define UNLOCK_ERROR	(ONE_PULSE / 2)
+#define RESTART_ERROR	(2 * ONE_PULSE)
+#define LOCK_PULSES		SYNC_PPQN
+
+// how slowly the average error follows, as a shift
+#define AVERAGE			3
+
+// slave states
+#define STOPPED			0
+#define STARTING		1	// seen one pulse
+#define TRACKING		2
+#define LOCKED			3
+
+static INSTANCE sync_handler g_Handler = 0;
+
+static INSTANCE u8 g_Source = SYNC_INTERNAL;
+static INSTANCE u8 g_State = STOPPED;
+
+static INSTANCE u32 g_Now = 0;			// ms
+static INSTANCE u32 g_Phase = 0;
+static INSTANCE u32 g_Rate = 0;
+static INSTANCE u32 g_Tempo = 0;		// master rate
+static INSTANCE u8 g_Sent = 0;			// pulses sent, mod 256
+
+static INSTANCE u8 g_Received = 0;		// pulses received, mod 256
+static INSTANCE u32 g_LastPulse = 0;	// ms
+static INSTANCE s32 g_Error = 0;		// average phase error magnitude
+static INSTANCE u8 g_InRange = 0;		// pulses in a row with g_Error under LOCK_ERROR
+
+// u32 can be wider than 32 bits (on the host), and the phase wraps at 32
+static inline u32 wrap(u32 x)
+{
+	return x & 0xFFFFFFFFUL;
+}
+
+static inline s32 difference(u32 a, u32 b)
+{
+	return (s32)(int)wrap(a - b);
+}
+
+static inline s32 magnitude(s32 x)
+{
+	return x < 0 ? -x : x;
+}
+
+// restart the output so the next tick sends pulse 0
+static void restart_phase()
+{
+	g_Phase = wrap(0 - g_Rate);
+	g_Sent = 0xFF;
+}
+
+//______________________________________________________________________________
+
+void sync_init(sync_handler handler)
+{
+	g_Handler = handler;
+	g_Source = SYNC_INTERNAL;
+	g_State = STOPPED;
+	g_Now = 0;
+	
+	sync_set_tempo(120);
+	g_Rate = g_Tempo;
+	restart_phase();
+}
+
+void sync_set_source(u8 source)
+{
+	if (source == g_Source)
+	{
+		return;
+	}
+	
+	g_Source = source;
+	g_State = STOPPED;
+	g_Rate = g_Tempo;
+	restart_phase();
+}
+
+void sync_set_tempo(u16 bpm)
+{
+	bpm = bpm < SYNC_MIN_TEMPO ? SYNC_MIN_TEMPO : bpm > SYNC_MAX_TEMPO ? SYNC_MAX_TEMPO : bpm;
+	
+	// pulses per ms = bpm * SYNC_PPQN / 60000
+	g_Tempo = ((u32)bpm * SYNC_PPQN * ONE_PULSE + 30000) / 60000;
+	
+	if (g_Source == SYNC_INTERNAL)
+	{
+		g_Rate = g_Tempo;
+	}
+}
+
+//______________________________________________________________________________
+
+// correct the oscillator towards an incoming pulse
+static void track(s32 error)
+{
+	u8 phase_gain = g_State == LOCKED ? SLOW_PHASE : FAST_PHASE;
+	u8 rate_gain = g_State == LOCKED ? SLOW_RATE : FAST_RATE;
+	
+	// the rate correction is the phase error over the period, so it's the
+	// same fraction of the rate whatever the tempo
+	s32 rate_error = (s32)(((long long)error * (s32)g_Rate) >> 24);
+	
+	g_Phase = wrap(g_Phase + (error >> phase_gain));
+	g_Rate += rate_error >> rate_gain;
+	
+	// judge the lock on the average, so a jittery clock can still lock
+	g_Error += (magnitude(error) - g_Error) >> AVERAGE;
+	
+	if (g_Error < LOCK_ERROR)
+	{
+		if (g_State == TRACKING && ++g_InRange >= LOCK_PULSES)
+		{
+			g_State = LOCKED;
+		}
+	}
+	else
+	{
+		g_InRange = 0;
+		
+		if (g_Error >= UNLOCK_ERROR)
+		{
+			g_State = TRACKING;
+		}
+	}
+}
+
+static void receive_pulse()
+{
+	u32 interval = g_Now - g_LastPulse;
+	g_LastPulse = g_Now;
+	
+	switch (g_State)
+	{
+		case STOPPED:
+		{
+			g_Received = 0;
+			g_State = STARTING;
+			restart_phase();
+		}
+		break;
+			
+		case STARTING:
+		{
+			// first guess at the rate, from one (quantised) interval
+			++g_Received;
+			g_Rate = ONE_PULSE / (interval ? interval : 1);
+			g_Phase = (u32)g_Received << 24;
+			g_Error = 0;
+			g_InRange = 0;
+			g_State = TRACKING;
+		}
+		break;
+			
+		default:
+		{
+			++g_Received;
+			s32 error = difference((u32)g_Received << 24, g_Phase);
+			
+			if (magnitude(error) >= RESTART_ERROR)
+			{
+				// tempo jumped, or pulses went missing - start from this one
+				g_Received = 0;
+				g_State = STARTING;
+				restart_phase();
+			}
+			else
+			{
+				track(error);
+			}
+		}
+		break;
+	}
+}
+
+void sync_midi(u8 port, u8 status)
+{
+	if (port != g_Source)
+	{
+		return;
+	}
+	
+	switch (status)
+	{
+		case MIDITIMINGCLOCK:
+			receive_pulse();
+			break;
+			
+		case MIDISTART:
+		case MIDISTOP:
+			// start from scratch on the next pulse - after a start, it's the
+			// first of the song
+			g_State = STOPPED;
+			break;
+			
+		case MIDICONTINUE:
+			break;
+	}
+}
+
+//______________________________________________________________________________
+
+void sync_tick()
+{
+	++g_Now;
+	
+	if (g_Source != SYNC_INTERNAL)
+	{
+		if (g_State == STOPPED)
+		{
+			return;
+		}
+		
+		if (g_Now - g_LastPulse > SYNC_TIMEOUT)
+		{
+			g_State = STOPPED;
+			return;
+		}
+	}
+	
+	g_Phase = wrap(g_Phase + g_Rate);
+	
+	// at most one pulse a tick - if a correction skips the phase forward, the
+	// missing pulse goes out on the next tick, and if it pulls the phase back
+	// no pulse is repeated
+	if ((s8)((u8)(g_Phase >> 24) - g_Sent) > 0)
+	{
+		++g_Sent;
+		
+		if (g_Handler)
+		{
+			g_Handler();
+		}
+	}
+}
+
+u8 sync_locked()
+{
+	return g_Source == SYNC_INTERNAL || g_State == LOCKED;
+}
+
+u32 sync_rate()
+{
+	return g_Rate;
+}
@@ -0,0 +1,109 @@
+#ifndef LAUNCHPAD_SYNC_H
+#define LAUNCHPAD_SYNC_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// MIDI clock, as master or slave.  Either way the output is a steady stream of
+// pulses, SYNC_PPQN to the beat, on the 1 ms timer tick.
+//
+// As master the pulses come from a fixed point oscillator at the internal
+// tempo.  As slave, incoming MIDI clock is timestamped on the tick and a
+// phase locked loop pulls the same oscillator onto it: each incoming pulse
+// measures the phase error, which nudges the phase and (more gently) the
+// rate.  The oscillator runs on through the gaps, so the pulses it sends
+// carry far less jitter than the raw clock - USB and DIN both smear clock by a
+// few milliseconds.
+//
+// The loop starts with fast gains to get near the tempo quickly and settles
+// to slow ones once locked.  A big jump in tempo, or clock stopping for more
+// than SYNC_TIMEOUT ms, starts it over.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+#define SYNC_PPQN				24
+
+// source to follow the internal tempo instead of a port
+#define SYNC_INTERNAL			0xFF
+
+// slowest internal tempo, and how long external clock can stop without
+// us stopping too
+#define SYNC_MIN_TEMPO			20
+#define SYNC_MAX_TEMPO			300
+#define SYNC_TIMEOUT			500
+
+/**
+ * Called on each output pulse.
+ */
+typedef void (*sync_handler)();
+
+/**
+ * Stop, and set the output.  Starts out as master at 120 bpm.
+ */
+void sync_init(sync_handler handler);
+
+/**
+ * @param source - port to take MIDI clock from, or SYNC_INTERNAL to be master
+ */
+void sync_set_source(u8 source);
+
+/**
+ * Set the master tempo - beats per minute, [SYNC_MIN_TEMPO, SYNC_MAX_TEMPO].
+ */
+void sync_set_tempo(u16 bpm);
+
+/**
+ * Feed in incoming MIDI.  Call from app_midi_event - takes clock, start,
+ * continue and stop from the source port, and ignores the rest.
+ */
+void sync_midi(u8 port, u8 status);
+
+/**
+ * Advance by 1 ms, sending a pulse if one is due.  Call from app_timer_event.
+ */
+void sync_tick();
+
+/**
+ * Nonzero once the slave has locked on to the incoming clock, and always as
+ * master.
+ */
+u8 sync_locked();
+
+/**
+ * Current output rate in pulses per ms, 8.24 fixed point.
+ */
+u32 sync_rate();
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LAUNCHPAD_SYSEX_H
+#define LAUNCHPAD_SYSEX_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// SysEx messages understood by the app.  All of them start with the Launchpad
+// Pro header below, followed by a command byte and command specific data, and
+// end with 0xF7.  Messages are limited to SYSEX_MAX_SIZE in both directions.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+#include "arena.h"
+
+#define SYSEX_MAX_SIZE			320
+
+// blocks of SYSEX_MAX_SIZE for building messages to send, see sysex_take
+#define SYSEX_POOL_BLOCKS		2
+#define SYSEX_ARENA_SIZE		ARENA_POOL_SIZE(SYSEX_MAX_SIZE, SYSEX_POOL_BLOCKS)
+
+#define SYSEX_HEADER_SIZE		6
+
+static const u8 SYSEX_HEADER[SYSEX_HEADER_SIZE] = {0xF0, 0x00, 0x20, 0x29, 0x02, 0x10};
+
+// offset of the command byte, and of the first byte of command data
+#define SYSEX_COMMAND			SYSEX_HEADER_SIZE
+#define SYSEX_DATA				(SYSEX_HEADER_SIZE + 1)
+
+// commands - bulk transfer (transfer.h)
+#define SYSEX_TRANSFER_DUMP		0x60
+#define SYSEX_TRANSFER_DATA		0x61
+#define SYSEX_TRANSFER_ACK		0x62
+
+// commands - LED frame blit (blit.h)
+#define SYSEX_BLIT				0x63
+
+// commands - MIDI routing (route.h)
+#define SYSEX_ROUTE				0x64
+
+// commands - trace ring dump (trace.h)
+#define SYSEX_TRACE				0x65
+
+// commands - pressure looper (looper.h)
+#define SYSEX_LOOPER			0x66
+
+/**
+ * Returns the command byte of a message carrying our header, or 0 if the
+ * message isn't one of ours (or is too short to carry a command).
+ */
+static inline u8 sysex_command(const u8 *data, u16 count)
+{
+	if (count < SYSEX_DATA + 1 || data[count - 1] != 0xF7)
+	{
+		return 0;
+	}
+	
+	for (int i=0; i < SYSEX_HEADER_SIZE; ++i)
+	{
+		if (data[i] != SYSEX_HEADER[i])
+		{
+			return 0;
+		}
+	}
+	
+	return data[SYSEX_COMMAND];
+}
+
+/**
+ * Write the header and command into a message buffer, returning the offset of
+ * the first data byte.
+ */
+static inline u16 sysex_begin(u8 *data, u8 command)
+{
+	for (int i=0; i < SYSEX_HEADER_SIZE; ++i)
+	{
+		data[i] = SYSEX_HEADER[i];
+	}
+	
+	data[SYSEX_COMMAND] = command;
+	
+	return SYSEX_DATA;
+}
+
+/**
+ * Claim the message pool from the arena.  Call from app_init.
+ */
+void sysex_init();
+
+/**
+ * A block of SYSEX_MAX_SIZE to build a message in, or 0 if there isn't one
+ * free.  Modules take what they need to build and send a message, and give it
+ * back before they return, so one pool serves them all.
+ */
+u8 *sysex_take();
+
+void sysex_give(u8 *block);
+
+/**
+ * For the profile.
+ */
+const ArenaPool *sysex_pool();
+
+#endif
@@ -0,0 +1,215 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "app.h"
+#include "pack7.h"
+#include "sysex.h"
+#include "trace.h"
+
+//______________________________________________________________________________
+
+INSTANCE TraceRecord *g_TraceRing = 0;
+INSTANCE u8 g_TraceHead = 0;
+INSTANCE u8 g_TraceOn = 0;
+INSTANCE u16 g_TraceTick = 0;
+INSTANCE u8 g_TraceFull = 0;
+
+// dump in progress
+static INSTANCE u8 g_Enabled = 0;
+static INSTANCE u8 g_DumpPort = 0;
+static INSTANCE u8 g_DumpPart = 0;
+static INSTANCE u8 g_DumpParts = 0;
+static INSTANCE u8 g_DumpFirst = 0;
+static INSTANCE u8 g_DumpCount = 0;
+
+ARENA_CHECK(sizeof(TraceRecord) == TRACE_RECORD_SIZE, trace_record_size);
+
+// parts are built in blocks from the SysEx pool
+ARENA_CHECK(SYSEX_DATA + 2 + PACK7_SIZE(TRACE_PART_RECORDS * TRACE_RECORD_SIZE) + 1 <= SYSEX_MAX_SIZE, trace_part_fits_block);
+
+//______________________________________________________________________________
+
+void trace_init()
+{
+#ifdef __arm__
+	// start the DWT cycle counter
+	*(volatile u32*)0xE000EDFC |= 1UL << 24;	// DEMCR.TRCENA
+	*(volatile u32*)0xE0001000 |= 1;			// DWT_CTRL.CYCCNTENA
+#endif
+	
+	g_TraceRing = arena_claim("trace", TRACE_ARENA_SIZE, ARENA_ALIGN);
+	g_TraceHead = 0;
+	g_TraceTick = 0;
+	g_TraceFull = 0;
+	g_DumpParts = 0;
+	
+	trace_enable(1);
+	trace_end(trace_begin(TRACE_INIT, 0, 0, 0));
+}
+
+void trace_enable(u8 on)
+{
+	// no ring, no trace
+	g_Enabled = on && g_TraceRing;
+	
+	// stays off until a dump finishes
+	if (!g_DumpParts)
+	{
+		g_TraceOn = g_Enabled;
+	}
+}
+
+void trace_tick_end(u32 start)
+{
+	if (!g_TraceOn)
+	{
+		return;
+	}
+	
+	u16 cycles = (trace_cycles() - start) >> 4;
+	
+	// carry on the last record if it's a run of ticks up to this one
+	TraceRecord *r = &g_TraceRing[(g_TraceHead - 1) & (TRACE_RECORDS - 1)];
+	
+	if ((g_TraceHead || g_TraceFull) && r->event == TRACE_TIMER && r->a < 0xFF && (u16)(r->tick + r->a) == g_TraceTick)
+	{
+		++r->a;
+		
+		if (cycles > r->cycles)
+		{
+			r->cycles = cycles;
+		}
+		return;
+	}
+	
+	if (g_TraceHead == TRACE_RECORDS - 1)
+	{
+		g_TraceFull = 1;
+	}
+	
+	r = &g_TraceRing[g_TraceHead];
+	g_TraceHead = (g_TraceHead + 1) & (TRACE_RECORDS - 1);
+	
+	r->tick = g_TraceTick;
+	r->event = TRACE_TIMER;
+	r->a = 1;
+	r->b = 0;
+	r->c = 0;
+	r->cycles = cycles;
+}
+
+//______________________________________________________________________________
+
+u8 trace_sysex(u8 port, const u8 *data, u16 count)
+{
+	if (sysex_command(data, count) != SYSEX_TRACE)
+	{
+		return 0;
+	}
+	
+	// restarting a dump in progress is fine - the ring hasn't moved
+	if (!g_DumpParts)
+	{
+		g_TraceOn = 0;
+		g_DumpCount = g_TraceFull ? TRACE_RECORDS : g_TraceHead;
+		g_DumpFirst = g_TraceFull ? g_TraceHead : 0;
+	}
+	
+	// always at least one part, even if it's empty
+	g_DumpPort = port;
+	g_DumpPart = 0;
+	g_DumpParts = g_DumpCount ? (g_DumpCount + TRACE_PART_RECORDS - 1) / TRACE_PART_RECORDS : 1;
+	
+	return 1;
+}
+
+void trace_poll()
+{
+	if (!g_DumpParts)
+	{
+		return;
+	}
+	
+	u8 first = g_DumpPart * TRACE_PART_RECORDS;
+	u8 records = g_DumpCount - first;
+	
+	if (records > TRACE_PART_RECORDS)
+	{
+		records = TRACE_PART_RECORDS;
+	}
+	
+	// try again next time if the pool's empty
+	u8 *part = sysex_take();
+	u8 *message = sysex_take();
+	
+	if (!part || !message)
+	{
+		sysex_give(part);
+		sysex_give(message);
+		return;
+	}
+	
+	u8 *out = part;
+	
+	for (u8 i=0; i < records; ++i)
+	{
+		const TraceRecord *r = &g_TraceRing[(g_DumpFirst + first + i) & (TRACE_RECORDS - 1)];
+		
+		*out++ = r->tick & 0xFF;
+		*out++ = r->tick >> 8;
+		*out++ = r->event;
+		*out++ = r->a;
+		*out++ = r->b;
+		*out++ = r->c;
+		*out++ = r->cycles & 0xFF;
+		*out++ = r->cycles >> 8;
+	}
+	
+	u16 n = sysex_begin(message, SYSEX_TRACE);
+	
+	message[n++] = g_DumpPart;
+	message[n++] = g_DumpParts;
+	n += pack7(message + n, part, records * TRACE_RECORD_SIZE);
+	message[n++] = 0xF7;
+	
+	hal_send_sysex(g_DumpPort, message, n);
+	
+	sysex_give(part);
+	sysex_give(message);
+	
+	if (++g_DumpPart >= g_DumpParts)
+	{
+		// done - carry on where we left off
+		g_DumpParts = 0;
+		g_TraceOn = g_Enabled;
+	}
+}
@@ -0,0 +1,187 @@
+#ifndef LAUNCHPAD_TRACE_H
+#define LAUNCHPAD_TRACE_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// A flight recorder.  Each app_* callback writes a compact record into a ring
+// in RAM - the tick it happened on, what it was, up to three argument bytes,
+// and how many cycles it took - so after something goes wrong on stage the
+// last TRACE_RECORDS events can be pulled off the unit and read.
+//
+// Writing a record is inline and costs a handful of loads and stores.  Runs
+// of timer ticks share one record that counts them and keeps the slowest, or
+// ticks alone would fill the ring in a fraction of a second.
+//
+// A host asks for the ring with an empty TRACE message (after the header and
+// SYSEX_TRACE, just 0xF7).  The unit pauses tracing and answers with one
+// message per tick, each:
+//
+//   part  parts  packed records...
+//
+// with up to TRACE_PART_RECORDS records 8-to-7 packed (pack7.h), oldest
+// first.  Each record is 8 bytes, little endian:
+//
+//   tick(2)  event  a  b  c  cycles(2)
+//
+// cycles is in units of 16 CPU cycles.  It comes from the Cortex-M3 DWT cycle
+// counter, so is always 0 in the simulator.  tools/tracedump.c decodes a
+// captured dump.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+#include "arena.h"
+#include "instance.h"
+
+// records in the ring - a power of two
+#define TRACE_RECORDS			128
+#define TRACE_RECORD_SIZE		8
+
+// what trace_init claims for the ring
+#define TRACE_ARENA_SIZE		(TRACE_RECORDS * TRACE_RECORD_SIZE)
+
+// records in each dump message - keeps us inside SYSEX_MAX_SIZE
+#define TRACE_PART_RECORDS		32
+
+// events, and their arguments
+#define TRACE_INIT				0	// -
+#define TRACE_TIMER				1	// ticks in the run
+#define TRACE_SURFACE			2	// type index value
+#define TRACE_MIDI				3	// port status d1
+#define TRACE_SYSEX				4	// port count(2, high 7 bits first)
+#define TRACE_AFTERTOUCH		5	// index value
+#define TRACE_CABLE				6	// type value
+#define TRACE_BOOT				7	// stages - once started up, see boot.h
+#define TRACE_EVENT_COUNT		8
+
+// slot returned by trace_begin when tracing is off
+#define TRACE_OFF				0xFF
+
+typedef struct
+{
+	u16 tick;
+	u8 event;
+	u8 a;
+	u8 b;
+	u8 c;
+	u16 cycles;		// while the callback runs, when it started >> 4
+} TraceRecord;
+
+// the ring, claimed from the arena - only for the inline functions below
+extern INSTANCE TraceRecord *g_TraceRing;
+extern INSTANCE u8 g_TraceHead;
+extern INSTANCE u8 g_TraceOn;
+extern INSTANCE u16 g_TraceTick;
+extern INSTANCE u8 g_TraceFull;
+
+static inline u32 trace_cycles()
+{
+#ifdef __arm__
+	return *(volatile u32*)0xE0001004;	// DWT_CYCCNT
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Start a record for a callback.  Pass the slot it returns to trace_end as the
+ * callback returns.
+ */
+static inline u8 trace_begin(u8 event, u8 a, u8 b, u8 c)
+{
+	if (!g_TraceOn)
+	{
+		return TRACE_OFF;
+	}
+	
+	u8 slot = g_TraceHead;
+	g_TraceHead = (slot + 1) & (TRACE_RECORDS - 1);
+	
+	if (slot == TRACE_RECORDS - 1)
+	{
+		g_TraceFull = 1;
+	}
+	
+	TraceRecord *r = &g_TraceRing[slot];
+	
+	r->tick = g_TraceTick;
+	r->event = event;
+	r->a = a;
+	r->b = b;
+	r->c = c;
+	r->cycles = trace_cycles() >> 4;
+	
+	return slot;
+}
+
+static inline void trace_end(u8 slot)
+{
+	if (slot != TRACE_OFF)
+	{
+		TraceRecord *r = &g_TraceRing[slot];
+		r->cycles = (u16)(trace_cycles() >> 4) - r->cycles;
+	}
+}
+
+/**
+ * Bracket app_timer_event.  trace_tick_begin returns the cycle count to pass
+ * to trace_tick_end.
+ */
+static inline u32 trace_tick_begin()
+{
+	++g_TraceTick;
+	return trace_cycles();
+}
+
+void trace_tick_end(u32 start);
+
+/**
+ * Claim and clear the ring, start the cycle counter, and start tracing.  Call
+ * from app_init.
+ */
+void trace_init();
+
+void trace_enable(u8 on);
+
+/**
+ * Handle a SysEx message.  Returns nonzero if it was a trace request.
+ */
+u8 trace_sysex(u8 port, const u8 *data, u16 count);
+
+/**
+ * Send the next part of a dump in progress.  Call from app_timer_event.
+ */
+void trace_poll();
+
+#endif
@@ -0,0 +1,305 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "app.h"
+#include "instance.h"
+#include "pack7.h"
+#include "sysex.h"
+#include "transfer.h"
+
+//______________________________________________________________________________
+
+// offsets into a DATA message
+#define DATA_AREA				(SYSEX_DATA + 0)
+#define DATA_SEQ				(SYSEX_DATA + 1)
+#define DATA_FLAGS				(SYSEX_DATA + 2)
+#define DATA_OFFSET				(SYSEX_DATA + 3)
+#define DATA_LENGTH				(SYSEX_DATA + 5)
+#define DATA_PAYLOAD			(SYSEX_DATA + 7)
+
+// payload plus three CRC bytes and 0xF7
+#define DATA_TRAILER			4
+
+static INSTANCE const TransferArea *g_Areas = 0;
+static INSTANCE u8 g_AreaCount = 0;
+
+// chunks are unpacked into, and messages built in, blocks from the SysEx pool
+ARENA_CHECK(TRANSFER_CHUNK <= SYSEX_MAX_SIZE, transfer_chunk_fits_block);
+ARENA_CHECK(DATA_PAYLOAD + PACK7_SIZE(TRANSFER_CHUNK) + DATA_TRAILER <= SYSEX_MAX_SIZE, transfer_message_fits_block);
+
+// load in progress
+static INSTANCE u8 g_LoadSeq = 0;
+
+// dump in progress
+static INSTANCE u8 g_DumpArea = 0xFF;
+static INSTANCE u8 g_DumpPort = 0;
+static INSTANCE u8 g_DumpSeq = 0;
+static INSTANCE u16 g_DumpOffset = 0;
+
+//______________________________________________________________________________
+
+u16 transfer_crc(const u8 *data, u16 length)
+{
+	// nibble at a time, so the table stays small
+	static const u16 TABLE[16] =
+	{
+		0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+		0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	};
+	
+	u16 crc = 0xFFFF;
+	
+	for (u16 i=0; i < length; ++i)
+	{
+		crc = (crc << 4) ^ TABLE[(crc >> 12) ^ (data[i] >> 4)];
+		crc = (crc << 4) ^ TABLE[(crc >> 12) ^ (data[i] & 0x0F)];
+	}
+	
+	return crc;
+}
+
+//______________________________________________________________________________
+
+void transfer_init(const TransferArea *areas, u8 count)
+{
+	g_Areas = areas;
+	g_AreaCount = count;
+	g_LoadSeq = 0;
+	g_DumpArea = 0xFF;
+}
+
+static void send_ack(u8 port, u8 area, u8 seq, u8 status)
+{
+	u8 ack[SYSEX_DATA + 4];
+	u16 n = sysex_begin(ack, SYSEX_TRANSFER_ACK);
+	
+	ack[n++] = area;
+	ack[n++] = seq;
+	ack[n++] = status;
+	ack[n++] = 0xF7;
+	
+	hal_send_sysex(port, ack, n);
+}
+
+static void receive_data(u8 port, const u8 *data, u16 count)
+{
+	u8 area = data[DATA_AREA];
+	u8 seq = data[DATA_SEQ];
+	u16 offset = (data[DATA_OFFSET] << 7) | data[DATA_OFFSET + 1];
+	u16 length = (data[DATA_LENGTH] << 7) | data[DATA_LENGTH + 1];
+	
+	if (area >= g_AreaCount
+		|| length > TRANSFER_CHUNK
+		|| offset + length > g_Areas[area].size
+		|| count != DATA_PAYLOAD + PACK7_SIZE(length) + DATA_TRAILER)
+	{
+		send_ack(port, area & 0x7F, g_LoadSeq, TRANSFER_BAD_AREA);
+		return;
+	}
+	
+	// seq 0 always (re)starts a load
+	if (seq == 0)
+	{
+		g_LoadSeq = 0;
+	}
+	
+	if (seq != g_LoadSeq)
+	{
+		send_ack(port, area, g_LoadSeq, TRANSFER_BAD_SEQ);
+		return;
+	}
+	
+	u8 *chunk = sysex_take();
+	
+	if (!chunk)
+	{
+		send_ack(port, area, g_LoadSeq, TRANSFER_BUSY);
+		return;
+	}
+	
+	unpack7(chunk, data + DATA_PAYLOAD, length);
+	
+	const u8 *c = data + count - DATA_TRAILER;
+	u16 crc = (c[0] << 14) | (c[1] << 7) | c[2];
+	
+	if (crc != transfer_crc(chunk, length))
+	{
+		sysex_give(chunk);
+		send_ack(port, area, g_LoadSeq, TRANSFER_BAD_CRC);
+		return;
+	}
+	
+	const TransferArea *a = &g_Areas[area];
+	
+	// let the owner stop using the area while it's half old and half new
+	if (seq == 0 && a->loading)
+	{
+		a->loading();
+	}
+	
+	if (a->ram)
+	{
+		for (u16 i=0; i < length; ++i)
+		{
+			a->ram[offset + i] = chunk[i];
+		}
+	}
+	else
+	{
+		hal_write_flash(offset, chunk, length);
+	}
+	
+	sysex_give(chunk);
+	
+	g_LoadSeq = (g_LoadSeq + 1) & 0x7F;
+	
+	send_ack(port, area, seq, TRANSFER_OK);
+	
+	if (data[DATA_FLAGS] & TRANSFER_FLAG_LAST)
+	{
+		g_LoadSeq = 0;
+		
+		if (a->loaded)
+		{
+			a->loaded();
+		}
+	}
+}
+
+u8 transfer_sysex(u8 port, const u8 *data, u16 count)
+{
+	switch (sysex_command(data, count))
+	{
+		case SYSEX_TRANSFER_DUMP:
+		{
+			if (count > DATA_AREA + 1 && data[DATA_AREA] < g_AreaCount)
+			{
+				// restarts any dump already running
+				g_DumpArea = data[DATA_AREA];
+				g_DumpPort = port;
+				g_DumpSeq = 0;
+				g_DumpOffset = 0;
+			}
+			else
+			{
+				send_ack(port, count > DATA_AREA + 1 ? data[DATA_AREA] : 0, 0, TRANSFER_BAD_AREA);
+			}
+		}
+		return 1;
+			
+		case SYSEX_TRANSFER_DATA:
+		{
+			if (count >= DATA_PAYLOAD + DATA_TRAILER)
+			{
+				receive_data(port, data, count);
+			}
+		}
+		return 1;
+	}
+	
+	return 0;
+}
+
+void transfer_poll()
+{
+	if (g_DumpArea >= g_AreaCount)
+	{
+		return;
+	}
+	
+	const TransferArea *a = &g_Areas[g_DumpArea];
+	
+	u16 length = a->size - g_DumpOffset;
+	
+	if (length > TRANSFER_CHUNK)
+	{
+		length = TRANSFER_CHUNK;
+	}
+	
+	u8 last = g_DumpOffset + length >= a->size;
+	
+	// try again next time if the pool's empty
+	u8 *chunk = sysex_take();
+	u8 *message = sysex_take();
+	
+	if (!chunk || !message)
+	{
+		sysex_give(chunk);
+		sysex_give(message);
+		return;
+	}
+	
+	if (a->ram)
+	{
+		for (u16 i=0; i < length; ++i)
+		{
+			chunk[i] = a->ram[g_DumpOffset + i];
+		}
+	}
+	else
+	{
+		hal_read_flash(g_DumpOffset, chunk, length);
+	}
+	
+	u16 n = sysex_begin(message, SYSEX_TRANSFER_DATA);
+	
+	message[n++] = g_DumpArea;
+	message[n++] = g_DumpSeq;
+	message[n++] = last ? TRANSFER_FLAG_LAST : 0;
+	message[n++] = g_DumpOffset >> 7;
+	message[n++] = g_DumpOffset & 0x7F;
+	message[n++] = length >> 7;
+	message[n++] = length & 0x7F;
+	
+	pack7(message + n, chunk, length);
+	n += PACK7_SIZE(length);
+	
+	u16 crc = transfer_crc(chunk, length);
+	
+	message[n++] = crc >> 14;
+	message[n++] = (crc >> 7) & 0x7F;
+	message[n++] = crc & 0x7F;
+	message[n++] = 0xF7;
+	
+	hal_send_sysex(g_DumpPort, message, n);
+	
+	sysex_give(chunk);
+	sysex_give(message);
+	
+	g_DumpSeq = (g_DumpSeq + 1) & 0x7F;
+	g_DumpOffset += length;
+	
+	if (last)
+	{
+		g_DumpArea = 0xFF;
+	}
+}
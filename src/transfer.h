@@ -0,0 +1,104 @@
+#ifndef LAUNCHPAD_TRANSFER_H
+#define LAUNCHPAD_TRANSFER_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Bulk transfer of app state over SysEx.  The app registers a table of areas
+// (pad state, the flash user area, configuration...) which a host can dump or
+// load in chunks of up to TRANSFER_CHUNK bytes.
+//
+// Data is 8-to-7 bit packed (pack7.h) exactly as the firmware upgrade format.
+// Every chunk carries a sequence number and a CRC-16 (CCITT) of the unpacked
+// bytes, so a 1k area moves in four messages.  After the header and command byte:
+//
+// TRANSFER_DUMP  host -> unit  area
+// TRANSFER_DATA  both ways     area seq flags offset(2) length(2) packed... crc(3)
+// TRANSFER_ACK   unit -> host  area seq status
+//
+// Two byte values are sent most significant 7 bits first, the CRC as 2+7+7
+// bits.  flags bit 0 marks the last chunk of an area.  A dump is answered with
+// a stream of DATA messages, one per tick.  A load is a stream of DATA messages
+// starting at seq 0; each is ACKed, and a NAK status asks the host to resend
+// from the seq in the reply.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+// largest chunk of unpacked data in one message - keeps us inside SYSEX_MAX_SIZE
+#define TRANSFER_CHUNK			256
+
+#define TRANSFER_FLAG_LAST		0x01
+
+// ACK status values
+#define TRANSFER_OK				0
+#define TRANSFER_BAD_CRC		1
+#define TRANSFER_BAD_SEQ		2
+#define TRANSFER_BAD_AREA		3
+#define TRANSFER_BUSY			4		// no buffer free, send it again
+
+/**
+ * Something that can be dumped or loaded.
+ */
+typedef struct
+{
+	u8 *ram;				// the data, or 0 for the flash user area
+	u16 size;				// in bytes
+	void (*loaded)(void);	// called once the last chunk of a load lands, may be 0
+	void (*loading)(void);	// called just before the first chunk lands, may be 0
+} TransferArea;
+
+/**
+ * Set the areas a host can address (by index in the table).  The table isn't
+ * copied, so it has to stay put while the transfer module uses it - the app
+ * keeps its own in its per-instance state and fills it in from app_init.
+ */
+void transfer_init(const TransferArea *areas, u8 count);
+
+/**
+ * Handle a SysEx message.  Returns nonzero if it was a transfer message.
+ */
+u8 transfer_sysex(u8 port, const u8 *data, u16 count);
+
+/**
+ * Send the next chunk of any dump in progress.  Call once per tick.
+ */
+void transfer_poll();
+
+/**
+ * CRC-16 (CCITT, initial value 0xFFFF) as used to check each chunk.
+ */
+u16 transfer_crc(const u8 *data, u16 length);
+
+#endif
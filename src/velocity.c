@@ -0,0 +1,252 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "instance.h"
+#include "velocity.h"
+
+//______________________________________________________________________________
+//
+// Curves, indexed by the 7 bit raw velocity.  Entry 0 is 1 so that a very soft
+// strike still produces a note-on rather than a note-off.
+//______________________________________________________________________________
+
+static const u8 VELOCITY_CURVES[VELOCITY_CURVE_COUNT][128] =
+{
+	// linear
+	{
+		  1,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,
+		 16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,
+		 32,  33,  34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,
+		 48,  49,  50,  51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61,  62,  63,
+		 64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,  77,  78,  79,
+		 80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,
+		 96,  97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111,
+		112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127,
+	},
+	// soft - square root, light touches come out louder
+	{
+		  1,  11,  16,  20,  23,  25,  28,  30,  32,  34,  36,  37,  39,  41,  42,  44,
+		 45,  46,  48,  49,  50,  52,  53,  54,  55,  56,  57,  59,  60,  61,  62,  63,
+		 64,  65,  66,  67,  68,  69,  69,  70,  71,  72,  73,  74,  75,  76,  76,  77,
+		 78,  79,  80,  80,  81,  82,  83,  84,  84,  85,  86,  87,  87,  88,  89,  89,
+		 90,  91,  92,  92,  93,  94,  94,  95,  96,  96,  97,  98,  98,  99, 100, 100,
+		101, 101, 102, 103, 103, 104, 105, 105, 106, 106, 107, 108, 108, 109, 109, 110,
+		110, 111, 112, 112, 113, 113, 114, 114, 115, 115, 116, 117, 117, 118, 118, 119,
+		119, 120, 120, 121, 121, 122, 122, 123, 123, 124, 124, 125, 125, 126, 126, 127,
+	},
+	// hard - square, you have to hit it to get to the top
+	{
+		  1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,
+		  2,   2,   3,   3,   3,   3,   4,   4,   5,   5,   5,   6,   6,   7,   7,   8,
+		  8,   9,   9,  10,  10,  11,  11,  12,  13,  13,  14,  15,  15,  16,  17,  17,
+		 18,  19,  20,  20,  21,  22,  23,  24,  25,  26,  26,  27,  28,  29,  30,  31,
+		 32,  33,  34,  35,  36,  37,  39,  40,  41,  42,  43,  44,  45,  47,  48,  49,
+		 50,  52,  53,  54,  56,  57,  58,  60,  61,  62,  64,  65,  67,  68,  70,  71,
+		 73,  74,  76,  77,  79,  80,  82,  84,  85,  87,  88,  90,  92,  94,  95,  97,
+		 99, 101, 102, 104, 106, 108, 110, 112, 113, 115, 117, 119, 121, 123, 125, 127,
+	},
+	// s-curve - smoothstep, wide sweet spot in the middle
+	{
+		  1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   3,   3,   4,   4,   5,
+		  6,   6,   7,   8,   8,   9,  10,  11,  12,  13,  14,  15,  16,  17,  18,  19,
+		 20,  21,  22,  24,  25,  26,  27,  29,  30,  31,  32,  34,  35,  37,  38,  39,
+		 41,  42,  44,  45,  46,  48,  49,  51,  52,  54,  55,  57,  58,  60,  61,  63,
+		 64,  66,  67,  69,  70,  72,  73,  75,  76,  78,  79,  81,  82,  83,  85,  86,
+		 88,  89,  90,  92,  93,  95,  96,  97,  98, 100, 101, 102, 103, 105, 106, 107,
+		108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 119, 120, 121, 121,
+		122, 123, 123, 124, 124, 125, 125, 126, 126, 126, 126, 127, 127, 127, 127, 127,
+	},
+};
+
+//______________________________________________________________________________
+
+#define STATE_IDLE		0
+#define STATE_RISING	1
+#define STATE_HELD		2
+
+typedef struct
+{
+	u16 last;		// previous sample
+	u16 slope;		// steepest rise seen since onset
+	u8 state;
+	u8 ticks;		// ticks since onset
+	u8 latency;		// ticks taken to report the last strike
+} VelocityPad;
+
+static INSTANCE VelocityPad g_Pads[PAD_COUNT];
+
+static INSTANCE const u8 *g_Curve = VELOCITY_CURVES[VELOCITY_CURVE_LINEAR];
+static INSTANCE u8 g_Window = VELOCITY_DEFAULT_WINDOW;
+static INSTANCE velocity_handler g_Handler = 0;
+
+//______________________________________________________________________________
+
+void velocity_init(velocity_handler handler)
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		g_Pads[i].last = 0;
+		g_Pads[i].slope = 0;
+		g_Pads[i].state = STATE_IDLE;
+		g_Pads[i].ticks = 0;
+		g_Pads[i].latency = 0;
+	}
+	
+	g_Handler = handler;
+}
+
+void velocity_set_curve(u8 curve)
+{
+	if (curve < VELOCITY_CURVE_COUNT)
+	{
+		g_Curve = VELOCITY_CURVES[curve];
+	}
+}
+
+void velocity_set_window(u8 ticks)
+{
+	if (ticks < 1)
+	{
+		ticks = 1;
+	}
+	else if (ticks > VELOCITY_MAX_WINDOW)
+	{
+		ticks = VELOCITY_MAX_WINDOW;
+	}
+	
+	g_Window = ticks;
+}
+
+u8 velocity_latency(u8 adc_index)
+{
+	return g_Pads[adc_index].latency;
+}
+
+//______________________________________________________________________________
+
+static void report(u8 i, VelocityPad *pad)
+{
+	u16 raw = pad->slope >> VELOCITY_SLOPE_SHIFT;
+	
+	if (raw > 127)
+	{
+		raw = 127;
+	}
+	
+	pad->state = STATE_HELD;
+	pad->latency = pad->ticks;
+	
+	if (g_Handler)
+	{
+		g_Handler(ADC_MAP[i], g_Curve[raw]);
+	}
+}
+
+void velocity_scan(const u16 *adc)
+{
+	for (u8 i=0; i < PAD_COUNT; ++i)
+	{
+		VelocityPad *pad = &g_Pads[i];
+		
+		u16 s = adc[i];
+		u16 rise = s > pad->last ? s - pad->last : 0;
+		
+		pad->last = s;
+		
+		switch (pad->state)
+		{
+			case STATE_IDLE:
+			{
+				if (s >= VELOCITY_ONSET)
+				{
+					pad->state = STATE_RISING;
+					pad->ticks = 1;
+					pad->slope = rise;
+					
+					if (g_Window == 1)
+					{
+						report(i, pad);
+					}
+				}
+			}
+			break;
+				
+			case STATE_RISING:
+			{
+				++pad->ticks;
+				
+				if (rise > pad->slope)
+				{
+					pad->slope = rise;
+				}
+				
+				// settle once the rise has clearly passed its steepest point, or when
+				// we run out of window
+				if ((rise << 1) < pad->slope || pad->ticks >= g_Window)
+				{
+					report(i, pad);
+				}
+				
+				// a very short tap can end before it settles - still play it
+				if (s < VELOCITY_RELEASE)
+				{
+					if (pad->state == STATE_RISING)
+					{
+						report(i, pad);
+					}
+					
+					pad->state = STATE_IDLE;
+					
+					if (g_Handler)
+					{
+						g_Handler(ADC_MAP[i], 0);
+					}
+				}
+			}
+			break;
+				
+			case STATE_HELD:
+			{
+				if (s < VELOCITY_RELEASE)
+				{
+					pad->state = STATE_IDLE;
+					
+					if (g_Handler)
+					{
+						g_Handler(ADC_MAP[i], 0);
+					}
+				}
+			}
+			break;
+		}
+	}
+}
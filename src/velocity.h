@@ -0,0 +1,104 @@
+#ifndef LAUNCHPAD_VELOCITY_H
+#define LAUNCHPAD_VELOCITY_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Velocity engine.  Estimates strike velocity from the first few raw ADC
+// samples of each pad, rather than waiting for the library's pad event.
+//
+// A strike starts when a pad crosses VELOCITY_ONSET.  From then on we track the
+// steepest sample-to-sample rise; once the rise flattens off (or the window
+// runs out) the steepest slope is looked up in the selected velocity curve and
+// reported.  The window bounds the worst case latency: a note-on is always
+// reported no later than window ticks after onset.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+// raw ADC level that starts a strike, and the level it must fall below to end it
+#define VELOCITY_ONSET				64
+#define VELOCITY_RELEASE			32
+
+// slope (ADC counts per tick) is shifted down by this to get a 7 bit velocity
+#define VELOCITY_SLOPE_SHIFT		4
+
+// longest allowed estimation window, in ticks
+#define VELOCITY_MAX_WINDOW			8
+#define VELOCITY_DEFAULT_WINDOW		4
+
+// velocity curves
+#define VELOCITY_CURVE_LINEAR		0
+#define VELOCITY_CURVE_SOFT			1
+#define VELOCITY_CURVE_HARD			2
+#define VELOCITY_CURVE_S			3
+#define VELOCITY_CURVE_COUNT		4
+
+/**
+ * Called when a strike settles or is released.
+ *
+ * @param index - the LED/button index of the pad (already translated through ADC_MAP)
+ * @param velocity - estimated velocity in [1, 127], or 0 for release
+ */
+typedef void (*velocity_handler)(u8 index, u8 velocity);
+
+/**
+ * Reset all pads and set the function that receives note events.
+ */
+void velocity_init(velocity_handler handler);
+
+/**
+ * Select one of the VELOCITY_CURVE_* tables.  Invalid curves are ignored.
+ */
+void velocity_set_curve(u8 curve);
+
+/**
+ * Set the estimation window in ticks, clamped to [1, VELOCITY_MAX_WINDOW].
+ * Shorter windows report sooner, longer ones read the rise more accurately.
+ */
+void velocity_set_window(u8 ticks);
+
+/**
+ * Feed one raw ADC frame (PAD_COUNT 12 bit samples, ADC order).  Call once per
+ * tick from app_timer_event.
+ */
+void velocity_scan(const u16 *adc);
+
+/**
+ * Ticks between onset and the note-on for the last strike reported on a pad,
+ * indexed by ADC index.  Used for latency measurement.
+ */
+u8 velocity_latency(u8 adc_index);
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "animcode.h"
+
+// ____________________________________________________________________________
+
+typedef struct
+{
+	u8 *out;
+	int size;
+	int max;
+} Writer;
+
+static void put(Writer *w, u8 byte)
+{
+	if (w->size < w->max)
+	{
+		w->out[w->size] = byte;
+	}
+	++w->size;
+}
+
+static int same_colour(const u8 *a, int i, const u8 *b, int j)
+{
+	return a[3*i] == b[3*j] && a[3*i + 1] == b[3*j + 1] && a[3*i + 2] == b[3*j + 2];
+}
+
+static void encode_frame(Writer *w, const u8 *frame, const u8 *prev, u16 duration)
+{
+	duration = duration > ANIM_MAX_DURATION ? ANIM_MAX_DURATION : duration;
+	
+	put(w, duration >> 7);
+	put(w, duration & 0x7F);
+	
+	int i = 0;
+	
+	while (i < BLIT_LED_COUNT)
+	{
+		// skip pads that haven't changed, unless they run on to the end
+		if (prev && same_colour(frame, i, prev, i))
+		{
+			int n = 1;
+			
+			while (i + n < BLIT_LED_COUNT && n < BLIT_MAX_SKIP && same_colour(frame, i + n, prev, i + n))
+			{
+				++n;
+			}
+			
+			i += n;
+			
+			if (i < BLIT_LED_COUNT)
+			{
+				put(w, BLIT_OP_SKIP | (n - 1));
+			}
+			continue;
+		}
+		
+		// a run of one colour
+		int n = 1;
+		
+		while (i + n < BLIT_LED_COUNT && n < BLIT_MAX_SPAN && same_colour(frame, i + n, frame, i))
+		{
+			++n;
+		}
+		
+		if (n > 1)
+		{
+			put(w, BLIT_OP_RUN | (n - 1));
+			put(w, frame[3*i]);
+			put(w, frame[3*i + 1]);
+			put(w, frame[3*i + 2]);
+			
+			i += n;
+			continue;
+		}
+		
+		// a literal, up to the next pad to skip or run
+		n = 1;
+		
+		while (i + n < BLIT_LED_COUNT && n < BLIT_MAX_SPAN &&
+			   !(prev && same_colour(frame, i + n, prev, i + n)) &&
+			   !(i + n + 1 < BLIT_LED_COUNT && same_colour(frame, i + n + 1, frame, i + n)))
+		{
+			++n;
+		}
+		
+		put(w, BLIT_OP_LITERAL | (n - 1));
+		
+		for (int j=0; j < 3 * n; ++j)
+		{
+			put(w, frame[3*i + j]);
+		}
+		
+		i += n;
+	}
+	
+	put(w, ANIM_END_FRAME);
+}
+
+int animcode_encode(const u8 *frames, const u16 *durations, int count, int key_every, u8 *out, int max)
+{
+	Writer w = { out, 0, max };
+	
+	put(&w, ANIM_MAGIC);
+	put(&w, 0);
+	put(&w, 0);
+	
+	for (int f=0; f < count; ++f)
+	{
+		int key = f == 0 || (key_every && f % key_every == 0);
+		const u8 *frame = frames + f * ANIMCODE_FRAME_SIZE;
+		
+		encode_frame(&w, frame, key ? 0 : frame - ANIMCODE_FRAME_SIZE, durations[f]);
+	}
+	
+	put(&w, ANIM_END);
+	
+	if (w.size > w.max || w.size > 0x3FFF)
+	{
+		return 0;
+	}
+	
+	out[1] = w.size >> 7;
+	out[2] = w.size & 0x7F;
+	
+	return w.size;
+}
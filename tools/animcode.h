@@ -0,0 +1,63 @@
+#ifndef LAUNCHPAD_ANIMCODE_H
+#define LAUNCHPAD_ANIMCODE_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Host side animation encoder, for anim.h.  Each frame is coded against the
+// one before: unchanged pads are skipped, pads of one colour in a row become
+// a run, and anything else a literal.  A run may carry on over pads that
+// haven't changed if they're already that colour, as that's free.
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+#include "anim.h"
+#include "blit.h"
+
+// one raw frame - r g b for pads 0 to 99
+#define ANIMCODE_FRAME_SIZE		(3 * BLIT_LED_COUNT)
+
+/**
+ * Encode frames for anim_play.
+ *
+ * @param frames - count raw frames, one after the other
+ * @param durations - how long each frame shows, in ms (up to ANIM_MAX_DURATION)
+ * @param key_every - a keyframe every this many frames, or 0 for just the first
+ * @param out - receives the animation
+ * @param max - size of out
+ * @result the size of the animation, or 0 if it doesn't fit
+ */
+int animcode_encode(const u8 *frames, const u16 *durations, int count, int key_every, u8 *out, int max);
+
+#endif
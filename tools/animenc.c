@@ -0,0 +1,143 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// Encodes raw light show frames into the compressed format anim.h plays.  The
+// input is a file of frames, each a two byte duration in ms (least significant
+// byte first) followed by r g b for pads 0 to 99.  The output is the animation
+// itself, or with -c, C source for it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "animcode.h"
+
+#define MAX_FRAMES		4096
+#define MAX_SIZE		0x3FFF
+
+static u8 g_Frames[MAX_FRAMES * ANIMCODE_FRAME_SIZE];
+static u16 g_Durations[MAX_FRAMES];
+static u8 g_Out[MAX_SIZE];
+
+static int usage(const char *self)
+{
+	printf("usage: %s [-k frames] [-c name] in.raw out\n\n", self);
+	printf("  -k frames  a keyframe every this many frames (default just the first)\n");
+	printf("  -c name    write C source for a const array called name\n");
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	int key_every = 0;
+	const char *name = 0;
+	int arg = 1;
+	
+	while (arg + 1 < argc && argv[arg][0] == '-')
+	{
+		if (strcmp(argv[arg], "-k") == 0)
+		{
+			key_every = atoi(argv[arg + 1]);
+		}
+		else if (strcmp(argv[arg], "-c") == 0)
+		{
+			name = argv[arg + 1];
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+		arg += 2;
+	}
+	
+	if (argc - arg != 2)
+	{
+		return usage(argv[0]);
+	}
+	
+	FILE *in = fopen(argv[arg], "rb");
+	
+	if (!in)
+	{
+		printf("can't open %s\n", argv[arg]);
+		return 1;
+	}
+	
+	int count = 0;
+	u8 duration[2];
+	
+	while (count < MAX_FRAMES && fread(duration, 2, 1, in) == 1 &&
+		   fread(g_Frames + count * ANIMCODE_FRAME_SIZE, ANIMCODE_FRAME_SIZE, 1, in) == 1)
+	{
+		g_Durations[count++] = duration[0] | (duration[1] << 8);
+	}
+	
+	fclose(in);
+	
+	int size = count ? animcode_encode(g_Frames, g_Durations, count, key_every, g_Out, MAX_SIZE) : 0;
+	
+	if (!size)
+	{
+		printf("%s: no frames, or too big to encode\n", argv[arg]);
+		return 1;
+	}
+	
+	FILE *out = fopen(argv[arg + 1], name ? "w" : "wb");
+	
+	if (!out)
+	{
+		printf("can't write %s\n", argv[arg + 1]);
+		return 1;
+	}
+	
+	if (name)
+	{
+		fprintf(out, "// %d frames, made by animenc from %s\n\n", count, argv[arg]);
+		fprintf(out, "const u8 %s[%d] =\n{", name, size);
+		
+		for (int i=0; i < size; ++i)
+		{
+			fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n\t", g_Out[i]);
+		}
+		
+		fprintf(out, "\n};\n");
+	}
+	else
+	{
+		fwrite(g_Out, size, 1, out);
+	}
+	
+	fclose(out);
+	
+	printf("%d frames, %d bytes raw, %d encoded (%.1f:1)\n", count, count * ANIMCODE_FRAME_SIZE, size,
+		   (double)count * ANIMCODE_FRAME_SIZE / size);
+	return 0;
+}
@@ -32,93 +32,99 @@
 
 // Ported from the original Delphi version.
 // CLI parameters for ID, ByteWidth and BaseAddress removed for simplicity
+//
+// Converts one file, or in batch mode many, with a manifest or on the command
+// line, spread over a pool of threads.  Each job has its own hex data and
+// builds its whole output in memory before writing it in one go, so jobs
+// share nothing but the counter that hands them out.
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 #include "intelhex.h"
+#include "pack7.h"
 
 static const int ByteWidth = 32;
 static const int ID = 0x0051;
 
 static const unsigned char RESET[] = {0xf0, 0x00, 0x20, 0x29, 0x00, 0x71};
 
-// must match unpacking code in the bootloader, obviously
-static void eight_to_seven(unsigned char * Output, const int OOffset,
-			intelhex::hex_data& Input, const unsigned long IOffset)
+typedef std::vector<unsigned char> Buffer;
+
+static void write(Buffer& out, const unsigned char *data, size_t count)
 {
-	for (int i = 0; i < 7; ++i)
+	out.insert(out.end(), data, data + count);
+}
+
+// read whole groups of seven bytes, padding unset addresses
+static void read_groups(unsigned char * Output, intelhex::hex_data& Input, const unsigned long IOffset, const int Count)
+{
+	for (int i = 0; i < Count; ++i)
 	{
 		if (!Input.is_set(IOffset + i))
 		{
 			// pad unset addresses
 			Input.set(IOffset + i, 0xff);
 		}
-	}
-	
-	// seven bytes of eight-bit data converted to
-	// eight bytes of seven-bit data
-	// render 8-bit words as 16-bit words
-	Output[OOffset+0] =                           Input[IOffset+0] >> 1;
-	Output[OOffset+1] = (Input[IOffset+0] << 6) + (Input[IOffset+1] >> 2);
-	Output[OOffset+2] = (Input[IOffset+1] << 5) + (Input[IOffset+2] >> 3);
-	Output[OOffset+3] = (Input[IOffset+2] << 4) + (Input[IOffset+3] >> 4);
-	Output[OOffset+4] = (Input[IOffset+3] << 3) + (Input[IOffset+4] >> 5);
-	Output[OOffset+5] = (Input[IOffset+4] << 2) + (Input[IOffset+5] >> 6);
-	Output[OOffset+6] = (Input[IOffset+5] << 1) + (Input[IOffset+6] >> 7);
-	Output[OOffset+7] = (Input[IOffset+6]);
-
-	for (int i = 0; i < 8; ++i)
-	{
-		Output[OOffset+i] &= 0x7f;
+		
+		Output[i] = Input[IOffset + i];
 	}
 }
 
-static void write_block(intelhex::hex_data& data, std::ofstream& ofs, const unsigned long addr, const unsigned char type)
+static void write_block(intelhex::hex_data& data, Buffer& out, const unsigned long addr, const unsigned char type)
 {
 	// packet header
-	ofs.write(reinterpret_cast<const char*>(RESET), 5);
-	ofs.put(type);
+	write(out, RESET, 5);
+	out.push_back(type);
 	
-	int incount = 0;
-	int outcount = 0;
+	// seven bytes of eight-bit data converted to eight bytes of seven-bit data,
+	// a group at a time - must match unpacking code in the bootloader, obviously
+	const int inn = ((ByteWidth + 6) / 7) * 7;
 	int outn = 1 + (ByteWidth * 8) / 7;
 	
 	// payload
-	unsigned char payload[41];
+	unsigned char input[inn];
+	unsigned char payload[PACK7_SIZE(inn)];
 	
-	while (incount < ByteWidth)
-	{
-		eight_to_seven(payload, outcount, data, addr+incount);
-		
-		incount += 7;
-		outcount += 8;
-	}
+	read_groups(input, data, addr, inn);
+	pack7(payload, input, inn);
 	
-	ofs.write(reinterpret_cast<const char*>(payload), outn);
-	ofs.put(0xf7);
+	write(out, payload, outn);
+	out.push_back(0xf7);
 }
 
-static void write_header(intelhex::hex_data& data, std::ofstream& ofs, size_t BaseAddress)
+static void write_header(intelhex::hex_data& data, Buffer& out, size_t BaseAddress)
 {
 	// human-readable version number & header block
-	ofs.write(reinterpret_cast<const char*>(RESET), 6);
-	ofs.put(ID >> 8);
-	ofs.put(ID & 0x7f);
-	
-	ofs.put(data[BaseAddress + 0x102] >> 4);
-	ofs.put(data[BaseAddress + 0x102] & 0x0f);
-	ofs.put(data[BaseAddress + 0x101] >> 4);
-	ofs.put(data[BaseAddress + 0x101] & 0x0f);
-	ofs.put(data[BaseAddress + 0x100] >> 4);
-	ofs.put(data[BaseAddress + 0x100] & 0x0f);
-	
-	ofs.put(0xf7);
+	write(out, RESET, 6);
+	out.push_back(ID >> 8);
+	out.push_back(ID & 0x7f);
+	
+	out.push_back(data[BaseAddress + 0x102] >> 4);
+	out.push_back(data[BaseAddress + 0x102] & 0x0f);
+	out.push_back(data[BaseAddress + 0x101] >> 4);
+	out.push_back(data[BaseAddress + 0x101] & 0x0f);
+	out.push_back(data[BaseAddress + 0x100] >> 4);
+	out.push_back(data[BaseAddress + 0x100] & 0x0f);
+	
+	out.push_back(0xf7);
 }
 
-static void write_checksum(intelhex::hex_data& data, std::ofstream& ofs)
+static void write_checksum(intelhex::hex_data& data, Buffer& out)
 {
+	(void)data;
+	
 	// device doesn't respect the checksum, but we still need this block!
-	ofs.write(reinterpret_cast<const char*>(RESET), 5);
+	write(out, RESET, 5);
 	unsigned char payload[19];
 	
 	const char *FIRMWARE = "Firmware";
@@ -139,45 +145,249 @@ static void write_checksum(intelhex::hex_data& data, std::ofstream& ofs)
 	payload[17] = 0x00;
 	payload[18] = 0xf7;
 	
-	ofs.write(reinterpret_cast<const char*>(payload), 19);
+	write(out, payload, 19);
 }
 
-int main(int argc, char *argv[])
+//______________________________________________________________________________
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds_since(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Job
+{
+	std::string input;
+	std::string output;
+	
+	// filled in by whichever thread converts it
+	bool ok;
+	std::string error;
+	size_t min_address;
+	size_t max_address;
+	size_t bytes;
+	double seconds;
+};
+
+static void convert(Job& job)
+{
+	Clock::time_point start = Clock::now();
+	
+	job.ok = false;
+	job.bytes = 0;
+	
+	try
+	{
+		// read the hex file input
+		intelhex::hex_data data;
+		data.load(job.input);
+		
+		size_t BaseAddress = data.min_address();
+		size_t MaxAddress = data.max_address();
+		
+		job.min_address = BaseAddress;
+		job.max_address = MaxAddress;
+		
+		// a header, a block per ByteWidth bytes and the checksum
+		Buffer out;
+		out.reserve(64 + (MaxAddress - BaseAddress + ByteWidth) / ByteWidth * (7 + 1 + (ByteWidth * 8) / 7));
+		
+		write_header(data, out, BaseAddress);
+		
+		// payload blocks...
+		unsigned long i = BaseAddress + ByteWidth;
+		
+		while (i < MaxAddress)
+		{
+			write_block(data, out, i, 0x72);
+			
+			i += ByteWidth;
+		}
+		
+		write_block(data, out, BaseAddress, 0x73);
+		
+		// footer/checksum block
+		write_checksum(data, out);
+		
+		// create output file
+		std::ofstream ofs(job.output.c_str(), std::ios::out | std::ios::binary);
+		
+		ofs.write(reinterpret_cast<const char*>(out.data()), out.size());
+		ofs.close();
+		
+		if (!ofs)
+		{
+			job.error = "can't write " + job.output;
+		}
+		else
+		{
+			job.ok = true;
+			job.bytes = out.size();
+		}
+	}
+	catch (const std::exception& e)
+	{
+		job.error = e.what();
+	}
+	
+	job.seconds = seconds_since(start);
+}
+
+static void convert_all(std::vector<Job>& jobs, unsigned threads)
 {
-	std::cout << "converting " << argv[1] << " to sysex file: " << argv[2] << std::endl;
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> pool;
 	
-	// read the hex file input
-	intelhex::hex_data data;
-	data.load(argv[1]);
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		pool.push_back(std::thread([&jobs, &next]()
+		{
+			for (size_t i = next++; i < jobs.size(); i = next++)
+			{
+				convert(jobs[i]);
+			}
+		}));
+	}
 	
-	size_t BaseAddress = data.min_address();
-	size_t MaxAddress = data.max_address();
+	for (size_t t = 0; t < pool.size(); ++t)
+	{
+		pool[t].join();
+	}
+}
+
+//______________________________________________________________________________
+
+// one "input.hex output.syx" pair per line, blank lines and # comments skipped
+static bool read_manifest(const char *path, std::vector<Job>& jobs)
+{
+	std::ifstream manifest(path);
+	std::string line;
 	
-	std::cout << "max addr: " << std::hex << data.max_address() << " min_addr: " << std::hex << data.min_address() << std::endl;
+	if (!manifest)
+	{
+		std::cerr << "can't read manifest " << path << std::endl;
+		return false;
+	}
 	
-	// create output file
-	std::ofstream ofs(argv[2] , std::ios::out | std::ios::binary);
-	if( !ofs )
-		return -1;
+	for (int n = 1; std::getline(manifest, line); ++n)
+	{
+		std::istringstream fields(line);
+		Job job;
+		
+		if (!(fields >> job.input) || job.input[0] == '#')
+		{
+			continue;
+		}
+		
+		if (!(fields >> job.output))
+		{
+			std::cerr << path << ":" << n << ": no output file for " << job.input << std::endl;
+			return false;
+		}
+		
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+static int usage()
+{
+	std::cerr << "usage: hextosyx input.hex output.syx" << std::endl;
+	std::cerr << "       hextosyx [-j threads] input.hex output.syx [input.hex output.syx ...]" << std::endl;
+	std::cerr << "       hextosyx [-j threads] -m manifest" << std::endl;
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<Job> jobs;
+	unsigned threads = std::thread::hardware_concurrency();
+	int arg = 1;
 	
-	write_header(data, ofs, BaseAddress);
+	for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+	{
+		if (strcmp(argv[arg], "-j") == 0)
+		{
+			threads = atoi(argv[arg + 1]);
+		}
+		else if (strcmp(argv[arg], "-m") == 0)
+		{
+			if (!read_manifest(argv[arg + 1], jobs))
+			{
+				return -1;
+			}
+		}
+		else
+		{
+			return usage();
+		}
+	}
 	
-	// payload blocks...
-	unsigned long i = BaseAddress + ByteWidth;
+	if ((argc - arg) % 2 != 0)
+	{
+		return usage();
+	}
 	
-	while (i < MaxAddress)
+	for (; arg < argc; arg += 2)
 	{
-		write_block(data, ofs, i, 0x72);
+		Job job;
 		
-		i += ByteWidth;
+		job.input = argv[arg];
+		job.output = argv[arg + 1];
+		jobs.push_back(job);
+	}
+	
+	if (jobs.empty())
+	{
+		return usage();
+	}
+	
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (threads > jobs.size())
+	{
+		threads = jobs.size();
 	}
 	
-	write_block(data, ofs, BaseAddress, 0x73);
+	Clock::time_point start = Clock::now();
+	
+	convert_all(jobs, threads);
+	
+	double wall = seconds_since(start);
+	
+	// report in the order given, whichever order they finished in
+	size_t bytes = 0;
+	int failed = 0;
 	
-	// footer/checksum block
-	write_checksum(data, ofs);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const Job& job = jobs[i];
+		
+		std::cout << "converting " << job.input << " to sysex file: " << job.output << std::endl;
+		
+		if (!job.ok)
+		{
+			std::cout << "  FAILED: " << job.error << std::endl;
+			++failed;
+			continue;
+		}
+		
+		std::cout << "max addr: " << std::hex << job.max_address << " min_addr: " << job.min_address << std::dec;
+		std::cout << ", " << job.bytes << " bytes in " << std::fixed << std::setprecision(1) << job.seconds * 1000 << " ms";
+		std::cout << " (" << job.bytes / job.seconds / 1e6 << " MB/s)" << std::endl;
+		
+		bytes += job.bytes;
+	}
 	
-	ofs.close();
+	if (jobs.size() > 1)
+	{
+		std::cout << jobs.size() << " files, " << bytes << " bytes on " << threads << " threads in " << wall * 1000 << " ms";
+		std::cout << " - " << jobs.size() / wall << " files/s, " << bytes / wall / 1e6 << " MB/s" << std::endl;
+	}
 	
-	return 0;
+	return failed ? -1 : 0;
 }
@@ -0,0 +1,89 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// Turns a binary simulator log (see simlog.h), as written by
+// "simulator -l file", back into the simulator's text log.
+
+#include <stdio.h>
+#include <string.h>
+#include "simlog.h"
+
+#define CHUNK 65536
+
+static SimLogRecord g_Records[CHUNK];
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		printf("usage: %s log.bin\n", argv[0]);
+		return 1;
+	}
+	
+	FILE *f = fopen(argv[1], "rb");
+	
+	if (!f)
+	{
+		printf("can't open %s\n", argv[1]);
+		return 1;
+	}
+	
+	SimLogHeader header;
+	
+	if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, SIMLOG_MAGIC, 4) != 0)
+	{
+		printf("%s isn't a simulator log\n", argv[1]);
+		fclose(f);
+		return 1;
+	}
+	
+	if (header.version != SIMLOG_VERSION || header.record_size != sizeof(SimLogRecord))
+	{
+		printf("%s is a version %d log with %d byte records - expected version %d, %d bytes\n",
+			   argv[1], header.version, header.record_size, SIMLOG_VERSION, (int)sizeof(SimLogRecord));
+		fclose(f);
+		return 1;
+	}
+	
+	size_t count;
+	
+	while ((count = fread(g_Records, sizeof(SimLogRecord), CHUNK, f)) > 0)
+	{
+		for (size_t i=0; i < count; ++i)
+		{
+			simlog_print(stdout, &g_Records[i]);
+		}
+	}
+	
+	fclose(f);
+	return 0;
+}
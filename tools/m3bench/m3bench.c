@@ -0,0 +1,530 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Cycle counts for the app's callbacks on a Cortex-M3.  This is built with the
+// firmware's compiler and flags into a standalone image (see "make m3bench"),
+// with the HAL stubbed out and a bare startup, and runs on the STM32F103
+// model of the Renode emulator - or on a real STM32F103 board.  Each callback
+// is timed with the DWT cycle counter, as the trace ring does (see trace.h),
+// and the results go out of USART1 as text.
+//
+// Under the emulator CYCCNT advances once per instruction, so the numbers
+// are instruction counts - a lower bound on the cycles, as loads, taken
+// branches and flash wait states cost more on the real chip.  They are
+// deterministic though, which is what catching regressions needs.
+// ____________________________________________________________________________
+
+#include "app.h"
+#include "arp.h"
+#include "blit.h"
+#include "boot.h"
+#include "looper.h"
+#include "mod.h"
+#include "seq.h"
+#include "sysex.h"
+#include "trace.h"
+
+// the app's timer runs every millisecond, on a 72MHz core
+#ifndef M3BENCH_TICK_BUDGET
+#define M3BENCH_TICK_BUDGET		72000
+#endif
+
+#define RUNS					1000
+
+//______________________________________________________________________________
+//
+// Startup - no libc, so the few things the compiler might call are here too.
+//______________________________________________________________________________
+
+extern u32 _estack, _sidata, _sdata, _edata, _sbss, _ebss;
+
+int main();
+
+void Reset_Handler()
+{
+	u32 *from = &_sidata;
+	
+	for (u32 *to = &_sdata; to < &_edata; )
+	{
+		*to++ = *from++;
+	}
+	
+	for (u32 *to = &_sbss; to < &_ebss; )
+	{
+		*to++ = 0;
+	}
+	
+	main();
+	
+	for (;;)
+	{
+		__asm__ volatile ("wfi");
+	}
+}
+
+static void print(const char *s);
+
+void Fault_Handler()
+{
+	print("m3bench: FAIL - fault\n");
+	
+	for (;;)
+	{
+		__asm__ volatile ("wfi");
+	}
+}
+
+__attribute__((section(".isr_vector"), used))
+static void (* const g_Vectors[])() =
+{
+	(void (*)())&_estack,
+	Reset_Handler,
+	Fault_Handler,		// NMI
+	Fault_Handler,		// hard fault
+	Fault_Handler,		// memory management
+	Fault_Handler,		// bus fault
+	Fault_Handler,		// usage fault
+};
+
+void *memset(void *dest, int c, unsigned n)
+{
+	u8 *d = dest;
+	
+	while (n--)
+	{
+		*d++ = c;
+	}
+	return dest;
+}
+
+void *memcpy(void *dest, const void *src, unsigned n)
+{
+	u8 *d = dest;
+	const u8 *s = src;
+	
+	while (n--)
+	{
+		*d++ = *s++;
+	}
+	return dest;
+}
+
+//______________________________________________________________________________
+//
+// Output, to USART1.
+//______________________________________________________________________________
+
+#define USART1_SR	(*(volatile u32*)0x40013800)
+#define USART1_DR	(*(volatile u32*)0x40013804)
+#define USART_TXE	0x80
+
+static void print(const char *s)
+{
+	while (*s)
+	{
+		while (!(USART1_SR & USART_TXE));
+		USART1_DR = *s++;
+	}
+}
+
+static void print_number(u32 n, u8 width)
+{
+	char text[11];
+	u8 i = sizeof(text);
+	
+	text[--i] = 0;
+	
+	do
+	{
+		text[--i] = '0' + n % 10;
+		n /= 10;
+	}
+	while (n);
+	
+	while (sizeof(text) - 1 - i < width)
+	{
+		text[--i] = ' ';
+	}
+	
+	print(text + i);
+}
+
+//______________________________________________________________________________
+//
+// HAL stubs.
+//______________________________________________________________________________
+
+static u8 g_Leds[100][3];
+static u8 g_Flash[USER_AREA_SIZE];
+static volatile u32 g_Sent;
+
+void hal_plot_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
+{
+	u8 *led = g_Leds[type == TYPESETUP ? 0 : index % 100];
+	
+	led[0] = red;
+	led[1] = green;
+	led[2] = blue;
+}
+
+void hal_read_led(u8 type, u8 index, u8 *red, u8 *green, u8 *blue)
+{
+	const u8 *led = g_Leds[type == TYPESETUP ? 0 : index % 100];
+	
+	*red = led[0];
+	*green = led[1];
+	*blue = led[2];
+}
+
+void hal_send_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	(void)port;
+	(void)d1;
+	(void)d2;
+	
+	g_Sent += status;
+}
+
+void hal_send_sysex(u8 port, const u8* data, u16 length)
+{
+	(void)port;
+	(void)data;
+	
+	g_Sent += length;
+}
+
+void hal_read_flash(u32 offset, u8 *data, u32 length)
+{
+	for (u32 i=0; i < length && offset + i < USER_AREA_SIZE; ++i)
+	{
+		data[i] = g_Flash[offset + i];
+	}
+}
+
+void hal_write_flash(u32 offset, const u8 *data, u32 length)
+{
+	for (u32 i=0; i < length && offset + i < USER_AREA_SIZE; ++i)
+	{
+		g_Flash[offset + i] = data[i];
+	}
+}
+
+u8 hal_read_device_id()
+{
+	return 0;
+}
+
+u8 hal_read_layout_text()
+{
+	return 0;
+}
+
+//______________________________________________________________________________
+//
+// Benchmarks.
+//______________________________________________________________________________
+
+static u16 g_Adc[PAD_COUNT];
+static u32 g_Seed = 0x12345678;
+
+static u32 next_random()
+{
+	g_Seed ^= g_Seed << 13;
+	g_Seed ^= g_Seed >> 17;
+	g_Seed ^= g_Seed << 5;
+	
+	return g_Seed;
+}
+
+typedef struct
+{
+	u32 min;
+	u32 max;
+	u32 total;
+	u32 runs;
+} Counts;
+
+static void count(Counts *c, u32 cycles)
+{
+	c->min = !c->runs || cycles < c->min ? cycles : c->min;
+	c->max = cycles > c->max ? cycles : c->max;
+	c->total += cycles;
+	c->runs++;
+}
+
+static void report(const char *name, const Counts *c)
+{
+	u8 length = 0;
+	
+	print("  ");
+	print(name);
+	
+	while (name[length])
+	{
+		++length;
+	}
+	
+	while (length++ < 22)
+	{
+		print(" ");
+	}
+	
+	print_number(c->min, 10);
+	print_number(c->runs ? c->total / c->runs : 0, 10);
+	print_number(c->max, 10);
+	print("\n");
+}
+
+#define TIMED(counts, call) \
+	do { u32 start = trace_cycles(); call; count(counts, trace_cycles() - start); } while (0)
+
+// a pad strike every few ticks, as the velocity engine sees it
+static void strike(u32 tick)
+{
+	for (u8 i=0; i < PAD_COUNT; ++i)
+	{
+		g_Adc[i] = g_Adc[i] > 64 ? g_Adc[i] - 64 : 0;
+	}
+	
+	if (tick % 4 == 0)
+	{
+		g_Adc[next_random() % PAD_COUNT] = 512 + next_random() % 3584;
+	}
+}
+
+static void timer(const char *name, u8 pads)
+{
+	Counts c = { 0 };
+	
+	for (u32 tick=0; tick < RUNS; ++tick)
+	{
+		if (pads)
+		{
+			strike(tick);
+		}
+		TIMED(&c, app_timer_event());
+	}
+	
+	report(name, &c);
+}
+
+int main()
+{
+	for (u32 i=0; i < USER_AREA_SIZE; ++i)
+	{
+		g_Flash[i] = 0xFF;
+	}
+	
+	// start the DWT cycle counter, as trace_init will
+	*(volatile u32*)0xE000EDFC |= 1UL << 24;	// DEMCR.TRCENA
+	*(volatile u32*)0xE0001000 |= 1;			// DWT_CTRL.CYCCNTENA
+	
+	Counts init = { 0 };
+	TIMED(&init, app_init(g_Adc));
+	
+	// make sure there's a counter to read
+	u32 start = trace_cycles();
+	
+	for (volatile int i=0; i < 100; ++i);
+	
+	if (trace_cycles() == start)
+	{
+		print("m3bench: FAIL - DWT cycle counter isn't running\n");
+		return 1;
+	}
+	
+	print("m3bench: cycles per callback over ");
+	print_number(RUNS, 0);
+	print(" calls\n\n  callback                     min       avg       max\n");
+	
+	report("app_init", &init);
+	
+	// the first ticks finish starting up (boot.h)
+	Counts boot = { 0 };
+	
+	while (!boot_ready())
+	{
+		TIMED(&boot, app_timer_event());
+	}
+	
+	report("timer, starting up", &boot);
+	
+	timer("timer, idle", 0);
+	timer("timer, pads", 1);
+	
+	Counts surface = { 0 };
+	Counts midi = { 0 };
+	
+	for (u32 i=0; i < RUNS; ++i)
+	{
+		u8 index = 11 + (i % 8) * 10 + (i / 8) % 8;
+		
+		TIMED(&surface, app_surface_event(TYPEPAD, index, i & 1 ? 0 : 100));
+		TIMED(&midi, app_midi_event(USBSTANDALONE, i & 1 ? NOTEOFF : NOTEON, 36 + i % 64, 100));
+	}
+	
+	report("surface", &surface);
+	report("midi", &midi);
+	
+	// a full frame of coded blit runs
+	static u8 frame[SYSEX_MAX_SIZE];
+	u16 n = sysex_begin(frame, SYSEX_BLIT);
+	
+	frame[n++] = BLIT_CODED;
+	
+	for (u8 led=0; led < BLIT_LED_COUNT; led += 20)
+	{
+		frame[n++] = BLIT_OP_RUN | (20 - 1);
+		frame[n++] = led % 64;
+		frame[n++] = 63 - led % 64;
+		frame[n++] = 32;
+	}
+	frame[n++] = 0xF7;
+	
+	Counts blit = { 0 };
+	
+	for (u32 i=0; i < RUNS; ++i)
+	{
+		TIMED(&blit, app_sysex_event(USBSTANDALONE, frame, n));
+	}
+	
+	report("sysex, coded blit", &blit);
+	
+	// the arpeggiator, with pads feeding it
+	arp_set_chord(ARP_CHORD_SEVENTH);
+	arp_set_mode(ARP_UP_DOWN, ARP_MAX_OCTAVES, 4, 2);
+	
+	Counts arp = { 0 };
+	
+	for (u32 tick=0; tick < RUNS; ++tick)
+	{
+		strike(tick);
+		TIMED(&arp, app_timer_event());
+	}
+	
+	report("timer, pads and arp", &arp);
+	
+	// ...and the sequencer with every step of every track playing, stepping
+	// every tick
+	seq_set_sync(0);
+	seq_set_rate(1, SEQ_SWING_NONE);
+	
+	for (u8 t=0; t < SEQ_TRACKS; ++t)
+	{
+		seq_set_length(t, SEQ_STEPS);
+		
+		for (u8 s=0; s < SEQ_STEPS; ++s)
+		{
+			seq_set_step(t, s, 36 + s, 100, 80, SEQ_ALWAYS);
+		}
+	}
+	
+	seq_start();
+	
+	Counts seq = { 0 };
+	
+	for (u32 tick=0; tick < RUNS; ++tick)
+	{
+		strike(tick);
+		TIMED(&seq, app_timer_event());
+	}
+	
+	report("timer, with seq", &seq);
+	
+	// ...and every modulation generator running, a third each of LFOs,
+	// envelopes and pressure followers, with the pads gating and pressing
+	for (u8 g=0; g < MOD_GENERATORS; ++g)
+	{
+		switch (g % 3)
+		{
+			case 0:
+				mod_set_lfo(g, g % MOD_SHAPE_COUNT, 100, 127, 64, USBMIDI, 0, g);
+				break;
+				
+			case 1:
+				mod_set_envelope(g, 20, 40, 64, 40, 127, 0, USBMIDI, 0, g);
+				break;
+				
+			default:
+				mod_set_follower(g, 10, 20, 127, 0, USBMIDI, 0, g);
+				break;
+		}
+	}
+	
+	Counts mod = { 0 };
+	
+	for (u32 tick=0; tick < RUNS; ++tick)
+	{
+		strike(tick);
+		app_aftertouch_event(11 + tick % 8, tick & 0x7F);
+		TIMED(&mod, app_timer_event());
+	}
+	
+	report("timer, with mod", &mod);
+	
+	// ...and the pressure looper playing back every pad moving every ms - as
+	// much of that as fits the ring is 32ms
+	looper_record(32);
+	
+	for (u32 tick=0; tick < 32; ++tick)
+	{
+		for (u8 pad=0; pad < PAD_COUNT; ++pad)
+		{
+			app_aftertouch_event(ADC_MAP[pad], 1 + ((tick + pad) & 0x3F));
+		}
+		app_timer_event();
+	}
+	
+	Counts looper = { 0 };
+	
+	for (u32 tick=0; tick < RUNS; ++tick)
+	{
+		strike(tick);
+		TIMED(&looper, app_timer_event());
+	}
+	
+	report("timer, with looper", &looper);
+	
+	if (arp.max > M3BENCH_TICK_BUDGET || boot.max > M3BENCH_TICK_BUDGET || seq.max > M3BENCH_TICK_BUDGET ||
+		mod.max > M3BENCH_TICK_BUDGET || looper.max > M3BENCH_TICK_BUDGET)
+	{
+		print("\nm3bench: FAIL - worst timer tick is over the budget of ");
+		print_number(M3BENCH_TICK_BUDGET, 0);
+		print(" cycles\n");
+		return 1;
+	}
+	
+	print("\nm3bench: ok\n");
+	return 0;
+}
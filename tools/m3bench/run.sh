@@ -0,0 +1,16 @@
+#!/bin/sh
+# Runs the cycle count benchmark image (see m3bench.c) under Renode, prints
+# what it reports and fails if it does.
+
+ELF=${1:-build/m3bench.elf}
+LOG=$(mktemp)
+DIR=$(dirname "$0")
+
+renode --disable-xwt --console --plain \
+	-e "\$elf=@$ELF; \$log=@$LOG; include @$DIR/m3bench.resc" > /dev/null || exit 1
+
+cat "$LOG"
+grep -q "^m3bench: ok" "$LOG"
+RESULT=$?
+rm -f "$LOG"
+exit $RESULT
@@ -0,0 +1,399 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "anim.h"
+#include "animcode.h"
+
+// ____________________________________________________________________________
+//
+// Light show workout.  Encodes a few generated animations, plays each back
+// checking every frame lands on the LEDs exactly and on time - at the normal
+// 1ms tick, a slower tick and double speed - and reports how well they
+// compress and what a frame costs to decode.  Also plays corrupt animations,
+// which must stop without drawing off the end of the pads, and one saved in
+// flash, which the app should play at power up.
+// ____________________________________________________________________________
+
+#define MAX_FRAMES		128
+#define MAX_SIZE		0x3FFF
+
+// where app.c keeps a light show in the user area
+#define FLASH_OFFSET	128
+#define FLASH_ROOM		(USER_AREA_SIZE - FLASH_OFFSET)
+
+#define COST_TICKS		200000
+#define FUZZ_RUNS		2000
+
+static u8 g_Frames[MAX_FRAMES * ANIMCODE_FRAME_SIZE];
+static u16 g_Durations[MAX_FRAMES];
+static u8 g_Anim[MAX_SIZE];
+
+static u16 raw_ADC[PAD_COUNT];
+
+// ____________________________________________________________________________
+//
+// Animations to encode.
+// ____________________________________________________________________________
+
+static void set(int frame, int pad, int r, int g, int b)
+{
+	u8 *p = g_Frames + frame * ANIMCODE_FRAME_SIZE + 3 * pad;
+	
+	p[0] = r;
+	p[1] = g;
+	p[2] = b;
+}
+
+// a hue round the colour wheel, [0, 6 * MAXLED)
+static void set_hue(int frame, int pad, int hue)
+{
+	int x = hue % MAXLED;
+	
+	switch ((hue / MAXLED) % 6)
+	{
+		case 0: set(frame, pad, MAXLED, x, 0); break;
+		case 1: set(frame, pad, MAXLED - x, MAXLED, 0); break;
+		case 2: set(frame, pad, 0, MAXLED, x); break;
+		case 3: set(frame, pad, 0, MAXLED - x, MAXLED); break;
+		case 4: set(frame, pad, x, 0, MAXLED); break;
+		default: set(frame, pad, MAXLED, 0, MAXLED - x); break;
+	}
+}
+
+static int rainbow(void)
+{
+	for (int f=0; f < 48; ++f)
+	{
+		for (int pad=0; pad < 100; ++pad)
+		{
+			set_hue(f, pad, (pad / 10 + pad % 10) * 24 + f * 8);
+		}
+		g_Durations[f] = 40;
+	}
+	return 48;
+}
+
+static int ripple(void)
+{
+	for (int f=0; f < 32; ++f)
+	{
+		for (int pad=0; pad < 100; ++pad)
+		{
+			int dx = 2 * (pad % 10) - 9;
+			int dy = 2 * (pad / 10) - 9;
+			int ring = (dx * dx + dy * dy) / 16;
+			
+			set(f, pad, 0, ring == f % 12 ? MAXLED : 0, ring == (f + 6) % 12 ? MAXLED / 2 : 0);
+		}
+		g_Durations[f] = 50;
+	}
+	return 32;
+}
+
+static int sparkle(void)
+{
+	sim_srand(7);
+	memset(g_Frames, 0, ANIMCODE_FRAME_SIZE);
+	
+	for (int f=0; f < 120; ++f)
+	{
+		if (f)
+		{
+			memcpy(g_Frames + f * ANIMCODE_FRAME_SIZE, g_Frames + (f - 1) * ANIMCODE_FRAME_SIZE, ANIMCODE_FRAME_SIZE);
+		}
+		
+		for (int i=0; i < 6; ++i)
+		{
+			u32 r = sim_rand();
+			set(f, r % 100, (r >> 8) % (MAXLED + 1), (r >> 16) % (MAXLED + 1), (r >> 24) % (MAXLED + 1));
+		}
+		g_Durations[f] = 25;
+	}
+	return 120;
+}
+
+static int pulse(void)
+{
+	for (int f=0; f < 32; ++f)
+	{
+		int level = f < 16 ? f * 4 : (31 - f) * 4;
+		
+		for (int pad=0; pad < 100; ++pad)
+		{
+			set(f, pad, level, 0, level / 2);
+		}
+		g_Durations[f] = 30;
+	}
+	return 32;
+}
+
+static int wipe(void)
+{
+	for (int f=0; f < 40; ++f)
+	{
+		for (int pad=0; pad < 100; ++pad)
+		{
+			int lit = pad % 10 <= f % 10;
+			set(f, pad, lit && (f / 10) & 1 ? MAXLED : 0, lit ? MAXLED / 2 : 0, lit && !((f / 10) & 1) ? MAXLED : 0);
+		}
+		g_Durations[f] = 30;
+	}
+	return 40;
+}
+
+typedef struct
+{
+	const char *name;
+	int (*make)(void);
+} Show;
+
+static const Show SHOWS[] =
+{
+	{ "rainbow", rainbow },
+	{ "ripple", ripple },
+	{ "sparkle", sparkle },
+	{ "pulse", pulse },
+	{ "wipe", wipe },
+};
+
+#define SHOW_COUNT (sizeof(SHOWS) / sizeof(SHOWS[0]))
+
+// ____________________________________________________________________________
+
+static int matches(int frame)
+{
+	const u8 *p = g_Frames + frame * ANIMCODE_FRAME_SIZE;
+	
+	for (int pad=0; pad < 100; ++pad, p += 3)
+	{
+		u8 r, g, b;
+		hal_read_led(TYPEPAD, pad, &r, &g, &b);
+		
+		if (r != p[0] || g != p[1] || b != p[2])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// play one through, checking each frame, and return when the last was drawn,
+// in ms - or -1 if a frame was wrong or it never finished.  A tick at t draws
+// what's due up to t + ms.
+static int play(int size, int count, u16 ms, u16 speed)
+{
+	anim_set_speed(speed);
+	anim_play(g_Anim, size, 0);
+	
+	int shown = 0;
+	int finished = -1;
+	
+	for (int t=0; anim_playing() && t < 100000; t += ms)
+	{
+		anim_tick(ms);
+		
+		if (anim_frame() != shown)
+		{
+			shown = anim_frame();
+			
+			if (!matches(shown - 1))
+			{
+				printf("anim: frame %d drawn wrong\n", shown - 1);
+				return -1;
+			}
+			finished = t + ms;
+		}
+	}
+	
+	anim_set_speed(ANIM_SPEED_NORMAL);
+	return shown == count ? finished : -1;
+}
+
+static int g_OffTheEnd = 0;
+
+static void on_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
+{
+	(void)red;
+	(void)green;
+	(void)blue;
+	
+	g_OffTheEnd += type == TYPEPAD && index >= 100;
+}
+
+// ____________________________________________________________________________
+
+int sim_anim(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = 0;
+	
+	sim_set_quiet(1);
+	
+	printf("anim: %d pads per tick at most\n\n", ANIM_PADS_PER_TICK);
+	printf("  %-8s %6s %8s %8s %7s %6s %10s %10s %12s\n",
+		   "show", "frames", "raw", "coded", "ratio", "flash", "ms late", "ns/frame", "cycles/frame");
+	
+	for (size_t s=0; s < SHOW_COUNT; ++s)
+	{
+		int count = SHOWS[s].make();
+		int size = animcode_encode(g_Frames, g_Durations, count, 0, g_Anim, MAX_SIZE);
+		
+		int total = 0;
+		
+		for (int f=0; f < count - 1; ++f)
+		{
+			total += g_Durations[f];
+		}
+		
+		// every frame exact, and on time whatever the tick or speed, give
+		// or take the ticks it takes to draw a keyframe
+		int late = 0;
+		static const u16 TICK_MS[] = { 1, 4 };
+		
+		for (int i=0; i < 3; ++i)
+		{
+			u16 ms = i < 2 ? TICK_MS[i] : 1;
+			u16 speed = i < 2 ? ANIM_SPEED_NORMAL : 2 * ANIM_SPEED_NORMAL;
+			int due = i < 2 ? total : total / 2;
+			int slack = ms * (BLIT_LED_COUNT / ANIM_PADS_PER_TICK + 1);
+			
+			int t = play(size, count, ms, speed);
+			
+			if (t < 0 || t < due || t > due + slack)
+			{
+				printf("anim: %s at %d ms a tick, speed %d - last frame at %d ms, due at %d\n",
+					   SHOWS[s].name, ms, speed, t, due);
+				failed = 1;
+			}
+			
+			late = t - due > late ? t - due : late;
+		}
+		
+		// decode cost, with every frame due at once
+		anim_set_speed(0xFFFF);
+		anim_play(g_Anim, size, 1);
+		
+		double start = sim_now_ns();
+		u64 cycles = sim_cycles();
+		
+		for (int t=0; t < COST_TICKS; ++t)
+		{
+			anim_tick(1);
+		}
+		
+		cycles = sim_cycles() - cycles;
+		double ns = sim_now_ns() - start;
+		int frames = anim_frame();
+		
+		anim_stop();
+		anim_set_speed(ANIM_SPEED_NORMAL);
+		
+		printf("  %-8s %6d %8d %8d %6.1f:1 %6s %10d %10.0f %12.0f\n", SHOWS[s].name, count,
+			   count * ANIMCODE_FRAME_SIZE, size, (double)count * ANIMCODE_FRAME_SIZE / size,
+			   size <= FLASH_ROOM ? "fits" : "-", late, ns / frames, (double)cycles / frames);
+	}
+	
+	// corrupt animations must stop, without drawing off the end
+	sim_srand(99);
+	sim_set_led_hook(on_led);
+	
+	int stopped = 0;
+	
+	for (int run=0; run < FUZZ_RUNS; ++run)
+	{
+		int size = 8 + sim_rand() % 512;
+		
+		for (int i=0; i < size; ++i)
+		{
+			g_Anim[i] = sim_rand();
+		}
+		
+		g_Anim[0] = ANIM_MAGIC;
+		g_Anim[1] = size >> 7;
+		g_Anim[2] = size & 0x7F;
+		
+		anim_play(g_Anim, size, 1);
+		
+		for (int t=0; t < 2000 && anim_playing(); ++t)
+		{
+			anim_tick(50);
+		}
+		
+		stopped += !anim_playing();
+		anim_stop();
+	}
+	
+	sim_set_led_hook(0);
+	printf("\nanim: %d corrupt animations, %d stopped, %d pads drawn off the end\n", FUZZ_RUNS, stopped, g_OffTheEnd);
+	
+	if (g_OffTheEnd)
+	{
+		failed = 1;
+	}
+	
+	// one saved in flash plays at power up, and stops when a pad is pressed
+	int count = pulse();
+	int size = animcode_encode(g_Frames, g_Durations, count, 0, g_Anim, MAX_SIZE);
+	
+	hal_write_flash(FLASH_OFFSET, g_Anim, size);
+	app_init(raw_ADC);
+	
+	int ticks = 0;
+	
+	while (anim_frame() < 1 && ticks < 100)
+	{
+		app_timer_event();
+		++ticks;
+	}
+	
+	int shown = matches(0);
+	
+	app_surface_event(TYPEPAD, 11, 127);
+	app_surface_event(TYPEPAD, 11, 0);
+	
+	printf("anim: saved light show %s at power up, after %d ticks, and %s on a pad press\n",
+		   shown ? "plays" : "DOESN'T play", ticks, anim_playing() ? "DOESN'T stop" : "stops");
+	
+	if (!shown || anim_playing())
+	{
+		failed = 1;
+	}
+	
+	return failed;
+}
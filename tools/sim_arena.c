@@ -0,0 +1,239 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "arena.h"
+#include "sysex.h"
+#include "transfer.h"
+
+// ____________________________________________________________________________
+//
+// Arena workout.  Runs app_init and prints what each module claimed against
+// the arena and the RAM budget, then checks alignment, running out, claims
+// after the seal, and the block pools.  Streams a dump and a trace through
+// the app to see how much of the SysEx pool they use, and compares the cost
+// of taking and giving a block with malloc and free.
+// ____________________________________________________________________________
+
+#define ROUNDS			1000000
+
+static int g_Sent = 0;
+
+static void on_sysex(u8 port, const u8 *data, u16 count)
+{
+	(void)port;
+	(void)data;
+	(void)count;
+	
+	++g_Sent;
+}
+
+static int check(const char *what, int ok)
+{
+	if (!ok)
+	{
+		printf("arena: %s - FAILED\n", what);
+	}
+	return !ok;
+}
+
+static void profile()
+{
+	const ArenaClaim *claims;
+	u8 count = arena_claims(&claims);
+	
+	for (u8 i=0; i < count; ++i)
+	{
+		printf("arena: %-12s %5d bytes at %5d\n", claims[i].name, claims[i].size, claims[i].offset);
+	}
+	
+	printf("arena: %d of %d bytes used, %d free, high water %d - budget %d of %d RAM\n",
+		   arena_used(), ARENA_SIZE, ARENA_SIZE - arena_used(), arena_high_water(), ARENA_BUDGET, ARENA_RAM_SIZE);
+}
+
+static int check_claims()
+{
+	int failed = 0;
+	
+	arena_init();
+	
+	u8 *a = arena_claim("a", 1, 1);
+	u8 *b = arena_claim("b", 3, 8);
+	u8 *c = arena_claim("c", 2, 2);
+	
+	failed += check("claims", a && b && c);
+	failed += check("alignment", ((unsigned long)b & 7) == 0 && ((unsigned long)c & 1) == 0);
+	failed += check("claims don't overlap", b > a && c >= b + 3);
+	failed += check("bad alignment refused", !arena_claim("d", 1, 3) && arena_failures() == 1);
+	failed += check("running out", !arena_claim("e", ARENA_SIZE, 1) && arena_failures() == 2);
+	
+	u16 used = arena_used();
+	u8 *f = arena_claim("f", ARENA_SIZE - used, 1);
+	
+	failed += check("filling up", f && arena_used() == ARENA_SIZE);
+	
+	arena_init();
+	
+	failed += check("reset", arena_used() == 0 && arena_claim("g", 4, 4) == (void*)a);
+	
+	arena_seal();
+	
+	failed += check("sealed", !arena_claim("h", 1, 1) && arena_failures() == 1);
+	
+	return failed;
+}
+
+static int check_pool()
+{
+	int failed = 0;
+	ArenaPool pool;
+	
+	arena_init();
+	arena_pool_init(&pool, "pool", 10, 4);
+	
+	failed += check("pool rounds up blocks", pool.size == 12 && arena_used() == 48);
+	
+	void *blocks[5];
+	
+	for (int i=0; i < 5; ++i)
+	{
+		blocks[i] = arena_pool_take(&pool);
+	}
+	
+	failed += check("pool hands out distinct blocks", blocks[0] && blocks[1] && blocks[2] && blocks[3]
+					&& blocks[0] != blocks[1] && blocks[1] != blocks[2] && blocks[2] != blocks[3]);
+	failed += check("pool runs out", !blocks[4] && pool.used == 4);
+	
+	arena_pool_give(&pool, blocks[2]);
+	arena_pool_give(&pool, blocks[0]);
+	
+	failed += check("pool takes back", arena_pool_take(&pool) == blocks[0] && arena_pool_take(&pool) == blocks[2]);
+	failed += check("pool high water", pool.high_water == 4 && pool.used == 4);
+	
+	return failed;
+}
+
+// the SysEx pool while the app streams a dump of the flash area and a trace
+static int check_app_pool()
+{
+	static u8 dump[] = {0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRANSFER_DUMP, 1, 0xF7};
+	static u8 trace[] = {0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRACE, 0xF7};
+	
+	sim_set_sysex_hook(on_sysex);
+	g_Sent = 0;
+	
+	app_sysex_event(USBSTANDALONE, dump, sizeof(dump));
+	app_sysex_event(USBSTANDALONE, trace, sizeof(trace));
+	
+	for (int i=0; i < 100; ++i)
+	{
+		app_timer_event();
+	}
+	
+	sim_set_sysex_hook(0);
+	
+	const ArenaPool *pool = sysex_pool();
+	
+	printf("arena: %d messages sent, SysEx pool high water %d of %d blocks, %d in use after\n",
+		   g_Sent, pool->high_water, pool->count, pool->used);
+	
+	return check("SysEx pool", g_Sent > 4 && pool->used == 0 && pool->high_water <= pool->count);
+}
+
+static void time_pool()
+{
+	ArenaPool pool;
+	
+	arena_init();
+	arena_pool_init(&pool, "pool", SYSEX_MAX_SIZE, 2);
+	
+	double start = sim_now_ns();
+	
+	for (int i=0; i < ROUNDS; ++i)
+	{
+		void *volatile a = arena_pool_take(&pool);
+		void *volatile b = arena_pool_take(&pool);
+		arena_pool_give(&pool, b);
+		arena_pool_give(&pool, a);
+	}
+	
+	double pooled = (sim_now_ns() - start) / (ROUNDS * 2.0);
+	
+	start = sim_now_ns();
+	
+	for (int i=0; i < ROUNDS; ++i)
+	{
+		void *volatile a = malloc(SYSEX_MAX_SIZE);
+		void *volatile b = malloc(SYSEX_MAX_SIZE);
+		free(b);
+		free(a);
+	}
+	
+	double heap = (sim_now_ns() - start) / (ROUNDS * 2.0);
+	
+	printf("arena: %.1f ns to take and give a block, %.1f ns to malloc and free\n", pooled, heap);
+}
+
+int sim_arena(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = 0;
+	
+	sim_app_init();
+	
+	profile();
+	
+	failed += check("app claims", arena_failures() == 0);
+	failed += check_app_pool();
+	failed += check_claims();
+	failed += check_pool();
+	
+	time_pool();
+	
+	// leave things as app_init did
+	sim_app_init();
+	
+	if (failed)
+	{
+		printf("arena: FAILED\n");
+		return 1;
+	}
+	
+	printf("arena: OK\n");
+	return 0;
+}
@@ -0,0 +1,239 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "arp.h"
+
+// ____________________________________________________________________________
+//
+// Chord and arpeggiator workout.  Checks chords keep shared tones sounding
+// until the last note using them is released, and that the arpeggiator walks
+// the held notes in order.  Then holds all 64 pads with seventh chords, four
+// octaves, stepping every tick, and measures the cost of every tick.
+// ____________________________________________________________________________
+
+#define TICKS			200000
+
+// what the engine says is sounding
+static u8 g_Sounding[16][128];
+static int g_Events = 0;
+
+static u8 g_Sequence[64];
+static int g_SequenceLength = 0;
+
+static void on_note(u8 channel, u8 note, u8 velocity)
+{
+	g_Sounding[channel][note] = velocity;
+	++g_Events;
+	
+	if (velocity && g_SequenceLength < (int)sizeof(g_Sequence))
+	{
+		g_Sequence[g_SequenceLength++] = note;
+	}
+}
+
+static int expect(const char *what, u8 channel, const u8 *notes, int count)
+{
+	u8 expected[128] = {0};
+	
+	for (int i=0; i < count; ++i)
+	{
+		expected[notes[i]] = 1;
+	}
+	
+	for (int n=0; n < 128; ++n)
+	{
+		if (!g_Sounding[channel][n] != !expected[n])
+		{
+			printf("arp: %s - note %d is %s\n", what, n, g_Sounding[channel][n] ? "sounding" : "silent");
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+static int check_chords(void)
+{
+	memset(g_Sounding, 0, sizeof(g_Sounding));
+	arp_init(on_note);
+	arp_set_mode(ARP_OFF, 1, 1, 1);
+	arp_set_chord(ARP_CHORD_MAJOR);
+	
+	// C and E major share E
+	arp_note_on(0, 60, 100);
+	arp_note_on(0, 64, 100);
+	
+	const u8 both[] = { 60, 64, 67, 68, 71 };
+	const u8 e_major[] = { 64, 68, 71 };
+	
+	if (!expect("C and E held", 0, both, 5))
+	{
+		return 0;
+	}
+	
+	arp_note_off(0, 60);
+	
+	if (!expect("C released", 0, e_major, 3))
+	{
+		return 0;
+	}
+	
+	// switching chord re-voices what's held
+	arp_set_chord(ARP_CHORD_MINOR);
+	
+	const u8 e_minor[] = { 64, 67, 71 };
+	
+	if (!expect("E minor", 0, e_minor, 3))
+	{
+		return 0;
+	}
+	
+	arp_note_off(0, 64);
+	
+	return expect("all released", 0, 0, 0);
+}
+
+static int check_arp(u8 mode, u8 octaves, const u8 *expected, int count)
+{
+	memset(g_Sounding, 0, sizeof(g_Sounding));
+	arp_init(on_note);
+	arp_set_chord(ARP_CHORD_NONE);
+	arp_set_mode(mode, octaves, 2, 1);
+	
+	arp_note_on(3, 62, 90);
+	arp_note_on(3, 60, 90);
+	arp_note_on(3, 67, 90);
+	
+	g_SequenceLength = 0;
+	
+	for (int t=0; t < 2 * count; ++t)
+	{
+		arp_tick();
+	}
+	
+	if (g_SequenceLength != count || memcmp(g_Sequence, expected, count) != 0)
+	{
+		printf("arp: mode %d, %d octaves plays", mode, octaves);
+		for (int i=0; i < g_SequenceLength; ++i)
+		{
+			printf(" %d", g_Sequence[i]);
+		}
+		printf("\n");
+		return 0;
+	}
+	
+	return 1;
+}
+
+static int compare_ns(const void *a, const void *b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+// ____________________________________________________________________________
+
+int sim_arp(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = 0;
+	
+	const u8 up[] = { 60, 62, 67, 72, 74, 79, 60, 62 };
+	const u8 down[] = { 79, 74, 72, 67, 62, 60, 79, 74 };
+	const u8 up_down[] = { 60, 62, 67, 72, 74, 79, 74, 72, 67, 62, 60, 62 };
+	
+	failed |= !check_chords();
+	failed |= !check_arp(ARP_UP, 2, up, sizeof(up));
+	failed |= !check_arp(ARP_DOWN, 2, down, sizeof(down));
+	failed |= !check_arp(ARP_UP_DOWN, 2, up_down, sizeof(up_down));
+	
+	printf("arp: checks %s\n", failed ? "FAILED" : "ok");
+	
+	// worst case - the whole grid held, big chords, stepping every tick with a
+	// long gate so the voice pool is always full and stealing
+	static double ns[TICKS];
+	
+	arp_init(on_note);
+	arp_set_chord(ARP_CHORD_SEVENTH);
+	arp_set_mode(ARP_UP_DOWN, ARP_MAX_OCTAVES, 1, 200);
+	
+	double start = sim_now_ns();
+	for (int pad=0; pad < 64; ++pad)
+	{
+		arp_note_on(pad % 16, 36 + pad, 100);
+	}
+	double note_on = (sim_now_ns() - start) / 64;
+	
+	g_Events = 0;
+	
+	for (int t=0; t < TICKS; ++t)
+	{
+		start = sim_now_ns();
+		arp_tick();
+		ns[t] = sim_now_ns() - start;
+	}
+	
+	int events = g_Events;
+	
+	start = sim_now_ns();
+	for (int pad=0; pad < 64; ++pad)
+	{
+		arp_note_off(pad % 16, 36 + pad);
+	}
+	double note_off = (sim_now_ns() - start) / 64;
+	
+	double mean = 0;
+	for (int t=0; t < TICKS; ++t)
+	{
+		mean += ns[t];
+	}
+	mean /= TICKS;
+	
+	qsort(ns, TICKS, sizeof(double), compare_ns);
+	
+	printf("arp: 64 pads held, 16 channels, 7ths over %d octaves, step every tick\n", ARP_MAX_OCTAVES);
+	printf("arp: note on %.0f ns, note off %.0f ns, %.2f notes per tick\n", note_on, note_off, (double)events / TICKS);
+	printf("arp: tick mean %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.0f ns\n",
+		   mean, ns[TICKS * 99 / 100], ns[TICKS * 999 / 1000], ns[TICKS - 1]);
+	
+	return failed;
+}
@@ -0,0 +1,354 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "blit.h"
+#include "boot.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// LED blit workout.  Encodes a few animations as the host would (coded
+// against the previous frame, or raw if that's smaller), plays them through
+// app_sysex_event with timer ticks in between, and checks the LEDs match -
+// then that the app draws the pads again once the host stops.  Reports bytes
+// per frame, decode cost and the frame rate each port could sustain, against
+// painting the same frames with one LED message per changed LED.
+// ____________________________________________________________________________
+
+#define FRAMES				5000
+
+// ticks between frames - 30fps
+#define TICKS_PER_FRAME		33
+
+#define DIN_BYTES_PER_S		3125.0		// 31250 baud, 10 bits per byte
+#define USB_BYTES_PER_S		48000.0		// 16 USB-MIDI packets of 3 bytes per 1ms frame
+
+#define LED_MESSAGE_SIZE	12			// F0 00 20 29 02 10 0B index r g b F7
+
+typedef u8 Frame[BLIT_LED_COUNT][3];
+
+static u16 raw_ADC[PAD_COUNT];
+
+// ____________________________________________________________________________
+//
+// Host side encoder
+// ____________________________________________________________________________
+
+static int same(const u8 *a, const u8 *b)
+{
+	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+static int showing(Frame f)
+{
+	for (int i=0; i < BLIT_LED_COUNT; ++i)
+	{
+		u8 rgb[3];
+		hal_read_led(TYPEPAD, i, rgb, rgb + 1, rgb + 2);
+		
+		if (!same(rgb, f[i]))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void ticks(int n)
+{
+	for (int i=0; i < n; ++i)
+	{
+		app_timer_event();
+	}
+}
+
+static int run_length(Frame next, int i)
+{
+	int n = 1;
+	
+	while (i + n < BLIT_LED_COUNT && n < BLIT_MAX_SPAN && same(next[i], next[i + n]))
+	{
+		++n;
+	}
+	return n;
+}
+
+static u16 encode_coded(u8 *out, Frame prev, Frame next)
+{
+	u16 n = 0;
+	int i = 0;
+	
+	while (i < BLIT_LED_COUNT)
+	{
+		if (same(prev[i], next[i]))
+		{
+			int skip = 1;
+			
+			while (i + skip < BLIT_LED_COUNT && skip < BLIT_MAX_SKIP && same(prev[i + skip], next[i + skip]))
+			{
+				++skip;
+			}
+			
+			// trailing unchanged LEDs need no op at all
+			if (i + skip < BLIT_LED_COUNT)
+			{
+				out[n++] = BLIT_OP_SKIP | (skip - 1);
+			}
+			i += skip;
+			continue;
+		}
+		
+		int run = run_length(next, i);
+		
+		if (run > 1)
+		{
+			out[n++] = BLIT_OP_RUN | (run - 1);
+			memcpy(out + n, next[i], 3);
+			n += 3;
+			i += run;
+			continue;
+		}
+		
+		// literal until something unchanged, or a run starts
+		int count = 1;
+		
+		while (i + count < BLIT_LED_COUNT && count < BLIT_MAX_SPAN
+			   && !same(prev[i + count], next[i + count]) && run_length(next, i + count) == 1)
+		{
+			++count;
+		}
+		
+		out[n++] = BLIT_OP_LITERAL | (count - 1);
+		memcpy(out + n, next[i], 3 * count);
+		n += 3 * count;
+		i += count;
+	}
+	
+	return n;
+}
+
+static u16 encode(u8 *msg, Frame prev, Frame next)
+{
+	u16 n = sysex_begin(msg, SYSEX_BLIT);
+	u16 coded = encode_coded(msg + n + 1, prev, next);
+	
+	if (coded < 3 * BLIT_LED_COUNT)
+	{
+		msg[n] = BLIT_CODED;
+		n += 1 + coded;
+	}
+	else
+	{
+		msg[n++] = BLIT_RAW;
+		memcpy(msg + n, next, 3 * BLIT_LED_COUNT);
+		n += 3 * BLIT_LED_COUNT;
+	}
+	
+	msg[n++] = 0xF7;
+	return n;
+}
+
+// ____________________________________________________________________________
+//
+// Animations
+// ____________________________________________________________________________
+
+static void noise(Frame f, int t)
+{
+	(void)t;
+	
+	for (int i=0; i < BLIT_LED_COUNT; ++i)
+	{
+		f[i][0] = sim_rand() % (MAXLED + 1);
+		f[i][1] = sim_rand() % (MAXLED + 1);
+		f[i][2] = sim_rand() % (MAXLED + 1);
+	}
+}
+
+static void bars(Frame f, int t)
+{
+	// a colour per row, scrolling up
+	for (int i=0; i < BLIT_LED_COUNT; ++i)
+	{
+		int row = (i / 10 + t) % 10;
+		
+		f[i][0] = row * 7;
+		f[i][1] = MAXLED - row * 7;
+		f[i][2] = (row & 1) * MAXLED;
+	}
+}
+
+static void sparkle(Frame f, int t)
+{
+	(void)t;
+	
+	// a handful of LEDs change each frame
+	for (int k=0; k < 6; ++k)
+	{
+		int i = sim_rand() % BLIT_LED_COUNT;
+		
+		f[i][0] = sim_rand() % (MAXLED + 1);
+		f[i][1] = sim_rand() % (MAXLED + 1);
+		f[i][2] = 0;
+	}
+}
+
+static void still(Frame f, int t)
+{
+	(void)t;
+	(void)f;
+}
+
+typedef struct
+{
+	const char *name;
+	void (*draw)(Frame f, int t);
+} Animation;
+
+static const Animation ANIMATIONS[] =
+{
+	{ "noise", noise },
+	{ "bars", bars },
+	{ "sparkle", sparkle },
+	{ "still", still },
+};
+
+// ____________________________________________________________________________
+
+int sim_blit(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	static Frame prev;
+	static Frame next;
+	u8 msg[SYSEX_MAX_SIZE];
+	int failed = 0;
+	
+	app_init(raw_ADC);
+	sim_srand(1);
+	
+	// let it start up and draw its own pads first
+	while (!boot_ready())
+	{
+		app_timer_event();
+	}
+	
+	printf("\nblit: animation  bytes/frame  decode ns  DIN fps  USB fps  | LED msgs: bytes/frame  DIN fps  USB fps\n");
+	
+	for (size_t a=0; a < sizeof(ANIMATIONS) / sizeof(ANIMATIONS[0]); ++a)
+	{
+		double bytes = 0;
+		double single_bytes = 0;
+		double decode_ns = 0;
+		
+		memset(prev, 0, sizeof(prev));
+		memset(next, 0, sizeof(next));
+		
+		// start from a known, blank frame
+		u16 n = sysex_begin(msg, SYSEX_BLIT);
+		msg[n++] = BLIT_RAW;
+		memset(msg + n, 0, 3 * BLIT_LED_COUNT);
+		n += 3 * BLIT_LED_COUNT;
+		msg[n++] = 0xF7;
+		app_sysex_event(USBSTANDALONE, msg, n);
+		
+		for (int t=0; t < FRAMES; ++t)
+		{
+			ANIMATIONS[a].draw(next, t);
+			n = encode(msg, prev, next);
+			
+			double start = sim_now_ns();
+			app_sysex_event(USBSTANDALONE, msg, n);
+			decode_ns += sim_now_ns() - start;
+			
+			bytes += n;
+			
+			// the frame has to last until the next one
+			ticks(TICKS_PER_FRAME);
+			
+			if (!showing(next))
+			{
+				failed = 1;
+			}
+			
+			for (int i=0; i < BLIT_LED_COUNT; ++i)
+			{
+				if (!same(prev[i], next[i]))
+				{
+					single_bytes += LED_MESSAGE_SIZE;
+				}
+			}
+			
+			memcpy(prev, next, sizeof(prev));
+		}
+		
+		bytes /= FRAMES;
+		single_bytes /= FRAMES;
+		decode_ns /= FRAMES;
+		
+		// a still frame costs nothing as single LED messages - show it as unlimited
+		printf("blit: %-9s  %11.1f  %9.0f  %7.1f  %7.0f  | %20.1f  %7.1f  %7.0f\n",
+			   ANIMATIONS[a].name, bytes, decode_ns,
+			   DIN_BYTES_PER_S / bytes, USB_BYTES_PER_S / bytes,
+			   single_bytes,
+			   single_bytes ? DIN_BYTES_PER_S / single_bytes : 1.0 / 0.0,
+			   single_bytes ? USB_BYTES_PER_S / single_bytes : 1.0 / 0.0);
+	}
+	
+	// a pad pressed hard shows red, once the host has stopped sending frames
+	raw_ADC[0] = 1024;
+	ticks(BLIT_HOLD_TICKS - TICKS_PER_FRAME - 1);
+	
+	u8 rgb[3];
+	int held = showing(next);
+	
+	ticks(1);
+	hal_read_led(TYPEPAD, ADC_MAP[0], rgb, rgb + 1, rgb + 2);
+	int back = !blit_showing() && rgb[0] != 0;
+	
+	raw_ADC[0] = 0;
+	
+	if (!held || !back)
+	{
+		printf("blit: %s\n", held ? "FAILED - the pads aren't drawn again after the hold" : "FAILED - the frame didn't last the hold");
+		failed = 1;
+	}
+	
+	printf("blit: %s\n", failed ? "FAILED - LEDs don't match the frames sent" : "ok");
+	return failed;
+}
@@ -0,0 +1,331 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "anim.h"
+#include "animcode.h"
+#include "boot.h"
+
+// ____________________________________________________________________________
+//
+// Start up workout.  app_init only sets up, and the timer reads flash and
+// draws over the first few ticks (see boot.h), so this times app_init, the
+// ticks and CPU time to the first pad lit and to ready, and the worst start
+// up tick against an ordinary one.  For comparison, it also times running all
+// the stages up front, as app_init used to.
+//
+// Checks the pads come up as saved, a saved light show plays once ready, a
+// pad pressed while starting up keeps it from starting without toggling the
+// pad, Setup pressed then doesn't save over the pads, and notes arriving
+// early don't upset anything.
+// ____________________________________________________________________________
+
+#define RUNS			2000
+#define TICKS			10000
+
+// saved buttons light the first tick, and the rest is read a chunk a tick
+#define LIGHT_BY		1
+#define READY_BY		8
+
+#define BUTTON_COUNT	100
+#define SHOW_OFFSET		128
+
+static u16 raw_ADC[PAD_COUNT];
+
+static u8 g_Buttons[BUTTON_COUNT];
+
+static int g_Tick = 0;
+static int g_LitTick = 0;
+static double g_Start = 0;
+static double g_LitNs = 0;
+
+static void on_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
+{
+	(void)type;
+	(void)index;
+	
+	if (!g_LitTick && (red || green || blue))
+	{
+		g_LitNs = sim_now_ns() - g_Start;
+		g_LitTick = g_Tick ? g_Tick : -1;
+	}
+}
+
+static void save_buttons()
+{
+	for (int i=0; i < BUTTON_COUNT; ++i)
+	{
+		g_Buttons[i] = (i * 7) % 64;
+	}
+	
+	hal_write_flash(0, g_Buttons, BUTTON_COUNT);
+}
+
+static void save_show(int on)
+{
+	static u8 frame[ANIMCODE_FRAME_SIZE];
+	static u8 show[USER_AREA_SIZE - SHOW_OFFSET];
+	u16 duration = 100;
+	
+	memset(frame, 0, sizeof(frame));
+	memset(show, 0, sizeof(show));
+	
+	if (on)
+	{
+		frame[3 * 44] = MAXLED;
+		animcode_encode(frame, &duration, 1, 0, show, sizeof(show));
+	}
+	
+	hal_write_flash(SHOW_OFFSET, show, sizeof(show));
+}
+
+static int buttons_shown()
+{
+	for (int i=0; i < BUTTON_COUNT; ++i)
+	{
+		u8 r, g, b;
+		hal_read_led(TYPEPAD, i, &r, &g, &b);
+		
+		if (b != g_Buttons[i])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+typedef struct
+{
+	double init;		// ns in app_init
+	int lit;			// tick the first pad lit on
+	double lit_ns;		// CPU time from app_init to then
+	int ready;			// tick ready after
+	double ready_ns;
+	double worst;		// longest start up tick
+} Boot;
+
+static void boot(Boot *b)
+{
+	g_Tick = 0;
+	g_LitTick = 0;
+	g_Start = sim_now_ns();
+	
+	app_init(raw_ADC);
+	
+	b->init = sim_now_ns() - g_Start;
+	b->worst = 0;
+	
+	while (!boot_ready() && g_Tick < 100)
+	{
+		++g_Tick;
+		
+		double start = sim_now_ns();
+		app_timer_event();
+		double took = sim_now_ns() - start;
+		
+		b->worst = took > b->worst ? took : b->worst;
+	}
+	
+	b->lit = g_LitTick;
+	b->lit_ns = g_LitNs;
+	b->ready = g_Tick;
+	b->ready_ns = sim_now_ns() - g_Start;
+}
+
+static int check_boot()
+{
+	int failed = 0;
+	Boot b;
+	
+	save_show(0);
+	boot(&b);
+	
+	if (b.lit < 1 || b.lit > LIGHT_BY || b.ready > READY_BY || !buttons_shown())
+	{
+		printf("boot: first light on tick %d, ready after %d ticks, pads %s - FAILED\n",
+			   b.lit, b.ready, buttons_shown() ? "as saved" : "NOT as saved");
+		++failed;
+	}
+	
+	// a saved show plays once ready
+	save_show(1);
+	boot(&b);
+	app_timer_event();
+	
+	if (!anim_playing())
+	{
+		printf("boot: saved light show doesn't play - FAILED\n");
+		++failed;
+	}
+	
+	// ...unless a pad was pressed before it could, with notes arriving too
+	app_init(raw_ADC);
+	app_midi_event(USBMIDI, NOTEON, 60, 100);
+	app_timer_event();
+	app_surface_event(TYPEPAD, 11, 127);
+	app_surface_event(TYPEPAD, 11, 0);
+	app_midi_event(USBMIDI, NOTEOFF, 60, 0);
+	
+	for (int i=0; i < READY_BY; ++i)
+	{
+		app_timer_event();
+	}
+	
+	if (!boot_ready() || anim_playing())
+	{
+		printf("boot: light show %s after a pad press while starting up - FAILED\n",
+			   anim_playing() ? "starts" : "doesn't finish loading");
+		++failed;
+	}
+	
+	// the press didn't toggle the pad, as the saved states weren't in yet
+	u8 red, green, blue;
+	hal_read_led(TYPEPAD, 11, &red, &green, &blue);
+	
+	if (blue != g_Buttons[11])
+	{
+		printf("boot: pad pressed while starting up toggled it - FAILED\n");
+		++failed;
+	}
+	
+	// Setup pressed before the states are read mustn't save blank ones over
+	// them
+	u8 saved[BUTTON_COUNT];
+	
+	save_show(0);
+	app_init(raw_ADC);
+	app_surface_event(TYPESETUP, 0, 127);
+	app_surface_event(TYPESETUP, 0, 0);
+	
+	for (int i=0; i < READY_BY; ++i)
+	{
+		app_timer_event();
+	}
+	
+	hal_read_flash(0, saved, BUTTON_COUNT);
+	
+	if (memcmp(saved, g_Buttons, BUTTON_COUNT) || !buttons_shown())
+	{
+		printf("boot: Setup pressed while starting up wiped the saved pads - FAILED\n");
+		++failed;
+	}
+	
+	
+	return failed;
+}
+
+int sim_boot(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	sim_set_quiet(1);
+	sim_set_led_hook(on_led);
+	
+	save_buttons();
+	
+	int failed = check_boot();
+	
+	// timing, with a light show saved, as that's the most to read
+	save_show(1);
+	
+	Boot best = { 1e9, 0, 1e9, 0, 1e9, 1e9 };
+	
+	for (int i=0; i < RUNS; ++i)
+	{
+		Boot b;
+		boot(&b);
+		
+		best.init = b.init < best.init ? b.init : best.init;
+		best.lit_ns = b.lit_ns < best.lit_ns ? b.lit_ns : best.lit_ns;
+		best.ready_ns = b.ready_ns < best.ready_ns ? b.ready_ns : best.ready_ns;
+		best.worst = b.worst < best.worst ? b.worst : best.worst;
+		best.lit = b.lit;
+		best.ready = b.ready;
+	}
+	
+	// everything up front, as app_init used to
+	double upfront = 1e9;
+	
+	for (int i=0; i < RUNS; ++i)
+	{
+		double start = sim_now_ns();
+		
+		app_init(raw_ADC);
+		
+		while (!boot_poll())
+		{
+		}
+		
+		double took = sim_now_ns() - start;
+		upfront = took < upfront ? took : upfront;
+	}
+	
+	// an ordinary tick, once ready
+	app_init(raw_ADC);
+	
+	while (!boot_ready())
+	{
+		app_timer_event();
+	}
+	anim_stop();
+	
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		app_timer_event();
+	}
+	
+	double tick = (sim_now_ns() - start) / TICKS;
+	
+	sim_set_led_hook(0);
+	save_show(0);
+	
+	printf("boot: app_init %.0f ns, against %.0f ns doing it all up front\n", best.init, upfront);
+	printf("boot: first light on tick %d (%.0f ns CPU), ready after %d ticks (%.0f ns CPU)\n",
+		   best.lit, best.lit_ns, best.ready, best.ready_ns);
+	printf("boot: worst start up tick %.0f ns, against %.0f ns once ready\n", best.worst, tick);
+	
+	if (failed)
+	{
+		printf("boot: FAILED\n");
+		return 1;
+	}
+	
+	printf("boot: OK\n");
+	return 0;
+}
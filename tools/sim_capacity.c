@@ -0,0 +1,398 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "grid.h"
+
+// ____________________________________________________________________________
+//
+// Input capacity workout.  Holds every pad down with moving pressure while
+// aftertouch, edge buttons and MIDI on both ports come in between ticks, at a
+// rate ramped up until the app can't keep up, then narrowed down to the
+// highest rate it sustains - the capacity, in input events per ms.
+//
+// A rate is sustained if no output is dropped, the output queues aren't still
+// growing at the end, and the worst ms of work fits in the timer's budget.
+// The output ports drain at their wire speed into a FIFO of a few hundred
+// bytes, like the HAL's: DIN at 31250 baud, USB as one 64 byte packet of four
+// byte events each ms.  Work is counted in host cycles against the 72MHz
+// core's ms, which flatters the app - see tools/m3bench for the real thing.
+//
+// The wires are usually what gives first, so it then ramps again with them
+// taken out, for the rate the app itself runs out of time at.
+//
+// "simulator capacity 4" fails if the capacity is under 4 events per ms.
+// ____________________________________________________________________________
+
+#define WARM_MS			500
+#define RUN_MS			2000
+
+#define CYCLES_PER_MS	72000
+
+// output FIFO per port, and what each wire takes a ms, in 1/1000ths of a byte
+#define FIFO_BYTES		256
+#define DIN_DRAIN		3125
+#define USB_DRAIN		64000
+
+#define MAX_RATE		1024.0
+#define BISECTIONS		8
+
+#define LINK_USB		0
+#define LINK_DIN		1
+#define LINKS			2
+
+static const char *LINK_NAMES[LINKS] = { "USB", "DIN" };
+
+typedef struct
+{
+	int fill;			// 1/1000ths of a byte
+	int peak;
+	int dropped;
+	int sent;
+} Link;
+
+typedef struct
+{
+	double rate;
+	u64 tick_p99;		// app_timer_event alone
+	u64 ms_p99;			// everything in a ms
+	int peak[LINKS];	// bytes
+	int growth[LINKS];	// bytes over the second half of the run
+	int dropped[LINKS];
+	int events;
+	const char *limit;	// what failed, or 0
+} Result;
+
+static Link g_Links[LINKS];
+static int g_Wires = 1;
+static u16 raw_ADC[PAD_COUNT];
+static u8 g_Buttons[32];
+static u8 g_ButtonCount = 0;
+
+//______________________________________________________________________________
+
+// both USB cables share the one link
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	(void)d1;
+	(void)d2;
+	
+	Link *link = &g_Links[port == DINMIDI ? LINK_DIN : LINK_USB];
+	int bytes = port == DINMIDI ? (status >= 0xF8 ? 1 : 3) : 4;
+	
+	if (g_Wires && link->fill + bytes * 1000 > FIFO_BYTES * 1000)
+	{
+		++link->dropped;
+		return;
+	}
+	
+	link->fill += bytes * 1000;
+	link->peak = link->fill > link->peak ? link->fill : link->peak;
+	++link->sent;
+}
+
+static void on_sysex(u8 port, const u8 *data, u16 length)
+{
+	(void)data;
+	(void)length;
+	
+	// nothing asks for a dump, so there shouldn't be any
+	on_midi(port, 0xF0, 0, 0);
+}
+
+static void drain()
+{
+	static const int DRAIN[LINKS] = { USB_DRAIN, DIN_DRAIN };
+	
+	for (u8 l=0; l < LINKS; ++l)
+	{
+		g_Links[l].fill -= g_Wires ? DRAIN[l] : g_Links[l].fill;
+		g_Links[l].fill = g_Links[l].fill < 0 ? 0 : g_Links[l].fill;
+	}
+}
+
+//______________________________________________________________________________
+
+// every pad held, the pressure wandering well above the release threshold
+static void press_pads(int ms)
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		raw_ADC[i] = 2400 + 1200 * ((ms + i * 37) % 200 < 100 ? 1 : -1) * ((ms + i * 37) % 100) / 100;
+	}
+}
+
+static void event()
+{
+	u32 r = sim_rand() % 10;
+	
+	if (r < 4)
+	{
+		// pressure on a held pad
+		app_aftertouch_event(ADC_MAP[sim_rand() % PAD_COUNT], sim_rand() % 128);
+	}
+	else if (r < 7)
+	{
+		// dense DIN in - notes that light pads, controllers and pressure
+		u8 channel = sim_rand() % 16;
+		
+		switch (sim_rand() % 4)
+		{
+			case 0:
+				app_midi_event(DINMIDI, NOTEON | channel, 36 + sim_rand() % 64, 1 + sim_rand() % 127);
+				break;
+				
+			case 1:
+				app_midi_event(DINMIDI, NOTEOFF | channel, 36 + sim_rand() % 64, 0);
+				break;
+				
+			case 2:
+				app_midi_event(DINMIDI, CC | channel, sim_rand() % 120, sim_rand() % 128);
+				break;
+				
+			default:
+				app_midi_event(DINMIDI, CHANNELAFTERTOUCH | channel, sim_rand() % 128, 0);
+				break;
+		}
+	}
+	else if (r < 9)
+	{
+		// and from the host
+		app_midi_event(USBMIDI, CC | (sim_rand() % 16), sim_rand() % 120, sim_rand() % 128);
+	}
+	else
+	{
+		u8 index = g_Buttons[sim_rand() % g_ButtonCount];
+		app_surface_event(TYPEPAD, index, sim_rand() % 2 ? 127 : 0);
+	}
+}
+
+//______________________________________________________________________________
+
+static int compare_cycles(const void *a, const void *b)
+{
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+static Result run(double rate)
+{
+	static u64 tick_cycles[RUN_MS];
+	static u64 ms_cycles[RUN_MS];
+	
+	Result result;
+	memset(&result, 0, sizeof(result));
+	result.rate = rate;
+	
+	sim_srand(49);
+	press_pads(0);
+	app_init(raw_ADC);
+	
+	// settle, and let the burst of notes from pressing every pad go out
+	for (int ms=0; ms < WARM_MS; ++ms)
+	{
+		press_pads(ms);
+		app_timer_event();
+		drain();
+	}
+	
+	memset(g_Links, 0, sizeof(g_Links));
+	
+	int half[LINKS] = { 0 };
+	double due = 0;
+	
+	for (int ms=0; ms < RUN_MS; ++ms)
+	{
+		press_pads(WARM_MS + ms);
+		
+		u64 c = sim_cycles();
+		app_timer_event();
+		u64 t = sim_cycles();
+		
+		for (due += rate; due >= 1; due -= 1)
+		{
+			event();
+			++result.events;
+		}
+		
+		ms_cycles[ms] = sim_cycles() - c;
+		tick_cycles[ms] = t - c;
+		
+		drain();
+		
+		if (ms == RUN_MS / 2)
+		{
+			for (u8 l=0; l < LINKS; ++l)
+			{
+				half[l] = g_Links[l].fill;
+			}
+		}
+	}
+	
+	qsort(tick_cycles, RUN_MS, sizeof(u64), compare_cycles);
+	qsort(ms_cycles, RUN_MS, sizeof(u64), compare_cycles);
+	
+	result.tick_p99 = tick_cycles[RUN_MS * 99 / 100];
+	result.ms_p99 = ms_cycles[RUN_MS * 99 / 100];
+	
+	for (u8 l=0; l < LINKS; ++l)
+	{
+		result.peak[l] = g_Links[l].peak / 1000;
+		result.growth[l] = (g_Links[l].fill - half[l]) / 1000;
+		result.dropped[l] = g_Links[l].dropped;
+		
+		// a queue that's filled by more than a message since halfway will
+		// fill up given time
+		if (!result.limit && (result.dropped[l] || result.growth[l] > 4))
+		{
+			result.limit = LINK_NAMES[l];
+		}
+	}
+	
+	if (!result.limit && result.ms_p99 > CYCLES_PER_MS)
+	{
+		result.limit = "CPU";
+	}
+	
+	return result;
+}
+
+static void print_result(const Result *r)
+{
+	printf("capacity: %8.2f  %8llu  %8llu  %4d %4d  %5d %5d  %6d %6d  %s\n", r->rate,
+		   r->tick_p99, r->ms_p99, r->peak[LINK_USB], r->peak[LINK_DIN],
+		   r->growth[LINK_USB], r->growth[LINK_DIN], r->dropped[LINK_USB], r->dropped[LINK_DIN],
+		   r->limit ? r->limit : "ok");
+}
+
+//______________________________________________________________________________
+
+// the highest rate that sustains, printing the ramp
+static Result ramp(Result *limit)
+{
+	printf("capacity: events/ms  tick p99    ms p99  peak queue   growth     dropped\n");
+	printf("capacity:            (cycles)  (cycles)   USB  DIN   USB   DIN     USB    DIN\n");
+	
+	// double the rate until something gives...
+	Result good = run(0);
+	Result bad = good;
+	
+	print_result(&good);
+	
+	for (double rate = 0.25; rate <= MAX_RATE; rate *= 2)
+	{
+		Result r = run(rate);
+		print_result(&r);
+		
+		if (r.limit)
+		{
+			bad = r;
+			break;
+		}
+		good = r;
+	}
+	
+	// ...then narrow it down
+	if (bad.limit)
+	{
+		for (int i=0; i < BISECTIONS; ++i)
+		{
+			Result r = run((good.rate + bad.rate) / 2);
+			
+			if (r.limit)
+			{
+				bad = r;
+			}
+			else
+			{
+				good = r;
+			}
+		}
+		
+		printf("capacity:\n");
+		print_result(&good);
+		print_result(&bad);
+	}
+	
+	*limit = bad;
+	return good;
+}
+
+int sim_capacity(int argc, char *argv[])
+{
+	double least = argc > 0 ? atof(argv[0]) : 0;
+	
+	for (u8 index = grid_next(&GRID_BUTTONS, 0); index != GRID_NONE; index = grid_next(&GRID_BUTTONS, index + 1))
+	{
+		g_Buttons[g_ButtonCount++] = index;
+	}
+	
+	sim_set_quiet(1);
+	sim_set_midi_hook(on_midi);
+	sim_set_sysex_hook(on_sysex);
+	
+	Result limit;
+	Result wires;
+	Result cpu;
+	
+	g_Wires = 1;
+	wires = ramp(&limit);
+	const char *by = limit.limit;
+	
+	printf("\ncapacity: without the wires\n");
+	
+	g_Wires = 0;
+	cpu = ramp(&limit);
+	g_Wires = 1;
+	
+	sim_set_sysex_hook(0);
+	sim_set_midi_hook(0);
+	sim_set_quiet(0);
+	
+	printf("\ncapacity: app alone %.2f events/ms, limited by %s\n", cpu.rate, limit.limit ? limit.limit : "nothing up to the top rate");
+	printf("capacity: %.2f events/ms, limited by %s\n", wires.rate, by ? by : "nothing up to the top rate");
+	
+	int failed = wires.rate < least;
+	
+	if (failed)
+	{
+		printf("capacity: FAILED - under %.2f events/ms\n", least);
+	}
+	return failed;
+}
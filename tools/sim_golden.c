@@ -0,0 +1,514 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "instance.h"
+#include "simulator.h"
+#include "arp.h"
+#include "blit.h"
+#include "layout.h"
+#include "sync.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// Golden output regression suite.  Plays a fixed set of scenarios - pads,
+// the arpeggiator, layouts, MIDI, buttons, blits, external clock and so on,
+// each generated from its own seed - and keeps a running digest of the LED
+// frame buffer and everything sent out, folded in after every tick.
+//
+// The digests are checked against tools/golden.txt, which holds the final
+// digest of each scenario plus the low 4 bits of the running digest after
+// every tick, so a mismatch points at the first tick that went differently.
+// Regenerate the file with "make golden" after changing what the app does on
+// purpose.
+//
+// Each scenario runs on a fresh thread, so starts on a freshly powered up
+// Launchpad (see instance.h), and they run as many at a time as there are
+// cores.
+// ____________________________________________________________________________
+
+#define GOLDEN_FILE		"tools/golden.txt"
+
+#define SCENARIOS		2048
+#define TICKS			64
+
+// kinds of scenario, by scenario number
+#define IDLE			0
+#define PADS			1
+#define ARP				2
+#define LAYOUTS			3
+#define MIDI			4
+#define SURFACE			5
+#define BLIT			6
+#define SYNC			7
+#define KINDS			8
+
+static const char *KIND_NAMES[KINDS] =
+{
+	"idle", "pads", "arp", "layouts", "midi", "surface", "blit", "sync"
+};
+
+typedef struct
+{
+	int number;
+	u32 digest;
+	char ticks[TICKS + 1];		// low nibble of the running digest, in hex
+} Scenario;
+
+static Scenario g_Scenarios[SCENARIOS];
+static Scenario g_Golden[SCENARIOS];
+
+// per thread - the running digest, and the output since the last tick
+static INSTANCE u32 g_Running;
+static INSTANCE u32 g_Output;
+
+static u32 fnv(u32 h, u32 x)
+{
+	for (int i=0; i < 4; ++i)
+	{
+		h = ((h ^ ((x >> (8 * i)) & 0xFF)) * 16777619) & 0xFFFFFFFF;
+	}
+	
+	return h;
+}
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	g_Output = fnv(g_Output, (port << 24) | (status << 16) | (d1 << 8) | d2);
+}
+
+static void on_sysex(u8 port, const u8 *data, u16 length)
+{
+	g_Output = fnv(g_Output, 0x80000000 | (port << 16) | length);
+	
+	for (u16 i=0; i < length; ++i)
+	{
+		g_Output = fnv(g_Output, data[i]);
+	}
+}
+
+// fold a tick's output and the LEDs into the running digest
+static void fold()
+{
+	u32 h = fnv(g_Running, g_Output);
+	
+	for (u8 index=0; index < 100; ++index)
+	{
+		u8 r, g, b;
+		hal_read_led(TYPEPAD, index, &r, &g, &b);
+		h = fnv(h, (r << 16) | (g << 8) | b);
+	}
+	
+	u8 r, g, b;
+	hal_read_led(TYPESETUP, 0, &r, &g, &b);
+	
+	g_Running = fnv(h, (r << 16) | (g << 8) | b);
+	g_Output = 2166136261u;
+}
+
+//______________________________________________________________________________
+//
+// Scenarios.
+//______________________________________________________________________________
+
+typedef struct
+{
+	u16 adc[PAD_COUNT];
+	u16 peak[PAD_COUNT];
+	u8 age[PAD_COUNT];
+} Pads;
+
+static void strike(Pads *p)
+{
+	u32 r = sim_rand();
+	u8 i = r % PAD_COUNT;
+	
+	p->peak[i] = 128 + (r >> 8) % 3968;
+	p->age[i] = 0;
+}
+
+// pads rise over 2 ms, hold for 12 and drop
+static void scan(Pads *p)
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		u8 age = p->age[i];
+		
+		p->adc[i] = !p->peak[i] ? 0 : age < 2 ? p->peak[i] * (age + 1) / 2 : age < 14 ? p->peak[i] : 0;
+		
+		if (p->peak[i] && ++p->age[i] > 14)
+		{
+			p->peak[i] = 0;
+		}
+	}
+}
+
+static void send_blit()
+{
+	u8 message[SYSEX_MAX_SIZE];
+	u16 n = sysex_begin(message, SYSEX_BLIT);
+	
+	message[n++] = BLIT_CODED;
+	
+	// runs and skips across the frame, ending wherever it ends
+	for (int led=0; led < BLIT_LED_COUNT && n < SYSEX_MAX_SIZE - 8; )
+	{
+		u32 r = sim_rand();
+		u8 span = 1 + (r >> 8) % BLIT_MAX_SPAN;
+		
+		if (r & 1)
+		{
+			message[n++] = BLIT_OP_SKIP | (span - 1);
+		}
+		else
+		{
+			message[n++] = BLIT_OP_RUN | (span - 1);
+			message[n++] = (r >> 16) % (MAXLED + 1);
+			message[n++] = (r >> 22) % (MAXLED + 1);
+			message[n++] = (r >> 26) % (MAXLED + 1);
+		}
+		
+		led += span;
+	}
+	
+	message[n++] = 0xF7;
+	app_sysex_event(USBSTANDALONE, message, n);
+}
+
+static void setup(int kind)
+{
+	switch (kind)
+	{
+		case ARP:
+			arp_set_chord(1 + sim_rand() % (ARP_CHORD_COUNT - 1));
+			arp_set_mode(1 + sim_rand() % (ARP_MODE_COUNT - 1), 1 + sim_rand() % ARP_MAX_OCTAVES, 4, 3);
+			break;
+			
+		case LAYOUTS:
+			layout_set(sim_rand() % LAYOUT_COUNT, 24 + sim_rand() % 24, LAYOUT_SCALE_DORIAN);
+			break;
+			
+		case SYNC:
+			sync_set_source(DINMIDI);
+			arp_set_sync(1);
+			arp_set_mode(ARP_UP, 2, 3, 2);
+			break;
+	}
+}
+
+static void play(int kind, Pads *p, int tick)
+{
+	u32 r = sim_rand();
+	
+	switch (kind)
+	{
+		case PADS:
+		case ARP:
+			if ((r & 3) == 0)
+			{
+				strike(p);
+			}
+			break;
+			
+		case LAYOUTS:
+			if ((r & 3) == 0)
+			{
+				strike(p);
+			}
+			if ((r & 0x30) == 0)
+			{
+				app_midi_event(USBMIDI, (r & 0x40 ? NOTEON : NOTEOFF), (r >> 8) & 0x7F, (r >> 16) & 0x7F);
+			}
+			break;
+			
+		case MIDI:
+			if (r & 1)
+			{
+				static const u8 TYPES[] = { NOTEOFF, NOTEON, POLYAFTERTOUCH, CC, 0xC0, CHANNELAFTERTOUCH, 0xE0, 0xF0 };
+				u8 type = TYPES[(r >> 1) & 7];
+				u8 status = type == 0xF0 ? MIDITIMINGCLOCK : type | ((r >> 4) & 15);
+				
+				app_midi_event((r >> 8) % 3, status, (r >> 12) & 0x7F, (r >> 20) & 0x7F);
+			}
+			if (tick == TICKS / 2)
+			{
+				static u8 route[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_ROUTE, USBSTANDALONE, DINMIDI, 0x02, 0, 9, 0xF7 };
+				app_sysex_event(USBSTANDALONE, route, sizeof(route));
+			}
+			break;
+			
+		case SURFACE:
+			if ((r & 3) == 0)
+			{
+				u8 index = (r >> 8) % 100;
+				app_surface_event(TYPEPAD, index, (r >> 16) & 1 ? 1 + ((r >> 17) & 0x7E) : 0);
+			}
+			if ((r & 0x1C) == 0)
+			{
+				app_aftertouch_event(ADC_MAP[(r >> 8) % PAD_COUNT], (r >> 20) & 0x7F);
+			}
+			if ((r & 0x3E0) == 0)
+			{
+				app_cable_event((r >> 10) & 1 ? MIDI_IN_CABLE : MIDI_OUT_CABLE, (r >> 11) & 1 ? 127 : 0);
+			}
+			if (tick == TICKS / 2)
+			{
+				app_surface_event(TYPESETUP, 0, 127);
+			}
+			break;
+			
+		case BLIT:
+			if ((r & 7) == 0)
+			{
+				send_blit();
+			}
+			if (tick == 3)
+			{
+				static u8 dump[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRANSFER_DUMP, 2, 0xF7 };
+				app_sysex_event(USBMIDI, dump, sizeof(dump));
+			}
+			break;
+			
+		case SYNC:
+			if (tick == 1)
+			{
+				app_midi_event(DINMIDI, MIDISTART, 0, 0);
+			}
+			if (tick % 4 == 0 && (r & 7))
+			{
+				app_midi_event(DINMIDI, MIDITIMINGCLOCK, 0, 0);
+			}
+			if ((r & 0x70) == 0)
+			{
+				strike(p);
+			}
+			break;
+	}
+}
+
+static void *run(void *arg)
+{
+	Scenario *s = (Scenario*)arg;
+	Pads pads;
+	
+	memset(&pads, 0, sizeof(pads));
+	
+	sim_set_quiet(1);
+	sim_set_midi_hook(on_midi);
+	sim_set_sysex_hook(on_sysex);
+	sim_srand(s->number + 1);
+	
+	int kind = s->number % KINDS;
+	
+	g_Running = 2166136261u;
+	g_Output = 2166136261u;
+	
+	app_init(pads.adc);
+	setup(kind);
+	fold();
+	
+	for (int tick=0; tick < TICKS; ++tick)
+	{
+		play(kind, &pads, tick);
+		scan(&pads);
+		app_timer_event();
+		fold();
+		
+		s->ticks[tick] = "0123456789abcdef"[g_Running & 15];
+	}
+	
+	s->ticks[TICKS] = 0;
+	s->digest = g_Running;
+	
+	return 0;
+}
+
+//______________________________________________________________________________
+
+static int load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	
+	if (!f)
+	{
+		printf("golden: can't open %s - run \"make golden\" to make it\n", path);
+		return 0;
+	}
+	
+	char line[256];
+	int count = 0;
+	
+	while (fgets(line, sizeof(line), f))
+	{
+		Scenario s;
+		unsigned long digest;
+		
+		if (line[0] == '#' || sscanf(line, "%d %lx %64s", &s.number, &digest, s.ticks) != 3)
+		{
+			continue;
+		}
+		
+		if (s.number >= 0 && s.number < SCENARIOS && strlen(s.ticks) == TICKS)
+		{
+			s.digest = digest;
+			g_Golden[s.number] = s;
+			++count;
+		}
+	}
+	
+	fclose(f);
+	return count;
+}
+
+static int save(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	
+	if (!f)
+	{
+		printf("golden: can't write %s\n", path);
+		return 0;
+	}
+	
+	fprintf(f, "# Golden digests for \"simulator golden\" - regenerate with \"make golden\".\n");
+	fprintf(f, "# scenario, final digest, low 4 bits of the running digest after each tick\n");
+	
+	for (int i=0; i < SCENARIOS; ++i)
+	{
+		fprintf(f, "%d %08lx %s\n", i, g_Scenarios[i].digest, g_Scenarios[i].ticks);
+	}
+	
+	fclose(f);
+	return 1;
+}
+
+int sim_golden(int argc, char *argv[])
+{
+	const char *path = GOLDEN_FILE;
+	int record = 0;
+	
+	for (int i=0; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "record") == 0)
+		{
+			record = 1;
+		}
+		else
+		{
+			path = argv[i];
+		}
+	}
+	
+	int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	cores = cores < 1 ? 1 : cores > 64 ? 64 : cores;
+	
+	double start = sim_now_ns();
+	
+	// a fresh thread for each scenario, a core's worth at a time
+	for (int first=0; first < SCENARIOS; first += cores)
+	{
+		pthread_t threads[64];
+		int n = SCENARIOS - first < cores ? SCENARIOS - first : cores;
+		
+		for (int i=0; i < n; ++i)
+		{
+			g_Scenarios[first + i].number = first + i;
+			pthread_create(&threads[i], 0, run, &g_Scenarios[first + i]);
+		}
+		
+		for (int i=0; i < n; ++i)
+		{
+			pthread_join(threads[i], 0);
+		}
+	}
+	
+	double ms = (sim_now_ns() - start) * 1e-6;
+	
+	printf("golden: %d scenarios of %d ticks in %.0f ms\n", SCENARIOS, TICKS, ms);
+	
+	if (record)
+	{
+		if (!save(path))
+		{
+			return 1;
+		}
+		
+		printf("golden: recorded %s\n", path);
+		return 0;
+	}
+	
+	if (load(path) != SCENARIOS)
+	{
+		printf("golden: %s doesn't cover all %d scenarios\n", path, SCENARIOS);
+		return 1;
+	}
+	
+	int failed = 0;
+	
+	for (int i=0; i < SCENARIOS; ++i)
+	{
+		const Scenario *s = &g_Scenarios[i];
+		const Scenario *g = &g_Golden[i];
+		
+		if (s->digest == g->digest)
+		{
+			continue;
+		}
+		
+		if (++failed <= 10)
+		{
+			int tick = 0;
+			
+			while (tick < TICKS - 1 && s->ticks[tick] == g->ticks[tick])
+			{
+				++tick;
+			}
+			
+			printf("golden: scenario %d (%s) first differs at tick %d\n", i, KIND_NAMES[i % KINDS], tick);
+		}
+	}
+	
+	if (failed)
+	{
+		printf("golden: %d of %d scenarios FAILED\n", failed, SCENARIOS);
+		return 1;
+	}
+	
+	printf("golden: ok\n");
+	return 0;
+}
@@ -0,0 +1,487 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "grid.h"
+
+// ____________________________________________________________________________
+//
+// Bitboard workout.  Checks the row, column and ADC tables against the button
+// numbering, then shifts, neighbours, rectangles, counts and the game of life
+// on random boards against the obvious loop over every button index.  Then
+// times each of them both ways.
+// ____________________________________________________________________________
+
+#define BOARDS			2000
+#define RUNS			100000
+
+static const s8 STEP_ROW[GRID_DIRECTIONS] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const s8 STEP_COLUMN[GRID_DIRECTIONS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+static int check(const char *what, int ok)
+{
+	if (!ok)
+	{
+		printf("grid: %s - FAILED\n", what);
+	}
+	return ok;
+}
+
+static void random_board(Grid *g, u8 cells[GRID_CELLS], u8 density)
+{
+	grid_clear(g);
+	
+	for (u8 i=0; i < GRID_CELLS; ++i)
+	{
+		cells[i] = sim_rand() % 100 < density;
+		
+		if (cells[i])
+		{
+			grid_set(g, i);
+		}
+	}
+}
+
+static int same(const Grid *g, const u8 cells[GRID_CELLS])
+{
+	for (u8 i=0; i < GRID_CELLS; ++i)
+	{
+		if (grid_test(g, i) != cells[i])
+		{
+			return 0;
+		}
+	}
+	
+	// nothing past the last index either
+	return (g->w[GRID_WORDS - 1] & ~GRID_ALL.w[GRID_WORDS - 1] & 0xFFFFFFFF) == 0;
+}
+
+// ____________________________________________________________________________
+//
+// The per-index versions, one byte a button.
+// ____________________________________________________________________________
+
+static u8 inside(int row, int column)
+{
+	return row >= 0 && row < GRID_SIZE && column >= 0 && column < GRID_SIZE;
+}
+
+static void loop_shift(u8 out[GRID_CELLS], const u8 in[GRID_CELLS], u8 d)
+{
+	memset(out, 0, GRID_CELLS);
+	
+	for (int i=0; i < GRID_CELLS; ++i)
+	{
+		int row = i / 10 + STEP_ROW[d];
+		int column = i % 10 + STEP_COLUMN[d];
+		
+		if (in[i] && inside(row, column))
+		{
+			out[row * 10 + column] = 1;
+		}
+	}
+}
+
+static void loop_neighbours(u8 out[GRID_CELLS], const u8 in[GRID_CELLS], u8 diagonals)
+{
+	for (int i=0; i < GRID_CELLS; ++i)
+	{
+		out[i] = 0;
+		
+		for (u8 d=0; d < GRID_DIRECTIONS; d += diagonals ? 1 : 2)
+		{
+			int row = i / 10 + STEP_ROW[d];
+			int column = i % 10 + STEP_COLUMN[d];
+			
+			if (inside(row, column) && in[row * 10 + column])
+			{
+				out[i] = !in[i];
+			}
+		}
+	}
+}
+
+static void loop_life(u8 out[GRID_CELLS], const u8 in[GRID_CELLS])
+{
+	for (int i=0; i < GRID_CELLS; ++i)
+	{
+		int row = i / 10;
+		int column = i % 10;
+		
+		out[i] = 0;
+		
+		if (row < 1 || row > 8 || column < 1 || column > 8)
+		{
+			continue;
+		}
+		
+		int count = 0;
+		
+		for (int r = row - 1; r <= row + 1; ++r)
+		{
+			for (int c = column - 1; c <= column + 1; ++c)
+			{
+				if ((r != row || c != column) && r >= 1 && r <= 8 && c >= 1 && c <= 8)
+				{
+					count += in[r * 10 + c];
+				}
+			}
+		}
+		
+		out[i] = count == 3 || (count == 2 && in[i]);
+	}
+}
+
+static int loop_count(const u8 in[GRID_CELLS])
+{
+	int count = 0;
+	
+	for (int i=0; i < GRID_CELLS; ++i)
+	{
+		count += in[i];
+	}
+	return count;
+}
+
+// ____________________________________________________________________________
+
+static int check_tables()
+{
+	int ok = 1;
+	int pads = 0;
+	
+	for (u8 i=0; i < GRID_CELLS; ++i)
+	{
+		u8 row = i / 10;
+		u8 column = i % 10;
+		u8 pad = row >= 1 && row <= 8 && column >= 1 && column <= 8;
+		u8 corner = (row == 0 || row == 9) && (column == 0 || column == 9);
+		
+		ok &= GRID_ROW[i] == row && GRID_COLUMN[i] == column;
+		ok &= grid_test(&GRID_ROWS[row], i) && grid_test(&GRID_COLUMNS[column], i);
+		ok &= grid_test(&GRID_PADS, i) == pad;
+		ok &= grid_test(&GRID_BUTTONS, i) == (!pad && !corner);
+		ok &= grid_test(&GRID_ALL, i);
+		
+		if (GRID_ADC[i] != GRID_NO_PAD)
+		{
+			ok &= pad && ADC_MAP[GRID_ADC[i]] == i;
+			++pads;
+		}
+	}
+	
+	for (u8 r=0; r < GRID_SIZE; ++r)
+	{
+		ok &= grid_count(&GRID_ROWS[r]) == GRID_SIZE && grid_count(&GRID_COLUMNS[r]) == GRID_SIZE;
+	}
+	
+	ok &= pads == PAD_COUNT && grid_count(&GRID_PADS) == 64 && grid_count(&GRID_BUTTONS) == 32;
+	ok &= grid_count(&GRID_ALL) == GRID_CELLS;
+	
+	return check("row, column and ADC tables", ok);
+}
+
+static int check_boards()
+{
+	int ok_shift = 1;
+	int ok_neighbours = 1;
+	int ok_life = 1;
+	int ok_count = 1;
+	int ok_next = 1;
+	int ok_rect = 1;
+	
+	Grid g;
+	Grid out;
+	u8 cells[GRID_CELLS];
+	u8 expected[GRID_CELLS];
+	
+	sim_srand(48);
+	
+	for (int b=0; b < BOARDS; ++b)
+	{
+		random_board(&g, cells, b % 100);
+		
+		for (u8 d=0; d < GRID_DIRECTIONS; ++d)
+		{
+			grid_shift(&out, &g, d);
+			loop_shift(expected, cells, d);
+			ok_shift &= same(&out, expected);
+		}
+		
+		for (u8 diagonals=0; diagonals < 2; ++diagonals)
+		{
+			grid_neighbours(&out, &g, diagonals);
+			loop_neighbours(expected, cells, diagonals);
+			ok_neighbours &= same(&out, expected);
+		}
+		
+		grid_life(&out, &g, &GRID_PADS);
+		loop_life(expected, cells);
+		ok_life &= same(&out, expected);
+		
+		// and in place
+		grid_copy(&out, &g);
+		grid_life(&out, &out, &GRID_PADS);
+		ok_life &= same(&out, expected);
+		
+		ok_count &= grid_count(&g) == loop_count(cells);
+		ok_count &= grid_any(&g) == (loop_count(cells) != 0);
+		
+		int visited = 0;
+		int last = -1;
+		
+		for (u8 i = grid_next(&g, 0); i != GRID_NONE; i = grid_next(&g, i + 1))
+		{
+			ok_next &= i > last && i < GRID_CELLS && cells[i];
+			last = i;
+			++visited;
+		}
+		ok_next &= visited == loop_count(cells);
+		
+		u8 r0 = sim_rand() % GRID_SIZE;
+		u8 c0 = sim_rand() % GRID_SIZE;
+		u8 r1 = sim_rand() % GRID_SIZE;
+		u8 c1 = sim_rand() % GRID_SIZE;
+		
+		grid_rect(&out, r0, c0, r1, c1);
+		
+		for (u8 i=0; i < GRID_CELLS; ++i)
+		{
+			u8 row = i / 10;
+			u8 column = i % 10;
+			
+			expected[i] = row >= (r0 < r1 ? r0 : r1) && row <= (r0 > r1 ? r0 : r1) &&
+				column >= (c0 < c1 ? c0 : c1) && column <= (c0 > c1 ? c0 : c1);
+		}
+		ok_rect &= same(&out, expected);
+	}
+	
+	// a glider on the pads comes back after four generations, a step along
+	// the diagonal
+	grid_clear(&g);
+	grid_set(&g, 82);
+	grid_set(&g, 73);
+	grid_set(&g, 61);
+	grid_set(&g, 62);
+	grid_set(&g, 63);
+	
+	for (int i=0; i < 4; ++i)
+	{
+		grid_life(&g, &g, &GRID_PADS);
+	}
+	grid_shift(&out, &g, GRID_NORTH_WEST);
+	
+	Grid start;
+	grid_clear(&start);
+	grid_set(&start, 82);
+	grid_set(&start, 73);
+	grid_set(&start, 61);
+	grid_set(&start, 62);
+	grid_set(&start, 63);
+	
+	grid_xor(&out, &out, &start);
+	ok_life &= !grid_any(&out);
+	
+	int ok = 1;
+	
+	ok &= check("shifts", ok_shift);
+	ok &= check("neighbours", ok_neighbours);
+	ok &= check("life", ok_life);
+	ok &= check("count", ok_count);
+	ok &= check("next", ok_next);
+	ok &= check("rect", ok_rect);
+	ok &= check("edges", grid_test(&g, 0xFF) == 0 && grid_next(&GRID_ALL, 100) == GRID_NONE);
+	
+	return ok;
+}
+
+// ____________________________________________________________________________
+
+static int compare_cycles(const void *a, const void *b)
+{
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+enum
+{
+	TIME_SHIFT,
+	TIME_NEIGHBOURS,
+	TIME_RIPPLE,
+	TIME_LIFE,
+	TIME_COUNT,
+	TIME_OPS
+};
+
+// so the counts aren't optimised away
+static volatile int g_Sink;
+
+static const char *TIME_NAMES[TIME_OPS] =
+{
+	"shift", "neighbours", "ripple x4", "life", "count"
+};
+
+// the median cycles for one operation on a random board, done either way
+static u64 timing(u8 op, u8 bitboard)
+{
+	static u64 cycles[RUNS];
+	static Grid g[2];
+	static u8 cells[2][GRID_CELLS];
+	
+	sim_srand(1000 + op);
+	random_board(&g[0], cells[0], 40);
+	
+	for (int i=0; i < RUNS; ++i)
+	{
+		Grid *in = &g[i & 1];
+		Grid *out = &g[~i & 1];
+		u8 *from = cells[i & 1];
+		u8 *to = cells[~i & 1];
+		
+		u64 c = sim_cycles();
+		
+		switch (op)
+		{
+			case TIME_SHIFT:
+				if (bitboard)
+				{
+					grid_shift(out, in, i & 7);
+				}
+				else
+				{
+					loop_shift(to, from, i & 7);
+				}
+				break;
+				
+			case TIME_NEIGHBOURS:
+				if (bitboard)
+				{
+					grid_neighbours(out, in, 1);
+				}
+				else
+				{
+					loop_neighbours(to, from, 1);
+				}
+				break;
+				
+			case TIME_RIPPLE:
+				// four rings spreading out from a pressed pad
+				if (bitboard)
+				{
+					grid_clear(out);
+					grid_set(out, 44 + (i & 3) * 11);
+					
+					for (int r=0; r < 4; ++r)
+					{
+						grid_neighbours(in, out, 1);
+						grid_or(out, out, in);
+					}
+				}
+				else
+				{
+					memset(to, 0, GRID_CELLS);
+					to[44 + (i & 3) * 11] = 1;
+					
+					for (int r=0; r < 4; ++r)
+					{
+						loop_neighbours(from, to, 1);
+						
+						for (int j=0; j < GRID_CELLS; ++j)
+						{
+							to[j] |= from[j];
+						}
+					}
+				}
+				break;
+				
+			case TIME_LIFE:
+				if (bitboard)
+				{
+					grid_life(out, in, &GRID_PADS);
+				}
+				else
+				{
+					loop_life(to, from);
+				}
+				break;
+				
+			default:
+				g_Sink = bitboard ? grid_count(in) : loop_count(from);
+				break;
+		}
+		
+		cycles[i] = sim_cycles() - c;
+		
+		// keep boards from dying out
+		if ((i & 63) == 63)
+		{
+			random_board(&g[0], cells[0], 40);
+			random_board(&g[1], cells[1], 40);
+		}
+	}
+	
+	qsort(cycles, RUNS, sizeof(u64), compare_cycles);
+	
+	return cycles[RUNS / 2];
+}
+
+int sim_grid(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = 0;
+	
+	failed |= !check_tables();
+	failed |= !check_boards();
+	
+	printf("grid: checks %s\n\n", failed ? "FAILED" : "ok");
+	printf("grid: operation   bitboard  per index  (median cycles)\n");
+	
+	for (u8 op=0; op < TIME_OPS; ++op)
+	{
+		u64 bits = timing(op, 1);
+		u64 loop = timing(op, 0);
+		
+		printf("grid: %-10s  %8llu  %9llu  %5.1fx\n", TIME_NAMES[op], bits, loop,
+			   bits ? (double)loop / bits : 0);
+	}
+	
+	return failed;
+}
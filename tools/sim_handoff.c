@@ -0,0 +1,316 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "boot.h"
+#include "layout.h"
+#include "pack7.h"
+#include "sysex.h"
+#include "transfer.h"
+
+// ____________________________________________________________________________
+//
+// State handoff workout.  On the unit the callbacks are interrupts, so a note
+// can arrive while the timer is part way through drawing the pads, and the
+// timer can go off while a SysEx load is part way through changing them.  The
+// LED hook plays both: MIDI notes land between the pads of a frame, and
+// timer ticks land in the middle of loading new pad states.  Events nest too,
+// so notes also land mid-load, followed by a tick before the load is done.
+//
+// A frame is torn if the pads playing one note (the fourths layout has up to
+// three) aren't all lit the same, or if the pad states aren't all from the
+// same load.  Also reports what a tick costs with and without a change to
+// hand off.
+// ____________________________________________________________________________
+
+#define TICKS			20000
+#define LOADS_EVERY		16
+#define TIMING_TICKS	200000
+
+// the most a handoff may add to a tick, on the host
+#define BUDGET_NS		1000.0
+
+static u16 raw_ADC[PAD_COUNT];
+
+// what's running, as the interrupts would nest
+static int g_InTick = 0;
+static int g_InEvent = 0;		// how deep
+
+// the pad states of the last two loads - a frame must show one or the other
+static u8 g_Loads[2][100];
+static int g_Load = 0;
+
+static int g_Frames = 0;
+static int g_Torn = 0;
+static int g_NotesInFrames = 0;
+static int g_TicksInLoads = 0;
+static int g_NotesInLoads = 0;
+
+// ____________________________________________________________________________
+
+static int is_grid_pad(u8 index)
+{
+	return index / 10 >= 1 && index / 10 <= 8 && index % 10 >= 1 && index % 10 <= 8;
+}
+
+static void check_frame()
+{
+	u8 r, g, b;
+	int torn = 0;
+	
+	// every pad of a note lit the same
+	for (int note=0; note < 128 && !torn; ++note)
+	{
+		u8 count;
+		const u8 *pads = layout_pads(note, &count);
+		u8 first = 0;
+		
+		for (u8 i=0; i < count; ++i)
+		{
+			hal_read_led(TYPEPAD, pads[i], &r, &g, &b);
+			
+			if (i == 0)
+			{
+				first = g;
+			}
+			else if (g != first)
+			{
+				torn = 1;
+			}
+		}
+	}
+	
+	// and the pad states all from one load
+	int matches[2] = { 1, 1 };
+	
+	for (u8 index=0; index < 100; ++index)
+	{
+		if (is_grid_pad(index))
+		{
+			hal_read_led(TYPEPAD, index, &r, &g, &b);
+			
+			for (int k=0; k < 2; ++k)
+			{
+				matches[k] &= b == g_Loads[(g_Load + k) & 1][index];
+			}
+		}
+	}
+	
+	if (torn || !(matches[0] || matches[1]))
+	{
+		if (++g_Torn <= 5)
+		{
+			printf("handoff: torn frame %d (%s)\n", g_Frames, torn ? "note" : "pad states");
+		}
+	}
+	
+	++g_Frames;
+}
+
+static void tick()
+{
+	g_InTick = 1;
+	app_timer_event();
+	g_InTick = 0;
+	
+	check_frame();
+}
+
+static void note()
+{
+	u32 r = sim_rand();
+	u8 status = r & 1 ? NOTEON : NOTEOFF;
+	
+	++g_InEvent;
+	app_midi_event(USBSTANDALONE, status, 36 + (r >> 8) % 64, 1 + (r >> 16) % 127);
+	--g_InEvent;
+}
+
+// new pad states, in one transfer DATA message (see transfer.h)
+static void load()
+{
+	u8 buttons[100];
+	u8 msg[SYSEX_MAX_SIZE];
+	
+	for (int i=0; i < 100; ++i)
+	{
+		buttons[i] = sim_rand() & 1 ? MAXLED : 0;
+	}
+	
+	u16 n = sysex_begin(msg, SYSEX_TRANSFER_DATA);
+	
+	msg[n++] = 0;
+	msg[n++] = 0;
+	msg[n++] = TRANSFER_FLAG_LAST;
+	msg[n++] = 0;
+	msg[n++] = 0;
+	msg[n++] = 0;
+	msg[n++] = 100;
+	
+	pack7(msg + n, buttons, 100);
+	n += PACK7_SIZE(100);
+	
+	u16 crc = transfer_crc(buttons, 100);
+	msg[n++] = crc >> 14;
+	msg[n++] = (crc >> 7) & 0x7F;
+	msg[n++] = crc & 0x7F;
+	msg[n++] = 0xF7;
+	
+	g_Load ^= 1;
+	memcpy(g_Loads[g_Load], buttons, 100);
+	
+	++g_InEvent;
+	app_sysex_event(USBSTANDALONE, msg, n);
+	--g_InEvent;
+}
+
+// the interrupts - a note while the timer draws, a tick while a load draws,
+// and a note while a load draws with a tick straight after, so the note's
+// change has finished but the load's hasn't
+static void on_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
+{
+	(void)type;
+	(void)index;
+	(void)red;
+	(void)green;
+	(void)blue;
+	
+	u32 r = sim_rand();
+	
+	if (g_InTick && !g_InEvent && (r & 15) == 0)
+	{
+		note();
+		++g_NotesInFrames;
+	}
+	else if (g_InEvent && !g_InTick && (r & 31) == 0)
+	{
+		tick();
+		++g_TicksInLoads;
+	}
+	else if (g_InEvent && !g_InTick && (r & 31) == 1)
+	{
+		note();
+		tick();
+		++g_NotesInLoads;
+	}
+}
+
+// ____________________________________________________________________________
+
+static double time_ticks(u8 status)
+{
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TIMING_TICKS; ++i)
+	{
+		app_midi_event(USBSTANDALONE, status, 36 + (i & 63), 100);
+		app_timer_event();
+	}
+	
+	return (sim_now_ns() - start) / TIMING_TICKS;
+}
+
+int sim_handoff(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	sim_set_quiet(1);
+	sim_srand(1);
+	
+	app_init(raw_ADC);
+	layout_set(LAYOUT_FOURTHS, 36, LAYOUT_SCALE_MAJOR);
+	
+	// let it start up, so it doesn't read the pad states from flash over ours
+	while (!boot_ready())
+	{
+		app_timer_event();
+	}
+	
+	// the first load, and a frame showing it, before anything can interrupt
+	load();
+	memcpy(g_Loads[g_Load ^ 1], g_Loads[g_Load], 100);
+	tick();
+	
+	sim_set_led_hook(on_led);
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		if (i % LOADS_EVERY == 0)
+		{
+			load();
+		}
+		
+		tick();
+	}
+	
+	sim_set_led_hook(0);
+	
+	printf("handoff: %d frames, %d notes arrived mid-frame, %d ticks and %d notes then ticks arrived mid-load, %d torn frames\n",
+		   g_Frames, g_NotesInFrames, g_TicksInLoads, g_NotesInLoads, g_Torn);
+	
+	// a note off every time changes what's drawn, a control change doesn't -
+	// the difference is the note's handling and its handoff, best of a few
+	double with = 1e30, without = 1e30;
+	
+	for (int run=0; run < 5; ++run)
+	{
+		double ns = time_ticks(NOTEOFF);
+		with = ns < with ? ns : with;
+		
+		ns = time_ticks(CC);
+		without = ns < without ? ns : without;
+	}
+	
+	double cost = with - without;
+	
+	printf("handoff: %.0f ns per tick with a change to hand off, %.0f ns without - at most %.0f ns for the handoff (budget %.0f)\n",
+		   with, without, cost, BUDGET_NS);
+	
+	if (g_Torn || !g_NotesInFrames || !g_TicksInLoads || !g_NotesInLoads)
+	{
+		printf("handoff: FAILED\n");
+		return 1;
+	}
+	
+	if (cost > BUDGET_NS)
+	{
+		printf("handoff: FAILED - over budget\n");
+		return 1;
+	}
+	
+	return 0;
+}
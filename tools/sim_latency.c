@@ -0,0 +1,488 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "arp.h"
+#include "layout.h"
+#include "velocity.h"
+
+// ____________________________________________________________________________
+//
+// End to end latency workout.  Plays the whole app with a stream of pad
+// strikes (as raw ADC frames), pressure, edge buttons and incoming MIDI, on a
+// simulated 1 ms timeline.  Every input is tagged with the output it should
+// cause and when it happened; outputs are timestamped as they reach
+// hal_send_midi and matched to the oldest waiting tag, however long the app
+// held on to them.
+//
+// Prints a latency histogram for each kind of input and output port, and
+// fails if anything never came out, or if a p99 goes over the threshold
+// given (in ms) on the command line, e.g. "simulator latency 5".
+// ____________________________________________________________________________
+
+#define RUN_MS			60000
+#define DRAIN_MS		500
+#define ARP_ON_HOLD		600
+
+#define MAX_TAGS		1024
+
+// histogram resolution, and range
+#define BINS_PER_MS		10
+#define MAX_MS			1000
+#define BINS			(MAX_MS * BINS_PER_MS + 1)
+
+// kinds of input
+#define PAD_ON			0
+#define PAD_OFF			1
+#define PRESSURE		2
+#define BUTTON			3
+#define THRU			4
+#define ARP_ON			5
+#define KINDS			6
+
+static const char *KIND_NAMES[KINDS] =
+{
+	"pad strike", "pad release", "pressure", "button", "MIDI thru", "pad, arp on"
+};
+
+// the arpeggiator's wait for the next step is the music, not a delay, so it
+// doesn't count against the threshold
+static const u8 THRESHOLD[KINDS] = { 1, 1, 1, 1, 1, 0 };
+
+static const char *PORT_NAMES[3] = { "standalone", "USB MIDI", "DIN" };
+
+// an input waiting for its output
+typedef struct
+{
+	double time;
+	u8 kind;
+	u8 port;
+	u8 status;
+	u8 d1;
+} Tag;
+
+static Tag g_Tags[MAX_TAGS];
+static int g_TagCount = 0;
+static int g_Dropped = 0;
+
+static u32 g_Histogram[KINDS][3][BINS];
+static u32 g_Count[KINDS][3];
+
+// now, in ms
+static double g_Now = 0;
+
+static u16 raw_ADC[PAD_COUNT];
+
+//______________________________________________________________________________
+
+// note on with velocity 0 is note off
+static u8 normalise(u8 status, u8 d2)
+{
+	return (status & 0xF0) == NOTEON && d2 == 0 ? NOTEOFF | (status & 0x0F) : status;
+}
+
+static void tag(u8 kind, u8 port, u8 status, u8 d1, u8 d2)
+{
+	if (g_TagCount == MAX_TAGS)
+	{
+		++g_Dropped;
+		return;
+	}
+	
+	Tag t = { g_Now, kind, port, normalise(status, d2), d1 };
+	g_Tags[g_TagCount++] = t;
+}
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	status = normalise(status, d2);
+	
+	// tags are kept oldest first
+	for (int i=0; i < g_TagCount; ++i)
+	{
+		Tag *t = &g_Tags[i];
+		
+		if (t->port == port && t->status == status && t->d1 == d1)
+		{
+			double ms = g_Now - t->time;
+			int bin = (int)(ms * BINS_PER_MS + 0.5);
+			
+			++g_Histogram[t->kind][port][bin < BINS ? bin : BINS - 1];
+			++g_Count[t->kind][port];
+			
+			--g_TagCount;
+			for (int j=i; j < g_TagCount; ++j)
+			{
+				g_Tags[j] = g_Tags[j + 1];
+			}
+			return;
+		}
+	}
+}
+
+// ms at or below which a fraction of the outputs came
+static double percentile(const u32 *histogram, u32 count, double fraction)
+{
+	u32 total = 0;
+	
+	for (int bin=0; bin < BINS; ++bin)
+	{
+		total += histogram[bin];
+		
+		if (total >= fraction * count)
+		{
+			return (double)bin / BINS_PER_MS;
+		}
+	}
+	
+	return MAX_MS;
+}
+
+//______________________________________________________________________________
+//
+// Pad strikes, as raw ADC frames - a short rise, a hold, and a release.
+//______________________________________________________________________________
+
+typedef struct
+{
+	int start;		// ms, or -1 if idle
+	u16 peak;
+	u8 rise;
+	u16 hold;
+	u8 fall;
+	u8 down;		// onset has been tagged
+	u8 kind;
+} Strike;
+
+static Strike g_Strikes[PAD_COUNT];
+
+static u16 envelope(const Strike *s, int t)
+{
+	if (t < s->rise)
+	{
+		return s->peak * (t + 1) / s->rise;
+	}
+	
+	t -= s->rise;
+	if (t < s->hold)
+	{
+		return s->peak;
+	}
+	
+	t -= s->hold;
+	if (t < s->fall)
+	{
+		return s->peak * (s->fall - t - 1) / s->fall;
+	}
+	
+	return 0;
+}
+
+static void start_strike(u8 kind, u16 hold)
+{
+	int i = sim_rand() % PAD_COUNT;
+	Strike *s = &g_Strikes[i];
+	
+	if (s->start >= 0)
+	{
+		return;
+	}
+	
+	s->start = (int)g_Now;
+	s->peak = 200 + sim_rand() % 3800;
+	s->rise = 1 + sim_rand() % 4;
+	s->hold = hold + sim_rand() % hold;
+	s->fall = 1 + sim_rand() % 3;
+	s->down = 0;
+	s->kind = kind;
+}
+
+// the next ADC frame, tagging the notes it should start and stop
+static void scan_strikes()
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		Strike *s = &g_Strikes[i];
+		
+		if (s->start < 0)
+		{
+			continue;
+		}
+		
+		int t = (int)g_Now - s->start;
+		raw_ADC[i] = envelope(s, t);
+		
+		u8 note = layout_note(ADC_MAP[i]);
+		
+		if (!s->down && raw_ADC[i] >= VELOCITY_ONSET)
+		{
+			s->down = 1;
+			tag(s->kind, DINMIDI, NOTEON, note, 1);
+		}
+		else if (s->down && raw_ADC[i] < VELOCITY_RELEASE)
+		{
+			if (s->kind == PAD_ON)
+			{
+				tag(PAD_OFF, DINMIDI, NOTEOFF, note, 0);
+			}
+			s->down = 0;
+		}
+		
+		// rest a little before the pad can be struck again
+		if (t > s->rise + s->hold + s->fall + 20)
+		{
+			s->start = -1;
+		}
+	}
+}
+
+//______________________________________________________________________________
+
+// edge buttons whose MIDI can't be mistaken for a pad's
+static u8 g_Buttons[36];
+static u8 g_ButtonCount = 0;
+
+static void find_buttons()
+{
+	u8 played[128] = {0};
+	
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		u8 note = layout_note(ADC_MAP[i]);
+		
+		if (note != LAYOUT_NO_NOTE)
+		{
+			played[note] = 1;
+		}
+	}
+	
+	for (u8 index=0; index < 100; ++index)
+	{
+		u8 row = index / 10;
+		u8 col = index % 10;
+		u8 edge = row == 0 || row == 9 || col == 0 || col == 9;
+		u8 corner = (row == 0 || row == 9) && (col == 0 || col == 9);
+		
+		if (edge && !corner && !played[index])
+		{
+			g_Buttons[g_ButtonCount++] = index;
+		}
+	}
+}
+
+// inputs that come in between ticks, through the app_*_event callbacks
+static void callbacks(int inputs)
+{
+	for (int k=0; k < inputs; ++k)
+	{
+		switch (sim_rand() % 3)
+		{
+			case 0:
+			{
+				// pressure on a grid pad goes out as poly aftertouch
+				u8 index = ADC_MAP[sim_rand() % PAD_COUNT];
+				u8 value = sim_rand() % 128;
+				
+				tag(PRESSURE, USBMIDI, POLYAFTERTOUCH, index, value);
+				app_aftertouch_event(index, value);
+			}
+			break;
+				
+			case 1:
+			{
+				// an edge button
+				u8 index = g_Buttons[sim_rand() % g_ButtonCount];
+				u8 value = sim_rand() % 2 ? 1 + sim_rand() % 127 : 0;
+				
+				tag(BUTTON, DINMIDI, NOTEON, index, value);
+				app_surface_event(TYPEPAD, index, value);
+			}
+			break;
+				
+			case 2:
+			{
+				// CCs on channels the pads don't use, USB <-> DIN
+				u8 in = sim_rand() % 2 ? USBMIDI : DINMIDI;
+				u8 out = in == USBMIDI ? DINMIDI : USBMIDI;
+				u8 status = CC | (1 + sim_rand() % 15);
+				u8 cc = sim_rand() % 128;
+				
+				tag(THRU, out, status, cc, 0);
+				app_midi_event(in, status, cc, sim_rand() % 128);
+			}
+			break;
+		}
+		
+		g_Now += 1.0 / (inputs + 1);
+	}
+}
+
+// one ms of the timeline, with an ADC frame and tick at the start
+static void step(int inputs, int strike_every, u8 kind, u16 hold)
+{
+	double tick = g_Now;
+	
+	if (strike_every && sim_rand() % strike_every == 0)
+	{
+		start_strike(kind, hold);
+	}
+	
+	scan_strikes();
+	app_timer_event();
+	
+	g_Now = tick + (double)(sim_rand() % 100) / 1000;
+	callbacks(inputs);
+	
+	g_Now = tick + 1;
+}
+
+//______________________________________________________________________________
+
+static void print_row(const char *kind, u8 port, const u32 *histogram, u32 count)
+{
+	static const char SHADES[] = " .:-=+*#%@";
+	
+	// one character per ms, up to 16 ms, darker for more
+	char bars[18] = {0};
+	u32 ms[17] = {0};
+	u32 most = 1;
+	
+	for (int bin=0; bin < BINS; ++bin)
+	{
+		int m = bin / BINS_PER_MS;
+		ms[m < 16 ? m : 16] += histogram[bin];
+	}
+	
+	for (int m=0; m < 17; ++m)
+	{
+		most = ms[m] > most ? ms[m] : most;
+	}
+	
+	for (int m=0; m < 17; ++m)
+	{
+		bars[m] = SHADES[ms[m] ? 1 + (ms[m] * 8) / most : 0];
+	}
+	
+	printf("%-12s %-10s %7d %6.1f %6.1f %6.1f %6.1f  |%s|\n",
+		kind, PORT_NAMES[port], (int)count,
+		percentile(histogram, count, 0.5), percentile(histogram, count, 0.9),
+		percentile(histogram, count, 0.99), percentile(histogram, count, 1.0), bars);
+}
+
+int sim_latency(int argc, char *argv[])
+{
+	double threshold = argc > 0 ? atof(argv[0]) : 0;
+	
+	sim_set_quiet(1);
+	sim_set_midi_hook(on_midi);
+	sim_srand(1);
+	
+	app_init(raw_ADC);
+	
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		g_Strikes[i].start = -1;
+	}
+	
+	find_buttons();
+	
+	// busy playing, with the arpeggiator off...
+	for (int ms=0; ms < RUN_MS; ++ms)
+	{
+		step(sim_rand() % 4, 8, PAD_ON, 10);
+	}
+	
+	for (int ms=0; ms < DRAIN_MS; ++ms)
+	{
+		step(0, 0, 0, 0);
+	}
+	
+	// ...then on, stepping every 125 ms.  The latency is the wait for the
+	// arpeggiator to reach the note, so hold notes long enough to get there.
+	arp_set_mode(ARP_UP, 1, 125, 60);
+	
+	for (int ms=0; ms < RUN_MS; ++ms)
+	{
+		step(0, 400, ARP_ON, ARP_ON_HOLD);
+	}
+	
+	for (int ms=0; ms < 2 * ARP_ON_HOLD; ++ms)
+	{
+		step(0, 0, 0, 0);
+	}
+	
+	sim_set_midi_hook(0);
+	sim_set_quiet(0);
+	
+	printf("input        output       count    p50    p90    p99    max  |0 ms .. 16+ ms  |\n");
+	
+	int failed = 0;
+	
+	for (u8 kind=0; kind < KINDS; ++kind)
+	{
+		for (u8 port=0; port < 3; ++port)
+		{
+			if (!g_Count[kind][port])
+			{
+				continue;
+			}
+			
+			print_row(KIND_NAMES[kind], port, g_Histogram[kind][port], g_Count[kind][port]);
+			
+			double p99 = percentile(g_Histogram[kind][port], g_Count[kind][port], 0.99);
+			
+			if (threshold > 0 && THRESHOLD[kind] && p99 > threshold)
+			{
+				printf("latency: %s to %s p99 %.1f ms is over %.1f ms\n", KIND_NAMES[kind], PORT_NAMES[port], p99, threshold);
+				failed = 1;
+			}
+		}
+	}
+	
+	if (g_TagCount || g_Dropped)
+	{
+		printf("latency: %d inputs never came out\n", g_TagCount + g_Dropped);
+		
+		for (int i=0; i < g_TagCount && i < 8; ++i)
+		{
+			printf("  %s at %.1f ms: %d 0x%2.2x %d\n", KIND_NAMES[g_Tags[i].kind], g_Tags[i].time, g_Tags[i].port, g_Tags[i].status, g_Tags[i].d1);
+		}
+		failed = 1;
+	}
+	
+	printf("latency: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
@@ -0,0 +1,300 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "layout.h"
+
+// ____________________________________________________________________________
+//
+// Layout workout.  For each layout, checks that the pad -> note and note ->
+// pads tables agree with each other, then times a rebuild and the per-event
+// lookups in both directions, against finding the pads for a note by
+// searching the grid.  Also checks the app lets go of the note a pad started
+// when the layout changes while it's held.
+// ____________________________________________________________________________
+
+#define EVENTS			1000000
+#define REBUILDS		10000
+
+typedef struct
+{
+	const char *name;
+	u8 layout;
+	u8 root;
+	u16 scale;
+} LayoutCase;
+
+static const LayoutCase CASES[] =
+{
+	{ "chromatic", LAYOUT_CHROMATIC, 36, 0 },
+	{ "fourths", LAYOUT_FOURTHS, 36, 0 },
+	{ "major", LAYOUT_SCALE, 48, LAYOUT_SCALE_MAJOR },
+	{ "min pent", LAYOUT_SCALE, 45, LAYOUT_SCALE_MINOR_PENTATONIC },
+	{ "drum", LAYOUT_DRUM, 36, 0 },
+	{ "high", LAYOUT_FOURTHS, 100, 0 },
+};
+
+static int check(const LayoutCase *c)
+{
+	int pads = 0;
+	
+	for (u8 index=0; index < 100; ++index)
+	{
+		u8 note = layout_note(index);
+		
+		if (note == LAYOUT_NO_NOTE)
+		{
+			continue;
+		}
+		
+		++pads;
+		
+		if (c->layout == LAYOUT_SCALE && !(c->scale & (1 << ((note + 12 - c->root % 12) % 12))))
+		{
+			printf("layout: %s pad %d plays %d, not in the scale\n", c->name, index, note);
+			return 0;
+		}
+		
+		u8 count;
+		const u8 *list = layout_pads(note, &count);
+		int found = 0;
+		
+		for (u8 i=0; i < count; ++i)
+		{
+			found |= list[i] == index;
+		}
+		
+		if (!found)
+		{
+			printf("layout: %s pad %d missing from note %d\n", c->name, index, note);
+			return 0;
+		}
+	}
+	
+	int listed = 0;
+	
+	for (int note=0; note < 128; ++note)
+	{
+		u8 count;
+		const u8 *list = layout_pads(note, &count);
+		
+		for (u8 i=0; i < count; ++i)
+		{
+			if (layout_note(list[i]) != note)
+			{
+				printf("layout: %s note %d lists pad %d, which plays %d\n", c->name, note, list[i], layout_note(list[i]));
+				return 0;
+			}
+		}
+		listed += count;
+	}
+	
+	if (listed != pads)
+	{
+		printf("layout: %s has %d pads with notes but lists %d\n", c->name, pads, listed);
+		return 0;
+	}
+	
+	return 1;
+}
+
+// notes sounding on DIN, and whether any came on
+static int g_Sounding[128];
+static int g_Played = 0;
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	u8 type = status & 0xF0;
+	
+	if (port == DINMIDI && (type == NOTEON || type == NOTEOFF))
+	{
+		u8 on = type == NOTEON && d2;
+		
+		g_Sounding[d1] += on ? 1 : -1;
+		g_Played |= on;
+	}
+}
+
+// hold a pad, change the layout under it - so it plays another note, or none
+// - and let go
+static int check_held(u8 layout, u8 root, u8 none)
+{
+	static u16 adc[PAD_COUNT];
+	int pad = 0;
+	
+	// a pad that plays nothing in the new layout, if that's the case wanted
+	layout_set(layout, root, 0);
+	
+	while (none && pad < PAD_COUNT - 1 && layout_note(ADC_MAP[pad]) != LAYOUT_NO_NOTE)
+	{
+		++pad;
+	}
+	
+	memset(adc, 0, sizeof(adc));
+	memset(g_Sounding, 0, sizeof(g_Sounding));
+	g_Played = 0;
+	
+	sim_set_quiet(1);
+	sim_set_midi_hook(on_midi);
+	
+	app_init(adc);
+	layout_set(LAYOUT_CHROMATIC, 36, 0);
+	
+	for (int tick=0; tick < 50; ++tick)
+	{
+		adc[pad] = 3000;
+		app_timer_event();
+	}
+	
+	layout_set(layout, root, 0);
+	
+	for (int tick=0; tick < 50; ++tick)
+	{
+		adc[pad] = 0;
+		app_timer_event();
+	}
+	
+	sim_set_midi_hook(0);
+	sim_set_quiet(0);
+	
+	int ok = g_Played;
+	
+	for (int note=0; note < 128; ++note)
+	{
+		ok &= g_Sounding[note] == 0;
+	}
+	
+	if (!ok)
+	{
+		printf("layout: a pad held while the layout changed %s\n", g_Played ? "left its note on" : "didn't play");
+	}
+	return ok;
+}
+
+// ____________________________________________________________________________
+
+int sim_layout(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	static u8 indices[EVENTS];
+	static u8 notes[EVENTS];
+	int failed = 0;
+	
+	sim_srand(1);
+	
+	for (int i=0; i < EVENTS; ++i)
+	{
+		indices[i] = (1 + sim_rand() % 8) * 10 + 1 + sim_rand() % 8;
+		notes[i] = sim_rand() % 128;
+	}
+	
+	printf("layout: name       pads  rebuild ns  pad->note ns  note->pads ns  search ns\n");
+	
+	for (size_t c=0; c < sizeof(CASES) / sizeof(CASES[0]); ++c)
+	{
+		const LayoutCase *lc = &CASES[c];
+		u32 sink = 0;
+		
+		double start = sim_now_ns();
+		for (int i=0; i < REBUILDS; ++i)
+		{
+			layout_set(lc->layout, lc->root, lc->scale);
+		}
+		double rebuild = (sim_now_ns() - start) / REBUILDS;
+		
+		if (!check(lc))
+		{
+			failed = 1;
+			continue;
+		}
+		
+		int pads = 0;
+		for (u8 index=0; index < 100; ++index)
+		{
+			pads += layout_note(index) != LAYOUT_NO_NOTE;
+		}
+		
+		start = sim_now_ns();
+		for (int i=0; i < EVENTS; ++i)
+		{
+			sink += layout_note(indices[i]);
+		}
+		double to_note = (sim_now_ns() - start) / EVENTS;
+		
+		start = sim_now_ns();
+		for (int i=0; i < EVENTS; ++i)
+		{
+			u8 count;
+			const u8 *list = layout_pads(notes[i], &count);
+			
+			for (u8 k=0; k < count; ++k)
+			{
+				sink += list[k];
+			}
+		}
+		double to_pads = (sim_now_ns() - start) / EVENTS;
+		
+		// what it would cost without the reverse table
+		start = sim_now_ns();
+		for (int i=0; i < EVENTS; ++i)
+		{
+			for (u8 row=1; row <= 8; ++row)
+			{
+				for (u8 col=1; col <= 8; ++col)
+				{
+					if (layout_note(row * 10 + col) == notes[i])
+					{
+						sink += row * 10 + col;
+					}
+				}
+			}
+		}
+		double search = (sim_now_ns() - start) / EVENTS;
+		
+		printf("layout: %-9s  %4d  %10.0f  %12.1f  %13.1f  %9.1f (%d)\n",
+			   lc->name, pads, rebuild, to_note, to_pads, search, (int)(sink & 1));
+	}
+	
+	// another root moves the note, and fourths from a high root run off the
+	// top of the note range
+	failed |= !check_held(LAYOUT_CHROMATIC, 48, 0);
+	failed |= !check_held(LAYOUT_FOURTHS, 100, 1);
+	
+	printf("layout: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
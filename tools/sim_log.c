@@ -0,0 +1,251 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simlog.h"
+#include "simulator.h"
+
+// ____________________________________________________________________________
+//
+// Soak run of the logging.  Plays the same few hundred thousand ticks of pad
+// presses and MIDI with the full log written as text, as binary records and
+// not at all, each on a fresh thread so from power up (see instance.h).  The
+// binary log is then decoded and has to match the text one byte for byte.
+// ____________________________________________________________________________
+
+#define DEFAULT_TICKS 200000
+#define RUNS 5
+
+typedef struct
+{
+	FILE *file;
+	int binary;
+	int ticks;
+	double ns;
+} Soak;
+
+static void *soak(void *arg)
+{
+	Soak *s = (Soak*)arg;
+	
+	sim_srand(1);
+	
+	double start = sim_now_ns();
+	
+	sim_app_init();
+	
+	for (int tick=0; tick < s->ticks; ++tick)
+	{
+		u32 r = sim_rand();
+		
+		switch (r & 3)
+		{
+			case 0:
+				sim_app_surface_event(TYPEPAD, 11 + (r >> 8) % 8 * 10 + (r >> 12) % 8, (r >> 16) & 0x7F);
+				break;
+				
+			case 1:
+				sim_app_midi_event(USBSTANDALONE, NOTEON, (r >> 8) & 0x7F, (r >> 16) & 0x7F);
+				break;
+		}
+		
+		sim_app_timer_event();
+	}
+	
+	sim_log_flush();
+	s->ns = sim_now_ns() - start;
+	
+	return 0;
+}
+
+static double run(FILE *file, int binary, int level, int ticks)
+{
+	Soak s = { file, binary, ticks, 0 };
+	pthread_t thread;
+	
+	sim_set_log_level(level);
+	sim_set_log_file(file, binary);
+	
+	pthread_create(&thread, 0, soak, &s);
+	pthread_join(thread, 0);
+	
+	sim_set_log_file(0, 0);
+	
+	if (file)
+	{
+		fflush(file);
+	}
+	
+	return s.ns;
+}
+
+// decode a binary log into text
+static int decode(FILE *in, FILE *out)
+{
+	SimLogHeader header;
+	SimLogRecord record;
+	
+	rewind(in);
+	
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, SIMLOG_MAGIC, 4) != 0)
+	{
+		return 0;
+	}
+	
+	while (fread(&record, sizeof(record), 1, in) == 1)
+	{
+		simlog_print(out, &record);
+	}
+	
+	return 1;
+}
+
+static long same_files(FILE *a, FILE *b)
+{
+	rewind(a);
+	rewind(b);
+	
+	long offset = 0;
+	int ca, cb;
+	
+	do
+	{
+		ca = getc(a);
+		cb = getc(b);
+		++offset;
+	}
+	while (ca == cb && ca != EOF);
+	
+	return ca == cb ? -1 : offset - 1;
+}
+
+int sim_log(int argc, char *argv[])
+{
+	int ticks = argc > 0 ? atoi(argv[0]) : DEFAULT_TICKS;
+	ticks = ticks > 0 ? ticks : DEFAULT_TICKS;
+	
+	FILE *text = 0;
+	FILE *binary = 0;
+	FILE *decoded = tmpfile();
+	double text_ns = 1e30, binary_ns = 1e30, quiet_ns = 1e30;
+	
+	// best of a few runs each, taking turns, as the host is noisy
+	for (int i=0; i < RUNS; ++i)
+	{
+		if (text)
+		{
+			fclose(text);
+			fclose(binary);
+		}
+		
+		text = tmpfile();
+		binary = tmpfile();
+		
+		if (!text || !binary || !decoded)
+		{
+			printf("log: can't make temporary files\n");
+			return 1;
+		}
+		
+		double ns = run(text, 0, SIM_LOG_ALL, ticks);
+		text_ns = ns < text_ns ? ns : text_ns;
+		
+		ns = run(binary, 1, SIM_LOG_ALL, ticks);
+		binary_ns = ns < binary_ns ? ns : binary_ns;
+		
+		ns = run(0, 0, SIM_LOG_NONE, ticks);
+		quiet_ns = ns < quiet_ns ? ns : quiet_ns;
+	}
+	
+	long text_bytes = ftell(text);
+	long binary_bytes = ftell(binary);
+	
+	sim_set_log_level(SIM_LOG_ALL);
+	
+	long records = (binary_bytes - (long)sizeof(SimLogHeader)) / (long)sizeof(SimLogRecord);
+	
+	printf("log: %d ticks, %ld log lines\n\n", ticks, records);
+	printf("  %-8s %10s %12s %14s\n", "log", "ms", "ns/line", "bytes");
+	printf("  %-8s %10.1f %12.1f %14ld\n", "text", text_ns * 1e-6, text_ns / records, text_bytes);
+	printf("  %-8s %10.1f %12.1f %14ld\n", "binary", binary_ns * 1e-6, binary_ns / records, binary_bytes);
+	printf("  %-8s %10.1f\n\n", "none", quiet_ns * 1e-6);
+	
+	// what the logging itself costs, taking away what the app costs
+	double text_cost = text_ns - quiet_ns;
+	double binary_cost = binary_ns - quiet_ns;
+	
+	// with the app dominating, the difference can be lost in the noise
+	if (binary_cost > 0)
+	{
+		printf("log: binary logging is %.1fx faster than text to a file (%.0fx on the logging alone)\n",
+			   text_ns / binary_ns, text_cost / binary_cost);
+	}
+	else
+	{
+		printf("log: binary logging is %.1fx faster than text to a file (the logging alone is unmeasurable)\n",
+			   text_ns / binary_ns);
+	}
+	
+	int failed = 0;
+	
+	if (!decode(binary, decoded))
+	{
+		printf("log: binary log has no header\n");
+		failed = 1;
+	}
+	else
+	{
+		fflush(decoded);
+		long offset = same_files(text, decoded);
+		
+		if (offset >= 0)
+		{
+			printf("log: decoded binary log differs from the text log at byte %ld\n", offset);
+			failed = 1;
+		}
+		else
+		{
+			printf("log: decoded binary log matches the text log\n");
+		}
+	}
+	
+	fclose(text);
+	fclose(binary);
+	fclose(decoded);
+	
+	return failed;
+}
@@ -0,0 +1,602 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "simlog.h"
+#include "arena.h"
+#include "looper.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// Pressure looper workout.  Takes the poly aftertouch the app sent, and when,
+// from a binary simulator log - one given on the command line ("simulator -v 2
+// -l run.bin ..." makes one), or else one it makes by playing the app a minute
+// of chords with swelling pressure.  Each few seconds of it is recorded as a
+// loop and played back twice, and has to come back the same.
+//
+// Reports the ring bytes used per second of playing against the raw 128K a
+// second of sampling every pad, then checks a take too big for the ring stops
+// cleanly, and times playback ticks against how much is moving.
+// ____________________________________________________________________________
+
+#define PLAY_MS			60000
+#define LOOP_MS			2000
+#define TICKS			100000
+
+// 64 pads, every ms, two bytes each
+#define RAW_PER_S		(PAD_COUNT * 1000 * 2)
+
+typedef struct
+{
+	u32 ms;
+	u8 index;
+	u8 value;
+} Press;
+
+static Press *g_Trace = 0;
+static int g_TraceCount = 0;
+static u32 g_TraceMs = 0;
+
+static Press *g_Played = 0;
+static int g_PlayedCount = 0;
+static int g_PlayedMost = 0;
+static u32 g_Now = 0;
+
+static void on_played(u8 index, u8 value)
+{
+	if (g_PlayedCount < g_PlayedMost)
+	{
+		Press p = { g_Now, index, value };
+		g_Played[g_PlayedCount] = p;
+	}
+	++g_PlayedCount;
+}
+
+static int same(const Press *a, const Press *b, int count)
+{
+	for (int i=0; i < count; ++i)
+	{
+		if (a[i].ms != b[i].ms || a[i].index != b[i].index || a[i].value != b[i].value)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static int check(const char *what, int ok)
+{
+	if (!ok)
+	{
+		printf("looper: %s - FAILED\n", what);
+	}
+	return ok;
+}
+
+//______________________________________________________________________________
+//
+// Making and reading a trace
+//______________________________________________________________________________
+
+typedef struct
+{
+	u8 index;
+	int start;
+	int attack;
+	int hold;
+	int release;
+	u8 peak;
+	u8 last;
+} Held;
+
+// pressure on a held pad - a swell, a wobble, and a fade
+static u8 pressure(const Held *h, int ms)
+{
+	int t = ms - h->start;
+	int level;
+	
+	if (t < h->attack)
+	{
+		level = h->peak * t / h->attack;
+	}
+	else if (t < h->attack + h->hold)
+	{
+		int wobble = (t / 12) % 16;
+		level = h->peak - 8 + (wobble < 8 ? wobble : 16 - wobble);
+	}
+	else
+	{
+		t -= h->attack + h->hold;
+		level = t < h->release ? (h->peak - 8) * (h->release - t) / h->release : 0;
+	}
+	
+	return level < 0 ? 0 : level > 127 ? 127 : level;
+}
+
+static void play_app(FILE *log)
+{
+	Held held[8];
+	int count = 0;
+	
+	sim_srand(50);
+	sim_set_log_level(SIM_LOG_ALL);
+	sim_set_log_file(log, 1);
+	
+	sim_app_init();
+	
+	for (int ms=0; ms < PLAY_MS; ++ms)
+	{
+		// a chord of one to three pads every 600ms, when hands are free
+		if (ms % 600 == 0 && count <= 5)
+		{
+			int notes = 1 + sim_rand() % 3;
+			
+			for (int n=0; n < notes; ++n)
+			{
+				Held h;
+				
+				h.index = ADC_MAP[sim_rand() % PAD_COUNT];
+				h.start = ms;
+				h.attack = 30 + sim_rand() % 300;
+				h.hold = 100 + sim_rand() % 600;
+				h.release = 20 + sim_rand() % 150;
+				h.peak = 40 + sim_rand() % 88;
+				h.last = 0;
+				
+				held[count++] = h;
+			}
+		}
+		
+		// the hardware sends pressure when it changes
+		for (int i=0; i < count; ++i)
+		{
+			Held *h = &held[i];
+			u8 value = pressure(h, ms);
+			
+			if (value != h->last)
+			{
+				app_aftertouch_event(h->index, value);
+				h->last = value;
+			}
+			
+			if (ms >= h->start + h->attack + h->hold + h->release)
+			{
+				held[i--] = held[--count];
+			}
+		}
+		
+		sim_app_timer_event();
+	}
+	
+	sim_log_flush();
+	sim_set_log_file(0, 0);
+	fflush(log);
+}
+
+// the poly aftertouch the app sent to USB, timed by its ticks
+static int read_trace(FILE *log)
+{
+	SimLogHeader header;
+	SimLogRecord record;
+	int most = 0;
+	
+	rewind(log);
+	
+	if (fread(&header, sizeof(header), 1, log) != 1 || memcmp(header.magic, SIMLOG_MAGIC, 4) != 0 ||
+		header.record_size != sizeof(SimLogRecord))
+	{
+		return 0;
+	}
+	
+	g_TraceCount = 0;
+	g_TraceMs = 0;
+	
+	while (fread(&record, sizeof(record), 1, log) == 1)
+	{
+		if (record.kind == SIMLOG_TIMER)
+		{
+			++g_TraceMs;
+		}
+		else if (record.kind == SIMLOG_SEND_MIDI && record.a == USBMIDI && (record.b & 0xF0) == POLYAFTERTOUCH)
+		{
+			if (g_TraceCount == most)
+			{
+				most = most ? most * 2 : 4096;
+				g_Trace = realloc(g_Trace, most * sizeof(Press));
+			}
+			
+			Press p = { g_TraceMs, record.c, record.x };
+			g_Trace[g_TraceCount++] = p;
+		}
+	}
+	
+	return 1;
+}
+
+//______________________________________________________________________________
+
+static void reset()
+{
+	arena_init();
+	looper_init(on_played);
+	
+	g_PlayedCount = 0;
+	g_Now = 0;
+}
+
+// record one loop of the trace from start, play it twice, and check it comes
+// back as it went in.  Returns the ring bytes it took.
+static int take(u32 start, u32 length, int *ok, int *dropped)
+{
+	static Press expected[LOOP_MS * 4];
+	static Press played[LOOP_MS * 4];
+	static u8 values[100];
+	
+	int count = 0;
+	int i = 0;
+	
+	while (i < g_TraceCount && g_Trace[i].ms < start)
+	{
+		++i;
+	}
+	
+	reset();
+	memset(values, 0, sizeof(values));
+	g_Played = played;
+	g_PlayedMost = LOOP_MS * 4;
+	
+	looper_record(length);
+	
+	for (g_Now=0; g_Now < length; ++g_Now)
+	{
+		for (; i < g_TraceCount && g_Trace[i].ms == start + g_Now; ++i)
+		{
+			Press p = g_Trace[i];
+			looper_pressure(p.index, p.value);
+			
+			// what should come back - only changes, from nothing
+			if (p.value != values[p.index] && count < LOOP_MS * 4)
+			{
+				p.ms = g_Now;
+				expected[count++] = p;
+				values[p.index] = p.value;
+			}
+		}
+		looper_tick();
+	}
+	
+	*dropped += looper_dropped();
+	
+	// and pads still pressed let go as it goes round
+	int changes = count;
+	
+	for (int pad=0; pad < PAD_COUNT && count < LOOP_MS * 4; ++pad)
+	{
+		if (values[ADC_MAP[pad]])
+		{
+			Press p = { length - 1, ADC_MAP[pad], 0 };
+			expected[count++] = p;
+		}
+	}
+	
+	for (int pass=0; pass < 2; ++pass)
+	{
+		g_PlayedCount = 0;
+		
+		for (g_Now=0; g_Now < length; ++g_Now)
+		{
+			looper_tick();
+		}
+		
+		// all of it, or as far as fitted, before letting go at the end
+		if (looper_dropped())
+		{
+			int kept = 0;
+			
+			while (kept < g_PlayedCount && played[kept].ms < length - 1)
+			{
+				++kept;
+			}
+			*ok &= kept < changes && same(played, expected, kept);
+		}
+		else
+		{
+			*ok &= g_PlayedCount == count && same(played, expected, count);
+		}
+	}
+	
+	*ok &= looper_state() == LOOPER_PLAY;
+	
+	return looper_used();
+}
+
+static int check_trace()
+{
+	int ok = 1;
+	int dropped = 0;
+	int bytes = 0;
+	int loops = 0;
+	u32 ms = 0;
+	
+	for (u32 start=0; start + LOOP_MS <= g_TraceMs; start += LOOP_MS)
+	{
+		bytes += take(start, LOOP_MS, &ok, &dropped);
+		ms += LOOP_MS;
+		++loops;
+	}
+	
+	double per_s = ms ? bytes * 1000.0 / ms : 0;
+	double events_per_s = g_TraceMs ? g_TraceCount * 1000.0 / g_TraceMs : 0;
+	
+	printf("looper: %d events in %.1f s of trace, %.0f a second\n", g_TraceCount, g_TraceMs / 1000.0, events_per_s);
+	printf("looper: %d loops of %d ms, %.0f bytes a second, %.2f an event - raw sampling is %d, %.0fx more\n",
+		   loops, LOOP_MS, per_s, events_per_s ? per_s / events_per_s : 0, RAW_PER_S, per_s ? RAW_PER_S / per_s : 0);
+	printf("looper: the %d byte ring holds %.1f s of this playing\n", LOOPER_RING_SIZE, per_s ? LOOPER_RING_SIZE / per_s : 0);
+	
+	ok &= check("loops play back as recorded", ok);
+	ok &= check("nothing dropped", dropped == 0);
+	
+	return ok;
+}
+
+// every pad jumping about every ms fills the ring in well under a second
+static int check_overflow()
+{
+	int ok = 1;
+	int dropped = 0;
+	
+	Press *trace = g_Trace;
+	int count = g_TraceCount;
+	
+	static Press busy[PAD_COUNT * 1000];
+	int n = 0;
+	
+	sim_srand(5);
+	
+	for (u32 ms=0; ms < 1000; ++ms)
+	{
+		for (int pad=0; pad < PAD_COUNT; ++pad)
+		{
+			Press p = { ms, ADC_MAP[pad], sim_rand() % 128 };
+			busy[n++] = p;
+		}
+	}
+	
+	g_Trace = busy;
+	g_TraceCount = n;
+	
+	take(0, 1000, &ok, &dropped);
+	
+	// half way round...
+	for (g_Now=0; g_Now < 500; ++g_Now)
+	{
+		looper_tick();
+	}
+	
+	g_Trace = trace;
+	g_TraceCount = count;
+	
+	ok &= check("a full ring plays what fitted", ok);
+	ok &= check("a full ring counts what didn't", dropped > 0 && looper_used() <= LOOPER_RING_SIZE);
+	
+	// ...stopping lets go of everything still pressed
+	g_PlayedCount = 0;
+	looper_stop();
+	
+	ok &= check("stopping lets go", g_PlayedCount > 0 && looper_state() == LOOPER_STOP);
+	
+	for (int i=0; i < g_PlayedCount && i < g_PlayedMost; ++i)
+	{
+		ok &= g_Played[i].value == 0;
+	}
+	
+	return ok;
+}
+
+// the app, recording and playing over SysEx
+static Press g_Sent[16];
+static int g_SentCount = 0;
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	if (port == USBMIDI && status == POLYAFTERTOUCH && g_SentCount < 16)
+	{
+		Press p = { g_Now, d1, d2 };
+		g_Sent[g_SentCount++] = p;
+	}
+}
+
+static void send_looper(u8 state, u32 length)
+{
+	u8 message[SYSEX_DATA + 5];
+	u16 n = sysex_begin(message, SYSEX_LOOPER);
+	
+	message[n++] = state;
+	message[n++] = length & 0x7F;
+	message[n++] = (length >> 7) & 0x7F;
+	message[n++] = (length >> 14) & 0x7F;
+	message[n++] = 0xF7;
+	
+	app_sysex_event(USBMIDI, message, n);
+}
+
+static int check_app()
+{
+	static u16 adc[PAD_COUNT];
+	
+	sim_set_midi_hook(on_midi);
+	app_init(adc);
+	
+	send_looper(LOOPER_RECORD, 100);
+	
+	for (g_Now=0; g_Now < 100; ++g_Now)
+	{
+		if (g_Now == 10)
+		{
+			app_aftertouch_event(44, 90);
+		}
+		else if (g_Now == 30)
+		{
+			app_aftertouch_event(44, 0);
+		}
+		app_timer_event();
+	}
+	
+	// round once, then stop part way through the second time with the pad held
+	g_SentCount = 0;
+	
+	for (g_Now=0; g_Now < 120; ++g_Now)
+	{
+		app_timer_event();
+	}
+	send_looper(LOOPER_STOP, 0);
+	
+	sim_set_midi_hook(0);
+	
+	int ok = g_SentCount == 4;
+	
+	ok &= g_Sent[0].ms == 10 && g_Sent[0].index == 44 && g_Sent[0].value == 90;
+	ok &= g_Sent[1].ms == 30 && g_Sent[1].index == 44 && g_Sent[1].value == 0;
+	ok &= g_Sent[2].ms == 110 && g_Sent[2].value == 90;
+	ok &= g_Sent[3].ms == 120 && g_Sent[3].value == 0;
+	
+	return check("the app records and plays over SysEx", ok && looper_state() == LOOPER_STOP);
+}
+
+//______________________________________________________________________________
+
+static int compare_cycles(const void *a, const void *b)
+{
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+// playback tick cost with pads pads sweeping up and down, each every step ms
+static void timing(int pads, int step)
+{
+	static u64 cycles[TICKS];
+	static u8 values[PAD_COUNT];
+	
+	reset();
+	memset(values, 0, sizeof(values));
+	g_PlayedMost = 0;
+	
+	// a second loop, as much of it as fits
+	looper_record(1000);
+	
+	for (g_Now=0; g_Now < 1000; ++g_Now)
+	{
+		for (int pad=0; pad < pads; ++pad)
+		{
+			if ((g_Now + pad) % step == 0)
+			{
+				values[pad] = (values[pad] + 1) & 0x7F;
+				looper_pressure(ADC_MAP[pad], values[pad]);
+			}
+		}
+		looper_tick();
+	}
+	
+	int events = 0;
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		int before = g_PlayedCount;
+		
+		u64 c = sim_cycles();
+		looper_tick();
+		cycles[i] = sim_cycles() - c;
+		
+		events += g_PlayedCount - before;
+	}
+	
+	double mean = (sim_now_ns() - start) / TICKS;
+	
+	qsort(cycles, TICKS, sizeof(u64), compare_cycles);
+	
+	printf("looper: %4d %5d  %6.2f  %6d  %7.1f  %7llu  %7llu\n", pads, step, (double)events / TICKS,
+		   looper_used(), mean, cycles[TICKS / 2], cycles[TICKS * 999 / 1000]);
+}
+
+int sim_looper(int argc, char *argv[])
+{
+	int failed = 0;
+	FILE *log = argc > 0 ? fopen(argv[0], "rb") : tmpfile();
+	
+	if (!log)
+	{
+		printf("looper: can't open %s\n", argc > 0 ? argv[0] : "a temporary file");
+		return 1;
+	}
+	
+	if (argc == 0)
+	{
+		play_app(log);
+	}
+	
+	if (!read_trace(log))
+	{
+		printf("looper: %s isn't a binary simulator log\n", argc > 0 ? argv[0] : "the log");
+		fclose(log);
+		return 1;
+	}
+	fclose(log);
+	
+	sim_set_quiet(1);
+	
+	failed |= !check_trace();
+	failed |= !check_overflow();
+	failed |= !check_app();
+	
+	printf("looper: checks %s\n\n", failed ? "FAILED" : "ok");
+	printf("looper: pads every  events/tick  bytes  mean ns   median    p99.9 (cycles)\n");
+	
+	timing(1, 10);
+	timing(4, 4);
+	timing(16, 4);
+	timing(64, 8);
+	timing(64, 1);
+	
+	sim_set_quiet(0);
+	free(g_Trace);
+	
+	return failed;
+}
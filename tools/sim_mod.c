@@ -0,0 +1,387 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "arena.h"
+#include "mod.h"
+
+// ____________________________________________________________________________
+//
+// Modulation generator workout.  Checks an LFO's period and range, that a CC
+// only goes out when its value changes, that generators sharing the DIN port
+// keep to its budget and each get their turn, that a CC held back by the
+// budget goes out with its latest value, and that envelopes and followers
+// take as long as their settings say.  Then times ticks against the number
+// of generators running.
+// ____________________________________________________________________________
+
+#define TICKS			200000
+
+typedef struct
+{
+	int sends;
+	int changes;		// sends that differ from the last one
+	int bytes;
+	u8 last;
+	int first_tick;		// of the last value sent
+} Output;
+
+static Output g_Out[MOD_GENERATORS];
+static int g_Tick = 0;
+static int g_PortBytes[3];
+
+// the CC number says which generator sent it
+static void on_cc(u8 port, u8 channel, u8 cc, u8 value)
+{
+	(void)channel;
+	
+	Output *o = &g_Out[cc % MOD_GENERATORS];
+	
+	o->changes += o->sends == 0 || value != o->last;
+	o->sends++;
+	o->last = value;
+	o->first_tick = g_Tick;
+	
+	g_PortBytes[port] += 3;
+}
+
+static void reset()
+{
+	arena_init();
+	mod_init(on_cc);
+	
+	memset(g_Out, 0, sizeof(g_Out));
+	memset(g_PortBytes, 0, sizeof(g_PortBytes));
+	g_Tick = 0;
+}
+
+static void run(int ticks)
+{
+	for (int i=0; i < ticks; ++i)
+	{
+		++g_Tick;
+		mod_tick();
+	}
+}
+
+static int check(const char *what, int ok)
+{
+	if (!ok)
+	{
+		printf("mod: %s - FAILED\n", what);
+	}
+	return ok;
+}
+
+// run until a generator sends a value, returning the ticks it took
+static int ticks_until(u8 g, u8 value, int most)
+{
+	int start = g_Tick;
+	
+	while (g_Tick - start < most)
+	{
+		run(1);
+		
+		if (g_Out[g].sends && g_Out[g].last == value)
+		{
+			return g_Tick - start;
+		}
+	}
+	return -1;
+}
+
+// ____________________________________________________________________________
+
+static int check_lfo()
+{
+	int ok = 1;
+	
+	reset();
+	mod_set_lfo(0, MOD_SINE, MOD_RATE_1HZ, 127, 64, USBMIDI, 0, 0);
+	
+	// time ten cycles by the ticks it crosses the middle going up
+	u8 lowest = 127;
+	u8 highest = 0;
+	u8 last = 64;
+	int crossings = 0;
+	int first = 0;
+	int latest = 0;
+	
+	while (crossings <= 10 && g_Tick < 20000)
+	{
+		run(1);
+		
+		u8 value = mod_sent(0);
+		
+		lowest = value < lowest ? value : lowest;
+		highest = value > highest ? value : highest;
+		
+		if (last < 64 && value >= 64)
+		{
+			first = crossings++ ? first : g_Tick;
+			latest = g_Tick;
+		}
+		last = value;
+	}
+	
+	double expected = 1000 / (0.02 * pow(2500, MOD_RATE_1HZ / 127.0));
+	double period = (latest - first) / 10.0;
+	
+	ok &= check("LFO range", lowest == 0 && highest == 127);
+	ok &= check("LFO period", fabs(period - expected) < expected / 100);
+	ok &= check("only changes sent", g_Out[0].changes == g_Out[0].sends);
+	
+	printf("mod: 1Hz sine period %.1f ticks, expected %.1f, %d CCs a cycle\n", period, expected,
+		   (int)(g_Out[0].sends * expected / g_Tick + 0.5));
+	
+	// with no depth there's one CC, then nothing
+	reset();
+	mod_set_lfo(1, MOD_SQUARE, 127, 0, 100, USBMIDI, 0, 1);
+	run(1000);
+	ok &= check("no depth, one CC", g_Out[1].sends == 1 && g_Out[1].last == 100);
+	
+	return ok;
+}
+
+static int check_budget()
+{
+	int ok = 1;
+	
+	// eight fast sine waves want to send a CC nearly every tick, far more
+	// than the DIN port's budget
+	reset();
+	
+	for (u8 g=0; g < 8; ++g)
+	{
+		mod_set_lfo(g, MOD_SINE, 100, 127, 64, DINMIDI, 0, g);
+	}
+	
+	const int ticks = 10000;
+	
+	run(ticks);
+	
+	int most = g_Out[0].sends;
+	int least = g_Out[0].sends;
+	
+	for (u8 g=1; g < 8; ++g)
+	{
+		most = g_Out[g].sends > most ? g_Out[g].sends : most;
+		least = g_Out[g].sends < least ? g_Out[g].sends : least;
+	}
+	
+	int allowed = MOD_BUDGET_DIN * ticks / 16;
+	
+	ok &= check("DIN budget", g_PortBytes[DINMIDI] <= allowed && g_PortBytes[DINMIDI] > allowed * 9 / 10);
+	ok &= check("round robin", least * 10 >= most * 9);
+	
+	printf("mod: 8 sine waves on DIN, %d bytes a second of %d allowed, %d to %d CCs each\n",
+		   g_PortBytes[DINMIDI] * 1000 / ticks, allowed * 1000 / ticks, least, most);
+	
+	// a follower held back by an empty budget sends its latest value once
+	// there's room again, and nothing in between - after using up what the
+	// port had saved
+	reset();
+	mod_set_follower(2, 0, 0, 127, 0, DINMIDI, 0, 2);
+	run(10);
+	mod_set_budget(DINMIDI, 0);
+	
+	for (u8 p=1; p <= 20; ++p)
+	{
+		mod_pressure(p);
+		run(5);
+	}
+	
+	int sends = g_Out[2].sends;
+	
+	for (u8 p=10; p <= 100; p += 10)
+	{
+		mod_pressure(p);
+		run(5);
+	}
+	
+	ok &= check("nothing sent without budget", g_Out[2].sends == sends);
+	
+	mod_set_budget(DINMIDI, MOD_BUDGET_DIN);
+	run(10);
+	ok &= check("latest value sent", g_Out[2].sends == sends + 1 && g_Out[2].last == 100);
+	
+	return ok;
+}
+
+static int check_envelope()
+{
+	int ok = 1;
+	
+	// instant attack, 100ms decay to half, 100ms release
+	reset();
+	mod_set_envelope(3, 0, MOD_TIME_100MS, 64, MOD_TIME_100MS, 127, 0, USBMIDI, 0, 3);
+	run(10);
+	ok &= check("envelope idle", g_Out[3].last == 0);
+	
+	double expected = pow(10000, MOD_TIME_100MS / 127.0);
+	
+	mod_note_on();
+	int attack = ticks_until(3, 127, 100);
+	int decay = ticks_until(3, 64, 1000);
+	
+	// a second note doesn't release when the first is let go
+	mod_note_on();
+	mod_note_off();
+	run(200);
+	ok &= check("sustain while held", g_Out[3].last == 64);
+	
+	mod_note_off();
+	int release = ticks_until(3, 0, 1000);
+	
+	ok &= check("attack", attack >= 1 && attack <= 2);
+	// the curve's exponential, so it's within a CC step of the end a little
+	// before the stage is over
+	ok &= check("decay", decay >= expected * 0.8 && decay <= expected + 2);
+	ok &= check("release", release >= expected * 0.8 && release <= expected + 2);
+	
+	printf("mod: envelope attack %d, decay %d, release %d ticks, expected %.1f\n", attack, decay, release, expected);
+	
+	// and a follower rising slowly, falling at once
+	reset();
+	mod_set_follower(4, MOD_TIME_100MS, 0, 127, 0, USBMIDI, 0, 4);
+	mod_pressure(127);
+	
+	int rise = ticks_until(4, 127, 1000);
+	
+	mod_pressure(0);
+	
+	int fall = ticks_until(4, 0, 100);
+	
+	ok &= check("follower rise", rise >= expected * 0.9 && rise <= expected + 2);
+	ok &= check("follower fall", fall >= 1 && fall <= 2);
+	
+	return ok;
+}
+
+// ____________________________________________________________________________
+
+static int compare_cycles(const void *a, const void *b)
+{
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+// per tick cost with n generators, a third each LFOs, envelopes and followers,
+// with a note held and the pressure moving so they're all changing
+static void timing(int n)
+{
+	static u64 cycles[TICKS];
+	
+	reset();
+	
+	for (u8 g=0; g < n; ++g)
+	{
+		switch (g % 3)
+		{
+			case 0:
+				mod_set_lfo(g, g % MOD_SHAPE_COUNT, 100, 127, 64, USBMIDI, 0, g);
+				break;
+				
+			case 1:
+				mod_set_envelope(g, 20, 40, 64, 40, 127, 0, USBMIDI, 0, g);
+				break;
+				
+			default:
+				mod_set_follower(g, 10, 20, 127, 0, USBMIDI, 0, g);
+				break;
+		}
+	}
+	
+	int sends = 0;
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		// a note every 100ms, held for 50
+		if (i % 100 == 0)
+		{
+			mod_note_on();
+		}
+		else if (i % 100 == 50)
+		{
+			mod_note_off();
+		}
+		mod_pressure(i & 0x7F);
+		
+		u64 c = sim_cycles();
+		mod_tick();
+		cycles[i] = sim_cycles() - c;
+	}
+	
+	double mean = (sim_now_ns() - start) / TICKS;
+	
+	for (u8 g=0; g < MOD_GENERATORS; ++g)
+	{
+		sends += g_Out[g].sends;
+	}
+	
+	qsort(cycles, TICKS, sizeof(u64), compare_cycles);
+	
+	printf("mod: %10d  %6.2f  %7.1f  %7llu  %7llu  %9.1f\n", n, (double)sends / TICKS, mean,
+		   cycles[TICKS / 2], cycles[TICKS * 999 / 1000], n ? (double)cycles[TICKS / 2] / n : 0);
+}
+
+int sim_mod(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = 0;
+	
+	failed |= !check_lfo();
+	failed |= !check_budget();
+	failed |= !check_envelope();
+	
+	printf("mod: checks %s\n\n", failed ? "FAILED" : "ok");
+	printf("mod: generators  CCs/tick  mean ns   median    p99.9  per generator (cycles)\n");
+	
+	timing(0);
+	timing(1);
+	timing(4);
+	timing(8);
+	timing(MOD_GENERATORS);
+	
+	return failed;
+}
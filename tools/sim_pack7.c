@@ -0,0 +1,233 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "pack7.h"
+
+// ____________________________________________________________________________
+//
+// 8-to-7 codec workout.  Checks pack7/unpack7 against the original byte at a
+// time eight_to_seven from tools/hextosyx.cpp: every value in every byte of a
+// group, every pair of neighbouring bytes, and random buffers of every length
+// up to the flash user area with guard bytes either side.  Then measures
+// throughput in GB/s of unpacked data.
+// ____________________________________________________________________________
+
+#define BENCH_SIZE		(1 << 20)
+#define BENCH_BYTES		(1UL << 30)
+#define GUARD			0xA5
+
+// the original, one group at a time
+static void eight_to_seven(u8 *out, const u8 *in)
+{
+	out[0] =                  in[0] >> 1;
+	out[1] = ((in[0] << 6) + (in[1] >> 2)) & 0x7F;
+	out[2] = ((in[1] << 5) + (in[2] >> 3)) & 0x7F;
+	out[3] = ((in[2] << 4) + (in[3] >> 4)) & 0x7F;
+	out[4] = ((in[3] << 3) + (in[4] >> 5)) & 0x7F;
+	out[5] = ((in[4] << 2) + (in[5] >> 6)) & 0x7F;
+	out[6] = ((in[5] << 1) + (in[6] >> 7)) & 0x7F;
+	out[7] =                  in[6] & 0x7F;
+}
+
+static int check_group(const u8 *in)
+{
+	u8 expected[8];
+	u8 packed[8];
+	u8 unpacked[7];
+	
+	eight_to_seven(expected, in);
+	pack7(packed, in, 7);
+	unpack7(unpacked, packed, 7);
+	
+	return memcmp(expected, packed, 8) == 0 && memcmp(in, unpacked, 7) == 0;
+}
+
+static int check_lengths(void)
+{
+	static u8 in[USER_AREA_SIZE];
+	static u8 expected[PACK7_SIZE(USER_AREA_SIZE)];
+	static u8 packed[PACK7_SIZE(USER_AREA_SIZE) + 2];
+	static u8 unpacked[USER_AREA_SIZE + 2];
+	
+	for (int length=0; length <= USER_AREA_SIZE; ++length)
+	{
+		for (int i=0; i < length; ++i)
+		{
+			in[i] = sim_rand();
+		}
+		
+		// reference, padding the last group with zeros
+		for (int i=0; i < length; i += 7)
+		{
+			u8 group[7] = {0};
+			memcpy(group, in + i, length - i < 7 ? length - i : 7);
+			eight_to_seven(expected + (i / 7) * 8, group);
+		}
+		
+		int size = PACK7_SIZE(length);
+		
+		memset(packed, GUARD, sizeof(packed));
+		memset(unpacked, GUARD, sizeof(unpacked));
+		
+		int written = pack7(packed + 1, in, length);
+		unpack7(unpacked + 1, packed + 1, length);
+		
+		if (written != size
+			|| memcmp(packed + 1, expected, size) != 0
+			|| memcmp(unpacked + 1, in, length) != 0
+			|| packed[0] != GUARD || packed[size + 1] != GUARD
+			|| unpacked[0] != GUARD || unpacked[length + 1] != GUARD)
+		{
+			printf("pack7: length %d fails\n", length);
+			return 0;
+		}
+		
+		for (int i=0; i < size; ++i)
+		{
+			if (packed[i + 1] & 0x80)
+			{
+				printf("pack7: length %d sets bit 7\n", length);
+				return 0;
+			}
+		}
+	}
+	
+	return 1;
+}
+
+// ____________________________________________________________________________
+
+int sim_pack7(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	u8 group[7];
+	int failed = 0;
+	
+	sim_srand(1);
+	
+	// every value of every byte, on a random background
+	for (int pos=0; pos < 7 && !failed; ++pos)
+	{
+		for (int v=0; v < 256; ++v)
+		{
+			for (int i=0; i < 7; ++i)
+			{
+				group[i] = sim_rand();
+			}
+			group[pos] = v;
+			
+			if (!check_group(group))
+			{
+				printf("pack7: byte %d value %d fails\n", pos, v);
+				failed = 1;
+				break;
+			}
+		}
+	}
+	
+	// every pair of neighbouring bytes, which covers every bit crossing a boundary
+	for (int pos=0; pos < 6 && !failed; ++pos)
+	{
+		memset(group, 0, sizeof(group));
+		
+		for (int v=0; v < 65536; ++v)
+		{
+			group[pos] = v >> 8;
+			group[pos + 1] = v;
+			
+			if (!check_group(group))
+			{
+				printf("pack7: bytes %d,%d value 0x%4.4x fails\n", pos, pos + 1, v);
+				failed = 1;
+				break;
+			}
+		}
+	}
+	
+	if (!failed && !check_lengths())
+	{
+		failed = 1;
+	}
+	
+	printf("pack7: round trip %s\n", failed ? "FAILED" : "ok");
+	
+	if (failed)
+	{
+		return 1;
+	}
+	
+	// throughput
+	u8 *in = malloc(BENCH_SIZE);
+	u8 *packed = malloc(PACK7_SIZE(BENCH_SIZE));
+	u8 *out = malloc(BENCH_SIZE);
+	
+	for (int i=0; i < BENCH_SIZE; ++i)
+	{
+		in[i] = sim_rand();
+	}
+	
+	const int passes = BENCH_BYTES / BENCH_SIZE;
+	u32 sink = 0;
+	
+	double start = sim_now_ns();
+	for (int p=0; p < passes; ++p)
+	{
+		pack7(packed, in, BENCH_SIZE);
+		sink += packed[p & 0xFF];
+	}
+	double pack = sim_now_ns() - start;
+	
+	start = sim_now_ns();
+	for (int p=0; p < passes; ++p)
+	{
+		unpack7(out, packed, BENCH_SIZE);
+		sink += out[p & 0xFF];
+	}
+	double unpack = sim_now_ns() - start;
+	
+	// bytes per ns is GB/s
+	printf("pack7: pack7 %.2f GB/s, unpack7 %.2f GB/s (%d)\n",
+		   BENCH_BYTES / pack, BENCH_BYTES / unpack, (int)(sink & 1));
+	
+	free(in);
+	free(packed);
+	free(out);
+	return 0;
+}
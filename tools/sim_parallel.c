@@ -0,0 +1,360 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "instance.h"
+#include "simulator.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// Parallel workout.  Runs many Launchpads at once, one per thread, each
+// replaying its own input trace - pad strikes as raw ADC frames, pressure,
+// buttons, MIDI and SysEx.  Every instance's output is hashed, and has to come
+// out the same whether it ran alone or alongside the others, which shows the
+// instances really are separate.
+//
+// Reports simulated ticks per second across all instances, and how that
+// scales from one thread up to the number asked for (by default, one per
+// core).
+// ____________________________________________________________________________
+
+#define TRACE_TICKS		10000
+#define MAX_EVENTS		(4 * TRACE_TICKS)
+#define DEFAULT_TICKS	200000
+
+// input events
+#define MIDI			0	// port status d1
+#define PRESSURE		1	// index value
+#define BUTTON			2	// index value
+#define STRIKE			3	// adc index, peak >> 4
+#define SYSEX			4	// message
+
+typedef struct
+{
+	u16 tick;
+	u8 kind;
+	u8 a;
+	u8 b;
+	u8 c;
+} Event;
+
+typedef struct
+{
+	// the trace, looped
+	Event events[MAX_EVENTS];
+	int count;
+	
+	// how long to run, and what came out
+	u32 ticks;
+	u32 digest;
+	
+	// pad strikes in progress
+	u16 adc[PAD_COUNT];
+	u16 peak[PAD_COUNT];
+	u8 age[PAD_COUNT];
+} Instance;
+
+static u8 ROUTE_MESSAGE[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_ROUTE, DINMIDI, DINMIDI, 0x7F, 1, 3, 0xF7 };
+static u8 TRACE_MESSAGE[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRACE, 0xF7 };
+
+// each thread's hash of everything its Launchpad sent
+static INSTANCE u32 g_Digest;
+
+static void hash(u32 x)
+{
+	// FNV-1a, a byte at a time
+	for (int i=0; i < 4; ++i)
+	{
+		g_Digest = ((g_Digest ^ ((x >> (8 * i)) & 0xFF)) * 16777619) & 0xFFFFFFFF;
+	}
+}
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	hash((port << 24) | (status << 16) | (d1 << 8) | d2);
+}
+
+static void on_sysex(u8 port, const u8 *data, u16 length)
+{
+	hash((port << 16) | length);
+	
+	for (u16 i=0; i < length; ++i)
+	{
+		hash(data[i]);
+	}
+}
+
+//______________________________________________________________________________
+
+static void make_trace(Instance *in, u32 seed)
+{
+	sim_srand(seed);
+	in->count = 0;
+	
+	for (u16 tick=0; tick < TRACE_TICKS && in->count < MAX_EVENTS - 4; ++tick)
+	{
+		u32 r = sim_rand();
+		
+		if ((r & 7) == 0)
+		{
+			Event e = { tick, STRIKE, (r >> 8) % PAD_COUNT, 16 + (r >> 16) % 240, 0 };
+			in->events[in->count++] = e;
+		}
+		
+		if ((r & 0x18) == 0)
+		{
+			Event e = { tick, MIDI, (r >> 5) & 1 ? USBMIDI : DINMIDI, NOTEON | ((r >> 6) & 15), (r >> 10) & 0x7F };
+			in->events[in->count++] = e;
+		}
+		
+		if ((r & 0x60) == 0)
+		{
+			Event e = { tick, PRESSURE, ADC_MAP[(r >> 12) % PAD_COUNT], (r >> 20) & 0x7F, 0 };
+			in->events[in->count++] = e;
+		}
+		
+		if ((r & 0x780) == 0)
+		{
+			Event e = { tick, BUTTON, 1 + (r >> 14) % 8, (r >> 24) & 1 ? 127 : 0, 0 };
+			in->events[in->count++] = e;
+		}
+		
+		if (tick % 2500 == 0)
+		{
+			Event e = { tick, SYSEX, (tick / 2500) & 1, 0, 0 };
+			in->events[in->count++] = e;
+		}
+	}
+}
+
+static void play(Instance *in, const Event *e)
+{
+	switch (e->kind)
+	{
+		case MIDI:
+			app_midi_event(e->a, e->b, e->c, 0x40);
+			break;
+			
+		case PRESSURE:
+			app_aftertouch_event(e->a, e->b);
+			break;
+			
+		case BUTTON:
+			app_surface_event(TYPEPAD, e->a, e->b);
+			break;
+			
+		case STRIKE:
+			in->peak[e->a] = e->b << 4;
+			in->age[e->a] = 0;
+			break;
+			
+		case SYSEX:
+			if (e->a)
+			{
+				app_sysex_event(USBSTANDALONE, TRACE_MESSAGE, sizeof(TRACE_MESSAGE));
+			}
+			else
+			{
+				app_sysex_event(USBSTANDALONE, ROUTE_MESSAGE, sizeof(ROUTE_MESSAGE));
+			}
+			break;
+	}
+}
+
+// pads rise over 2 ms, hold for 40 and drop
+static void scan(Instance *in)
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		u8 age = in->age[i];
+		
+		in->adc[i] = !in->peak[i] ? 0 : age < 2 ? in->peak[i] * (age + 1) / 2 : age < 42 ? in->peak[i] : 0;
+		
+		if (in->peak[i] && ++in->age[i] > 42)
+		{
+			in->peak[i] = 0;
+		}
+	}
+}
+
+static void *run(void *arg)
+{
+	Instance *in = (Instance*)arg;
+	
+	g_Digest = 2166136261u;
+	
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		in->adc[i] = in->peak[i] = in->age[i] = 0;
+	}
+	
+	sim_set_quiet(1);
+	sim_set_midi_hook(on_midi);
+	sim_set_sysex_hook(on_sysex);
+	
+	app_init(in->adc);
+	
+	int next = 0;
+	
+	for (u32 t=0; t < in->ticks; ++t)
+	{
+		u16 tick = t % TRACE_TICKS;
+		
+		if (tick == 0)
+		{
+			next = 0;
+		}
+		
+		while (next < in->count && in->events[next].tick == tick)
+		{
+			play(in, &in->events[next++]);
+		}
+		
+		scan(in);
+		app_timer_event();
+	}
+	
+	// and what's left on the LEDs
+	for (u8 index=0; index < 100; ++index)
+	{
+		u8 r, g, b;
+		hal_read_led(TYPEPAD, index, &r, &g, &b);
+		hash((r << 16) | (g << 8) | b);
+	}
+	
+	in->digest = g_Digest;
+	return 0;
+}
+
+// run the first n instances, one thread each, returning the wall time in s
+static double run_threads(Instance *instances, int n)
+{
+	pthread_t threads[n];
+	
+	double start = sim_now_ns();
+	
+	for (int i=0; i < n; ++i)
+	{
+		pthread_create(&threads[i], 0, run, &instances[i]);
+	}
+	
+	for (int i=0; i < n; ++i)
+	{
+		pthread_join(threads[i], 0);
+	}
+	
+	return (sim_now_ns() - start) * 1e-9;
+}
+
+//______________________________________________________________________________
+
+int sim_parallel(int argc, char *argv[])
+{
+	int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int count = argc > 0 ? atoi(argv[0]) : cores;
+	u32 ticks = argc > 1 ? (u32)atol(argv[1]) : DEFAULT_TICKS;
+	
+	// always run a few at once, even on one core, to show they're separate
+	count = count < 4 ? 4 : count;
+	
+	Instance *instances = calloc(count, sizeof(Instance));
+	u32 *alone = calloc(count, sizeof(u32));
+	
+	if (!instances || !alone)
+	{
+		printf("parallel: out of memory\n");
+		return 1;
+	}
+	
+	for (int i=0; i < count; ++i)
+	{
+		make_trace(&instances[i], i + 1);
+		instances[i].ticks = ticks;
+	}
+	
+	// each one on its own, for the reference digest and single thread speed
+	double single = 0;
+	
+	for (int i=0; i < count; ++i)
+	{
+		single += run_threads(&instances[i], 1);
+		alone[i] = instances[i].digest;
+	}
+	single /= count;
+	
+	int failed = 0;
+	
+	printf("parallel: %d cores, %d instances of %lu ticks\n", cores, count, ticks);
+	printf("threads  wall ms  M ticks/s  speedup  efficiency  x real time\n");
+	
+	for (int n=1; n <= count; n = n == count ? count + 1 : n * 2 > count ? count : n * 2)
+	{
+		double seconds = run_threads(instances, n);
+		double rate = (double)n * ticks / seconds;
+		double speedup = rate / (ticks / single);
+		
+		printf("%7d  %7.1f  %9.2f  %7.2f  %9.0f%%  %11.0f\n",
+			n, seconds * 1000, rate / 1e6, speedup, 100 * speedup / (n < cores ? n : cores), rate / 1000);
+		
+		for (int i=0; i < n; ++i)
+		{
+			if (instances[i].digest != alone[i])
+			{
+				printf("parallel: instance %d gave %08lx with %d threads, %08lx alone\n", i, instances[i].digest, n, alone[i]);
+				failed = 1;
+			}
+		}
+	}
+	
+	// different traces have to give different results, or the digests prove
+	// nothing
+	for (int i=1; i < count; ++i)
+	{
+		if (alone[i] == alone[0])
+		{
+			printf("parallel: instances 0 and %d gave the same digest\n", i);
+			failed = 1;
+		}
+	}
+	
+	free(instances);
+	free(alone);
+	
+	printf("parallel: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
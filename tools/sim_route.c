@@ -0,0 +1,211 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include "simulator.h"
+#include "route.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// MIDI routing workout.  Checks the default USB <-> DIN routes, filters,
+// channel remapping, merging and SysEx configuration through app_midi_event,
+// then measures how many messages per second the app forwards.
+// ____________________________________________________________________________
+
+#define MESSAGES		4000000
+
+typedef struct
+{
+	u8 port;
+	u8 status;
+	u8 d1;
+	u8 d2;
+} Message;
+
+static Message g_Sent[16];
+static int g_SentCount = 0;
+static volatile u32 g_Sink = 0;
+
+static u16 raw_ADC[PAD_COUNT];
+
+static void on_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	if (g_SentCount < 16)
+	{
+		Message m = { port, status, d1, d2 };
+		g_Sent[g_SentCount] = m;
+	}
+	++g_SentCount;
+}
+
+static void count_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	(void)d1;
+	(void)d2;
+	
+	g_Sink += port + status;
+	++g_SentCount;
+}
+
+// send one message in, and check exactly what comes out
+static int expect(const char *what, u8 port, u8 status, const Message *out, int count)
+{
+	g_SentCount = 0;
+	app_midi_event(port, status, 60, 100);
+	
+	int ok = g_SentCount == count;
+	
+	for (int i=0; ok && i < count; ++i)
+	{
+		ok = g_Sent[i].port == out[i].port && g_Sent[i].status == out[i].status;
+	}
+	
+	if (!ok)
+	{
+		printf("route: %s - got", what);
+		for (int i=0; i < g_SentCount && i < 16; ++i)
+		{
+			printf(" %d:0x%2.2x", g_Sent[i].port, g_Sent[i].status);
+		}
+		printf("\n");
+	}
+	
+	return ok;
+}
+
+static int checks(void)
+{
+	int ok = 1;
+	
+	const Message to_din = { DINMIDI, 0x93, 0, 0 };
+	const Message to_usb = { USBMIDI, 0x93, 0, 0 };
+	
+	ok &= expect("usb -> din", USBMIDI, 0x93, &to_din, 1);
+	ok &= expect("din -> usb", DINMIDI, 0x93, &to_usb, 1);
+	ok &= expect("standalone unrouted", USBSTANDALONE, 0x93, 0, 0);
+	ok &= expect("data byte", USBMIDI, 0x13, 0, 0);
+	
+	// over SysEx: standalone notes to DIN on channel 10, and CCs thru DIN
+	u8 msg[] = {
+		0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_ROUTE,
+		USBSTANDALONE, DINMIDI, ROUTE_NOTES, 0, 9,
+		DINMIDI, DINMIDI, ROUTE_CC, 0, ROUTE_KEEP_CHANNEL,
+		0xF7
+	};
+	app_sysex_event(USBSTANDALONE, msg, sizeof(msg));
+	
+	const Message remapped = { DINMIDI, 0x99, 0, 0 };
+	const Message cc[] = { { USBMIDI, 0xB2, 0, 0 }, { DINMIDI, 0xB2, 0, 0 } };
+	const Message clock[] = { { USBMIDI, MIDITIMINGCLOCK, 0, 0 } };
+	
+	ok &= expect("standalone note remapped", USBSTANDALONE, 0x93, &remapped, 1);
+	ok &= expect("standalone CC filtered", USBSTANDALONE, 0xB3, 0, 0);
+	ok &= expect("din CC thru and merged", DINMIDI, 0xB2, cc, 2);
+	ok &= expect("din clock not thru", DINMIDI, MIDITIMINGCLOCK, clock, 1);
+	
+	// system messages never get a channel
+	route_set(USBMIDI, DINMIDI, ROUTE_ALL, 5);
+	const Message clock_din = { DINMIDI, MIDITIMINGCLOCK, 0, 0 };
+	ok &= expect("system keeps status", USBMIDI, MIDITIMINGCLOCK, &clock_din, 1);
+	
+	return ok;
+}
+
+static double throughput(const Message *in, int count)
+{
+	g_SentCount = 0;
+	
+	double start = sim_now_ns();
+	for (int i=0; i < MESSAGES; ++i)
+	{
+		const Message *m = &in[i % count];
+		app_midi_event(m->port, m->status, m->d1, m->d2);
+	}
+	
+	return MESSAGES / ((sim_now_ns() - start) * 1e-9);
+}
+
+// ____________________________________________________________________________
+
+int sim_route(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	static Message traffic[4096];
+	
+	sim_set_quiet(1);
+	app_init(raw_ADC);
+	sim_set_midi_hook(on_midi);
+	
+	int failed = !checks();
+	printf("route: checks %s\n", failed ? "FAILED" : "ok");
+	
+	// a dense mix of notes, CCs, pressure and clock on every port
+	sim_srand(1);
+	for (int i=0; i < 4096; ++i)
+	{
+		static const u8 TYPES[] = { NOTEON, NOTEOFF, CC, POLYAFTERTOUCH, CHANNELAFTERTOUCH, 0xE0 };
+		
+		traffic[i].port = sim_rand() % 3;
+		traffic[i].status = i % 24 == 0 ? MIDITIMINGCLOCK : TYPES[sim_rand() % 6] | (sim_rand() % 16);
+		traffic[i].d1 = sim_rand() % 128;
+		traffic[i].d2 = sim_rand() % 128;
+	}
+	
+	sim_set_midi_hook(count_midi);
+	
+	route_init();
+	double defaults = throughput(traffic, 4096);
+	double out_defaults = (double)g_SentCount / MESSAGES;
+	
+	// every port to every port, with filters and remaps
+	for (u8 src=0; src < ROUTE_PORTS; ++src)
+	{
+		for (u8 dst=0; dst < ROUTE_PORTS; ++dst)
+		{
+			route_set(src, dst, src == dst ? ROUTE_NOTES : ROUTE_ALL, dst == DINMIDI ? 3 : ROUTE_KEEP_CHANNEL);
+		}
+	}
+	double full = throughput(traffic, 4096);
+	double out_full = (double)g_SentCount / MESSAGES;
+	
+	printf("route: defaults     %6.1f M msgs/s in, %.2f out per message\n", defaults / 1e6, out_defaults);
+	printf("route: full matrix  %6.1f M msgs/s in, %.2f out per message\n", full / 1e6, out_full);
+	
+	sim_set_midi_hook(0);
+	sim_set_quiet(0);
+	return failed;
+}
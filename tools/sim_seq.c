@@ -0,0 +1,350 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "arena.h"
+#include "seq.h"
+
+// ____________________________________________________________________________
+//
+// Step sequencer workout.  Checks steps fire on the right ticks for tracks of
+// different lengths, with and without swing and on clock pulses, that gates
+// and ties end notes when they should, and that probability plays about the
+// right share of steps.  Then times ticks with all 8 tracks of 64 steps
+// active, stepping every tick - the worst case - and with sparser patterns
+// at a normal rate.
+// ____________________________________________________________________________
+
+#define TICKS			200000
+#define MAX_EVENTS		256
+
+typedef struct
+{
+	int tick;
+	u8 channel;
+	u8 note;
+	u8 velocity;
+} Event;
+
+static Event g_Events[MAX_EVENTS];
+static int g_EventCount = 0;
+static int g_Notes = 0;
+static int g_Tick = 0;
+
+static void on_note(u8 channel, u8 note, u8 velocity)
+{
+	if (g_EventCount < MAX_EVENTS)
+	{
+		Event *e = &g_Events[g_EventCount++];
+		
+		e->tick = g_Tick;
+		e->channel = channel;
+		e->note = note;
+		e->velocity = velocity;
+	}
+	
+	g_Notes += velocity != 0;
+}
+
+static void reset()
+{
+	arena_init();
+	seq_init(on_note);
+	
+	g_EventCount = 0;
+	g_Notes = 0;
+	g_Tick = 0;
+}
+
+static void run(int ticks)
+{
+	for (int i=0; i < ticks; ++i)
+	{
+		++g_Tick;
+		seq_tick();
+	}
+}
+
+// the ticks a channel's note ons landed on, against what's expected
+static int expect_ons(const char *what, u8 channel, const int *ticks, int count)
+{
+	int n = 0;
+	int ok = 1;
+	
+	for (int i=0; i < g_EventCount; ++i)
+	{
+		const Event *e = &g_Events[i];
+		
+		if (e->channel == channel && e->velocity)
+		{
+			ok &= n < count && e->tick == ticks[n];
+			++n;
+		}
+	}
+	
+	ok &= n == count;
+	
+	if (!ok)
+	{
+		printf("seq: %s - FAILED, note ons at", what);
+		
+		for (int i=0; i < g_EventCount; ++i)
+		{
+			if (g_Events[i].channel == channel && g_Events[i].velocity)
+			{
+				printf(" %d", g_Events[i].tick);
+			}
+		}
+		printf("\n");
+	}
+	return !ok;
+}
+
+// ticks each note sounded for on a channel, which should all be the same
+static int expect_gates(const char *what, u8 channel, int ticks)
+{
+	int ok = 1;
+	
+	for (int i=0; i < g_EventCount; ++i)
+	{
+		const Event *on = &g_Events[i];
+		
+		if (on->channel != channel || !on->velocity)
+		{
+			continue;
+		}
+		
+		for (int j=i + 1; j < g_EventCount; ++j)
+		{
+			const Event *off = &g_Events[j];
+			
+			if (off->channel == channel && off->note == on->note && !off->velocity)
+			{
+				ok &= off->tick - on->tick == ticks;
+				break;
+			}
+		}
+	}
+	
+	if (!ok)
+	{
+		printf("seq: %s - FAILED\n", what);
+	}
+	return !ok;
+}
+
+static int checks()
+{
+	int failed = 0;
+	
+	// 4 ticks a step - track 0 is 4 steps with the first and third playing,
+	// track 1 is 3 steps with the second playing
+	reset();
+	seq_set_rate(4, SEQ_SWING_NONE);
+	seq_set_length(0, 4);
+	seq_set_length(1, 3);
+	seq_set_step(0, 0, 60, 100, 50, SEQ_ALWAYS);
+	seq_set_step(0, 2, 62, 100, 50, SEQ_ALWAYS);
+	seq_set_step(1, 1, 64, 90, 25, SEQ_ALWAYS);
+	seq_start();
+	run(48);
+	
+	static const int even[] = { 1, 9, 17, 25, 33, 41 };
+	static const int thirds[] = { 5, 17, 29, 41 };
+	
+	failed += expect_ons("steps", 0, even, 6);
+	failed += expect_ons("track lengths", 1, thirds, 4);
+	failed += expect_gates("gates", 0, 2);
+	failed += expect_gates("short gates", 1, 1);
+	
+	// swing - the first step of each pair takes 6 of the 8 ticks
+	reset();
+	seq_set_rate(4, SEQ_SWING_MAX);
+	seq_set_length(0, 2);
+	seq_set_step(0, 0, 60, 100, 50, SEQ_ALWAYS);
+	seq_set_step(0, 1, 61, 100, 50, SEQ_ALWAYS);
+	seq_start();
+	run(24);
+	
+	static const int swung[] = { 1, 7, 9, 15, 17, 23 };
+	
+	failed += expect_ons("swing", 0, swung, 6);
+	failed += expect_gates("gates with swing", 0, 2);
+	
+	// a tie runs into the next step, which ends it just before it plays
+	reset();
+	seq_set_rate(4, SEQ_SWING_NONE);
+	seq_set_length(0, 2);
+	seq_set_step(0, 0, 60, 100, 150, SEQ_ALWAYS);
+	seq_start();
+	run(4);
+	seq_set_step(0, 1, 61, 100, 50, SEQ_ALWAYS);
+	run(4);
+	
+	int tied = g_EventCount >= 3 && g_Events[1].note == 60 && !g_Events[1].velocity && g_Events[1].tick == 5
+		&& g_Events[2].note == 61 && g_Events[2].velocity && g_Events[2].tick == 5;
+	
+	if (!tied)
+	{
+		printf("seq: ties - FAILED\n");
+		++failed;
+	}
+	
+	// on clock pulses, 6 to the step, with nothing happening on ticks
+	reset();
+	seq_set_sync(1);
+	seq_set_rate(6, SEQ_SWING_NONE);
+	seq_set_length(0, 1);
+	seq_set_step(0, 0, 60, 100, 50, SEQ_ALWAYS);
+	seq_start();
+	
+	for (int pulse=0; pulse < 24; ++pulse)
+	{
+		run(20);
+		seq_pulse();
+	}
+	
+	static const int pulsed[] = { 20, 140, 260, 380 };
+	
+	failed += expect_ons("sync", 0, pulsed, 4);
+	seq_set_sync(0);
+	
+	// probability - about half the steps play
+	reset();
+	seq_set_rate(1, SEQ_SWING_NONE);
+	seq_set_length(0, 1);
+	seq_set_step(0, 0, 60, 100, 50, 50);
+	seq_start();
+	run(10000);
+	
+	if (g_Notes < 4700 || g_Notes > 5300)
+	{
+		printf("seq: probability - FAILED, %d of 10000 steps played\n", g_Notes);
+		++failed;
+	}
+	
+	// stopping ends what's sounding
+	reset();
+	seq_set_rate(4, SEQ_SWING_NONE);
+	
+	for (u8 t=0; t < SEQ_TRACKS; ++t)
+	{
+		seq_set_step(t, 0, 60, 100, 100, SEQ_ALWAYS);
+	}
+	
+	seq_start();
+	run(1);
+	seq_stop();
+	run(100);
+	
+	if (g_EventCount != 2 * SEQ_TRACKS || g_Notes != SEQ_TRACKS)
+	{
+		printf("seq: stop - FAILED\n");
+		++failed;
+	}
+	
+	return failed;
+}
+
+static int compare_cycles(const void *a, const void *b)
+{
+	u64 x = *(const u64*)a;
+	u64 y = *(const u64*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+// per tick cost over TICKS ticks, with every nth step active on every track
+static void timing(const char *what, int every, u16 rate)
+{
+	static u64 cycles[TICKS];
+	
+	reset();
+	seq_set_rate(rate, SEQ_SWING_NONE);
+	
+	for (u8 t=0; t < SEQ_TRACKS; ++t)
+	{
+		seq_set_length(t, SEQ_STEPS - t);
+		
+		for (u8 s=0; s < SEQ_STEPS; ++s)
+		{
+			if (s % every == 0)
+			{
+				seq_set_step(t, s, 36 + s, 100, 80, SEQ_ALWAYS);
+			}
+		}
+	}
+	
+	seq_start();
+	
+	// cycles per tick from the time stamp counter, which costs far less to
+	// read than the clock.  The host's worst tick is whenever it was
+	// interrupted, so it isn't shown - see m3bench for the unit's.
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		u64 c = sim_cycles();
+		seq_tick();
+		cycles[i] = sim_cycles() - c;
+	}
+	
+	double mean = (sim_now_ns() - start) / TICKS;
+	
+	qsort(cycles, TICKS, sizeof(u64), compare_cycles);
+	
+	printf("seq: %-28s %6.2f  %7.1f  %7llu  %7llu\n", what, (double)g_Notes / TICKS, mean,
+		   cycles[TICKS / 2], cycles[TICKS * 999 / 1000]);
+}
+
+int sim_seq(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	int failed = checks();
+	
+	printf("seq: checks %s\n\n", failed ? "FAILED" : "ok");
+	printf("seq: %d tracks of up to %d steps                notes  mean ns   median    p99.9 (cycles)\n",
+		   SEQ_TRACKS, SEQ_STEPS);
+	
+	timing("every step, step every tick", 1, 1);
+	timing("every step, 16ths at 120", 1, 125);
+	timing("every 4th step, 16ths at 120", 4, 125);
+	timing("every 16th step, 16ths", 16, 125);
+	
+	return failed;
+}
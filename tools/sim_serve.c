@@ -0,0 +1,250 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "instance.h"
+#include "simsock.h"
+#include "simulator.h"
+
+// ____________________________________________________________________________
+//
+// The app as a device on a socket (see simsock.h).  Events from the driver go
+// in through the sim_app_* wrappers, so they log like any other workout, and
+// the HAL hooks queue up what comes out.  Replies go back in one write per
+// batch the driver sends, or per tick when the simulator keeps its own time.
+// ____________________________________________________________________________
+
+static INSTANCE SimSock *g_Sock = 0;
+
+// the app redraws every pad every tick, so only send the LEDs that change
+#define LED_TYPES	2
+#define LED_COUNT	100
+
+static INSTANCE u8 g_Sent[LED_TYPES][LED_COUNT][3];
+
+static void send_midi(u8 port, u8 status, u8 d1, u8 d2)
+{
+	u8 payload[] = {port, status, d1, d2};
+	
+	simsock_put(g_Sock, SIMSOCK_MIDI, payload, sizeof(payload));
+}
+
+static void send_sysex(u8 port, const u8 *data, u16 length)
+{
+	u8 payload[SIMSOCK_MAX_FRAME - SIMSOCK_HEADER];
+	
+	if (length < sizeof(payload))
+	{
+		payload[0] = port;
+		memcpy(payload + 1, data, length);
+		simsock_put(g_Sock, SIMSOCK_SYSEX, payload, length + 1);
+	}
+}
+
+static void send_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
+{
+	if (type < LED_TYPES && index < LED_COUNT)
+	{
+		u8 *sent = g_Sent[type][index];
+		
+		if (sent[0] == red && sent[1] == green && sent[2] == blue)
+		{
+			return;
+		}
+		
+		sent[0] = red;
+		sent[1] = green;
+		sent[2] = blue;
+	}
+	
+	u8 payload[] = {type, index, red, green, blue};
+	
+	simsock_put(g_Sock, SIMSOCK_LED, payload, sizeof(payload));
+}
+
+static void receive(void *context, u8 kind, const u8 *payload, u16 length)
+{
+	(void)context;
+	
+	switch (kind)
+	{
+		case SIMSOCK_MIDI:
+			if (length == 4)
+			{
+				sim_app_midi_event(payload[0], payload[1], payload[2], payload[3]);
+			}
+			break;
+			
+		case SIMSOCK_SYSEX:
+			if (length > 1)
+			{
+				// the app may write to its SysEx buffer, as it's the HAL's
+				u8 data[SIMSOCK_MAX_FRAME];
+				
+				memcpy(data, payload + 1, length - 1);
+				sim_app_sysex_event(payload[0], data, length - 1);
+			}
+			break;
+			
+		case SIMSOCK_SURFACE:
+			if (length == 3)
+			{
+				sim_app_surface_event(payload[0], payload[1], payload[2]);
+			}
+			break;
+			
+		case SIMSOCK_AFTERTOUCH:
+			if (length == 2)
+			{
+				sim_app_aftertouch_event(payload[0], payload[1]);
+			}
+			break;
+			
+		case SIMSOCK_TICKS:
+			if (length == 2)
+			{
+				for (u16 i = payload[0] | (payload[1] << 8); i > 0; --i)
+				{
+					sim_app_timer_event();
+				}
+			}
+			break;
+			
+		case SIMSOCK_SYNC:
+			simsock_put(g_Sock, SIMSOCK_SYNC, payload, length);
+			break;
+			
+		// anything else is from a newer driver, and skipped
+	}
+}
+
+#define TICK_NS 1000000.0
+
+int sim_serve_connection(int fd, int realtime)
+{
+	SimSock *sock = malloc(sizeof(SimSock));
+	
+	if (!sock)
+	{
+		return 0;
+	}
+	
+	simsock_open(sock, fd);
+	g_Sock = sock;
+	
+	// nothing has been sent, so the first time the app draws an LED it goes out
+	memset(g_Sent, 0xFF, sizeof(g_Sent));
+	
+	sim_set_midi_hook(send_midi);
+	sim_set_sysex_hook(send_sysex);
+	sim_set_led_hook(send_led);
+	
+	sim_app_init();
+	
+	double next = sim_now_ns() + TICK_NS;
+	int connected = 1;
+	
+	while (connected)
+	{
+		if (realtime)
+		{
+			// 1ms ticks, catching up after a slow batch but not after a stall
+			double now = sim_now_ns();
+			
+			if (now - next > 100 * TICK_NS)
+			{
+				next = now;
+			}
+			
+			while (next <= now)
+			{
+				sim_app_timer_event();
+				next += TICK_NS;
+			}
+			
+			connected = simsock_flush(sock);
+			
+			struct pollfd wait = { fd, POLLIN, 0 };
+			
+			if (!connected || poll(&wait, 1, (int)((next - now) / TICK_NS) + 1) <= 0)
+			{
+				continue;
+			}
+		}
+		
+		connected = simsock_read(sock, receive, 0) && simsock_flush(sock);
+	}
+	
+	sim_set_midi_hook(0);
+	sim_set_sysex_hook(0);
+	sim_set_led_hook(0);
+	
+	g_Sock = 0;
+	free(sock);
+	
+	return 1;
+}
+
+int sim_serve(int argc, char *argv[])
+{
+	if (argc < 1)
+	{
+		printf("serve: needs a socket path\n");
+		return 1;
+	}
+	
+	int realtime = argc > 1 && strcmp(argv[1], "realtime") == 0;
+	
+	printf("serve: waiting for a driver on %s\n", argv[0]);
+	fflush(stdout);
+	
+	int fd = simsock_accept(argv[0]);
+	
+	if (fd < 0)
+	{
+		perror("serve");
+		return 1;
+	}
+	
+	int ok = sim_serve_connection(fd, realtime);
+	
+	close(fd);
+	printf("serve: driver hung up\n");
+	
+	return !ok;
+}
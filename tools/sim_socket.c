@@ -0,0 +1,322 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "simsock.h"
+#include "simulator.h"
+#include "sysex.h"
+
+// ____________________________________________________________________________
+//
+// A test driver for "simulator serve", talking to one on another thread over
+// a real socket.  Checks the transport carries every kind of frame, then
+// measures round trip latency and how many messages a second it sustains as
+// more of them share each write.
+// ____________________________________________________________________________
+
+#define ROUND_TRIPS		20000
+#define RUN_NS			300000000.0
+
+typedef struct
+{
+	SimSock sock;
+	
+	// what has come back
+	u32 midi;
+	u32 leds;
+	u32 sysex;
+	u32 synced;
+	u8 last_midi[4];
+	u8 last_led[5];
+	u8 last_sysex[SYSEX_DATA + 1];
+} Driver;
+
+static void receive(void *context, u8 kind, const u8 *payload, u16 length)
+{
+	Driver *d = context;
+	
+	switch (kind)
+	{
+		case SIMSOCK_MIDI:
+			memcpy(d->last_midi, payload, sizeof(d->last_midi));
+			d->midi++;
+			break;
+			
+		case SIMSOCK_LED:
+			memcpy(d->last_led, payload, sizeof(d->last_led));
+			d->leds++;
+			break;
+			
+		case SIMSOCK_SYSEX:
+			memcpy(d->last_sysex, payload, length < sizeof(d->last_sysex) ? length : sizeof(d->last_sysex));
+			d->sysex++;
+			break;
+			
+		case SIMSOCK_SYNC:
+			d->synced = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((u32)payload[3] << 24);
+			break;
+	}
+}
+
+static void put_midi(Driver *d, u8 port, u8 status, u8 d1, u8 d2)
+{
+	u8 payload[] = {port, status, d1, d2};
+	
+	simsock_put(&d->sock, SIMSOCK_MIDI, payload, sizeof(payload));
+}
+
+static void put_ticks(Driver *d, u16 count)
+{
+	u8 payload[] = {count & 0xFF, count >> 8};
+	
+	simsock_put(&d->sock, SIMSOCK_TICKS, payload, sizeof(payload));
+}
+
+// send what's queued and a sync behind it, and wait for everything to be done
+static int roundtrip(Driver *d)
+{
+	u32 token = (d->synced + 1) & 0xFFFFFFFF;
+	u8 payload[] = {token & 0xFF, (token >> 8) & 0xFF, (token >> 16) & 0xFF, token >> 24};
+	
+	if (!simsock_put(&d->sock, SIMSOCK_SYNC, payload, sizeof(payload)) || !simsock_flush(&d->sock))
+	{
+		return 0;
+	}
+	
+	while (d->synced != token)
+	{
+		if (!simsock_read(&d->sock, receive, d))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// ____________________________________________________________________________
+
+static int check(const char *what, int ok)
+{
+	if (!ok)
+	{
+		printf("socket: %s - FAILED\n", what);
+	}
+	return ok;
+}
+
+static int check_frames(Driver *d)
+{
+	int ok = 1;
+	
+	// boot draws every LED once, after which nothing changes so nothing's sent
+	put_ticks(d, 8);
+	ok &= check("sync", roundtrip(d));
+	ok &= check("LEDs at start up", d->leds >= 64);
+	
+	u32 leds = d->leds;
+	
+	put_ticks(d, 8);
+	roundtrip(d);
+	ok &= check("unchanged LEDs not sent", d->leds == leds);
+	
+	// USB MIDI goes out of the DIN port by default
+	u32 midi = d->midi;
+	
+	put_midi(d, USBMIDI, NOTEON, 60, 100);
+	roundtrip(d);
+	ok &= check("MIDI routed", d->midi - midi == 1 && d->last_midi[0] == DINMIDI && d->last_midi[1] == NOTEON &&
+				d->last_midi[2] == 60 && d->last_midi[3] == 100);
+	
+	// an edge button toggles its LED and plays a note
+	u8 press[] = {TYPEPAD, 10, 127};
+	
+	leds = d->leds;
+	simsock_put(&d->sock, SIMSOCK_SURFACE, press, sizeof(press));
+	roundtrip(d);
+	ok &= check("button LED", d->leds == leds + 1 && d->last_led[0] == TYPEPAD && d->last_led[1] == 10);
+	ok &= check("button MIDI", d->midi - midi == 2 && d->last_midi[2] == 10);
+	
+	// a dump request is answered with SysEx over the next ticks
+	u8 dump[] = {USBSTANDALONE, 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRANSFER_DUMP, 0, 0xF7};
+	
+	simsock_put(&d->sock, SIMSOCK_SYSEX, dump, sizeof(dump));
+	put_ticks(d, 4);
+	roundtrip(d);
+	ok &= check("SysEx dump", d->sysex > 0 && d->last_sysex[1] == 0xF0 &&
+				d->last_sysex[1 + SYSEX_COMMAND] == SYSEX_TRANSFER_DATA);
+	
+	return ok;
+}
+
+// ____________________________________________________________________________
+
+static int compare_ns(const void *a, const void *b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	
+	return x < y ? -1 : x > y;
+}
+
+static int measure_latency(Driver *d)
+{
+	static double ns[ROUND_TRIPS];
+	u32 midi = d->midi;
+	
+	// a note in and the routed note back, one write each way
+	for (int i=0; i < ROUND_TRIPS; ++i)
+	{
+		double start = sim_now_ns();
+		
+		put_midi(d, USBMIDI, CC, 1, i & 0x7F);
+		
+		if (!roundtrip(d))
+		{
+			return 0;
+		}
+		ns[i] = sim_now_ns() - start;
+	}
+	
+	qsort(ns, ROUND_TRIPS, sizeof(double), compare_ns);
+	
+	printf("socket: round trip, MIDI in to routed MIDI out - median %.1f us, p99 %.1f us, p99.9 %.1f us\n",
+		   ns[ROUND_TRIPS / 2] / 1000, ns[ROUND_TRIPS * 99 / 100] / 1000, ns[ROUND_TRIPS * 999 / 1000] / 1000);
+	
+	return check("every note routed", d->midi - midi == ROUND_TRIPS);
+}
+
+static int measure_throughput(Driver *d, int batch)
+{
+	u32 midi = d->midi;
+	u32 syscalls = d->sock.reads + d->sock.writes;
+	u32 sent = 0;
+	
+	double start = sim_now_ns();
+	double elapsed;
+	
+	do
+	{
+		for (int i=0; i < batch; ++i)
+		{
+			put_midi(d, USBMIDI, CC, 7, sent++ & 0x7F);
+		}
+		
+		if (!roundtrip(d))
+		{
+			return 0;
+		}
+		elapsed = sim_now_ns() - start;
+	}
+	while (elapsed < RUN_NS);
+	
+	syscalls = d->sock.reads + d->sock.writes - syscalls;
+	
+	printf("socket: %4d  %12.0f  %16.3f\n", batch, sent / (elapsed / 1e9), (double)syscalls / sent);
+	
+	return check("every message routed", d->midi - midi == sent);
+}
+
+// ____________________________________________________________________________
+
+static void *serve(void *path)
+{
+	int fd = simsock_accept(path);
+	
+	if (fd >= 0)
+	{
+		sim_set_quiet(1);
+		sim_serve_connection(fd, 0);
+		close(fd);
+	}
+	return 0;
+}
+
+int sim_socket(int argc, char *argv[])
+{
+	char path[108];
+	
+	snprintf(path, sizeof(path), "%s", argc > 0 ? argv[0] : "");
+	if (argc < 1)
+	{
+		snprintf(path, sizeof(path), "/tmp/launchpad-sim-%d.sock", (int)getpid());
+	}
+	
+	pthread_t server;
+	pthread_create(&server, 0, serve, path);
+	
+	// the server may not be listening yet
+	int fd = -1;
+	
+	for (int i=0; fd < 0 && i < 1000; ++i)
+	{
+		fd = simsock_connect(path);
+		
+		if (fd < 0)
+		{
+			struct timespec ms = { 0, 1000000 };
+			nanosleep(&ms, 0);
+		}
+	}
+	
+	if (fd < 0)
+	{
+		printf("socket: can't connect to %s - FAILED\n", path);
+		return 1;
+	}
+	
+	static Driver driver;
+	
+	simsock_open(&driver.sock, fd);
+	
+	int failed = !check_frames(&driver);
+	
+	printf("socket: checks %s\n\n", failed ? "FAILED" : "ok");
+	
+	failed |= !measure_latency(&driver);
+	
+	printf("\nsocket: batch     msgs/sec  syscalls per msg\n");
+	failed |= !measure_throughput(&driver, 1);
+	failed |= !measure_throughput(&driver, 16);
+	failed |= !measure_throughput(&driver, 256);
+	
+	close(fd);
+	pthread_join(server, 0);
+	
+	return failed;
+}
@@ -0,0 +1,346 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include "simulator.h"
+#include "sync.h"
+
+// ____________________________________________________________________________
+//
+// MIDI clock sync workout.  Feeds the slave clock streams at a range of tempos
+// with random delays added to every pulse, as USB and DIN do, and compares the
+// jitter of the pulses it sends with the jitter of the ones it was given.
+// Also checks the master clock, a tempo change, and clock stopping and
+// starting again.
+// ____________________________________________________________________________
+
+#define MAX_PULSES		20000
+#define TWO_PI			6.283185307179586
+
+// pulse times, in ms
+static u32 g_Out[MAX_PULSES];
+static int g_OutCount = 0;
+static u32 g_In[MAX_PULSES];
+static int g_InCount = 0;
+
+static u32 g_Now = 0;
+
+static void on_pulse()
+{
+	if (g_OutCount < MAX_PULSES)
+	{
+		g_Out[g_OutCount++] = g_Now;
+	}
+}
+
+typedef struct
+{
+	double phase;		// rms distance from the ideal pulse times, ms
+	double interval;	// rms difference between intervals and the period, ms
+} Jitter;
+
+// distance from a pulse to the nearest tick of an ideal clock, ms
+static double offset(double time, double start, double period)
+{
+	double e = fmod(time - start, period);
+	
+	if (e < 0)
+	{
+		e += period;
+	}
+	
+	return e >= period / 2 ? e - period : e;
+}
+
+// jitter of pulses from index first on, against an ideal clock with the given
+// period - ignoring any constant offset
+static Jitter measure(const u32 *times, int count, int first, double start, double period)
+{
+	Jitter j = { 0, 0 };
+	
+	if (count - first < 2)
+	{
+		return j;
+	}
+	
+	// the constant offset, as an average angle so it doesn't matter where
+	// the pulses fall relative to the period
+	double x = 0;
+	double y = 0;
+	
+	for (int i=first; i < count; ++i)
+	{
+		double angle = TWO_PI * offset(times[i], start, period) / period;
+		
+		x += cos(angle);
+		y += sin(angle);
+	}
+	
+	start += period * atan2(y, x) / TWO_PI;
+	
+	double squares = 0;
+	double intervals = 0;
+	
+	for (int i=first; i < count; ++i)
+	{
+		double e = offset(times[i], start, period);
+		squares += e * e;
+		
+		if (i > first)
+		{
+			double d = (double)(times[i] - times[i - 1]) - period;
+			intervals += d * d;
+		}
+	}
+	
+	j.phase = sqrt(squares / (count - first));
+	j.interval = sqrt(intervals / (count - first - 1));
+	
+	return j;
+}
+
+static double random_ms(double range)
+{
+	return range * (sim_rand() / 4294967296.0);
+}
+
+//______________________________________________________________________________
+
+typedef struct
+{
+	double start;		// first pulse, ms
+	double period;		// ms
+	double jitter;		// each pulse is late by up to this, ms
+	u32 stop;			// no pulses in [stop, restart), ms
+	u32 restart;
+	double change_at;	// then switch to a new period
+	double new_period;
+} Stream;
+
+typedef struct
+{
+	u32 locked;			// last ms it locked, or 0 if it ended unlocked
+	u32 last_pulse;		// time of the last pulse sent
+} Result;
+
+static Result run(const Stream *s, u32 ms)
+{
+	Result r = { 0, 0 };
+	
+	sync_init(on_pulse);
+	sync_set_source(DINMIDI);
+	
+	g_OutCount = 0;
+	g_InCount = 0;
+	
+	double next = s->start;
+	double period = s->period;
+	double arrival = next + random_ms(s->jitter);
+	u8 was_locked = 0;
+	
+	for (g_Now=0; g_Now < ms; ++g_Now)
+	{
+		sync_tick();
+		
+		// pulses arriving before the next tick
+		while (arrival < g_Now + 1)
+		{
+			if ((arrival < s->stop || arrival >= s->restart) && g_InCount < MAX_PULSES)
+			{
+				g_In[g_InCount++] = g_Now;
+				sync_midi(DINMIDI, MIDITIMINGCLOCK);
+			}
+			
+			if (s->change_at && next >= s->change_at)
+			{
+				period = s->new_period;
+			}
+			
+			next += period;
+			arrival = next + random_ms(s->jitter);
+		}
+		
+		u8 locked = sync_locked();
+		
+		if (locked && !was_locked)
+		{
+			r.locked = g_Now;
+		}
+		else if (!locked)
+		{
+			r.locked = 0;
+		}
+		was_locked = locked;
+	}
+	
+	r.last_pulse = g_OutCount ? g_Out[g_OutCount - 1] : 0;
+	return r;
+}
+
+static double tempo(u32 rate)
+{
+	return rate * 60000.0 / SYNC_PPQN / 16777216.0;
+}
+
+// first pulse at or after a time
+static int first_after(const u32 *times, int count, double ms)
+{
+	int i = 0;
+	
+	while (i < count && times[i] < ms)
+	{
+		++i;
+	}
+	
+	return i;
+}
+
+//______________________________________________________________________________
+
+static int check_master()
+{
+	// the master clock, with incoming clock...
+	sync_init(on_pulse);
+	sync_set_tempo(125);
+	
+	g_OutCount = 0;
+	
+	for (g_Now=0; g_Now < 10000; ++g_Now)
+	{
+		sync_tick();
+		
+		// which it ignores
+		if (g_Now % 7 == 0)
+		{
+			sync_midi(DINMIDI, MIDITIMINGCLOCK);
+		}
+	}
+	
+	// 125 bpm is one pulse every 20 ms exactly, from the first tick
+	int ok = g_OutCount == 500;
+	
+	for (int i=1; ok && i < g_OutCount; ++i)
+	{
+		ok = g_Out[i] - g_Out[i - 1] == 20;
+	}
+	
+	if (!ok)
+	{
+		printf("sync: master at 125 bpm didn't pulse every 20 ms\n");
+	}
+	
+	return ok;
+}
+
+static int check_tempo_change()
+{
+	const Stream s = { 3.3, 60000.0 / (120 * SYNC_PPQN), 3, 0, 0, 15000, 60000.0 / (132 * SYNC_PPQN) };
+	
+	Result r = run(&s, 30000);
+	double bpm = tempo(sync_rate());
+	
+	printf("sync: 120 -> 132 bpm, relocked after %d ms at %.2f bpm\n", (int)(r.locked - 15000), bpm);
+	
+	return r.locked > 15000 && fabs(bpm - 132) < 0.5;
+}
+
+static int check_stop_start()
+{
+	const double period = 60000.0 / (120 * SYNC_PPQN);
+	const Stream s = { 3.3, period, 3, 10000, 12000, 0, 0 };
+	
+	Result r = run(&s, 20000);
+	
+	// output must stop once the timeout runs out, and not come back until
+	// input does
+	int stopped = first_after(g_Out, g_OutCount, 10000 + SYNC_TIMEOUT + 1);
+	int resumed = first_after(g_Out, g_OutCount, 12000);
+	
+	printf("sync: clock stopped for 2 s - out stopped %d ms later, relocked %d ms after it restarted\n",
+		(int)(g_Out[stopped - 1] - 10000), (int)(r.locked - 12000));
+	
+	return stopped == resumed && r.locked > 12000 && r.last_pulse + 2 * period > 20000;
+}
+
+//______________________________________________________________________________
+
+int sim_sync(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	static const u16 TEMPOS[] = { 60, 120, 140, 174, 240 };
+	static const double JITTER[] = { 0, 2, 4, 8 };
+	
+	int failed = 0;
+	sim_srand(1);
+	
+	failed |= !check_master();
+	
+	printf("  bpm  jitter  in rms  out rms  in interval  out interval  lock ms  tempo err\n");
+	
+	for (size_t t=0; t < sizeof(TEMPOS) / sizeof(TEMPOS[0]); ++t)
+	{
+		for (size_t j=0; j < sizeof(JITTER) / sizeof(JITTER[0]); ++j)
+		{
+			const double period = 60000.0 / (TEMPOS[t] * SYNC_PPQN);
+			const Stream s = { 3.3, period, JITTER[j], 0, 0, 0, 0 };
+			
+			Result r = run(&s, 30000);
+			
+			// steady state, a second after locking
+			double from = r.locked + 1000.0;
+			Jitter in = measure(g_In, g_InCount, first_after(g_In, g_InCount, from), s.start, period);
+			Jitter out = measure(g_Out, g_OutCount, first_after(g_Out, g_OutCount, from), s.start, period);
+			double error = 100 * (tempo(sync_rate()) - TEMPOS[t]) / TEMPOS[t];
+			
+			printf("%5d  %6.0f  %6.2f  %7.2f  %11.2f  %12.2f  %7d  %8.3f%%\n",
+				TEMPOS[t], JITTER[j], in.phase, out.phase, in.interval, out.interval, (int)r.locked, error);
+			
+			// once jitter is above the 1 ms tick, smoothing has to beat it
+			if (!r.locked || (JITTER[j] > 1 && out.phase >= in.phase) || fabs(error) > 0.2)
+			{
+				printf("sync: %d bpm, jitter %.0f ms FAILED\n", TEMPOS[t], JITTER[j]);
+				failed = 1;
+			}
+		}
+	}
+	
+	failed |= !check_tempo_change();
+	failed |= !check_stop_start();
+	
+	printf("sync: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
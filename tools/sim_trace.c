@@ -0,0 +1,276 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "pack7.h"
+#include "sysex.h"
+#include "trace.h"
+
+// ____________________________________________________________________________
+//
+// Trace ring workout.  Plays a known sequence of events into the app, asks
+// for the ring over SysEx, and checks the records that come back.  Optionally
+// writes the dump to a file for tools/tracedump.c.  Then measures what
+// tracing costs per tick of a busy app, and per record.
+// ____________________________________________________________________________
+
+#define TICKS			200000
+#define REPEATS			9
+#define RECORDS			10000000
+
+// ticks to let a whole dump out
+#define DUMP_TICKS		(TRACE_RECORDS / TRACE_PART_RECORDS + 1)
+
+static u16 raw_ADC[PAD_COUNT];
+
+// the dump, unpacked
+static u8 g_Records[TRACE_RECORDS * TRACE_RECORD_SIZE];
+static int g_RecordCount = 0;
+static int g_Parts = 0;
+static int g_PartsExpected = 0;
+static FILE *g_File = 0;
+
+static void on_sysex(u8 port, const u8 *data, u16 length)
+{
+	(void)port;
+	
+	if (sysex_command(data, length) != SYSEX_TRACE)
+	{
+		return;
+	}
+	
+	if (g_File)
+	{
+		fwrite(data, 1, length, g_File);
+	}
+	
+	int packed = length - (SYSEX_DATA + 3);
+	int count = (packed / 8) * 7 / TRACE_RECORD_SIZE;
+	u8 records[PACK7_SIZE(TRACE_PART_RECORDS * TRACE_RECORD_SIZE)];
+	
+	unpack7(records, data + SYSEX_DATA + 2, (packed / 8) * 7);
+	
+	if (data[SYSEX_DATA] == g_Parts && g_RecordCount + count <= TRACE_RECORDS)
+	{
+		memcpy(g_Records + g_RecordCount * TRACE_RECORD_SIZE, records, count * TRACE_RECORD_SIZE);
+		g_RecordCount += count;
+	}
+	
+	++g_Parts;
+	g_PartsExpected = data[SYSEX_DATA + 1];
+}
+
+static void dump()
+{
+	static u8 request[] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRACE, 0xF7 };
+	
+	g_RecordCount = 0;
+	g_Parts = 0;
+	g_PartsExpected = 0;
+	
+	app_sysex_event(USBSTANDALONE, request, sizeof(request));
+	
+	for (int i=0; i < DUMP_TICKS; ++i)
+	{
+		app_timer_event();
+	}
+}
+
+// the record n from the end of the dump
+static const u8 *record(int n)
+{
+	return g_Records + (g_RecordCount - 1 - n) * TRACE_RECORD_SIZE;
+}
+
+static int expect(int n, u8 event, u8 a, u8 b, u8 c)
+{
+	const u8 *r = record(n);
+	
+	if (r[2] != event || r[3] != a || r[4] != b || r[5] != c)
+	{
+		printf("trace: record %d from the end is %d %d %d %d, expected %d %d %d %d\n", n, r[2], r[3], r[4], r[5], event, a, b, c);
+		return 0;
+	}
+	
+	return 1;
+}
+
+//______________________________________________________________________________
+
+static int checks(const char *path)
+{
+	int ok = 1;
+	
+	app_init(raw_ADC);
+	
+	// a fresh ring has the init record, then 10 ticks in two records either
+	// side of the one saying it's started up, 5 ticks in (see boot.h)
+	for (int i=0; i < 10; ++i)
+	{
+		app_timer_event();
+	}
+	
+	dump();
+	
+	ok &= g_Parts == 1 && g_PartsExpected == 1 && g_RecordCount == 5;
+	ok &= g_RecordCount >= 4 && expect(g_RecordCount - 1, TRACE_INIT, 0, 0, 0) && expect(g_RecordCount - 2, TRACE_TIMER, 4, 0, 0);
+	ok &= g_RecordCount >= 4 && expect(g_RecordCount - 3, TRACE_BOOT, 2, 0, 0) && expect(g_RecordCount - 4, TRACE_TIMER, 6, 0, 0);
+	
+	// more than a ring full, ending with a known sequence
+	for (int i=0; i < 3 * TRACE_RECORDS; ++i)
+	{
+		app_midi_event(USBMIDI, CC | 3, i & 0x7F, 0);
+		app_timer_event();
+	}
+	
+	app_surface_event(TYPEPAD, 91, 127);
+	app_aftertouch_event(45, 100);
+	app_cable_event(MIDI_OUT_CABLE, 1);
+	app_timer_event();
+	app_timer_event();
+	
+	g_File = path ? fopen(path, "wb") : 0;
+	dump();
+	
+	if (g_File)
+	{
+		fclose(g_File);
+		g_File = 0;
+		printf("trace: dump written to %s\n", path);
+	}
+	
+	// the request itself is traced, but nothing after it while dumping
+	ok &= g_Parts == TRACE_RECORDS / TRACE_PART_RECORDS && g_PartsExpected == g_Parts && g_RecordCount == TRACE_RECORDS;
+	ok &= expect(0, TRACE_SYSEX, USBSTANDALONE, 0, 8);
+	ok &= expect(1, TRACE_TIMER, 2, 0, 0);
+	ok &= expect(2, TRACE_CABLE, MIDI_OUT_CABLE, 1, 0);
+	ok &= expect(3, TRACE_AFTERTOUCH, 45, 100, 0);
+	ok &= expect(4, TRACE_SURFACE, TYPEPAD, 91, 127);
+	ok &= expect(5, TRACE_TIMER, 1, 0, 0);
+	ok &= expect(6, TRACE_MIDI, USBMIDI, CC | 3, (3 * TRACE_RECORDS - 1) & 0x7F);
+	
+	// ticks count on, and so does tracing after the dump
+	const u8 *last = record(0);
+	u16 tick = last[0] | (last[1] << 8);
+	
+	ok &= tick == 10 + DUMP_TICKS + 3 * TRACE_RECORDS + 2;
+	
+	app_midi_event(DINMIDI, NOTEON, 60, 1);
+	dump();
+	ok &= expect(1, TRACE_MIDI, DINMIDI, NOTEON, 60);
+	
+	return ok;
+}
+
+static u32 g_BusyRecords = 0;
+
+// a busy tick - a few MIDI messages and some pressure
+static double busy(u8 on)
+{
+	g_BusyRecords = 0;
+	trace_enable(on);
+	sim_srand(1);
+	
+	double start = sim_now_ns();
+	
+	for (int i=0; i < TICKS; ++i)
+	{
+		u32 r = sim_rand();
+		
+		for (u32 k=0; k < (r & 3); ++k)
+		{
+			app_midi_event(USBMIDI, CC | 1, k, 0);
+		}
+		
+		if (r & 4)
+		{
+			app_aftertouch_event(ADC_MAP[(r >> 8) & 63], (r >> 16) & 0x7F);
+		}
+		
+		app_timer_event();
+		
+		// at most - quiet ticks share a record
+		g_BusyRecords += (r & 3) + ((r & 4) != 0) + 1;
+	}
+	
+	return (sim_now_ns() - start) / TICKS;
+}
+
+int sim_trace(int argc, char *argv[])
+{
+	sim_set_quiet(1);
+	sim_set_sysex_hook(on_sysex);
+	
+	int failed = !checks(argc > 0 ? argv[0] : 0);
+	printf("trace: checks %s\n", failed ? "FAILED" : "ok");
+	
+	sim_set_sysex_hook(0);
+	
+	// best of a few, alternating, so both see the same machine
+	busy(0);
+	
+	double off = 1e9;
+	double on = 1e9;
+	
+	for (int i=0; i < REPEATS; ++i)
+	{
+		double t = busy(0);
+		off = t < off ? t : off;
+		
+		t = busy(1);
+		on = t < on ? t : on;
+	}
+	
+	trace_enable(1);
+	
+	double start = sim_now_ns();
+	for (int i=0; i < RECORDS; ++i)
+	{
+		trace_end(trace_begin(TRACE_MIDI, i, i >> 8, 0));
+	}
+	double record = (sim_now_ns() - start) / RECORDS;
+	
+	// the difference between whole ticks is down in the noise, so work it
+	// out from the cost of a record too
+	double per_tick = (double)g_BusyRecords / TICKS;
+	
+	printf("trace: busy tick %.1f ns untraced, %.1f ns traced\n", off, on);
+	printf("trace: %.2f ns per record, up to %.2f records per busy tick - %.1f ns per tick\n",
+		record, per_tick, record * per_tick);
+	
+	sim_set_quiet(0);
+	return failed;
+}
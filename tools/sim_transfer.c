@@ -0,0 +1,295 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <string.h>
+#include "simulator.h"
+#include "pack7.h"
+#include "seq.h"
+#include "sysex.h"
+#include "transfer.h"
+
+// ____________________________________________________________________________
+//
+// Bulk transfer workout.  Plays the host side of the protocol in transfer.h:
+// loads a test pattern into every area the app exposes, dumps it back and
+// checks it arrived intact, then checks that corrupt and out of order chunks
+// are refused, and that a pattern doesn't play until all of it is in.  Reports messages, bytes, ticks and DIN wire time per area.
+// ____________________________________________________________________________
+
+#define AREA_COUNT		6
+#define MAX_AREA_SIZE	4096
+#define DIN_BYTES_PER_S	3125.0		// 31250 baud, 10 bits per byte
+
+static const char *AREA_NAMES[AREA_COUNT] = { "pads", "flash", "config", "animation", "pattern", "mod" };
+
+static u16 raw_ADC[PAD_COUNT];
+
+// what the app sent back
+static u8 g_Dump[MAX_AREA_SIZE];
+static int g_DumpDone = 0;
+static int g_DumpMessages = 0;
+static int g_DumpBytes = 0;
+static int g_DumpSize = 0;
+static int g_DumpErrors = 0;
+static u8 g_AckStatus = 0xFF;
+static u8 g_AckSeq = 0;
+
+// ____________________________________________________________________________
+
+static void on_sysex(u8 port, const u8 *data, u16 length)
+{
+	(void)port;
+	
+	u8 chunk[TRANSFER_CHUNK];
+	
+	switch (sysex_command(data, length))
+	{
+		case SYSEX_TRANSFER_ACK:
+		{
+			g_AckSeq = data[SYSEX_DATA + 1];
+			g_AckStatus = data[SYSEX_DATA + 2];
+		}
+		break;
+			
+		case SYSEX_TRANSFER_DATA:
+		{
+			const u8 *d = data + SYSEX_DATA;
+			u16 offset = (d[3] << 7) | d[4];
+			u16 n = (d[5] << 7) | d[6];
+			const u8 *c = data + length - 4;
+			
+			unpack7(chunk, d + 7, n);
+			
+			if (((c[0] << 14) | (c[1] << 7) | c[2]) != transfer_crc(chunk, n) || d[1] != g_DumpMessages)
+			{
+				++g_DumpErrors;
+			}
+			
+			if (offset + n <= sizeof(g_Dump))
+			{
+				memcpy(g_Dump + offset, chunk, n);
+			}
+			g_DumpSize = offset + n;
+			
+			++g_DumpMessages;
+			g_DumpBytes += length;
+			g_DumpDone = d[2] & TRANSFER_FLAG_LAST;
+		}
+		break;
+	}
+}
+
+// build one DATA message, host side
+static u16 build_data(u8 *msg, u8 area, u8 seq, u8 last, u16 offset, const u8 *data, u16 length)
+{
+	u16 n = sysex_begin(msg, SYSEX_TRANSFER_DATA);
+	
+	msg[n++] = area;
+	msg[n++] = seq;
+	msg[n++] = last ? TRANSFER_FLAG_LAST : 0;
+	msg[n++] = offset >> 7;
+	msg[n++] = offset & 0x7F;
+	msg[n++] = length >> 7;
+	msg[n++] = length & 0x7F;
+	
+	pack7(msg + n, data, length);
+	n += PACK7_SIZE(length);
+	
+	u16 crc = transfer_crc(data, length);
+	msg[n++] = crc >> 14;
+	msg[n++] = (crc >> 7) & 0x7F;
+	msg[n++] = crc & 0x7F;
+	msg[n++] = 0xF7;
+	
+	return n;
+}
+
+static void dump(u8 area)
+{
+	u8 request[] = {0xF0, 0x00, 0x20, 0x29, 0x02, 0x10, SYSEX_TRANSFER_DUMP, area, 0xF7};
+	
+	g_DumpDone = 0;
+	g_DumpMessages = 0;
+	g_DumpBytes = sizeof(request);
+	g_DumpErrors = 0;
+	g_DumpSize = 0;
+	memset(g_Dump, 0, sizeof(g_Dump));
+	
+	app_sysex_event(USBSTANDALONE, request, sizeof(request));
+}
+
+// dumps stream one chunk per tick - returns the number of ticks
+static int finish_dump()
+{
+	int ticks = 0;
+	
+	while (!g_DumpDone && ticks < 100)
+	{
+		app_timer_event();
+		++ticks;
+	}
+	
+	return ticks;
+}
+
+
+// ____________________________________________________________________________
+
+int sim_transfer(int argc, char *argv[])
+{
+	(void)argc;
+	(void)argv;
+	
+	u8 msg[SYSEX_MAX_SIZE];
+	u8 pattern[MAX_AREA_SIZE];
+	int failed = 0;
+	
+	sim_set_sysex_hook(on_sysex);
+	app_init(raw_ADC);
+	
+	printf("\ntransfer: area    bytes  load msgs  dump msgs  wire bytes  ticks  DIN ms  host us\n");
+	
+	for (u8 area=0; area < AREA_COUNT; ++area)
+	{
+		// find out how big the area is, and what's in it, from a dump
+		dump(area);
+		finish_dump();
+		
+		u16 size = g_DumpSize;
+		
+		if (area == 2)
+		{
+			// settings must stay sensible, so load back what we found
+			memcpy(pattern, g_Dump, size);
+		}
+		else
+		{
+			for (u16 i=0; i < size; ++i)
+			{
+				pattern[i] = area == 0 ? ((i * 7) & 1) * MAXLED : (i * 37 + area) & 0xFF;
+			}
+		}
+		
+		double start = sim_now_ns();
+		
+		// load
+		int load_msgs = 0;
+		int wire = 0;
+		
+		for (u16 offset=0; offset < size; offset += TRANSFER_CHUNK)
+		{
+			u16 n = size - offset < TRANSFER_CHUNK ? size - offset : TRANSFER_CHUNK;
+			u16 length = build_data(msg, area, load_msgs, offset + n >= size, offset, pattern + offset, n);
+			
+			g_AckStatus = 0xFF;
+			app_sysex_event(USBSTANDALONE, msg, length);
+			
+			if (g_AckStatus != TRANSFER_OK)
+			{
+				printf("transfer: %s chunk %d refused, status %d\n", AREA_NAMES[area], load_msgs, g_AckStatus);
+				failed = 1;
+			}
+			
+			++load_msgs;
+			wire += length + SYSEX_DATA + 4;
+		}
+		
+		// dump it back
+		dump(area);
+		int ticks = finish_dump();
+		
+		double us = (sim_now_ns() - start) / 1000;
+		wire += g_DumpBytes;
+		
+		if (!g_DumpDone || g_DumpErrors || g_DumpSize != size || memcmp(g_Dump, pattern, size) != 0)
+		{
+			printf("transfer: %s round trip failed\n", AREA_NAMES[area]);
+			failed = 1;
+		}
+		
+		printf("transfer: %-6s %6d  %9d  %9d  %10d  %5d  %6.1f  %7.1f\n",
+			   AREA_NAMES[area], size, load_msgs, g_DumpMessages, wire, ticks, 1000 * wire / DIN_BYTES_PER_S, us);
+	}
+	
+	// a corrupt chunk is refused, and so is one out of sequence
+	u16 length = build_data(msg, 1, 0, 0, 0, pattern, TRANSFER_CHUNK);
+	msg[SYSEX_DATA + 10] ^= 0x01;
+	app_sysex_event(USBSTANDALONE, msg, length);
+	
+	if (g_AckStatus != TRANSFER_BAD_CRC)
+	{
+		printf("transfer: corrupt chunk not refused\n");
+		failed = 1;
+	}
+	
+	length = build_data(msg, 1, 5, 0, 0, pattern, TRANSFER_CHUNK);
+	app_sysex_event(USBSTANDALONE, msg, length);
+	
+	if (g_AckStatus != TRANSFER_BAD_SEQ || g_AckSeq != 0)
+	{
+		printf("transfer: out of sequence chunk not refused\n");
+		failed = 1;
+	}
+	
+	// a pattern loaded over several chunks, with ticks in between, holds the
+	// sequencer until the last one lands - it doesn't play half old, half new
+	u16 size = sizeof(SeqPattern);
+	int held = 1;
+	u8 seq = 0;
+	
+	for (u16 offset=0; offset < size; offset += TRANSFER_CHUNK, ++seq)
+	{
+		u16 n = size - offset < TRANSFER_CHUNK ? size - offset : TRANSFER_CHUNK;
+		length = build_data(msg, 4, seq, offset + n >= size, offset, pattern + offset, n);
+		app_sysex_event(USBSTANDALONE, msg, length);
+		
+		if (offset + n < size)
+		{
+			app_timer_event();
+			held &= !seq_running();
+		}
+	}
+	
+	if (seq < 2 || !held || !seq_running())
+	{
+		printf("transfer: pattern %s while loading - FAILED\n", held ? "doesn't start after" : "plays");
+		failed = 1;
+	}
+	
+	printf("transfer: %s\n", failed ? "FAILED" : "ok");
+	
+	sim_set_sysex_hook(0);
+	return failed;
+}
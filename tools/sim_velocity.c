@@ -0,0 +1,304 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "simulator.h"
+#include "velocity.h"
+
+// ____________________________________________________________________________
+//
+// Velocity engine workout.  Plays strikes into the engine one ADC frame per
+// tick and, for every window length, reports how far the estimate is from the
+// expected velocity against how long it took to arrive.
+//
+// With no arguments the strikes are synthetic: a smoothstep rise with random
+// strength, sub-tick phase and noise.  The expected velocity is the steepest
+// one-tick rise of the noise-free samples - the best any estimator could read
+// at 1kHz.
+// Given a recorded trace (one tick per line, PAD_COUNT ADC values in ADC
+// order) the truth isn't known, so the longest window is used as reference.
+// ____________________________________________________________________________
+
+#define MAX_PER_PAD		256
+#define SYNTH_TICKS		10000
+#define NOISE			12
+
+static u8 g_Expected[PAD_COUNT][MAX_PER_PAD];
+static int g_ExpectedCount[PAD_COUNT];
+
+// results of the current run
+static u8 g_Estimate[PAD_COUNT][MAX_PER_PAD];
+static u8 g_Latency[PAD_COUNT][MAX_PER_PAD];
+static int g_Count[PAD_COUNT];
+
+static u8 g_LedToAdc[100];
+
+static u16 *g_Trace = 0;
+static int g_TraceTicks = 0;
+
+// ____________________________________________________________________________
+
+static void on_note(u8 index, u8 velocity)
+{
+	u8 pad = g_LedToAdc[index];
+	
+	if (velocity && g_Count[pad] < MAX_PER_PAD)
+	{
+		g_Estimate[pad][g_Count[pad]] = velocity;
+		g_Latency[pad][g_Count[pad]] = velocity_latency(pad);
+		++g_Count[pad];
+	}
+}
+
+static double smoothstep(double x)
+{
+	return x * x * (3 - 2 * x);
+}
+
+static void synthesise(void)
+{
+	g_TraceTicks = SYNTH_TICKS;
+	g_Trace = calloc(g_TraceTicks * PAD_COUNT, sizeof(u16));
+	
+	for (int pad=0; pad < PAD_COUNT; ++pad)
+	{
+		double t0 = 5 + (sim_rand() % 4000) / 100.0;
+		
+		g_ExpectedCount[pad] = 0;
+		
+		while (t0 + 80 < g_TraceTicks && g_ExpectedCount[pad] < MAX_PER_PAD)
+		{
+			int v = 4 + sim_rand() % 124;
+			
+			// harder strikes rise faster - pick the peak so the steepest slope,
+			// 1.5 * peak / rise, lands roughly on the velocity
+			double rise = 2 + (127 - v) * 6.0 / 127;
+			double peak = (v << VELOCITY_SLOPE_SHIFT) * rise / 1.5;
+			double hold = 10 + sim_rand() % 40;
+			double release = 3;
+			double end = t0 + rise + hold + release;
+			double last = 0;
+			double steepest = 0;
+			
+			for (int k = (int)t0 + 1; k < end; ++k)
+			{
+				double t = k - t0;
+				double p = 0;
+				
+				if (t < rise)
+				{
+					p = peak * smoothstep(t / rise);
+				}
+				else if (t < rise + hold)
+				{
+					p = peak;
+				}
+				else
+				{
+					p = peak * (1 - (t - rise - hold) / release);
+				}
+				
+				if (p - last > steepest)
+				{
+					steepest = p - last;
+				}
+				last = p;
+				
+				p += (int)(sim_rand() % (2 * NOISE + 1)) - NOISE;
+				
+				g_Trace[k * PAD_COUNT + pad] = p < 0 ? 0 : p > 4095 ? 4095 : (u16)p;
+			}
+			
+			int expected = (int)steepest >> VELOCITY_SLOPE_SHIFT;
+			g_Expected[pad][g_ExpectedCount[pad]++] = expected < 1 ? 1 : expected > 127 ? 127 : expected;
+			t0 = end + 5 + (sim_rand() % 2000) / 100.0;
+		}
+	}
+}
+
+static int load_trace(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	
+	if (!f)
+	{
+		printf("can't open trace %s\n", path);
+		return 0;
+	}
+	
+	int capacity = 1024;
+	g_Trace = malloc(capacity * PAD_COUNT * sizeof(u16));
+	g_TraceTicks = 0;
+	
+	unsigned int value;
+	int n = 0;
+	
+	while (fscanf(f, "%u", &value) == 1)
+	{
+		if (g_TraceTicks == capacity)
+		{
+			capacity *= 2;
+			g_Trace = realloc(g_Trace, capacity * PAD_COUNT * sizeof(u16));
+		}
+		
+		g_Trace[g_TraceTicks * PAD_COUNT + n] = value > 4095 ? 4095 : value;
+		
+		if (++n == PAD_COUNT)
+		{
+			n = 0;
+			++g_TraceTicks;
+		}
+	}
+	
+	fclose(f);
+	return g_TraceTicks;
+}
+
+// play the whole trace through the engine, returns ns per frame
+static double play(u8 window)
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		g_Count[i] = 0;
+	}
+	
+	velocity_init(on_note);
+	velocity_set_curve(VELOCITY_CURVE_LINEAR);
+	velocity_set_window(window);
+	
+	double start = sim_now_ns();
+	
+	for (int k=0; k < g_TraceTicks; ++k)
+	{
+		velocity_scan(g_Trace + k * PAD_COUNT);
+	}
+	
+	return (sim_now_ns() - start) / g_TraceTicks;
+}
+
+// ____________________________________________________________________________
+
+int sim_velocity(int argc, char *argv[])
+{
+	for (int i=0; i < PAD_COUNT; ++i)
+	{
+		g_LedToAdc[ADC_MAP[i]] = i;
+	}
+	
+	if (argc > 0)
+	{
+		if (!load_trace(argv[0]))
+		{
+			return 1;
+		}
+		
+		// the longest window reads the most of each rise, so compare against it
+		play(VELOCITY_MAX_WINDOW);
+		
+		for (int pad=0; pad < PAD_COUNT; ++pad)
+		{
+			g_ExpectedCount[pad] = g_Count[pad];
+			
+			for (int n=0; n < g_Count[pad]; ++n)
+			{
+				g_Expected[pad][n] = g_Estimate[pad][n];
+			}
+		}
+		
+		printf("velocity: %d ticks from %s, reference is window %d\n", g_TraceTicks, argv[0], VELOCITY_MAX_WINDOW);
+	}
+	else
+	{
+		sim_srand(1);
+		synthesise();
+		
+		printf("velocity: %d ticks of synthetic strikes, noise +/-%d\n", g_TraceTicks, NOISE);
+	}
+	
+	printf("window  strikes  missed  mean err  max err  mean latency  max latency  ns/frame\n");
+	
+	for (u8 window=1; window <= VELOCITY_MAX_WINDOW; ++window)
+	{
+		double ns = play(window);
+		
+		int strikes = 0;
+		int missed = 0;
+		int total_err = 0;
+		int max_err = 0;
+		int total_latency = 0;
+		int max_latency = 0;
+		
+		for (int pad=0; pad < PAD_COUNT; ++pad)
+		{
+			// count extra or missing note-ons, then compare what lines up
+			int n = g_Count[pad] < g_ExpectedCount[pad] ? g_Count[pad] : g_ExpectedCount[pad];
+			missed += abs(g_Count[pad] - g_ExpectedCount[pad]);
+			
+			for (int i=0; i < n; ++i)
+			{
+				int err = abs(g_Estimate[pad][i] - g_Expected[pad][i]);
+				int latency = g_Latency[pad][i];
+				
+				total_err += err;
+				total_latency += latency;
+				max_err = err > max_err ? err : max_err;
+				max_latency = latency > max_latency ? latency : max_latency;
+				++strikes;
+			}
+		}
+		
+		if (strikes == 0)
+		{
+			printf("%6d  no strikes detected\n", window);
+			continue;
+		}
+		
+		printf("%6d  %7d  %6d  %8.2f  %7d  %12.2f  %11d  %8.1f\n",
+			   window, strikes, missed,
+			   (double)total_err / strikes, max_err,
+			   (double)total_latency / strikes, max_latency, ns);
+		
+		// the window is a hard bound on latency - anything else is a bug
+		if (max_latency > window)
+		{
+			printf("velocity: latency %d exceeds window %d\n", max_latency, window);
+			free(g_Trace);
+			return 1;
+		}
+	}
+	
+	free(g_Trace);
+	return 0;
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#include "simlog.h"
+
+// ____________________________________________________________________________
+//
+// The text log.  The simulator prints through this too, so a decoded binary
+// log matches a text one byte for byte.
+// ____________________________________________________________________________
+
+void simlog_print(FILE *file, const SimLogRecord *r)
+{
+	switch (r->kind)
+	{
+		case SIMLOG_INIT:
+			fprintf(file, "calling app_init()...\n");
+			break;
+			
+		case SIMLOG_SURFACE:
+			fprintf(file, "calling sim_app_surface_event(%d, %d, %d)...\n", r->a, r->b, r->c);
+			break;
+			
+		case SIMLOG_MIDI:
+			fprintf(file, "calling app_midi_event(%d, 0x%2.2x, 0x%2.2x, 0x%2.2x)...\n", r->a, r->b, r->c, r->x);
+			break;
+			
+		case SIMLOG_TIMER:
+			fprintf(file, "calling app_timer_event()...\n");
+			break;
+			
+		case SIMLOG_TIMERS:
+			fprintf(file, "sending %d timer events via app_timer_event()...\n", r->x);
+			break;
+			
+		case SIMLOG_SEND_MIDI:
+			fprintf(file, "...hal_send_midi(%d, 0x%2.2x, 0x%2.2x, 0x%2.2x);\n", r->a, r->b, r->c, r->x);
+			break;
+			
+		case SIMLOG_SEND_SYSEX:
+			fprintf(file, "...hal_send_midi(%d, (data), %d);\n", r->a, r->x);
+			break;
+			
+		case SIMLOG_READ_FLASH:
+			fprintf(file, "...hal_read_flash(%d, (data), %d);\n", r->x, r->y);
+			break;
+			
+		case SIMLOG_WRITE_FLASH:
+			fprintf(file, "...hal_write_flash(%d, (data), %d);\n", r->x, r->y);
+			break;
+			
+		case SIMLOG_SYSEX:
+			fprintf(file, "calling app_sysex_event(%d, (data), %d)...\n", r->a, r->x);
+			break;
+			
+		case SIMLOG_AFTERTOUCH:
+			fprintf(file, "calling app_aftertouch_event(%d, %d)...\n", r->a, r->b);
+			break;
+			
+		default:
+			fprintf(file, "(unknown record %d)\n", r->kind);
+			break;
+	}
+}
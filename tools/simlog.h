@@ -0,0 +1,90 @@
+#ifndef LAUNCHPAD_SIMLOG_H
+#define LAUNCHPAD_SIMLOG_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// The simulator's binary log.  Formatting a line of text for every HAL call
+// and app event is most of what a long simulation spends its time on, so with
+// "simulator -l file" each one is instead stored as a fixed size record in a
+// big buffer, which goes out to the file in large writes.  tools/logdump.c
+// turns a log back into exactly the text the simulator would have printed.
+//
+// A log is a SimLogHeader followed by records, in host byte order.
+// ____________________________________________________________________________
+
+#include <stdio.h>
+#include "app_defs.h"
+
+#define SIMLOG_MAGIC		"LPSL"
+#define SIMLOG_VERSION		1
+
+typedef struct
+{
+	char magic[4];
+	u8 version;
+	u8 record_size;
+	u16 reserved;
+} SimLogHeader;
+
+// what a record is - the numbers say what goes in a, b, c, x and y
+#define SIMLOG_INIT			0	// app_init()
+#define SIMLOG_SURFACE		1	// app_surface_event(a, b, c)
+#define SIMLOG_MIDI			2	// app_midi_event(a, b, c, x)
+#define SIMLOG_TIMER		3	// app_timer_event()
+#define SIMLOG_TIMERS		4	// about to send x timer events
+#define SIMLOG_SEND_MIDI	5	// hal_send_midi(a, b, c, x)
+#define SIMLOG_SEND_SYSEX	6	// hal_send_sysex(a, data, x)
+#define SIMLOG_READ_FLASH	7	// hal_read_flash(x, data, y)
+#define SIMLOG_WRITE_FLASH	8	// hal_write_flash(x, data, y)
+#define SIMLOG_SYSEX		9	// app_sysex_event(a, data, x)
+#define SIMLOG_AFTERTOUCH	10	// app_aftertouch_event(a, b)
+#define SIMLOG_KIND_COUNT	11
+
+typedef struct
+{
+	u8 kind;
+	u8 a;
+	u8 b;
+	u8 c;
+	u16 x;		// flash offsets and lengths fit, as the user area is 1K
+	u16 y;
+} SimLogRecord;
+
+/**
+ * Print a record as a line of the simulator's text log.
+ */
+void simlog_print(FILE *file, const SimLogRecord *record);
+
+#endif
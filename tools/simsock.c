@@ -0,0 +1,224 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "simsock.h"
+
+// ____________________________________________________________________________
+//
+// Framing
+// ____________________________________________________________________________
+
+void simsock_open(SimSock *sock, int fd)
+{
+	memset(sock, 0, sizeof(*sock));
+	sock->fd = fd;
+}
+
+int simsock_put(SimSock *sock, u8 kind, const u8 *payload, u16 length)
+{
+	if (SIMSOCK_HEADER + length > SIMSOCK_MAX_FRAME)
+	{
+		return 0;
+	}
+	
+	if (sock->out_count + SIMSOCK_HEADER + length > SIMSOCK_BUFFER && !simsock_flush(sock))
+	{
+		return 0;
+	}
+	
+	u8 *frame = sock->out + sock->out_count;
+	
+	frame[0] = kind;
+	frame[1] = length & 0xFF;
+	frame[2] = length >> 8;
+	memcpy(frame + SIMSOCK_HEADER, payload, length);
+	
+	sock->out_count += SIMSOCK_HEADER + length;
+	sock->frames_out++;
+	
+	return 1;
+}
+
+int simsock_flush(SimSock *sock)
+{
+	u32 sent = 0;
+	
+	while (sent < sock->out_count)
+	{
+		// no SIGPIPE if the driver has gone, just a failed send
+		ssize_t n = send(sock->fd, sock->out + sent, sock->out_count - sent, MSG_NOSIGNAL);
+		
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		
+		if (n <= 0)
+		{
+			sock->out_count = 0;
+			return 0;
+		}
+		
+		sent += n;
+		sock->writes++;
+	}
+	
+	sock->out_count = 0;
+	return 1;
+}
+
+int simsock_read(SimSock *sock, simsock_handler handler, void *context)
+{
+	ssize_t n;
+	
+	do
+	{
+		n = read(sock->fd, sock->in + sock->in_count, SIMSOCK_BUFFER - sock->in_count);
+	}
+	while (n < 0 && errno == EINTR);
+	
+	if (n <= 0)
+	{
+		return 0;
+	}
+	
+	sock->reads++;
+	sock->in_count += n;
+	
+	// hand on every whole frame - the buffer is much bigger than a frame, so
+	// a part frame left at the end always has room to finish
+	u32 at = 0;
+	
+	while (sock->in_count - at >= SIMSOCK_HEADER)
+	{
+		const u8 *frame = sock->in + at;
+		u16 length = frame[1] | (frame[2] << 8);
+		
+		if (SIMSOCK_HEADER + length > SIMSOCK_MAX_FRAME)
+		{
+			return 0;
+		}
+		
+		if (sock->in_count - at < (u32)SIMSOCK_HEADER + length)
+		{
+			break;
+		}
+		
+		sock->frames_in++;
+		handler(context, frame[0], frame + SIMSOCK_HEADER, length);
+		at += SIMSOCK_HEADER + length;
+	}
+	
+	memmove(sock->in, sock->in + at, sock->in_count - at);
+	sock->in_count -= at;
+	
+	return 1;
+}
+
+// ____________________________________________________________________________
+//
+// Connecting
+// ____________________________________________________________________________
+
+static int address(struct sockaddr_un *addr, const char *path)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	
+	if (strlen(path) >= sizeof(addr->sun_path))
+	{
+		return 0;
+	}
+	
+	strcpy(addr->sun_path, path);
+	return 1;
+}
+
+int simsock_accept(const char *path)
+{
+	struct sockaddr_un addr;
+	
+	if (!address(&addr, path))
+	{
+		return -1;
+	}
+	
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	
+	if (listener < 0)
+	{
+		return -1;
+	}
+	
+	unlink(path);
+	
+	if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 1) < 0)
+	{
+		close(listener);
+		return -1;
+	}
+	
+	// one driver at a time, like one USB host
+	int fd = accept(listener, 0, 0);
+	
+	close(listener);
+	unlink(path);
+	
+	return fd;
+}
+
+int simsock_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	
+	if (!address(&addr, path))
+	{
+		return -1;
+	}
+	
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	
+	if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	
+	return fd;
+}
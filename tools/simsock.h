@@ -0,0 +1,124 @@
+#ifndef LAUNCHPAD_SIMSOCK_H
+#define LAUNCHPAD_SIMSOCK_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// The simulator's socket transport.  "simulator serve path" stands in for the
+// hardware and its USB MIDI ports: a test driver connects to a UNIX domain
+// socket and sends it MIDI, pad and SysEx events, and gets back everything the
+// app sends and every LED it changes.
+//
+// Both ways the stream is frames, each a kind byte, a little endian u16 payload
+// length and the payload.  Frames are batched - a writer queues as many as it
+// likes and sends them with one write, and a reader takes whatever one read
+// brings, so hundreds of messages cost a syscall each way and not hundreds.
+// That makes it easy to drive from anything, e.g. in Python:
+//
+//   s.sendall(bytes([SIMSOCK_MIDI, 4, 0, USBMIDI, 0x90, 60, 100]))
+// ____________________________________________________________________________
+
+#include "app_defs.h"
+
+// what a frame is - the payload, both ways unless marked
+#define SIMSOCK_MIDI		0	// port, status, d1, d2
+#define SIMSOCK_SYSEX		1	// port, then the message, F0 to F7
+#define SIMSOCK_SURFACE		2	// type, index, value - to the app only
+#define SIMSOCK_AFTERTOUCH	3	// index, value - to the app only
+#define SIMSOCK_TICKS		4	// u16 count - to the app only, runs that many timer events
+#define SIMSOCK_LED			5	// type, index, red, green, blue - from the app only
+#define SIMSOCK_SYNC		6	// u32 token - echoed once all the frames before it are done
+
+#define SIMSOCK_HEADER		3
+#define SIMSOCK_MAX_FRAME	(SIMSOCK_HEADER + 2048)
+
+// big enough for a few hundred frames in one write
+#define SIMSOCK_BUFFER		65536
+
+typedef struct
+{
+	int fd;
+	u8 out[SIMSOCK_BUFFER];
+	u32 out_count;
+	u8 in[SIMSOCK_BUFFER];
+	u32 in_count;
+	
+	// for the benchmark
+	u32 reads;
+	u32 writes;
+	u32 frames_in;
+	u32 frames_out;
+} SimSock;
+
+/**
+ * Called by simsock_read for each whole frame that arrives.
+ */
+typedef void (*simsock_handler)(void *context, u8 kind, const u8 *payload, u16 length);
+
+/**
+ * Set up a connection on an open socket.
+ */
+void simsock_open(SimSock *sock, int fd);
+
+/**
+ * Queue a frame, sending what's queued first if it won't fit.  Returns 0 if the
+ * frame is too big or the send failed.
+ */
+int simsock_put(SimSock *sock, u8 kind, const u8 *payload, u16 length);
+
+/**
+ * Send everything queued with one write (or a few, if the socket is full).
+ * Returns 0 if the other end has gone.
+ */
+int simsock_flush(SimSock *sock);
+
+/**
+ * Wait for data, then hand every whole frame it brings to the handler, keeping
+ * any part frame for next time.  Returns 0 when the other end hangs up or
+ * sends nonsense.
+ */
+int simsock_read(SimSock *sock, simsock_handler handler, void *context);
+
+/**
+ * Listen on a UNIX domain socket at the path, replacing any old one, and wait
+ * for a driver to connect.  Returns the connection, or -1.
+ */
+int simsock_accept(const char *path);
+
+/**
+ * Connect to a simulator listening on the path.  Returns the socket, or -1.
+ */
+int simsock_connect(const char *path);
+
+#endif
@@ -30,81 +30,362 @@
  
  *****************************************************************************/
 
+#define _POSIX_C_SOURCE 199309L
+
 #include <stdio.h>
-#include "app.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "instance.h"
+#include "simlog.h"
+#include "simulator.h"
 
 // ____________________________________________________________________________
 //
 // Simulator "hal".  This lets you exercise your device code without having to upload
 // it to the hardware, which also means you can debug it interactively.
+//
+// Like the app's state, the hal's is per thread (see instance.h), so each
+// thread is a separate Launchpad with its own LEDs, flash and hooks.
 // ____________________________________________________________________________
 
+// benchmarks turn off the logging, so they measure the app and not printf
+static INSTANCE int g_Quiet = 0;
+
+void sim_set_quiet(int quiet)
+{
+	g_Quiet = quiet;
+}
+
+// the log goes to the console as text unless given a file, and can be binary
+// records (see simlog.h), which are buffered per thread and written in chunks
+#define LOG_CHUNK 65536
+
+static int g_LogLevel = SIM_LOG_ALL;
+static FILE *g_LogFile = 0;
+static int g_LogBinary = 0;
+
+static INSTANCE SimLogRecord *g_LogBuffer = 0;
+static INSTANCE int g_LogCount = 0;
+
+void sim_set_log_level(int level)
+{
+	g_LogLevel = level;
+}
+
+void sim_set_log_file(FILE *file, int binary)
+{
+	sim_log_flush();
+	
+	g_LogFile = file;
+	g_LogBinary = file && binary;
+	
+	if (g_LogBinary)
+	{
+		SimLogHeader header = { SIMLOG_MAGIC, SIMLOG_VERSION, sizeof(SimLogRecord), 0 };
+		fwrite(&header, sizeof(header), 1, file);
+	}
+}
+
+static void write_log(void)
+{
+	// stdio locks around each fwrite, so threads' chunks don't get mixed up
+	if (g_LogCount && g_LogFile)
+	{
+		fwrite(g_LogBuffer, sizeof(SimLogRecord), g_LogCount, g_LogFile);
+	}
+	
+	g_LogCount = 0;
+}
+
+void sim_log_flush(void)
+{
+	// the thread's finishing with the log, so let go of its buffer too
+	write_log();
+	
+	free(g_LogBuffer);
+	g_LogBuffer = 0;
+}
+
+static void log_record(int level, u8 kind, u8 a, u8 b, u8 c, u16 x, u16 y)
+{
+	if (g_Quiet || level > g_LogLevel)
+	{
+		return;
+	}
+	
+	SimLogRecord record = { kind, a, b, c, x, y };
+	
+	if (!g_LogBinary)
+	{
+		simlog_print(g_LogFile ? g_LogFile : stdout, &record);
+		return;
+	}
+	
+	if (!g_LogBuffer)
+	{
+		g_LogBuffer = malloc(LOG_CHUNK * sizeof(SimLogRecord));
+	}
+	
+	g_LogBuffer[g_LogCount] = record;
+	
+	if (++g_LogCount == LOG_CHUNK)
+	{
+		write_log();
+	}
+}
+
+// what the LEDs are showing, so workouts can check what the app drew
+static INSTANCE u8 g_Leds[100][3];
+static INSTANCE u8 g_SetupLed[3];
+static INSTANCE sim_led_hook g_LedHook = 0;
+
+void sim_set_led_hook(sim_led_hook hook)
+{
+	g_LedHook = hook;
+}
+
 void hal_plot_led(u8 type, u8 index, u8 red, u8 green, u8 blue)
 {
     // wire this up to MIDI out...?
+    u8 *led = type == TYPESETUP ? g_SetupLed : g_Leds[index % 100];
+    
+    led[0] = red;
+    led[1] = green;
+    led[2] = blue;
+    
+    if (g_LedHook)
+    {
+        g_LedHook(type, index, red, green, blue);
+    }
 }
 
 void hal_read_led(u8 type, u8 index, u8 *red, u8 *green, u8 *blue)
 {
+    const u8 *led = type == TYPESETUP ? g_SetupLed : g_Leds[index % 100];
+    
+    *red = led[0];
+    *green = led[1];
+    *blue = led[2];
+}
+
+static INSTANCE sim_midi_hook g_MidiHook = 0;
+static INSTANCE sim_sysex_hook g_SysexHook = 0;
+
+void sim_set_midi_hook(sim_midi_hook hook)
+{
+	g_MidiHook = hook;
 }
 
 void hal_send_midi(u8 port, u8 status, u8 d1, u8 d2)
 {
 	// send this up a virtual MIDI port?
-	printf("...hal_send_midi(%d, 0x%2.2x, 0x%2.2x, 0x%2.2x);\n", port, status, d1, d2);
+	log_record(SIM_LOG_ALL, SIMLOG_SEND_MIDI, port, status, d1, d2, 0);
+	
+	if (g_MidiHook)
+	{
+		g_MidiHook(port, status, d1, d2);
+	}
+}
+
+void sim_set_sysex_hook(sim_sysex_hook hook)
+{
+	g_SysexHook = hook;
 }
 
 void hal_send_sysex(u8 port, const u8* data, u16 length)
 {
 	// as above, or just dump to console?
-	printf("...hal_send_midi(%d, (data), %d);\n", port, length);
+	log_record(SIM_LOG_ALL, SIMLOG_SEND_SYSEX, port, 0, 0, length, 0);
+	
+	if (g_SysexHook)
+	{
+		g_SysexHook(port, data, length);
+	}
+}
+
+// like a fresh device, flash reads 0xFF until written
+static INSTANCE u8 g_Flash[USER_AREA_SIZE];
+static INSTANCE int g_FlashErased = 0;
+
+static void erase_flash()
+{
+	if (!g_FlashErased)
+	{
+		memset(g_Flash, 0xFF, USER_AREA_SIZE);
+		g_FlashErased = 1;
+	}
 }
 
 void hal_read_flash(u32 offset, u8 *data, u32 length)
 {
-	printf("...hal_read_flash(%lu, (data), %lu);\n", offset, length);
+	log_record(SIM_LOG_ALL, SIMLOG_READ_FLASH, 0, 0, 0, offset, length);
+	
+	erase_flash();
+	if (offset < USER_AREA_SIZE)
+	{
+		memcpy(data, g_Flash + offset, length < USER_AREA_SIZE - offset ? length : USER_AREA_SIZE - offset);
+	}
 }
 
 void hal_write_flash(u32 offset,const u8 *data, u32 length)
 {
-	printf("...hal_write_flash(%lu, (data), %lu);\n", offset, length);
+	log_record(SIM_LOG_ALL, SIMLOG_WRITE_FLASH, 0, 0, 0, offset, length);
+	
+	erase_flash();
+	if (offset < USER_AREA_SIZE)
+	{
+		memcpy(g_Flash + offset, data, length < USER_AREA_SIZE - offset ? length : USER_AREA_SIZE - offset);
+	}
 }
 
 // ____________________________________________________________________________
 //
-// App event wrappers - these just log to the console.  Would be nice to wire
-// these up to a MIDI input from the real Launchpad Pro!
+// App event wrappers - these just log.  Would be nice to wire these up to a
+// MIDI input from the real Launchpad Pro!
 // ____________________________________________________________________________
 
-static u16 raw_ADC[64];
+static INSTANCE u16 raw_ADC[64];
 
-static void sim_app_init()
+void sim_app_init(void)
 {
-	printf("calling app_init()...\n");
+	log_record(SIM_LOG_EVENTS, SIMLOG_INIT, 0, 0, 0, 0, 0);
 	app_init(raw_ADC);
 }
 
-static void sim_app_surface_event(u8 type, u8 index, u8 value)
+void sim_app_surface_event(u8 type, u8 index, u8 value)
 {
-	printf("calling sim_app_surface_event(%d, %d, %d)...\n", type, index, value);
+	log_record(SIM_LOG_EVENTS, SIMLOG_SURFACE, type, index, value, 0, 0);
 	app_surface_event(type, index, value);
 }
 
-static void sim_app_midi_event(u8 port, u8 status, u8 d1, u8 d2)
+void sim_app_midi_event(u8 port, u8 status, u8 d1, u8 d2)
 {
-	printf("calling app_midi_event(%d, 0x%2.2x, 0x%2.2x, 0x%2.2x)...\n", port, status, d1, d2);
+	log_record(SIM_LOG_EVENTS, SIMLOG_MIDI, port, status, d1, d2, 0);
 	app_midi_event(port, status, d1, d2);
 }
 
-static void sim_app_timer_event()
+void sim_app_sysex_event(u8 port, u8 *data, u16 count)
+{
+	log_record(SIM_LOG_EVENTS, SIMLOG_SYSEX, port, 0, 0, count, 0);
+	app_sysex_event(port, data, count);
+}
+
+void sim_app_aftertouch_event(u8 index, u8 value)
 {
-	printf("calling app_timer_event()...\n");
+	log_record(SIM_LOG_EVENTS, SIMLOG_AFTERTOUCH, index, value, 0, 0, 0);
+	app_aftertouch_event(index, value);
+}
+
+void sim_app_timer_event(void)
+{
+	log_record(SIM_LOG_EVENTS, SIMLOG_TIMER, 0, 0, 0, 0, 0);
 	app_timer_event();
 }
 
+// ____________________________________________________________________________
+//
+// Helpers shared by the workouts
 // ____________________________________________________________________________
 
-int main(int argc, char * argv[])
+double sim_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+u64 sim_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	u32 lo, hi;
+	__asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	
+	return ((u64)hi << 32) | (lo & 0xFFFFFFFF);
+#else
+	return 0;
+#endif
+}
+
+static INSTANCE u32 g_Seed = 0x12345678;
+
+void sim_srand(u32 seed)
+{
+	g_Seed = seed ? seed : 0x12345678;
+}
+
+u32 sim_rand(void)
+{
+	// xorshift32 - u32 is wider than 32 bits on some hosts, so keep it masked
+	g_Seed ^= (g_Seed << 13) & 0xFFFFFFFF;
+	g_Seed ^= g_Seed >> 17;
+	g_Seed ^= (g_Seed << 5) & 0xFFFFFFFF;
+	
+	return g_Seed;
+}
+
+// ____________________________________________________________________________
+
+static const SimWorkout WORKOUTS[] =
+{
+	{ "anim", sim_anim, "            light show encoding and playback checks, compression ratio and decode cost per frame" },
+	{ "arena", sim_arena, "           what app_init claims from the arena, allocator and pool checks, cost of a pool block" },
+	{ "arp", sim_arp, "             chord and arpeggiator checks, and worst case cost per tick" },
+	{ "blit", sim_blit, "            full-frame LED blit - bytes, decode cost and frame rate for a few animations" },
+	{ "boot", sim_boot, "            time to first light and to ready after app_init, start up checks" },
+	{ "capacity", sim_capacity, "[least] highest input event rate the app sustains with every pad held, and what gives first" },
+	{ "golden", sim_golden, "[record]  LED and MIDI output digests of 2048 scenarios, checked against tools/golden.txt" },
+	{ "grid", sim_grid, "            bitboard checks against per-index loops, and the cost of each both ways" },
+	{ "handoff", sim_handoff, "         events interrupting the timer's drawing and vice versa - checks for torn frames, and the cost" },
+	{ "latency", sim_latency, "[p99 ms] pad, button and MIDI to hal_send_midi latency histograms, failing over p99" },
+	{ "layout", sim_layout, "          note layout table checks and per-event lookup cost" },
+	{ "log", sim_log, "[ticks]   soak run logging as text and as binary - checks they decode the same, and the speedup" },
+	{ "looper", sim_looper, "[log]    pressure loops from a binary log round trip, ring bytes per second played, cost per tick" },
+	{ "mod", sim_mod, "             modulation generator checks, DIN budget sharing, and cost per tick by generator count" },
+	{ "pack7", sim_pack7, "           8-to-7 codec round trip checks and GB/s" },
+	{ "parallel", sim_parallel, "[n [ticks]] n independent instances on n threads - isolation check and scaling by thread count" },
+	{ "route", sim_route, "           MIDI routing checks and forwarding throughput" },
+	{ "seq", sim_seq, "             step sequencer checks, and cost per tick with 8 tracks of 64 steps" },
+	{ "serve", sim_serve, "path [realtime] be a Launchpad for a test driver on a UNIX socket - see tools/simsock.h" },
+	{ "socket", sim_socket, "[path]    socket transport checks, round trip latency and messages per second by batch size" },
+	{ "sync", sim_sync, "            MIDI clock slave jitter and lock time" },
+	{ "trace", sim_trace, "[file.syx] trace ring dump checks, optionally saving the dump, and cost per tick" },
+	{ "transfer", sim_transfer, "        bulk SysEx dump/load round trip of every transfer area" },
+	{ "velocity", sim_velocity, "[trace]  velocity engine latency vs. accuracy, optionally against a recorded ADC trace" },
+};
+
+#define WORKOUT_COUNT (sizeof(WORKOUTS) / sizeof(WORKOUTS[0]))
+
+static int usage(const char *self)
+{
+	printf("usage: %s [-v level] [-l file] [workout [args]]\n\n", self);
+	printf("With no workout, gives the app a very brief smoke test.\n\n");
+	printf("  -v level  0 logs nothing, 1 app events, 2 app events and HAL calls (the default)\n");
+	printf("  -l file   log to the file as binary, which \"logdump file\" turns back into text\n\n");
+	printf("Workouts:\n\n");
+	
+	for (size_t i=0; i < WORKOUT_COUNT; ++i)
+	{
+		printf("  %s %s\n", WORKOUTS[i].name, WORKOUTS[i].help);
+	}
+	return 1;
+}
+
+static int run_workout(const char *self, int argc, char * argv[])
+{
+	for (size_t i=0; i < WORKOUT_COUNT; ++i)
+	{
+		if (strcmp(argv[0], WORKOUTS[i].name) == 0)
+		{
+			return WORKOUTS[i].run(argc - 1, argv + 1);
+		}
+	}
+	
+	return usage(self);
+}
+
+static void smoke_test()
 {
 	// let's just call a few things to give the app a very brief workout.
 	sim_app_init();
@@ -120,10 +401,58 @@ int main(int argc, char * argv[])
 	
 	// timer
 	const int timerTicks = 21;
-	printf("sending %d timer events via app_timer_event()...\n", timerTicks);
+	log_record(SIM_LOG_EVENTS, SIMLOG_TIMERS, 0, 0, 0, timerTicks, 0);
 	for (int i=0; i < timerTicks; ++i)
 	{
 		sim_app_timer_event();
 	}
-	return 0;
+}
+
+// ____________________________________________________________________________
+
+int main(int argc, char * argv[])
+{
+	FILE *log = 0;
+	int arg = 1;
+	
+	while (arg < argc && argv[arg][0] == '-')
+	{
+		if (strcmp(argv[arg], "-v") == 0 && arg + 1 < argc)
+		{
+			sim_set_log_level(atoi(argv[arg + 1]));
+		}
+		else if (strcmp(argv[arg], "-l") == 0 && arg + 1 < argc && !log)
+		{
+			if (!(log = fopen(argv[arg + 1], "wb")))
+			{
+				printf("can't write %s\n", argv[arg + 1]);
+				return 1;
+			}
+			sim_set_log_file(log, 1);
+		}
+		else
+		{
+			return usage(argv[0]);
+		}
+		
+		arg += 2;
+	}
+	
+	int result = 0;
+	
+	if (arg < argc)
+	{
+		result = run_workout(argv[0], argc - arg, argv + arg);
+	}
+	else
+	{
+		smoke_test();
+	}
+	
+	if (log)
+	{
+		sim_set_log_file(0, 0);
+		fclose(log);
+	}
+	return result;
 }
@@ -0,0 +1,164 @@
+#ifndef LAUNCHPAD_SIMULATOR_H
+#define LAUNCHPAD_SIMULATOR_H
+
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// ____________________________________________________________________________
+//
+// Shared bits of the command line simulator.  Each workout lives in its own
+// tools/sim_*.c file and is selected by name, e.g. "simulator velocity".
+// ____________________________________________________________________________
+
+#include <stdio.h>
+#include "app.h"
+
+/**
+ * A named workout.  Returns the process exit code - nonzero fails the build.
+ */
+typedef struct
+{
+	const char *name;
+	int (*run)(int argc, char *argv[]);
+	const char *help;
+} SimWorkout;
+
+/**
+ * Monotonic host time in nanoseconds, for benchmarks.
+ */
+double sim_now_ns(void);
+
+/**
+ * The host's time stamp counter, on x86 - near enough CPU cycles for comparing
+ * costs.  0 elsewhere.
+ */
+typedef unsigned long long u64;
+
+u64 sim_cycles(void);
+
+/**
+ * Small deterministic PRNG so workouts give the same numbers on every run.
+ */
+void sim_srand(u32 seed);
+u32 sim_rand(void);
+
+/**
+ * Stop the HAL logging every call to the console.
+ */
+void sim_set_quiet(int quiet);
+
+/**
+ * How much gets logged, for every thread: nothing, the app events sent in
+ * through the sim_app_* wrappers, or those and every HAL call.
+ */
+#define SIM_LOG_NONE	0
+#define SIM_LOG_EVENTS	1
+#define SIM_LOG_ALL		2
+
+void sim_set_log_level(int level);
+
+/**
+ * Log to a file instead of the console, either as text or as binary records
+ * (see simlog.h).  Binary records are buffered per thread, so a thread must
+ * call sim_log_flush before it finishes, which writes out and frees its
+ * buffer; 0 goes back to the console.
+ */
+void sim_set_log_file(FILE *file, int binary);
+void sim_log_flush(void);
+
+/**
+ * Send the app events, logging them first.
+ */
+void sim_app_init(void);
+void sim_app_surface_event(u8 type, u8 index, u8 value);
+void sim_app_midi_event(u8 port, u8 status, u8 d1, u8 d2);
+void sim_app_sysex_event(u8 port, u8 *data, u16 count);
+void sim_app_aftertouch_event(u8 index, u8 value);
+void sim_app_timer_event(void);
+
+/**
+ * Have hal_send_midi pass everything the app sends on to a workout.
+ */
+typedef void (*sim_midi_hook)(u8 port, u8 status, u8 d1, u8 d2);
+
+void sim_set_midi_hook(sim_midi_hook hook);
+
+/**
+ * Have hal_send_sysex pass everything the app sends on to a workout.
+ */
+typedef void (*sim_sysex_hook)(u8 port, const u8 *data, u16 length);
+
+void sim_set_sysex_hook(sim_sysex_hook hook);
+
+/**
+ * Have hal_plot_led pass everything the app draws on to a workout, after the
+ * LED has changed.  Workouts can call into the app from here, to play an
+ * interrupt arriving part way through a frame.
+ */
+typedef void (*sim_led_hook)(u8 type, u8 index, u8 red, u8 green, u8 blue);
+
+void sim_set_led_hook(sim_led_hook hook);
+
+/**
+ * Run the app for a test driver on a connected socket (see simsock.h) until it
+ * hangs up.  The driver sends ticks, unless realtime, when the simulator runs
+ * its own 1ms timer.  Returns 0 if it couldn't start.
+ */
+int sim_serve_connection(int fd, int realtime);
+
+// workouts
+int sim_anim(int argc, char *argv[]);
+int sim_arena(int argc, char *argv[]);
+int sim_arp(int argc, char *argv[]);
+int sim_blit(int argc, char *argv[]);
+int sim_boot(int argc, char *argv[]);
+int sim_capacity(int argc, char *argv[]);
+int sim_golden(int argc, char *argv[]);
+int sim_grid(int argc, char *argv[]);
+int sim_handoff(int argc, char *argv[]);
+int sim_latency(int argc, char *argv[]);
+int sim_layout(int argc, char *argv[]);
+int sim_log(int argc, char *argv[]);
+int sim_looper(int argc, char *argv[]);
+int sim_mod(int argc, char *argv[]);
+int sim_pack7(int argc, char *argv[]);
+int sim_parallel(int argc, char *argv[]);
+int sim_route(int argc, char *argv[]);
+int sim_seq(int argc, char *argv[]);
+int sim_serve(int argc, char *argv[]);
+int sim_socket(int argc, char *argv[]);
+int sim_sync(int argc, char *argv[]);
+int sim_trace(int argc, char *argv[]);
+int sim_transfer(int argc, char *argv[]);
+int sim_velocity(int argc, char *argv[]);
+
+#endif
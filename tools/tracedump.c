@@ -0,0 +1,152 @@
+/******************************************************************************
+ 
+ Copyright (c) 2015, Focusrite Audio Engineering Ltd.
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright notice, this
+ list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright notice,
+ this list of conditions and the following disclaimer in the documentation
+ and/or other materials provided with the distribution.
+ 
+ * Neither the name of Focusrite Audio Engineering Ltd., nor the names of its
+ contributors may be used to endorse or promote products derived from
+ this software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ 
+ *****************************************************************************/
+
+// Decodes a trace ring dump (see src/trace.h) captured from the unit as raw
+// SysEx, e.g. with "amidi -p hw:1,0 -r trace.syx" after sending the request.
+
+#include <stdio.h>
+#include "pack7.h"
+#include "sysex.h"
+#include "trace.h"
+
+static const char *EVENTS[TRACE_EVENT_COUNT] =
+{
+	"init", "timer", "surface", "midi", "sysex", "aftertouch", "cable", "boot"
+};
+
+static void print_record(const unsigned char *r)
+{
+	unsigned tick = r[0] | (r[1] << 8);
+	unsigned event = r[2];
+	unsigned cycles = 16 * (r[6] | (r[7] << 8));
+	
+	printf("%6u  %-10s  ", tick, event < TRACE_EVENT_COUNT ? EVENTS[event] : "?");
+	
+	switch (event)
+	{
+		case TRACE_INIT:
+			printf("%-22s", "");
+			break;
+			
+		case TRACE_TIMER:
+			printf("%3u ticks%13s", r[3], "");
+			break;
+			
+		case TRACE_MIDI:
+			printf("port %u  %02X %02X%9s", r[3], r[4], r[5], "");
+			break;
+			
+		case TRACE_SYSEX:
+			printf("port %u  %5u bytes%5s", r[3], (r[4] << 7) | r[5], "");
+			break;
+			
+		default:
+			printf("%3u %3u %3u%12s", r[3], r[4], r[5], "");
+			break;
+	}
+	
+	// a run of ticks shows the slowest
+	printf("%s%8u cycles\n", event == TRACE_TIMER ? "max " : "    ", cycles);
+}
+
+int main(int argc, char * argv[])
+{
+	if (argc < 2)
+	{
+		printf("usage: %s dump.syx\n", argv[0]);
+		return 1;
+	}
+	
+	FILE *f = fopen(argv[1], "rb");
+	
+	if (!f)
+	{
+		printf("can't open %s\n", argv[1]);
+		return 1;
+	}
+	
+	static unsigned char message[SYSEX_MAX_SIZE];
+	unsigned char records[TRACE_PART_RECORDS * TRACE_RECORD_SIZE + 7];
+	int length = 0;
+	int parts = 0;
+	int expected = 0;
+	int c;
+	
+	printf("  tick  event       args                          cycles\n");
+	
+	while ((c = fgetc(f)) != EOF)
+	{
+		if (c == 0xF0)
+		{
+			length = 0;
+		}
+		
+		if (length < SYSEX_MAX_SIZE)
+		{
+			message[length++] = c;
+		}
+		
+		if (c != 0xF7 || sysex_command(message, length) != SYSEX_TRACE || length < SYSEX_DATA + 3)
+		{
+			continue;
+		}
+		
+		int part = message[SYSEX_DATA];
+		int packed = length - (SYSEX_DATA + 3);
+		int count = (packed / 8) * 7 / TRACE_RECORD_SIZE;
+		
+		if (part != parts)
+		{
+			printf("part %d out of order, expected %d\n", part, parts);
+		}
+		
+		expected = message[SYSEX_DATA + 1];
+		++parts;
+		
+		unpack7(records, message + SYSEX_DATA + 2, (packed / 8) * 7);
+		
+		for (int i=0; i < count; ++i)
+		{
+			print_record(records + i * TRACE_RECORD_SIZE);
+		}
+	}
+	
+	fclose(f);
+	
+	if (parts != expected)
+	{
+		printf("got %d of %d parts\n", parts, expected);
+		return 1;
+	}
+	
+	return 0;
+}